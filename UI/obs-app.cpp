@@ -447,6 +447,12 @@ bool OBSApp::InitGlobalConfigDefaults()
 				true);
 
 	config_set_default_bool(globalConfig, "General", "ConfirmOnExit", true);
+	config_set_default_bool(globalConfig, "General", "ParallelModuleLoading",
+				false);
+	config_set_default_bool(globalConfig, "General",
+				"ParallelVideoDelivery", false);
+	config_set_default_bool(globalConfig, "General", "FastVideoConversion",
+				false);
 
 #if _WIN32
 	config_set_default_string(globalConfig, "Video", "Renderer",
@@ -1427,6 +1427,8 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 		config_get_int(main->Config(), "SimpleOutput", "RecRBTime");
 	int rbSize =
 		config_get_int(main->Config(), "SimpleOutput", "RecRBSize");
+	bool rbSpill =
+		config_get_bool(main->Config(), "SimpleOutput", "RecRBSpill");
 	int tracks =
 		config_get_int(main->Config(), "SimpleOutput", "RecTracks");
 
@@ -1446,6 +1448,8 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 		obs_data_set_int(settings, "max_time_sec", rbTime);
 		obs_data_set_int(settings, "max_size_mb",
 				 usingRecordingPreset ? rbSize : 0);
+		obs_data_set_bool(settings, "spill_to_disk",
+				  usingRecordingPreset && rbSpill);
 	} else {
 		f = GetFormatString(filenameFormat, nullptr, nullptr);
 		string strPath = GetRecordingFilename(
@@ -2582,6 +2586,7 @@ bool AdvancedOutput::StartReplayBuffer()
 	const char *rbSuffix;
 	int rbTime;
 	int rbSize;
+	bool rbSpill;
 
 	if (!useStreamEncoder) {
 		if (!ffmpegOutput)
@@ -2616,6 +2621,8 @@ bool AdvancedOutput::StartReplayBuffer()
 					     "RecRBSuffix");
 		rbTime = config_get_int(main->Config(), "AdvOut", "RecRBTime");
 		rbSize = config_get_int(main->Config(), "AdvOut", "RecRBSize");
+		rbSpill = config_get_bool(main->Config(), "AdvOut",
+					  "RecRBSpill");
 
 		string f = GetFormatString(filenameFormat, rbPrefix, rbSuffix);
 		string ext = GetFormatExt(recFormat);
@@ -2629,6 +2636,8 @@ bool AdvancedOutput::StartReplayBuffer()
 		obs_data_set_int(settings, "max_time_sec", rbTime);
 		obs_data_set_int(settings, "max_size_mb",
 				 usesBitrate ? 0 : rbSize);
+		obs_data_set_bool(settings, "spill_to_disk",
+				  !usesBitrate && rbSpill);
 
 		obs_output_update(replayBuffer, settings);
 	}
@@ -1728,6 +1728,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool(basicConfig, "SimpleOutput", "RecRB", false);
 	config_set_default_int(basicConfig, "SimpleOutput", "RecRBTime", 20);
 	config_set_default_int(basicConfig, "SimpleOutput", "RecRBSize", 512);
+	config_set_default_bool(basicConfig, "SimpleOutput", "RecRBSpill",
+				false);
 	config_set_default_string(basicConfig, "SimpleOutput", "RecRBPrefix",
 				  "Replay");
 	config_set_default_string(basicConfig, "SimpleOutput",
@@ -1781,6 +1783,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool(basicConfig, "AdvOut", "RecRB", false);
 	config_set_default_uint(basicConfig, "AdvOut", "RecRBTime", 20);
 	config_set_default_int(basicConfig, "AdvOut", "RecRBSize", 512);
+	config_set_default_bool(basicConfig, "AdvOut", "RecRBSpill", false);
 
 	config_set_default_uint(basicConfig, "Video", "BaseCX", cx);
 	config_set_default_uint(basicConfig, "Video", "BaseCY", cy);
@@ -2123,6 +2126,16 @@ void OBSBasic::OBSInit()
 	if (!ResetAudio())
 		throw "Failed to initialize audio";
 
+	char effectCachePath[512];
+	if (GetConfigPath(effectCachePath, sizeof(effectCachePath),
+			  "obs-studio") > 0)
+		obs_set_effect_cache_dir(effectCachePath);
+
+	obs_set_video_parallel_delivery(config_get_bool(
+		App()->GlobalConfig(), "General", "ParallelVideoDelivery"));
+	obs_set_video_fast_conversion(config_get_bool(
+		App()->GlobalConfig(), "General", "FastVideoConversion"));
+
 	ret = ResetVideo();
 
 	switch (ret) {
@@ -2168,10 +2181,18 @@ void OBSBasic::OBSInit()
 		AddExtraModulePaths();
 	}
 
+	bool parallelModules = config_get_bool(
+		App()->GlobalConfig(), "General", "ParallelModuleLoading");
+	obs_set_parallel_module_loading(parallelModules);
+
 	blog(LOG_INFO, "---------------------------------");
 	obs_load_all_modules2(&mfi);
 	blog(LOG_INFO, "---------------------------------");
 	obs_log_loaded_modules();
+	if (parallelModules) {
+		blog(LOG_INFO, "---------------------------------");
+		obs_log_module_load_times();
+	}
 	blog(LOG_INFO, "---------------------------------");
 	obs_post_load_modules();
 
@@ -14,8 +14,13 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <inttypes.h>
+#include <sys/stat.h>
+
 #include <media-io/audio-io.h>
+#include <media-io/video-frame.h>
 #include <util/platform.h>
+#include <util/dstr.h>
 
 #include "media-playback.h"
 #include "cache.h"
@@ -32,8 +37,12 @@ static bool mp_cache_reset(mp_cache_t *c);
 
 static int64_t base_sys_ts = 0;
 
-#define v_eof(c) (c->cur_v_idx == c->video_frames.num)
-#define a_eof(c) (c->cur_a_idx == c->audio_segments.num)
+/* if the packets are not at least this many times smaller than the decoded
+ * frames, the decoded frames are cached instead */
+#define MIN_PACKET_RATIO 2
+
+#define v_eof(c) (c->cur_v_idx == c->store->video_frames.num)
+#define a_eof(c) (c->cur_a_idx == c->store->audio_segments.num)
 
 static inline int64_t mp_cache_get_next_min_pts(mp_cache_t *c)
 {
@@ -111,84 +120,691 @@ static bool mp_cache_eof(mp_cache_t *c)
 	return true;
 }
 
-bool mp_cache_decode(mp_cache_t *c)
+/* ------------------------------------------------------------------------- */
+/* packet mode */
+
+static inline int64_t packet_ts(mp_cache_t *c, const AVPacket *pkt)
+{
+	int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+	if (ts == AV_NOPTS_VALUE)
+		return INT64_MAX;
+
+	ts = av_rescale_q(ts, c->m.v.stream->time_base,
+			  (AVRational){1, 1000000000});
+	if (c->m.speed != 100)
+		ts = av_rescale_q(ts, (AVRational){1, c->m.speed},
+				  (AVRational){1, 100});
+	return ts;
+}
+
+static void record_packet(void *opaque, const AVPacket *pkt)
+{
+	mp_cache_t *c = opaque;
+	struct mp_cache_store *store = c->store;
+	AVPacket *copy;
+
+	if (!c->recording)
+		return;
+
+	copy = av_packet_clone(pkt);
+	if (!copy)
+		return;
+
+	if (pkt->flags & AV_PKT_FLAG_KEY) {
+		struct mp_cache_keyframe kf = {store->packets.num,
+					       packet_ts(c, pkt)};
+		da_push_back(store->keyframes, &kf);
+	}
+
+	da_push_back(store->packets, &copy);
+	store->packet_bytes += (uint64_t)pkt->size;
+}
+
+static int read_packet(void *opaque, AVPacket *pkt)
+{
+	mp_cache_t *c = opaque;
+	struct mp_cache_store *store = c->store;
+
+	if (c->read_packet_idx == store->packets.num)
+		return AVERROR_EOF;
+
+	return av_packet_ref(pkt, store->packets.array[c->read_packet_idx++]);
+}
+
+static void free_packets(struct mp_cache_store *store)
+{
+	for (size_t i = 0; i < store->packets.num; i++)
+		av_packet_free(&store->packets.array[i]);
+	da_free(store->packets);
+	da_free(store->keyframes);
+	store->packet_bytes = 0;
+}
+
+static void free_frames(struct mp_cache_store *store)
+{
+	for (size_t i = 0; i < store->video_frames.num; i++) {
+		struct obs_source_frame *f = &store->video_frames.array[i];
+		obs_source_frame_free(f);
+	}
+	for (size_t i = 0; i < store->audio_segments.num; i++) {
+		struct obs_source_audio *a = &store->audio_segments.array[i];
+		bfree((void *)a->data[0]);
+	}
+	da_free(store->video_frames);
+	da_free(store->audio_segments);
+	store->raw_bytes = 0;
+	store->audio_bytes = 0;
+}
+
+/* includes the window of one cache */
+static uint64_t get_resident_bytes(struct mp_cache_store *store)
 {
+	uint64_t frame_size;
+
+	if (!store->packet_mode || !store->video_frames.num)
+		return store->raw_bytes + store->audio_bytes;
+
+	/* the first frame, and the frames of the window */
+	frame_size = store->raw_bytes / store->video_frames.num;
+	return store->packet_bytes +
+	       frame_size * (MP_CACHE_WINDOW_FRAMES + 1) + store->audio_bytes;
+}
+
+/* ------------------------------------------------------------------------- */
+/* shared stores */
+
+static pthread_mutex_t stores_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct mp_cache_store *) stores;
+
+static char *get_store_key(mp_cache_t *c, const struct mp_media_info *info)
+{
+	struct dstr key = {0};
+	struct stat st = {0};
+
+	os_stat(info->path, &st);
+
+	dstr_printf(&key, "%s\n%s\n%s\n%d %d %d %d %lld", info->path,
+		    info->format ? info->format : "",
+		    info->ffmpeg_options ? info->ffmpeg_options : "",
+		    c->m.speed, (int)info->force_range, info->is_linear_alpha,
+		    info->hardware_decoding, (long long)st.st_mtime);
+	return key.array;
+}
+
+/* returns the store decoded by another cache, or a new one that this cache
+ * has to decode */
+static struct mp_cache_store *get_store(mp_cache_t *c,
+					const struct mp_media_info *info)
+{
+	struct mp_cache_store *store = NULL;
+	char *key = get_store_key(c, info);
+
+	pthread_mutex_lock(&stores_mutex);
+
+	for (size_t i = 0; i < stores.num; i++) {
+		struct mp_cache_store *cur = stores.array[i];
+		if (!cur->failed && strcmp(cur->key, key) == 0) {
+			store = cur;
+			break;
+		}
+	}
+
+	if (store) {
+		store->refs++;
+		bfree(key);
+	} else {
+		store = bzalloc(sizeof(*store));
+		store->key = key;
+		store->refs = 1;
+		os_event_init(&store->ready, OS_EVENT_TYPE_MANUAL);
+		da_push_back(stores, &store);
+		c->store_owner = true;
+	}
+
+	pthread_mutex_unlock(&stores_mutex);
+	return store;
+}
+
+static void set_store_loaded(struct mp_cache_store *store, bool success)
+{
+	pthread_mutex_lock(&stores_mutex);
+	store->loaded = true;
+	store->failed = !success;
+	pthread_mutex_unlock(&stores_mutex);
+
+	os_event_signal(store->ready);
+}
+
+/* leaves the store to one of the caches waiting for it, which then decodes
+ * the file instead */
+static void abandon_store(mp_cache_t *c)
+{
+	struct mp_cache_store *store = c->store;
+
+	pthread_mutex_lock(&stores_mutex);
+	if (!store->loaded) {
+		store->abandoned = true;
+		os_event_signal(store->ready);
+	}
+	pthread_mutex_unlock(&stores_mutex);
+
+	c->store_owner = false;
+}
+
+/* waits until the store is loaded, returns true if it was abandoned and this
+ * cache has to decode the file in its place */
+static bool wait_for_store(mp_cache_t *c)
+{
+	struct mp_cache_store *store = c->store;
+	bool done;
+
+	do {
+		os_event_wait(store->ready);
+
+		pthread_mutex_lock(&stores_mutex);
+		if (store->abandoned) {
+			store->abandoned = false;
+			os_event_reset(store->ready);
+			c->store_owner = true;
+		}
+		done = store->loaded || c->store_owner;
+		pthread_mutex_unlock(&stores_mutex);
+	} while (!done);
+
+	return c->store_owner;
+}
+
+static void release_store(struct mp_cache_store *store)
+{
+	bool destroy;
+
+	if (!store)
+		return;
+
+	pthread_mutex_lock(&stores_mutex);
+	destroy = --store->refs == 0;
+	if (destroy)
+		da_erase_item(stores, &store);
+	pthread_mutex_unlock(&stores_mutex);
+
+	if (!destroy)
+		return;
+
+	free_packets(store);
+	free_frames(store);
+	os_event_destroy(store->ready);
+	bfree(store->key);
+	bfree(store);
+}
+
+static inline double to_mb(uint64_t bytes)
+{
+	return (double)bytes / (1024.0 * 1024.0);
+}
+
+static inline bool window_frame_ready(mp_cache_t *c,
+				      struct mp_cache_window_frame *wf,
+				      int64_t ts)
+{
+	return wf->lap > c->read_lap ||
+	       (wf->lap == c->read_lap && (int64_t)wf->frame.timestamp >= ts);
+}
+
+/* returns the decoded frame with the given timestamp.  older frames are
+ * dropped, except for the last one of the current lap: if the decode thread
+ * has not gotten to the frame yet, that one is returned again instead of
+ * waiting for it, so playback never stalls on the decoder.  returns NULL if
+ * there is no such frame, or if the frame failed to decode. */
+static struct obs_source_frame *window_get(mp_cache_t *c, int64_t ts)
+{
+	struct obs_source_frame *frame = NULL;
+	struct mp_cache_window_frame *wf;
+	bool more;
+
+	pthread_mutex_lock(&c->window_mutex);
+
+	more = !c->window_end && !c->decode_stop;
+
+	while (c->window_count) {
+		wf = &c->window[c->window_head];
+		if (window_frame_ready(c, wf, ts))
+			break;
+		if (c->window_count == 1 && more && wf->lap == c->read_lap)
+			break;
+
+		c->window_head = (c->window_head + 1) % MP_CACHE_WINDOW_FRAMES;
+		c->window_count--;
+		os_sem_post(c->decode_sem);
+	}
+
+	if (c->window_count) {
+		wf = &c->window[c->window_head];
+		if (wf->lap == c->read_lap &&
+		    (int64_t)wf->frame.timestamp <= ts)
+			frame = &wf->frame;
+	}
+
+	pthread_mutex_unlock(&c->window_mutex);
+	return frame;
+}
+
+static void window_restart(mp_cache_t *c, int64_t ts)
+{
+	pthread_mutex_lock(&c->window_mutex);
+	if (c->write_lap > c->read_lap)
+		c->read_lap = c->write_lap;
+	c->restart_lap = ++c->read_lap;
+	c->restart_ts = ts;
+	c->restart = true;
+	c->window_count = 0;
+	c->window_end = false;
+	pthread_mutex_unlock(&c->window_mutex);
+
+	os_sem_post(c->decode_sem);
+}
+
+/* when looping, the decode thread will usually have started on the next lap
+ * already, in which case it just has to be picked up */
+static void window_rewind(mp_cache_t *c)
+{
+	bool next_lap;
+
+	pthread_mutex_lock(&c->window_mutex);
+	next_lap = !c->restart && c->write_lap > c->read_lap;
+	if (next_lap)
+		c->read_lap++;
+	pthread_mutex_unlock(&c->window_mutex);
+
+	if (!next_lap)
+		window_restart(c, INT64_MIN);
+}
+
+static void window_seek(mp_cache_t *c, size_t idx)
+{
+	int64_t ts = (int64_t)c->store->video_frames.array[idx].timestamp;
+	bool in_window = false;
+
+	pthread_mutex_lock(&c->window_mutex);
+	if (!c->restart && c->window_count) {
+		size_t last = (c->window_head + c->window_count - 1) %
+			      MP_CACHE_WINDOW_FRAMES;
+		struct mp_cache_window_frame *first =
+			&c->window[c->window_head];
+
+		in_window = first->lap == c->read_lap &&
+			    c->window[last].lap == c->read_lap &&
+			    (int64_t)first->frame.timestamp <= ts &&
+			    (int64_t)c->window[last].frame.timestamp >= ts;
+	}
+	pthread_mutex_unlock(&c->window_mutex);
+
+	if (!in_window)
+		window_restart(c, ts);
+}
+
+/* decoding restarts from the last keyframe at or before the frame */
+static void decode_restart(mp_cache_t *c, int64_t ts)
+{
+	struct mp_cache_store *store = c->store;
 	mp_media_t *m = &c->m;
-	bool success = false;
+	size_t packet_idx = 0;
+
+	for (size_t i = 0; i < store->keyframes.num; i++) {
+		struct mp_cache_keyframe *kf = &store->keyframes.array[i];
+		if (kf->ts <= ts && kf->packet_idx > packet_idx)
+			packet_idx = kf->packet_idx;
+	}
+
+	c->read_packet_idx = packet_idx;
+	c->skip_ts = ts;
+	c->lap_frames = 0;
+
+	mp_decode_flush(&m->v);
+	m->eof = false;
+}
+
+static void decode_next_frame(mp_cache_t *c)
+{
+	mp_media_t *m = &c->m;
+	uint64_t start = os_gettime_ns();
+	bool success = mp_media_prepare_frames(m);
+
+	if (success && m->v.frame_ready) {
+		mp_media_next_video(m, false);
+	} else {
+		bool looping;
+
+		pthread_mutex_lock(&c->mutex);
+		looping = c->looping;
+		pthread_mutex_unlock(&c->mutex);
+
+		if (success && looping && c->lap_frames) {
+			decode_restart(c, INT64_MIN);
+
+			pthread_mutex_lock(&c->window_mutex);
+			c->write_lap++;
+			pthread_mutex_unlock(&c->window_mutex);
+		} else {
+			pthread_mutex_lock(&c->window_mutex);
+			c->window_end = true;
+			pthread_mutex_unlock(&c->window_mutex);
+		}
+	}
+
+	pthread_mutex_lock(&c->window_mutex);
+	c->decode_time_ns += os_gettime_ns() - start;
+	pthread_mutex_unlock(&c->window_mutex);
+}
+
+static void *mp_cache_decode_thread(void *opaque)
+{
+	mp_cache_t *c = opaque;
+
+	os_set_thread_name("mp_cache_decode_thread");
+
+	for (;;) {
+		bool restart;
+		bool idle;
+		int64_t ts;
+
+		pthread_mutex_lock(&c->window_mutex);
+		if (c->decode_stop) {
+			pthread_mutex_unlock(&c->window_mutex);
+			break;
+		}
+
+		restart = c->restart;
+		ts = c->restart_ts;
+		if (restart) {
+			c->write_lap = c->restart_lap;
+			c->restart = false;
+		}
+
+		idle = c->window_count == MP_CACHE_WINDOW_FRAMES ||
+		       c->window_end;
+		pthread_mutex_unlock(&c->window_mutex);
+
+		if (restart)
+			decode_restart(c, ts);
+		else if (idle)
+			os_sem_wait(c->decode_sem);
+		else
+			decode_next_frame(c);
+	}
+
+	return NULL;
+}
+
+static void fill_window(void *data, struct obs_source_frame *frame)
+{
+	mp_cache_t *c = data;
+	struct mp_cache_window_frame *wf;
+	int64_t ts = (int64_t)frame->timestamp;
+
+	/* the first frame is always kept decoded */
+	if (ts < c->skip_ts ||
+	    ts == (int64_t)c->store->video_frames.array[0].timestamp)
+		return;
+
+	/* the next free slot is never read by the playback thread */
+	pthread_mutex_lock(&c->window_mutex);
+	wf = &c->window[(c->window_head + c->window_count) %
+			MP_CACHE_WINDOW_FRAMES];
+	pthread_mutex_unlock(&c->window_mutex);
+
+	if (!wf->frame.data[0] || wf->frame.format != frame->format ||
+	    wf->frame.width != frame->width ||
+	    wf->frame.height != frame->height) {
+		obs_source_frame_free(&wf->frame);
+		obs_source_frame_init(&wf->frame, frame->format, frame->width,
+				      frame->height);
+	}
+
+	obs_source_frame_copy(&wf->frame, frame);
 
+	pthread_mutex_lock(&c->window_mutex);
+	if (!c->restart) {
+		wf->lap = c->write_lap;
+		c->window_count++;
+		c->decoded_frames++;
+		c->lap_frames++;
+	}
+	pthread_mutex_unlock(&c->window_mutex);
+}
+
+static bool start_decode_thread(mp_cache_t *c)
+{
+	mp_media_t *m = &c->m;
+
+	/* the decoder is kept for playback, only video is decoded again */
 	m->full_decode = true;
+	m->packet_cb = NULL;
+	m->read_packet_cb = read_packet;
+	m->v_cb = fill_window;
+	m->has_audio = false;
+	mp_decode_free(&m->a);
+
+	c->restart_ts = INT64_MIN;
+	c->restart = true;
+
+	if (pthread_create(&c->decode_thread, NULL, mp_cache_decode_thread,
+			   c) != 0) {
+		blog(LOG_WARNING, "MP: Could not create cache decode thread");
+		return false;
+	}
+
+	c->decode_thread_valid = true;
+	return true;
+}
+
+static void stop_decode_thread(mp_cache_t *c)
+{
+	if (!c->decode_thread_valid)
+		return;
+
+	pthread_mutex_lock(&c->window_mutex);
+	c->decode_stop = true;
+	pthread_mutex_unlock(&c->window_mutex);
+
+	os_sem_post(c->decode_sem);
+	pthread_join(c->decode_thread, NULL);
+	c->decode_thread_valid = false;
+
+	if (c->decoded_frames) {
+		blog(LOG_INFO,
+		     "MP: '%s': decoded %" PRIu64 " cached frames during "
+		     "playback, %.2f ms per frame",
+		     c->path, c->decoded_frames,
+		     (double)c->decode_time_ns /
+			     (double)c->decoded_frames / 1000000.0);
+	}
+}
 
+/* ------------------------------------------------------------------------- */
+
+static bool mp_cache_killed(mp_cache_t *c)
+{
+	bool kill;
+
+	pthread_mutex_lock(&c->mutex);
+	kill = c->kill;
+	pthread_mutex_unlock(&c->mutex);
+	return kill;
+}
+
+static bool mp_cache_decode_pass(mp_cache_t *c)
+{
+	mp_media_t *m = &c->m;
+
+	c->recording = c->store->packet_mode;
 	mp_media_reset(m);
 
 	while (!mp_media_eof(m)) {
+		if (mp_cache_killed(c))
+			return false;
+
 		if (m->has_video)
 			mp_media_next_video(m, false);
 		if (m->has_audio)
 			mp_media_next_audio(m);
 
 		if (!mp_media_prepare_frames(m))
+			return false;
+
+		/* everything has been demuxed, mp_media_eof will seek back to
+		 * the start once the decoders are drained */
+		if (m->eof)
+			c->recording = false;
+	}
+
+	c->recording = false;
+	return true;
+}
+
+bool mp_cache_decode(mp_cache_t *c)
+{
+	struct mp_cache_store *store = c->store;
+	mp_media_t *m = &c->m;
+	bool success = false;
+
+	/* left over by a cache that was destroyed while decoding */
+	free_packets(store);
+	free_frames(store);
+
+	m->full_decode = true;
+	m->packet_cb = record_packet;
+	store->packet_mode = c->has_video;
+
+	if (!mp_cache_decode_pass(c))
+		goto fail;
+
+	if (store->packet_mode &&
+	    store->packet_bytes * MIN_PACKET_RATIO > store->raw_bytes) {
+		blog(LOG_INFO,
+		     "MP: '%s' does not compress well, caching decoded "
+		     "frames instead",
+		     c->path);
+
+		free_packets(store);
+		free_frames(store);
+		store->packet_mode = false;
+
+		if (!mp_cache_decode_pass(c))
 			goto fail;
 	}
 
+	if (store->packet_mode && store->video_frames.num < 2) {
+		free_packets(store);
+		store->packet_mode = false;
+	}
+
 	success = true;
 
-	c->start_time = c->m.fmt->start_time;
-	if (c->start_time == AV_NOPTS_VALUE)
-		c->start_time = 0;
+	store->start_time = c->m.fmt->start_time;
+	if (store->start_time == AV_NOPTS_VALUE)
+		store->start_time = 0;
+
+	blog(LOG_INFO,
+	     "MP: Cached '%s': %zu frames, %.1f MB in memory "
+	     "(%.1f MB as decoded frames)",
+	     c->path, store->video_frames.num,
+	     to_mb(get_resident_bytes(store)),
+	     to_mb(store->raw_bytes + store->audio_bytes));
+
+	if (store->packet_mode)
+		return true;
 
 fail:
 	mp_media_free(m);
 	return success;
 }
 
+/* the first cache of a file decodes it, the others wait for it to finish.
+ * if it is destroyed before that, the next one in line takes over */
+static bool mp_cache_load(mp_cache_t *c)
+{
+	struct mp_cache_store *store = c->store;
+	bool success;
+
+	if (c->store_owner || wait_for_store(c)) {
+		success = mp_cache_decode(c);
+		if (!success && mp_cache_killed(c))
+			abandon_store(c);
+		else
+			set_store_loaded(store, success);
+	} else {
+		pthread_mutex_lock(&stores_mutex);
+		success = !store->failed;
+		pthread_mutex_unlock(&stores_mutex);
+
+		if (success) {
+			blog(LOG_INFO, "MP: Sharing cached '%s'", c->path);
+		}
+		if (!success || !store->packet_mode) {
+			mp_media_free(&c->m);
+		}
+	}
+
+	if (success && store->packet_mode)
+		success = start_decode_thread(c);
+	return success;
+}
+
 static void seek_to(mp_cache_t *c, int64_t pos)
 {
+	struct mp_cache_store *store = c->store;
 	size_t new_v_idx = 0;
 	size_t new_a_idx = 0;
+	int64_t pos_ns;
 
 	if (pos > c->media_duration) {
 		blog(LOG_WARNING, "MP: Invalid seek position");
 		return;
 	}
 
+	/* the position is in microseconds, the cached timestamps are in
+	 * nanoseconds */
+	pos_ns = pos * 1000;
+
 	if (c->has_video) {
 		struct obs_source_frame *v;
 
-		for (size_t i = 0; i < c->video_frames.num; i++) {
-			v = &c->video_frames.array[i];
+		for (size_t i = 0; i < store->video_frames.num; i++) {
+			v = &store->video_frames.array[i];
 			new_v_idx = i;
-			if ((int64_t)v->timestamp >= pos) {
+			if ((int64_t)v->timestamp >= pos_ns) {
 				break;
 			}
 		}
 
 		size_t next_idx = new_v_idx + 1;
-		if (next_idx == c->video_frames.num) {
+		if (next_idx == store->video_frames.num) {
 			c->next_v_ts =
-				(int64_t)v->timestamp + c->final_v_duration;
+				(int64_t)v->timestamp + store->final_v_duration;
 		} else {
 			struct obs_source_frame *next =
-				&c->video_frames.array[next_idx];
+				&store->video_frames.array[next_idx];
 			c->next_v_ts = (int64_t)next->timestamp;
 		}
 	}
 	if (c->has_audio) {
 		struct obs_source_audio *a;
-		for (size_t i = 0; i < c->audio_segments.num; i++) {
-			a = &c->audio_segments.array[i];
+		for (size_t i = 0; i < store->audio_segments.num; i++) {
+			a = &store->audio_segments.array[i];
 			new_a_idx = i;
-			if ((int64_t)a->timestamp >= pos) {
+			if ((int64_t)a->timestamp >= pos_ns) {
 				break;
 			}
 		}
 
 		size_t next_idx = new_a_idx + 1;
-		if (next_idx == c->audio_segments.num) {
+		if (next_idx == store->audio_segments.num) {
 			c->next_a_ts =
-				(int64_t)a->timestamp + c->final_a_duration;
+				(int64_t)a->timestamp + store->final_a_duration;
 		} else {
 			struct obs_source_audio *next =
-				&c->audio_segments.array[next_idx];
+				&store->audio_segments.array[next_idx];
 			c->next_a_ts = (int64_t)next->timestamp;
 		}
 	}
@@ -214,13 +830,15 @@ static inline bool mp_media_can_play_audio(mp_cache_t *c)
 
 static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 {
+	struct mp_cache_store *store = c->store;
 	int64_t offset;
-	if (c->next_v_idx < c->video_frames.num) {
+
+	if (c->next_v_idx < store->video_frames.num) {
 		struct obs_source_frame *next =
-			&c->video_frames.array[c->next_v_idx];
+			&store->video_frames.array[c->next_v_idx];
 		offset = (int64_t)(next->timestamp - frame->timestamp);
 	} else {
-		offset = c->final_v_duration;
+		offset = store->final_v_duration;
 	}
 
 	c->next_v_ts += offset;
@@ -228,45 +846,65 @@ static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 
 static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 {
+	struct mp_cache_store *store = c->store;
 	int64_t offset;
-	if (c->next_a_idx < c->audio_segments.num) {
+
+	if (c->next_a_idx < store->audio_segments.num) {
 		struct obs_source_audio *next =
-			&c->audio_segments.array[c->next_a_idx];
+			&store->audio_segments.array[c->next_a_idx];
 		offset = (int64_t)(next->timestamp - audio->timestamp);
 	} else {
-		offset = c->final_a_duration;
+		offset = store->final_a_duration;
 	}
 
 	c->next_a_ts += offset;
 }
 
+static bool get_video_frame(mp_cache_t *c,
+			    const struct obs_source_frame *frame,
+			    struct obs_source_frame *dup)
+{
+	uint64_t ts = frame->timestamp;
+
+	if (!frame->data[0]) {
+		frame = window_get(c, (int64_t)ts);
+		if (!frame)
+			return false;
+	}
+
+	*dup = *frame;
+	dup->timestamp = c->base_ts + ts - c->start_ts + c->play_sys_ts -
+			 base_sys_ts;
+	return true;
+}
+
 static void mp_cache_next_video(mp_cache_t *c, bool preload)
 {
+	struct mp_cache_store *store = c->store;
+
 	/* eof check */
-	if (c->next_v_idx == c->video_frames.num) {
+	if (c->next_v_idx == store->video_frames.num) {
 		if (mp_media_can_play_video(c))
 			c->cur_v_idx = c->next_v_idx;
 		return;
 	}
 
-	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
-	struct obs_source_frame dup = *frame;
-
-	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
-			c->play_sys_ts - base_sys_ts;
+	struct obs_source_frame *frame =
+		&store->video_frames.array[c->next_v_idx];
+	struct obs_source_frame dup;
 
 	if (!preload) {
 		if (!mp_media_can_play_video(c))
 			return;
 
-		if (c->v_cb)
+		if (c->v_cb && get_video_frame(c, frame, &dup))
 			c->v_cb(c->opaque, &dup);
 
 		if (c->cur_v_idx < c->next_v_idx)
 			++c->cur_v_idx;
 		++c->next_v_idx;
 		calc_next_v_ts(c, frame);
-	} else {
+	} else if (get_video_frame(c, frame, &dup)) {
 		if (c->seek_next_ts && c->v_seek_cb) {
 			c->v_seek_cb(c->opaque, &dup);
 		} else if (!c->request_preload) {
@@ -277,8 +915,10 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 
 static void mp_cache_next_audio(mp_cache_t *c)
 {
+	struct mp_cache_store *store = c->store;
+
 	/* eof check */
-	if (c->next_a_idx == c->audio_segments.num) {
+	if (c->next_a_idx == store->audio_segments.num) {
 		if (mp_media_can_play_audio(c))
 			c->cur_a_idx = c->next_a_idx;
 		return;
@@ -288,7 +928,7 @@ static void mp_cache_next_audio(mp_cache_t *c)
 		return;
 
 	struct obs_source_audio *audio =
-		&c->audio_segments.array[c->next_a_idx];
+		&store->audio_segments.array[c->next_a_idx];
 	struct obs_source_audio dup = *audio;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
@@ -304,12 +944,13 @@ static void mp_cache_next_audio(mp_cache_t *c)
 
 static bool mp_cache_reset(mp_cache_t *c)
 {
+	struct mp_cache_store *store = c->store;
 	bool stopping;
 	bool active;
 
 	int64_t next_ts = mp_cache_get_base_pts(c);
 	int64_t offset = next_ts - c->next_pts_ns;
-	int64_t start_time = c->start_time;
+	int64_t start_time = store->start_time;
 
 	c->eof = false;
 	c->base_ts += next_ts;
@@ -324,15 +965,17 @@ static bool mp_cache_reset(mp_cache_t *c)
 	pthread_mutex_unlock(&c->mutex);
 
 	if (c->has_video) {
-		size_t next_idx = c->video_frames.num > 1 ? 1 : 0;
+		size_t next_idx = store->video_frames.num > 1 ? 1 : 0;
 		c->cur_v_idx = c->next_v_idx = 0;
-		c->next_v_ts = c->video_frames.array[next_idx].timestamp;
+		c->next_v_ts = store->video_frames.array[next_idx].timestamp;
 	}
 	if (c->has_audio) {
-		size_t next_idx = c->audio_segments.num > 1 ? 1 : 0;
+		size_t next_idx = store->audio_segments.num > 1 ? 1 : 0;
 		c->cur_a_idx = c->next_a_idx = 0;
-		c->next_a_ts = c->audio_segments.array[next_idx].timestamp;
+		c->next_a_ts = store->audio_segments.array[next_idx].timestamp;
 	}
+	if (store->packet_mode)
+		window_rewind(c);
 
 	if (active) {
 		if (!c->play_sys_ts)
@@ -381,8 +1024,9 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 {
 	os_set_thread_name("mp_cache_thread");
 
-	if (!mp_cache_decode(c)) {
-		return false;
+	/* being destroyed during loading is not a failure */
+	if (!mp_cache_load(c)) {
+		return mp_cache_killed(c);
 	}
 
 	for (;;) {
@@ -434,6 +1078,8 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 		if (seek) {
 			c->seek_next_ts = true;
 			seek_to(c, seek_pos);
+			if (c->store->packet_mode)
+				window_seek(c, c->next_v_idx);
 			continue;
 		}
 
@@ -446,7 +1092,8 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 			continue;
 
 		if (preload_frame)
-			c->v_preload_cb(c->opaque, &c->video_frames.array[0]);
+			c->v_preload_cb(c->opaque,
+					&c->store->video_frames.array[0]);
 
 		/* frames are ready */
 		if (is_active && !timeout) {
@@ -481,21 +1128,32 @@ static void *mp_cache_thread_start(void *opaque)
 static void fill_video(void *data, struct obs_source_frame *frame)
 {
 	mp_cache_t *c = data;
+	struct mp_cache_store *store = c->store;
 	struct obs_source_frame dup;
 
-	obs_source_frame_init(&dup, frame->format, frame->width, frame->height);
-	obs_source_frame_copy(&dup, frame);
+	store->raw_bytes += video_frame_get_data_size(
+		frame->format, frame->width, frame->height);
+
+	if (store->packet_mode && store->video_frames.num) {
+		dup = *frame;
+		memset(dup.data, 0, sizeof(dup.data));
+	} else {
+		obs_source_frame_init(&dup, frame->format, frame->width,
+				      frame->height);
+		obs_source_frame_copy(&dup, frame);
+	}
 
 	dup.timestamp = frame->timestamp;
 
-	c->final_v_duration = c->m.v.last_duration;
+	store->final_v_duration = c->m.v.last_duration;
 
-	da_push_back(c->video_frames, &dup);
+	da_push_back(store->video_frames, &dup);
 }
 
 static void fill_audio(void *data, struct obs_source_audio *audio)
 {
 	mp_cache_t *c = data;
+	struct mp_cache_store *store = c->store;
 	struct obs_source_audio dup = *audio;
 
 	size_t size =
@@ -518,9 +1176,11 @@ static void fill_audio(void *data, struct obs_source_audio *audio)
 		memcpy((uint8_t *)dup.data[0], audio->data[0], size);
 	}
 
-	c->final_a_duration = c->m.a.last_duration;
+	store->final_a_duration = c->m.a.last_duration;
+	store->audio_bytes += get_total_audio_size(dup.format, dup.speakers,
+					       dup.frames);
 
-	da_push_back(c->audio_segments, &dup);
+	da_push_back(store->audio_segments, &dup);
 }
 
 static inline bool mp_cache_init_internal(mp_cache_t *c,
@@ -534,6 +1194,14 @@ static inline bool mp_cache_init_internal(mp_cache_t *c,
 		blog(LOG_WARNING, "MP: Failed to init semaphore");
 		return false;
 	}
+	if (pthread_mutex_init(&c->window_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init mutex");
+		return false;
+	}
+	if (os_sem_init(&c->decode_sem, 0) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init semaphore");
+		return false;
+	}
 
 	c->path = info->path ? bstrdup(info->path) : NULL;
 	c->format_name = info->format ? bstrdup(info->format) : NULL;
@@ -556,12 +1224,14 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	info2.a_cb = fill_audio;
 	info2.v_preload_cb = NULL;
 	info2.v_seek_cb = NULL;
+	info2.v_borrow_cb = NULL;
 	info2.stop_cb = NULL;
 	info2.full_decode = true;
 
 	mp_media_t *m = &c->m;
 
 	pthread_mutex_init_value(&c->mutex);
+	pthread_mutex_init_value(&c->window_mutex);
 
 	if (!mp_media_init(m, &info2)) {
 		mp_cache_free(c);
@@ -585,6 +1255,7 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 
 	c->has_video = m->has_video;
 	c->has_audio = m->has_audio;
+	c->store = get_store(c, info);
 
 	if (!base_sys_ts)
 		base_sys_ts = (int64_t)os_gettime_ns();
@@ -616,25 +1287,25 @@ void mp_cache_free(mp_cache_t *c)
 
 	mp_cache_stop(c);
 	mp_kill_thread(c);
+	stop_decode_thread(c);
+
+	/* don't leave other caches waiting if the file was never decoded */
+	if (c->store_owner)
+		abandon_store(c);
 
 	if (c->m.fmt)
 		mp_media_free(&c->m);
 
-	for (size_t i = 0; i < c->video_frames.num; i++) {
-		struct obs_source_frame *f = &c->video_frames.array[i];
-		obs_source_frame_free(f);
-	}
-	for (size_t i = 0; i < c->audio_segments.num; i++) {
-		struct obs_source_audio *a = &c->audio_segments.array[i];
-		bfree((void *)a->data[0]);
-	}
-	da_free(c->video_frames);
-	da_free(c->audio_segments);
+	release_store(c->store);
+	for (size_t i = 0; i < MP_CACHE_WINDOW_FRAMES; i++)
+		obs_source_frame_free(&c->window[i].frame);
 
 	bfree(c->path);
 	bfree(c->format_name);
 	pthread_mutex_destroy(&c->mutex);
+	pthread_mutex_destroy(&c->window_mutex);
 	os_sem_destroy(c->sem);
+	os_sem_destroy(c->decode_sem);
 	memset(c, 0, sizeof(*c));
 }
 
@@ -707,10 +1378,32 @@ void mp_cache_seek(mp_cache_t *c, int64_t pos)
 
 int64_t mp_cache_get_frames(mp_cache_t *c)
 {
-	return c->video_frames.num;
+	return c->store->video_frames.num;
 }
 
 int64_t mp_cache_get_duration(mp_cache_t *c)
 {
 	return c->media_duration;
 }
+
+bool mp_cache_get_stats(mp_cache_t *c, struct mp_cache_stats *stats)
+{
+	struct mp_cache_store *store = c->store;
+
+	if (!stats)
+		return false;
+
+	pthread_mutex_lock(&stores_mutex);
+	stats->users = (uint32_t)store->refs;
+	pthread_mutex_unlock(&stores_mutex);
+
+	pthread_mutex_lock(&c->window_mutex);
+	stats->frames = store->video_frames.num;
+	stats->resident_bytes = get_resident_bytes(store);
+	stats->raw_bytes = store->raw_bytes;
+	stats->decoded_frames = c->decoded_frames;
+	stats->decode_time_ns = c->decode_time_ns;
+	stats->packet_mode = store->packet_mode;
+	pthread_mutex_unlock(&c->window_mutex);
+	return true;
+}
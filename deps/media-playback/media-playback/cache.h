@@ -22,6 +22,49 @@
 
 #include "media.h"
 
+#define MP_CACHE_WINDOW_FRAMES 8
+
+struct mp_cache_keyframe {
+	size_t packet_idx;
+	int64_t ts;
+};
+
+/* lap is incremented every time the decoder starts over, so that frames of
+ * the next loop can be decoded ahead while the current one is playing */
+struct mp_cache_window_frame {
+	struct obs_source_frame frame;
+	uint64_t lap;
+};
+
+/* the decoded media is shared by every cache of the same file with the same
+ * decode settings, each of which only keeps its own playback position */
+struct mp_cache_store {
+	char *key;
+	long refs;
+	os_event_t *ready;
+	bool loaded;
+	bool failed;
+	bool abandoned; /* the decoding cache was destroyed before it finished */
+
+	DARRAY(struct obs_source_frame) video_frames;
+	DARRAY(struct obs_source_audio) audio_segments;
+
+	int64_t final_v_duration;
+	int64_t final_a_duration;
+	int64_t start_time;
+
+	/* in packet mode, only the first video frame is kept decoded, the
+	 * others only keep their metadata.  the demuxed packets are kept
+	 * instead, and each cache decodes them ahead of playback into a small
+	 * window of its own */
+	bool packet_mode;
+	DARRAY(AVPacket *) packets;
+	DARRAY(struct mp_cache_keyframe) keyframes;
+	uint64_t packet_bytes;
+	uint64_t raw_bytes;
+	uint64_t audio_bytes;
+};
+
 struct mp_cache {
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
@@ -51,8 +94,30 @@ struct mp_cache {
 	bool thread_valid;
 	pthread_t thread;
 
-	DARRAY(struct obs_source_frame) video_frames;
-	DARRAY(struct obs_source_audio) audio_segments;
+	struct mp_cache_store *store;
+	bool store_owner;
+	bool recording;
+	size_t read_packet_idx;
+
+	pthread_mutex_t window_mutex;
+	os_sem_t *decode_sem;
+	struct mp_cache_window_frame window[MP_CACHE_WINDOW_FRAMES];
+	size_t window_head;
+	size_t window_count;
+	uint64_t read_lap;
+	uint64_t write_lap;
+	uint64_t restart_lap;
+	int64_t restart_ts;
+	int64_t skip_ts;
+	bool restart;
+	bool window_end;
+	bool decode_stop;
+	size_t lap_frames;
+	uint64_t decode_time_ns;
+	uint64_t decoded_frames;
+
+	bool decode_thread_valid;
+	pthread_t decode_thread;
 
 	size_t cur_v_idx;
 	size_t cur_a_idx;
@@ -61,9 +126,6 @@ struct mp_cache {
 	int64_t next_v_ts;
 	int64_t next_a_ts;
 
-	int64_t final_v_duration;
-	int64_t final_a_duration;
-
 	int64_t play_sys_ts;
 	int64_t next_pts_ns;
 	uint64_t next_ns;
@@ -76,7 +138,6 @@ struct mp_cache {
 	bool seek_next_ts;
 	bool eof;
 	int64_t seek_pos;
-	int64_t start_time;
 	int64_t media_duration;
 
 	mp_media_t m;
@@ -95,3 +156,4 @@ extern int64_t mp_cache_get_current_time(mp_cache_t *c);
 extern void mp_cache_seek(mp_cache_t *c, int64_t pos);
 extern int64_t mp_cache_get_frames(mp_cache_t *c);
 extern int64_t mp_cache_get_duration(mp_cache_t *c);
+extern bool mp_cache_get_stats(mp_cache_t *c, struct mp_cache_stats *stats);
@@ -16,6 +16,8 @@
 
 #include "decode.h"
 
+#include <util/platform.h>
+
 #include "media-playback.h"
 #include "media.h"
 #include <libavutil/mastering_display_metadata.h>
@@ -93,8 +95,16 @@ static int mp_open_codec(struct mp_decode *d, bool hw)
 	if (c->thread_count == 1 && c->codec_id != AV_CODEC_ID_PNG &&
 	    c->codec_id != AV_CODEC_ID_TIFF &&
 	    c->codec_id != AV_CODEC_ID_JPEG2000 &&
-	    c->codec_id != AV_CODEC_ID_MPEG4 && c->codec_id != AV_CODEC_ID_WEBP)
-		c->thread_count = 0;
+	    c->codec_id != AV_CODEC_ID_MPEG4 &&
+	    c->codec_id != AV_CODEC_ID_WEBP) {
+		/* 0 lets the decoder pick the thread count */
+		c->thread_count = d->m->decode_threads;
+
+		if (d->m->decode_thread_type == MP_THREAD_FRAME)
+			c->thread_type = FF_THREAD_FRAME;
+		else if (d->m->decode_thread_type == MP_THREAD_SLICE)
+			c->thread_type = FF_THREAD_SLICE;
+	}
 
 	ret = avcodec_open2(c, d->codec, NULL);
 	if (ret < 0)
@@ -230,6 +240,34 @@ bool mp_decode_init(mp_media_t *m, enum AVMediaType type, bool hw)
 
 extern void mp_media_free_packet(mp_media_t *m, AVPacket *pkt);
 
+struct mp_decode_frame {
+	AVFrame *frame;
+	int64_t pts;
+	int64_t next_pts;
+	int64_t duration;
+};
+
+/* when pipelined, the decoder is owned by a copy of the mp_decode structure
+ * which is only used on the decode thread, while the media thread queues
+ * packets for it and takes the decoded frames from it */
+struct mp_decode_pipe {
+	struct mp_decode worker;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_mutex_t decode_mutex;
+	os_event_t *packet_event;
+	os_event_t *frame_event;
+
+	struct deque frames;
+	struct deque done_packets;
+	AVFrame *out_frame;
+
+	bool input_eof;
+	bool output_eof;
+	bool stop;
+};
+
 void mp_decode_clear_packets(struct mp_decode *d)
 {
 	if (d->packet_pending) {
@@ -244,8 +282,61 @@ void mp_decode_clear_packets(struct mp_decode *d)
 	}
 }
 
+static void clear_frames(struct mp_decode_pipe *pipe)
+{
+	while (pipe->frames.size) {
+		struct mp_decode_frame out;
+		deque_pop_front(&pipe->frames, &out, sizeof(out));
+		av_frame_free(&out.frame);
+	}
+}
+
+/* packets used by the decode thread are handed back to the media thread, as
+ * the packet pool is not thread safe */
+static void recycle_packets(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+
+	while (pipe->done_packets.size) {
+		AVPacket *pkt;
+		deque_pop_front(&pipe->done_packets, &pkt, sizeof(pkt));
+		mp_media_free_packet(d->m, pkt);
+	}
+}
+
+static void stop_thread(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+
+	pthread_mutex_lock(&pipe->mutex);
+	pipe->stop = true;
+	pthread_mutex_unlock(&pipe->mutex);
+	os_event_signal(pipe->packet_event);
+
+	pthread_join(pipe->thread, NULL);
+
+	clear_frames(pipe);
+	recycle_packets(d);
+	deque_free(&pipe->frames);
+	deque_free(&pipe->done_packets);
+	av_frame_free(&pipe->out_frame);
+
+	/* the worker owns the decoder, so free that as usual */
+	*d = pipe->worker;
+	d->pipe = NULL;
+
+	pthread_mutex_destroy(&pipe->mutex);
+	pthread_mutex_destroy(&pipe->decode_mutex);
+	os_event_destroy(pipe->packet_event);
+	os_event_destroy(pipe->frame_event);
+	bfree(pipe);
+}
+
 void mp_decode_free(struct mp_decode *d)
 {
+	if (d->pipe)
+		stop_thread(d);
+
 	mp_decode_clear_packets(d);
 	deque_free(&d->packets);
 
@@ -274,7 +365,47 @@ void mp_decode_free(struct mp_decode *d)
 
 void mp_decode_push_packet(struct mp_decode *decode, AVPacket *packet)
 {
-	deque_push_back(&decode->packets, &packet, sizeof(packet));
+	struct mp_decode_pipe *pipe = decode->pipe;
+
+	if (pipe) {
+		pthread_mutex_lock(&pipe->mutex);
+		deque_push_back(&pipe->worker.packets, &packet, sizeof(packet));
+		pthread_mutex_unlock(&pipe->mutex);
+		os_event_signal(pipe->packet_event);
+	} else {
+		deque_push_back(&decode->packets, &packet, sizeof(packet));
+	}
+}
+
+static bool pop_packet(struct mp_decode *d, AVPacket **pkt)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+	bool success = false;
+
+	if (pipe)
+		pthread_mutex_lock(&pipe->mutex);
+	if (d->packets.size) {
+		deque_pop_front(&d->packets, pkt, sizeof(*pkt));
+		success = true;
+	}
+	if (pipe)
+		pthread_mutex_unlock(&pipe->mutex);
+
+	return success;
+}
+
+static void release_packet(struct mp_decode *d, AVPacket *pkt)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+
+	if (pipe) {
+		av_packet_unref(pkt);
+		pthread_mutex_lock(&pipe->mutex);
+		deque_push_back(&pipe->done_packets, &pkt, sizeof(pkt));
+		pthread_mutex_unlock(&pipe->mutex);
+	} else {
+		mp_media_free_packet(d->m, pkt);
+	}
 }
 
 static inline int64_t get_estimated_duration(struct mp_decode *d,
@@ -362,32 +493,29 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	return ret;
 }
 
-bool mp_decode_next(struct mp_decode *d)
+/* with a pipe set, this is only called on the worker, from the decode
+ * thread */
+static void decode_frame(struct mp_decode *d, bool eof)
 {
-	bool eof = d->m->eof;
 	int got_frame;
 	int ret;
 
 	d->frame_ready = false;
 
-	if (!eof && !d->packets.size)
-		return true;
-
 	while (!d->frame_ready) {
 		if (!d->packet_pending) {
-			if (!d->packets.size) {
-				if (eof) {
-					d->pkt->data = NULL;
-					d->pkt->size = 0;
-				} else {
-					return true;
-				}
-			} else {
-				mp_media_free_packet(d->m, d->orig_pkt);
-				deque_pop_front(&d->packets, &d->orig_pkt,
-						sizeof(d->orig_pkt));
+			AVPacket *pkt;
+
+			if (pop_packet(d, &pkt)) {
+				release_packet(d, d->orig_pkt);
+				d->orig_pkt = pkt;
 				av_packet_ref(d->pkt, d->orig_pkt);
 				d->packet_pending = true;
+			} else if (eof) {
+				d->pkt->data = NULL;
+				d->pkt->size = 0;
+			} else {
+				return;
 			}
 		}
 
@@ -395,7 +523,7 @@ bool mp_decode_next(struct mp_decode *d)
 
 		if (!got_frame && ret == 0) {
 			d->eof = true;
-			return true;
+			return;
 		}
 		if (ret < 0) {
 #ifdef DETAILED_DEBUG_INFO
@@ -408,7 +536,7 @@ bool mp_decode_next(struct mp_decode *d)
 				av_packet_unref(d->pkt);
 				d->packet_pending = false;
 			}
-			return true;
+			return;
 		}
 
 		d->frame_ready = !!got_frame;
@@ -460,16 +588,269 @@ bool mp_decode_next(struct mp_decode *d)
 		d->last_duration = duration;
 		d->next_pts = d->frame_pts + duration;
 	}
+}
+
+static inline size_t queued_frames(struct mp_decode_pipe *pipe)
+{
+	return pipe->frames.size / sizeof(struct mp_decode_frame);
+}
+
+static void push_frame(struct mp_decode_pipe *pipe, uint64_t decode_time_ns)
+{
+	struct mp_decode *w = &pipe->worker;
+	struct mp_decode_frame out = {
+		.frame = av_frame_alloc(),
+		.pts = w->frame_pts,
+		.next_pts = w->next_pts,
+		.duration = w->last_duration,
+	};
+
+	if (out.frame)
+		av_frame_move_ref(out.frame, w->frame);
+
+	pthread_mutex_lock(&pipe->mutex);
+	if (out.frame) {
+		deque_push_back(&pipe->frames, &out, sizeof(out));
+		w->decoded_frames++;
+	}
+	w->decode_time_ns += decode_time_ns;
+	pthread_mutex_unlock(&pipe->mutex);
+}
+
+static void *mp_decode_thread(void *opaque)
+{
+	struct mp_decode_pipe *pipe = opaque;
+	struct mp_decode *w = &pipe->worker;
+
+	os_set_thread_name(w->audio ? "mp_decode_audio" : "mp_decode_video");
+
+	for (;;) {
+		bool stop, eof, busy;
+		uint64_t start;
+
+		/* held while decoding, so the decoder is never flushed in the
+		 * middle of a frame */
+		pthread_mutex_lock(&pipe->decode_mutex);
+
+		pthread_mutex_lock(&pipe->mutex);
+		stop = pipe->stop;
+		eof = pipe->input_eof;
+		busy = !pipe->output_eof &&
+		       queued_frames(pipe) < MP_DECODE_MAX_FRAMES &&
+		       (w->packets.size || w->packet_pending || eof);
+		pthread_mutex_unlock(&pipe->mutex);
+
+		if (stop || !busy) {
+			pthread_mutex_unlock(&pipe->decode_mutex);
+			if (stop)
+				break;
+
+			os_event_wait(pipe->packet_event);
+			continue;
+		}
+
+		start = os_gettime_ns();
+		decode_frame(w, eof);
+
+		if (w->frame_ready) {
+			push_frame(pipe, os_gettime_ns() - start);
+			w->frame_ready = false;
+		}
+		if (w->eof) {
+			pthread_mutex_lock(&pipe->mutex);
+			pipe->output_eof = true;
+			pthread_mutex_unlock(&pipe->mutex);
+		}
+
+		pthread_mutex_unlock(&pipe->decode_mutex);
+		os_event_signal(pipe->frame_event);
+	}
+
+	return NULL;
+}
+
+bool mp_decode_start_thread(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = bzalloc(sizeof(*pipe));
+
+	pthread_mutex_init_value(&pipe->mutex);
+	pthread_mutex_init_value(&pipe->decode_mutex);
+
+	if (pthread_mutex_init(&pipe->mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&pipe->decode_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&pipe->packet_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (os_event_init(&pipe->frame_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	pipe->worker = *d;
+	pipe->worker.pipe = pipe;
+
+	if (pthread_create(&pipe->thread, NULL, mp_decode_thread, pipe) != 0)
+		goto fail;
+
+	/* the packet queue now belongs to the worker */
+	memset(&d->packets, 0, sizeof(d->packets));
+	d->pipe = pipe;
+	return true;
+
+fail:
+	blog(LOG_WARNING, "MP: Failed to create %s decode thread",
+	     d->audio ? "audio" : "video");
+	pthread_mutex_destroy(&pipe->mutex);
+	pthread_mutex_destroy(&pipe->decode_mutex);
+	os_event_destroy(pipe->packet_event);
+	os_event_destroy(pipe->frame_event);
+	bfree(pipe);
+	return false;
+}
+
+static bool next_queued_frame(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+	struct mp_decode_frame out = {0};
+
+	d->frame_ready = false;
+
+	for (;;) {
+		bool wait;
+
+		pthread_mutex_lock(&pipe->mutex);
+		pipe->input_eof = d->m->eof;
+		recycle_packets(d);
+
+		if (pipe->frames.size)
+			deque_pop_front(&pipe->frames, &out, sizeof(out));
+		else if (pipe->output_eof)
+			d->eof = true;
+
+		/* until the end of the file, only wait for the decoder once
+		 * it has fallen far enough behind, otherwise keep reading */
+		wait = !out.frame && !d->eof &&
+		       (pipe->input_eof ||
+			pipe->worker.packets.size >=
+				MP_DECODE_READ_AHEAD * 2 * sizeof(AVPacket *));
+		pthread_mutex_unlock(&pipe->mutex);
+
+		os_event_signal(pipe->packet_event);
+
+		if (!wait)
+			break;
+
+		os_event_wait(pipe->frame_event);
+	}
+
+	if (out.frame) {
+		av_frame_free(&pipe->out_frame);
+		pipe->out_frame = out.frame;
+
+		d->frame = out.frame;
+		d->frame_pts = out.pts;
+		d->next_pts = out.next_pts;
+		d->last_duration = out.duration;
+		d->frame_ready = true;
+	}
 
 	return true;
 }
 
+bool mp_decode_next(struct mp_decode *d)
+{
+	bool eof = d->m->eof;
+	uint64_t start;
+
+	if (d->pipe)
+		return next_queued_frame(d);
+
+	d->frame_ready = false;
+
+	if (!eof && !d->packets.size)
+		return true;
+
+	start = os_gettime_ns();
+	decode_frame(d, eof);
+
+	if (d->frame_ready)
+		d->decoded_frames++;
+	d->decode_time_ns += os_gettime_ns() - start;
+	return true;
+}
+
+static void flush_pipe(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+	struct mp_decode *w = &pipe->worker;
+
+	pthread_mutex_lock(&pipe->decode_mutex);
+
+	pthread_mutex_lock(&pipe->mutex);
+	clear_frames(pipe);
+	recycle_packets(d);
+	mp_decode_clear_packets(w);
+	pipe->input_eof = false;
+	pipe->output_eof = false;
+	pthread_mutex_unlock(&pipe->mutex);
+
+	avcodec_flush_buffers(w->decoder);
+	w->eof = false;
+	w->frame_pts = 0;
+	w->frame_ready = false;
+	w->next_pts = 0;
+
+	pthread_mutex_unlock(&pipe->decode_mutex);
+}
+
 void mp_decode_flush(struct mp_decode *d)
 {
-	avcodec_flush_buffers(d->decoder);
-	mp_decode_clear_packets(d);
+	if (d->pipe) {
+		flush_pipe(d);
+	} else {
+		avcodec_flush_buffers(d->decoder);
+		mp_decode_clear_packets(d);
+	}
+
 	d->eof = false;
 	d->frame_pts = 0;
 	d->frame_ready = false;
 	d->next_pts = 0;
 }
+
+size_t mp_decode_queued_packets(struct mp_decode *d)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+	size_t size;
+
+	if (!pipe)
+		return d->packets.size / sizeof(AVPacket *);
+
+	pthread_mutex_lock(&pipe->mutex);
+	size = pipe->worker.packets.size;
+	pthread_mutex_unlock(&pipe->mutex);
+
+	return size / sizeof(AVPacket *);
+}
+
+void mp_decode_get_counters(struct mp_decode *d,
+			    struct mp_decode_counters *counters)
+{
+	struct mp_decode_pipe *pipe = d->pipe;
+
+	if (!pipe) {
+		counters->frames = d->decoded_frames;
+		counters->decode_time_ns = d->decode_time_ns;
+		counters->queued_packets =
+			(uint32_t)(d->packets.size / sizeof(AVPacket *));
+		counters->queued_frames = 0;
+		return;
+	}
+
+	pthread_mutex_lock(&pipe->mutex);
+	counters->frames = pipe->worker.decoded_frames;
+	counters->decode_time_ns = pipe->worker.decode_time_ns;
+	counters->queued_packets =
+		(uint32_t)(pipe->worker.packets.size / sizeof(AVPacket *));
+	counters->queued_frames = (uint32_t)queued_frames(pipe);
+	pthread_mutex_unlock(&pipe->mutex);
+}
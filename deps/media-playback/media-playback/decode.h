@@ -41,7 +41,21 @@ extern "C" {
 #define CODEC_FLAG_TRUNC AV_CODEC_FLAG_TRUNCATED
 #endif
 
+/* when decoding on a thread of its own, packets are read ahead until this many
+ * are queued for each stream, and at most this many frames are decoded ahead
+ * of playback */
+#define MP_DECODE_READ_AHEAD 16
+#define MP_DECODE_MAX_FRAMES 4
+
 struct mp_media;
+struct mp_decode_pipe;
+
+struct mp_decode_counters {
+	uint64_t frames;
+	uint64_t decode_time_ns;
+	uint32_t queued_packets;
+	uint32_t queued_frames;
+};
 
 struct mp_decode {
 	struct mp_media *m;
@@ -70,6 +84,12 @@ struct mp_decode {
 	AVPacket *pkt;
 	bool packet_pending;
 	struct deque packets;
+
+	/* only set when pipelined, see mp_decode_start_thread */
+	struct mp_decode_pipe *pipe;
+
+	uint64_t decoded_frames;
+	uint64_t decode_time_ns;
 };
 
 extern bool mp_decode_init(struct mp_media *media, enum AVMediaType type,
@@ -82,6 +102,11 @@ extern void mp_decode_push_packet(struct mp_decode *decode, AVPacket *pkt);
 extern bool mp_decode_next(struct mp_decode *decode);
 extern void mp_decode_flush(struct mp_decode *decode);
 
+extern bool mp_decode_start_thread(struct mp_decode *decode);
+extern size_t mp_decode_queued_packets(struct mp_decode *decode);
+extern void mp_decode_get_counters(struct mp_decode *decode,
+				   struct mp_decode_counters *counters);
+
 #ifdef __cplusplus
 }
 #endif
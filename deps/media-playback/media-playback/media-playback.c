@@ -175,3 +175,35 @@ bool media_playback_has_audio(media_playback_t *mp)
 	else
 		return mp->media.has_audio;
 }
+
+bool media_playback_get_cache_stats(media_playback_t *mp,
+				    struct mp_cache_stats *stats)
+{
+	if (!mp || !mp->is_cached)
+		return false;
+
+	return mp_cache_get_stats(&mp->cache, stats);
+}
+
+bool media_playback_get_decode_stats(media_playback_t *mp,
+				     struct mp_decode_stats *stats)
+{
+	struct mp_cache_stats cache_stats;
+
+	if (!mp)
+		return false;
+
+	if (!mp->is_cached) {
+		mp_media_get_decode_stats(&mp->media, stats);
+		return true;
+	}
+
+	/* only the video of cached media is decoded during playback */
+	if (!mp_cache_get_stats(&mp->cache, &cache_stats))
+		return false;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->video_frames = cache_stats.decoded_frames;
+	stats->video_decode_time_ns = cache_stats.decode_time_ns;
+	return true;
+}
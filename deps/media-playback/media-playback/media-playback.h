@@ -22,15 +22,26 @@ struct media_playback;
 typedef struct media_playback media_playback_t;
 
 typedef void (*mp_video_cb)(void *opaque, struct obs_source_frame *frame);
+typedef void (*mp_video_borrow_cb)(void *opaque,
+				   struct obs_source_frame *frame,
+				   obs_source_frame_release_t release,
+				   void *param);
 typedef void (*mp_audio_cb)(void *opaque, struct obs_source_audio *audio);
 typedef void (*mp_stop_cb)(void *opaque);
 
+enum mp_thread_type {
+	MP_THREAD_AUTO,
+	MP_THREAD_FRAME,
+	MP_THREAD_SLICE,
+};
+
 struct mp_media_info {
 	void *opaque;
 
 	mp_video_cb v_cb;
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
+	mp_video_borrow_cb v_borrow_cb; /* optional, used instead of v_cb */
 	mp_audio_cb a_cb;
 	mp_stop_cb stop_cb;
 
@@ -46,6 +57,33 @@ struct mp_media_info {
 	bool reconnecting;
 	bool request_preload;
 	bool full_decode;
+
+	int decode_threads; /* 0 lets the decoder decide */
+	enum mp_thread_type decode_thread_type;
+	bool pipelined_decode; /* decode audio and video on their own threads */
+};
+
+struct mp_cache_stats {
+	uint64_t frames;
+	uint64_t resident_bytes; /* packets, decoded frames and audio */
+	uint32_t users;          /* sources sharing the cached data */
+	uint64_t raw_bytes;      /* size of the video frames if kept decoded */
+	uint64_t decoded_frames; /* frames decoded during playback */
+	uint64_t decode_time_ns;
+	bool packet_mode;
+};
+
+struct mp_decode_stats {
+	uint64_t video_frames; /* decoded since the media was opened */
+	uint64_t video_decode_time_ns;
+	uint64_t audio_frames;
+	uint64_t audio_decode_time_ns;
+	uint32_t video_queued_packets;
+	uint32_t audio_queued_packets;
+	uint32_t video_queued_frames; /* decoded ahead, only when pipelined */
+	uint32_t audio_queued_frames;
+	uint64_t late_frames; /* video frames output after their end time */
+	bool pipelined;
 };
 
 extern media_playback_t *
@@ -66,3 +104,7 @@ extern int64_t media_playback_get_frames(media_playback_t *mp);
 extern int64_t media_playback_get_duration(media_playback_t *mp);
 extern bool media_playback_has_video(media_playback_t *mp);
 extern bool media_playback_has_audio(media_playback_t *mp);
+extern bool media_playback_get_cache_stats(media_playback_t *mp,
+					   struct mp_cache_stats *stats);
+extern bool media_playback_get_decode_stats(media_playback_t *mp,
+					    struct mp_decode_stats *stats);
@@ -183,7 +183,9 @@ static int mp_media_next_packet(mp_media_t *media)
 		pkt = av_packet_alloc();
 	}
 
-	int ret = av_read_frame(media->fmt, pkt);
+	int ret = media->read_packet_cb
+			  ? media->read_packet_cb(media->opaque, pkt)
+			  : av_read_frame(media->fmt, pkt);
 	if (ret < 0) {
 		if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
 			blog(LOG_WARNING, "MP: av_read_frame failed: %s (%d)",
@@ -193,6 +195,8 @@ static int mp_media_next_packet(mp_media_t *media)
 
 	struct mp_decode *d = get_packet_decoder(media, pkt);
 	if (d && pkt->size) {
+		if (d == &media->v && media->packet_cb)
+			media->packet_cb(media->opaque, pkt);
 		mp_decode_push_packet(d, pkt);
 	} else {
 		mp_media_free_packet(media, pkt);
@@ -215,6 +219,30 @@ static inline bool mp_decode_frame(struct mp_decode *d)
 	return d->frame_ready || mp_decode_next(d);
 }
 
+static inline bool mp_media_wants_packets(mp_media_t *m)
+{
+	size_t v = m->has_video ? mp_decode_queued_packets(&m->v) : 0;
+	size_t a = m->has_audio ? mp_decode_queued_packets(&m->a) : 0;
+
+	if (v + a >= MP_DECODE_READ_AHEAD * 2)
+		return false;
+
+	return (m->has_video && v < MP_DECODE_READ_AHEAD) ||
+	       (m->has_audio && a < MP_DECODE_READ_AHEAD);
+}
+
+/* keeps the decode threads busy while the current frames are played */
+static void mp_media_read_ahead(mp_media_t *m)
+{
+	while (!m->eof && mp_media_wants_packets(m)) {
+		int ret = mp_media_next_packet(m);
+		if (ret == AVERROR_EOF || ret == AVERROR_EXIT)
+			m->eof = true;
+		else if (ret < 0)
+			break;
+	}
+}
+
 static inline int get_sws_colorspace(enum AVColorSpace cs)
 {
 	switch (cs) {
@@ -315,6 +343,9 @@ bool mp_media_prepare_frames(mp_media_t *m)
 		}
 	}
 
+	if (m->pipelined && !actively_seeking)
+		mp_media_read_ahead(m);
+
 	return true;
 }
 
@@ -395,6 +426,31 @@ void mp_media_next_audio(mp_media_t *m)
 	m->a_cb(m->opaque, &audio);
 }
 
+static void mp_media_release_frame(void *param)
+{
+	AVFrame *f = param;
+	av_frame_free(&f);
+}
+
+/* decoded frames are reference counted, so instead of being copied they can
+ * be handed out with a new reference, unless they are converted first or
+ * are reused in place for hardware frame transfers */
+static bool mp_media_borrow_video(mp_media_t *m, struct mp_decode *d,
+				  struct obs_source_frame *frame)
+{
+	AVFrame *ref;
+
+	if (!m->v_borrow_cb || m->swscale || d->hw || !d->frame->buf[0])
+		return false;
+
+	ref = av_frame_clone(d->frame);
+	if (!ref)
+		return false;
+
+	m->v_borrow_cb(m->opaque, frame, mp_media_release_frame, ref);
+	return true;
+}
+
 void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	struct mp_decode *d = &m->v;
@@ -410,6 +466,10 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 
 		d->frame_ready = false;
 
+		if (!m->full_decode &&
+		    os_gettime_ns() > m->next_ns + (uint64_t)d->last_duration)
+			m->late_frames++;
+
 		if (!m->v_cb)
 			return;
 	} else if (!d->frame_ready) {
@@ -520,7 +580,7 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 		} else if (!m->request_preload) {
 			m->v_preload_cb(m->opaque, frame);
 		}
-	} else {
+	} else if (!mp_media_borrow_video(m, d, frame)) {
 		m->v_cb(m->opaque, frame);
 	}
 }
@@ -762,6 +822,13 @@ static bool init_avformat(mp_media_t *m)
 		return false;
 	}
 
+	if (m->pipelined) {
+		if (m->has_video && !mp_decode_start_thread(&m->v))
+			m->pipelined = false;
+		if (m->has_audio && !mp_decode_start_thread(&m->a))
+			m->pipelined = false;
+	}
+
 	return true;
 }
 
@@ -781,6 +848,30 @@ bool mp_media_init2(mp_media_t *m)
 	return true;
 }
 
+static void mp_media_update_stats(mp_media_t *m)
+{
+	struct mp_decode_counters v = {0};
+	struct mp_decode_counters a = {0};
+
+	if (m->has_video)
+		mp_decode_get_counters(&m->v, &v);
+	if (m->has_audio)
+		mp_decode_get_counters(&m->a, &a);
+
+	pthread_mutex_lock(&m->mutex);
+	m->stats.video_frames = v.frames;
+	m->stats.video_decode_time_ns = v.decode_time_ns;
+	m->stats.audio_frames = a.frames;
+	m->stats.audio_decode_time_ns = a.decode_time_ns;
+	m->stats.video_queued_packets = v.queued_packets;
+	m->stats.audio_queued_packets = a.queued_packets;
+	m->stats.video_queued_frames = v.queued_frames;
+	m->stats.audio_queued_frames = a.queued_frames;
+	m->stats.late_frames = m->late_frames;
+	m->stats.pipelined = m->pipelined;
+	pthread_mutex_unlock(&m->mutex);
+}
+
 static inline bool mp_media_thread(mp_media_t *m)
 {
 	os_set_thread_name("mp_media_thread");
@@ -867,6 +958,9 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 			if (!mp_media_prepare_frames(m))
 				return false;
+
+			mp_media_update_stats(m);
+
 			if (mp_media_eof(m))
 				continue;
 
@@ -924,6 +1018,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	pthread_mutex_init_value(&media->mutex);
 	media->opaque = info->opaque;
 	media->v_cb = info->v_cb;
+	media->v_borrow_cb = info->v_borrow_cb;
 	media->a_cb = info->a_cb;
 	media->stop_cb = info->stop_cb;
 	media->ffmpeg_options = info->ffmpeg_options;
@@ -935,8 +1030,14 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->speed = info->speed;
 	media->request_preload = info->request_preload;
 	media->is_local_file = info->is_local_file;
+	media->decode_threads = info->decode_threads;
+	media->decode_thread_type = info->decode_thread_type;
 	da_init(media->packet_pool);
 
+	/* reading ahead would hold up playback waiting on network streams */
+	media->pipelined = info->pipelined_decode && info->is_local_file &&
+			   !info->full_decode;
+
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
 
@@ -1099,3 +1200,10 @@ void mp_media_seek(mp_media_t *m, int64_t pos)
 
 	os_sem_post(m->sem);
 }
+
+void mp_media_get_decode_stats(mp_media_t *m, struct mp_decode_stats *stats)
+{
+	pthread_mutex_lock(&m->mutex);
+	*stats = m->stats;
+	pthread_mutex_unlock(&m->mutex);
+}
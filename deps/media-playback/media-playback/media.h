@@ -45,6 +45,7 @@ struct mp_media {
 	mp_video_cb v_seek_cb;
 	mp_stop_cb stop_cb;
 	mp_video_cb v_cb;
+	mp_video_borrow_cb v_borrow_cb;
 	mp_audio_cb a_cb;
 	void *opaque;
 
@@ -54,12 +55,22 @@ struct mp_media {
 	int buffering;
 	int speed;
 
+	int decode_threads;
+	enum mp_thread_type decode_thread_type;
+	bool pipelined;
+
 	enum AVPixelFormat scale_format;
 	struct SwsContext *swscale;
 	int scale_linesizes[4];
 	uint8_t *scale_pic[4];
 
 	DARRAY(AVPacket *) packet_pool;
+
+	/* set by the cache to keep the demuxed video packets, and to feed them
+	 * back to the decoder instead of reading from the file */
+	void (*packet_cb)(void *opaque, const AVPacket *pkt);
+	int (*read_packet_cb)(void *opaque, AVPacket *pkt);
+
 	struct mp_decode v;
 	struct mp_decode a;
 	bool request_preload;
@@ -103,6 +114,10 @@ struct mp_media {
 	bool seek;
 	bool seek_next_ts;
 	int64_t seek_pos;
+
+	/* counted on the media thread, and copied to stats under the mutex */
+	uint64_t late_frames;
+	struct mp_decode_stats stats;
 };
 
 typedef struct mp_media mp_media_t;
@@ -118,6 +133,8 @@ extern int64_t mp_media_get_current_time(mp_media_t *m);
 extern int64_t mp_media_get_frames(mp_media_t *m);
 extern int64_t mp_media_get_duration(mp_media_t *m);
 extern void mp_media_seek(mp_media_t *m, int64_t pos);
+extern void mp_media_get_decode_stats(mp_media_t *m,
+				      struct mp_decode_stats *stats);
 
 /* #define DETAILED_DEBUG_INFO */
 
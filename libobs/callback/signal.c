@@ -16,69 +16,296 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Emitting a signal does not take any locks.  The callbacks of a signal are
+ * published as an immutable list which is replaced as a whole when a
+ * callback is connected or disconnected.  Emitters register themselves in
+ * one of two counters before picking up the list, and a replaced list is
+ * only freed once both counters have drained after the swap.  The table of
+ * signals of a handler is replaced and freed the same way when a signal is
+ * added.
+ *
+ * An emission calls the callbacks of the list it picked up when it started,
+ * so a callback connected while the signal is being emitted is first called
+ * by the next emission.
+ *
+ * Disconnecting waits for emitters still using the old list, so a callback
+ * is not running anymore once it returns, except when it is called from
+ * within an emission of the same signal on the same thread.  In that case
+ * the callback is only flagged, and removed once the emission ends.
+ */
+
+/* readers of data that is replaced as a whole, and freed once every reader
+ * that could have seen it is done */
+struct grace_period {
+	volatile long epoch;
+	volatile long readers[2];
+
+	/* the event is created on first use, and signaled when the readers
+	 * drain while someone is waiting */
+	volatile bool waiting;
+	os_event_t *event;
+
+	/* serializes waiting */
+	pthread_mutex_t mutex;
+};
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct callback_list {
+	size_t num;
+	struct signal_callback **array;
+
+	/* set once the list has been replaced */
+	DARRAY(struct signal_callback *) dropped;
+	struct callback_list *next;
+};
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+	uint64_t hash;
+
+	struct callback_list *callbacks;
+	struct grace_period emitters;
+
+	/* connect/disconnect */
 	pthread_mutex_t mutex;
-	bool signalling;
+	struct callback_list *retired;
+};
 
-	struct signal_info *next;
+/* sorted by hash, replaced when a signal is added */
+struct signal_table {
+	size_t num;
+	struct signal_info **signals;
 };
 
+static inline bool grace_period_init(struct grace_period *gp)
+{
+	return pthread_mutex_init(&gp->mutex, NULL) == 0;
+}
+
+static inline void grace_period_free(struct grace_period *gp)
+{
+	os_event_destroy(gp->event);
+	pthread_mutex_destroy(&gp->mutex);
+}
+
+static inline long grace_period_enter(struct grace_period *gp)
+{
+	long idx = os_atomic_load_long(&gp->epoch) & 1;
+	os_atomic_inc_long(&gp->readers[idx]);
+	return idx;
+}
+
+static inline void grace_period_leave(struct grace_period *gp, long idx)
+{
+	if (os_atomic_dec_long(&gp->readers[idx]) == 0 &&
+	    os_atomic_load_bool(&gp->waiting))
+		os_event_signal(
+			os_atomic_load_ptr((void *const volatile *)&gp->event));
+}
+
+/* waits until every reader which could have picked up data replaced before
+ * this call has finished.  both counters have to drain, as a reader may
+ * have read the epoch just before it was incremented. */
+static void grace_period_wait(struct grace_period *gp)
+{
+	pthread_mutex_lock(&gp->mutex);
+
+	if (!gp->event) {
+		os_event_t *event;
+		os_event_init(&event, OS_EVENT_TYPE_AUTO);
+		os_atomic_set_ptr((void *volatile *)&gp->event, event);
+	}
+
+	os_atomic_set_bool(&gp->waiting, true);
+
+	for (int i = 0; i < 2; i++) {
+		long idx = (os_atomic_inc_long(&gp->epoch) - 1) & 1;
+
+		while (os_atomic_load_long(&gp->readers[idx]))
+			os_event_wait(gp->event);
+	}
+
+	os_atomic_set_bool(&gp->waiting, false);
+
+	pthread_mutex_unlock(&gp->mutex);
+}
+
+static inline uint64_t signal_name_hash(const char *name)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static struct callback_list *callback_list_create(size_t num)
+{
+	struct callback_list *list =
+		bzalloc(sizeof(struct callback_list) +
+			num * sizeof(struct signal_callback *));
+	list->num = num;
+	list->array = (struct signal_callback **)(list + 1);
+	return list;
+}
+
+static void callback_list_free(struct callback_list *list, bool callbacks)
+{
+	while (list) {
+		struct callback_list *next = list->next;
+
+		if (callbacks) {
+			for (size_t i = 0; i < list->num; i++)
+				bfree(list->array[i]);
+		}
+		for (size_t i = 0; i < list->dropped.num; i++)
+			bfree(list->dropped.array[i]);
+
+		da_free(list->dropped);
+		bfree(list);
+		list = next;
+	}
+}
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
-	struct signal_info *si = bmalloc(sizeof(struct signal_info));
+	struct signal_info *si = bzalloc(sizeof(struct signal_info));
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->hash = signal_name_hash(info->name);
+	si->callbacks = callback_list_create(0);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
-
-		decl_info_free(&si->func);
-		bfree(si);
-		return NULL;
+		goto fail;
+	}
+	if (!grace_period_init(&si->emitters)) {
+		blog(LOG_ERROR, "Could not create signal");
+		pthread_mutex_destroy(&si->mutex);
+		goto fail;
 	}
 
 	return si;
+
+fail:
+	decl_info_free(&si->func);
+	callback_list_free(si->callbacks, false);
+	bfree(si);
+	return NULL;
 }
 
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
 		pthread_mutex_destroy(&si->mutex);
+		grace_period_free(&si->emitters);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
+		callback_list_free(si->callbacks, true);
+		callback_list_free(si->retired, false);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
+static inline struct callback_list *
+signal_get_callbacks(struct signal_info *si)
+{
+	return os_atomic_load_ptr((void *const volatile *)&si->callbacks);
+}
+
+static inline size_t signal_get_callback_idx(struct callback_list *list,
 					     signal_callback_t callback,
 					     void *data)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *sc = list->array[i];
 
-		if (sc->callback == callback && sc->data == data)
+		if (sc->callback == callback && sc->data == data &&
+		    !os_atomic_load_bool(&sc->remove))
 			return i;
 	}
 
 	return DARRAY_INVALID;
 }
 
+/* signals currently being emitted on this thread */
+#define MAX_EMIT_DEPTH 16
+
+static THREAD_LOCAL struct signal_info *emitting[MAX_EMIT_DEPTH];
+static THREAD_LOCAL size_t emit_depth = 0;
+
+static inline bool signal_emitting(struct signal_info *si)
+{
+	/* if it got too deep to track, assume it is */
+	if (emit_depth > MAX_EMIT_DEPTH)
+		return true;
+
+	for (size_t i = 0; i < emit_depth; i++) {
+		if (emitting[i] == si)
+			return true;
+	}
+
+	return false;
+}
+
+static inline long signal_enter(struct signal_info *si)
+{
+	long idx = grace_period_enter(&si->emitters);
+
+	if (emit_depth < MAX_EMIT_DEPTH)
+		emitting[emit_depth] = si;
+	emit_depth++;
+	return idx;
+}
+
+static inline void signal_leave(struct signal_info *si, long idx)
+{
+	emit_depth--;
+	grace_period_leave(&si->emitters, idx);
+}
+
+/* publishes list, which must be called with the signal mutex held.  returns
+ * the lists that can be freed once grace_period_wait returns, or NULL
+ * if the caller is itself emitting the signal and cannot wait. */
+static struct callback_list *signal_set_callbacks(struct signal_info *si,
+						  struct callback_list *list)
+{
+	struct callback_list *old = os_atomic_set_ptr(
+		(void *volatile *)&si->callbacks, list);
+
+	old->next = si->retired;
+	si->retired = NULL;
+
+	if (signal_emitting(si)) {
+		si->retired = old;
+		return NULL;
+	}
+
+	return old;
+}
+
+static void signal_free_retired(struct signal_info *si,
+				struct callback_list *retired)
+{
+	if (retired) {
+		grace_period_wait(&si->emitters);
+		callback_list_free(retired, false);
+	}
+}
+
 struct global_callback_info {
 	global_signal_callback_t callback;
 	void *data;
@@ -87,32 +314,59 @@ struct global_callback_info {
 };
 
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_table *signals;
+	struct grace_period lookups;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
 	DARRAY(struct global_callback_info) global_callbacks;
 	pthread_mutex_t global_callbacks_mutex;
+	volatile long global_callbacks_num;
 };
 
 static struct signal_info *getsignal(signal_handler_t *handler,
-				     const char *name,
-				     struct signal_info **p_last)
+				     const char *name, uint64_t hash)
 {
-	struct signal_info *signal, *last = NULL;
+	struct signal_table *table;
+	struct signal_info *found = NULL;
+	size_t lo = 0, hi;
+	long idx;
 
-	signal = handler->first;
-	while (signal != NULL) {
-		if (strcmp(signal->func.name, name) == 0)
-			break;
+	if (!handler)
+		return NULL;
+
+	idx = grace_period_enter(&handler->lookups);
 
-		last = signal;
-		signal = signal->next;
+	table = os_atomic_load_ptr((void *const volatile *)&handler->signals);
+	if (!table)
+		goto leave;
+
+	hi = table->num;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (table->signals[mid]->hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	if (p_last)
-		*p_last = last;
-	return signal;
+	for (; lo < table->num && table->signals[lo]->hash == hash; lo++) {
+		struct signal_info *si = table->signals[lo];
+		if (strcmp(si->func.name, name) == 0) {
+			found = si;
+			break;
+		}
+	}
+
+leave:
+	grace_period_leave(&handler->lookups, idx);
+	return found;
+}
+
+static inline struct signal_info *getsignal_name(signal_handler_t *handler,
+						 const char *name)
+{
+	return getsignal(handler, name, signal_name_hash(name));
 }
 
 /* ------------------------------------------------------------------------- */
@@ -120,7 +374,7 @@ static struct signal_info *getsignal(signal_handler_t *handler,
 signal_handler_t *signal_handler_create(void)
 {
 	struct signal_handler *handler = bzalloc(sizeof(struct signal_handler));
-	handler->first = NULL;
+	handler->signals = NULL;
 	handler->refs = 1;
 
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
@@ -128,10 +382,17 @@ signal_handler_t *signal_handler_create(void)
 		bfree(handler);
 		return NULL;
 	}
+	if (!grace_period_init(&handler->lookups)) {
+		blog(LOG_ERROR, "Couldn't create signal handler mutex!");
+		pthread_mutex_destroy(&handler->mutex);
+		bfree(handler);
+		return NULL;
+	}
 	if (pthread_mutex_init_recursive(&handler->global_callbacks_mutex) !=
 	    0) {
 		blog(LOG_ERROR, "Couldn't create signal handler global "
 				"callbacks mutex!");
+		grace_period_free(&handler->lookups);
 		pthread_mutex_destroy(&handler->mutex);
 		bfree(handler);
 		return NULL;
@@ -142,15 +403,17 @@ signal_handler_t *signal_handler_create(void)
 
 static void signal_handler_actually_destroy(signal_handler_t *handler)
 {
-	struct signal_info *sig = handler->first;
-	while (sig != NULL) {
-		struct signal_info *next = sig->next;
-		signal_info_destroy(sig);
-		sig = next;
+	struct signal_table *table = handler->signals;
+
+	if (table) {
+		for (size_t i = 0; i < table->num; i++)
+			signal_info_destroy(table->signals[i]);
+		bfree(table);
 	}
 
 	da_free(handler->global_callbacks);
 	pthread_mutex_destroy(&handler->global_callbacks_mutex);
+	grace_period_free(&handler->lookups);
 	pthread_mutex_destroy(&handler->mutex);
 	bfree(handler);
 }
@@ -165,8 +428,10 @@ void signal_handler_destroy(signal_handler_t *handler)
 bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 {
 	struct decl_info func = {0};
-	struct signal_info *sig, *last;
+	struct signal_table *table, *old = NULL;
+	struct signal_info *sig;
 	bool success = true;
+	size_t num, idx = 0;
 
 	if (!parse_decl_string(&func, signal_decl)) {
 		blog(LOG_ERROR, "Signal declaration invalid: %s", signal_decl);
@@ -175,21 +440,50 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 
 	pthread_mutex_lock(&handler->mutex);
 
-	sig = getsignal(handler, func.name, &last);
+	sig = getsignal_name(handler, func.name);
 	if (sig) {
 		blog(LOG_WARNING, "Signal declaration '%s' exists", func.name);
 		decl_info_free(&func);
 		success = false;
-	} else {
-		sig = signal_info_create(&func);
-		if (!last)
-			handler->first = sig;
-		else
-			last->next = sig;
+		goto unlock;
 	}
 
+	sig = signal_info_create(&func);
+	if (!sig) {
+		success = false;
+		goto unlock;
+	}
+
+	old = handler->signals;
+	num = old ? old->num : 0;
+
+	table = bmalloc(sizeof(struct signal_table) +
+			(num + 1) * sizeof(struct signal_info *));
+	table->num = num + 1;
+	table->signals = (struct signal_info **)(table + 1);
+
+	while (idx < num && old->signals[idx]->hash <= sig->hash)
+		idx++;
+
+	if (idx)
+		memcpy(table->signals, old->signals,
+		       idx * sizeof(struct signal_info *));
+	table->signals[idx] = sig;
+	if (num > idx)
+		memcpy(table->signals + idx + 1, old->signals + idx,
+		       (num - idx) * sizeof(struct signal_info *));
+
+	os_atomic_set_ptr((void *volatile *)&handler->signals, table);
+
+unlock:
 	pthread_mutex_unlock(&handler->mutex);
 
+	/* the old table may still be in use by a lookup */
+	if (old) {
+		grace_period_wait(&handler->lookups);
+		bfree(old);
+	}
+
 	return success;
 }
 
@@ -198,17 +492,14 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 					    signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
+	struct signal_info *sig;
+	struct callback_list *old, *list, *retired = NULL;
 	size_t idx;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal_name(handler, signal);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -224,11 +515,26 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	old = sig->callbacks;
+	idx = signal_get_callback_idx(old, callback, data);
+	if (keep_ref || idx == DARRAY_INVALID) {
+		struct signal_callback *cb =
+			bzalloc(sizeof(struct signal_callback));
+		cb->callback = callback;
+		cb->data = data;
+		cb->keep_ref = keep_ref;
+
+		list = callback_list_create(old->num + 1);
+		memcpy(list->array, old->array,
+		       old->num * sizeof(struct signal_callback *));
+		list->array[old->num] = cb;
+
+		retired = signal_set_callbacks(sig, list);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
+
+	signal_free_retired(sig, retired);
 }
 
 void signal_handler_connect(signal_handler_t *handler, const char *signal,
@@ -243,26 +549,47 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal,
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-						   const char *name)
+/* replaces the callback list with one lacking the callbacks flagged for
+ * removal, which must be called with the signal mutex held */
+static struct callback_list *signal_remove_flagged(struct signal_info *sig,
+						   long *remove_refs)
 {
-	struct signal_info *sig;
+	struct callback_list *old = sig->callbacks;
+	struct callback_list *list;
+	size_t num = 0;
 
-	if (!handler)
+	for (size_t i = 0; i < old->num; i++) {
+		if (!os_atomic_load_bool(&old->array[i]->remove))
+			num++;
+	}
+
+	if (num == old->num)
 		return NULL;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
+	list = callback_list_create(num);
+	num = 0;
+
+	for (size_t i = 0; i < old->num; i++) {
+		struct signal_callback *cb = old->array[i];
 
-	return sig;
+		if (!os_atomic_load_bool(&cb->remove)) {
+			list->array[num++] = cb;
+		} else {
+			if (cb->keep_ref)
+				(*remove_refs)++;
+			da_push_back(old->dropped, &cb);
+		}
+	}
+
+	return signal_set_callbacks(sig, list);
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 			       signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
+	struct signal_info *sig = getsignal_name(handler, signal);
+	struct callback_list *retired = NULL;
+	long remove_refs = 0;
 	size_t idx;
 
 	if (!sig)
@@ -270,20 +597,24 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
+	idx = signal_get_callback_idx(sig->callbacks, callback, data);
 	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
+		os_atomic_set_bool(&sig->callbacks->array[idx]->remove, true);
+
+		/* removed once the current emission is done */
+		if (!signal_emitting(sig))
+			retired = signal_remove_flagged(sig, &remove_refs);
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
-		signal_handler_actually_destroy(handler);
+	signal_free_retired(sig, retired);
+
+	while (remove_refs--) {
+		if (os_atomic_dec_long(&handler->refs) == 0) {
+			signal_handler_actually_destroy(handler);
+			break;
+		}
 	}
 }
 
@@ -293,48 +624,47 @@ static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
 void signal_handler_remove_current(void)
 {
 	if (current_signal_cb)
-		current_signal_cb->remove = true;
+		os_atomic_set_bool(&current_signal_cb->remove, true);
 	else if (current_global_cb)
 		current_global_cb->remove = true;
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal,
-			   calldata_t *params)
+static void signal_emit(signal_handler_t *handler, struct signal_info *sig,
+			calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct callback_list *list, *retired = NULL;
 	long remove_refs = 0;
+	bool removed = false;
+	long idx;
 
-	if (!sig)
-		return;
-
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	idx = signal_enter(sig);
+	list = signal_get_callbacks(sig);
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
+		if (!os_atomic_load_bool(&cb->remove)) {
 			current_signal_cb = cb;
 			cb->callback(cb->data, params);
 			current_signal_cb = NULL;
 		}
+		if (os_atomic_load_bool(&cb->remove))
+			removed = true;
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
+	signal_leave(sig, idx);
 
-			da_erase(sig->callbacks, i - 1);
-		}
-	}
+	if (removed) {
+		pthread_mutex_lock(&sig->mutex);
+		if (!signal_emitting(sig))
+			retired = signal_remove_flagged(sig, &remove_refs);
+		pthread_mutex_unlock(&sig->mutex);
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+		signal_free_retired(sig, retired);
+	}
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	if (os_atomic_load_long(&handler->global_callbacks_num)) {
+		pthread_mutex_lock(&handler->global_callbacks_mutex);
 
-	if (handler->global_callbacks.num) {
 		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
 			struct global_callback_info *cb =
 				handler->global_callbacks.array + i;
@@ -342,7 +672,7 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			if (!cb->remove) {
 				cb->signaling++;
 				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
+				cb->callback(cb->data, sig->func.name, params);
 				current_global_cb = NULL;
 				cb->signaling--;
 			}
@@ -355,9 +685,11 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			if (cb->remove && !cb->signaling)
 				da_erase(handler->global_callbacks, i - 1);
 		}
-	}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+		os_atomic_set_long(&handler->global_callbacks_num,
+				   (long)handler->global_callbacks.num);
+		pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	}
 
 	if (remove_refs) {
 		os_atomic_set_long(&handler->refs,
@@ -366,6 +698,28 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 	}
 }
 
+void signal_handler_signal(signal_handler_t *handler, const char *signal,
+			   calldata_t *params)
+{
+	struct signal_info *sig = getsignal_name(handler, signal);
+	if (sig)
+		signal_emit(handler, sig, params);
+}
+
+struct signal_id signal_id_create(const char *name)
+{
+	struct signal_id id = {name, signal_name_hash(name)};
+	return id;
+}
+
+void signal_handler_signal_id(signal_handler_t *handler,
+			      const struct signal_id *id, calldata_t *params)
+{
+	struct signal_info *sig = getsignal(handler, id->name, id->hash);
+	if (sig)
+		signal_emit(handler, sig, params);
+}
+
 void signal_handler_connect_global(signal_handler_t *handler,
 				   global_signal_callback_t callback,
 				   void *data)
@@ -382,6 +736,8 @@ void signal_handler_connect_global(signal_handler_t *handler,
 	if (idx == DARRAY_INVALID)
 		da_push_back(handler->global_callbacks, &cb_data);
 
+	os_atomic_set_long(&handler->global_callbacks_num,
+			   (long)handler->global_callbacks.num);
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
@@ -408,5 +764,7 @@ void signal_handler_disconnect_global(signal_handler_t *handler,
 			da_erase(handler->global_callbacks, idx);
 	}
 
+	os_atomic_set_long(&handler->global_callbacks_num,
+			   (long)handler->global_callbacks.num);
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
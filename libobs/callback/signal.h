@@ -78,6 +78,25 @@ EXPORT void signal_handler_remove_current(void);
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal,
 				  calldata_t *params);
 
+/*
+ * Signal IDs
+ *
+ *   A signal name along with its precomputed hash.  Signals that are emitted
+ * often can keep an ID around instead of hashing the name on every emit.
+ * The name must stay valid for as long as the ID is used.
+ */
+
+struct signal_id {
+	const char *name;
+	uint64_t hash;
+};
+
+EXPORT struct signal_id signal_id_create(const char *name);
+
+EXPORT void signal_handler_signal_id(signal_handler_t *handler,
+				     const struct signal_id *id,
+				     calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
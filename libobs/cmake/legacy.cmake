@@ -13,7 +13,6 @@ target_sources(libobs-version PRIVATE obsversion.c obsversion.h)
 target_include_directories(libobs-version PUBLIC ${CMAKE_CURRENT_SOURCE_DIR})
 set_property(TARGET libobs-version PROPERTY FOLDER core)
 
-find_package(Jansson 2.5 REQUIRED)
 find_package(Threads REQUIRED)
 find_package(
   FFmpeg REQUIRED
@@ -44,6 +43,7 @@ target_sources(
           obs-encoder.c
           obs-encoder.h
           obs-ffmpeg-compat.h
+          obs-frame-pool.c
           obs-hotkey.c
           obs-hotkey.h
           obs-hotkeys.h
@@ -53,6 +53,8 @@ target_sources(
           obs-nal.h
           obs-hotkey-name-map.c
           obs-interaction.h
+          obs-interleave.c
+          obs-interleave.h
           obs-internal.h
           obs-module.c
           obs-module.h
@@ -115,6 +117,8 @@ target_sources(
           graphics/device-exports.h
           graphics/effect.c
           graphics/effect.h
+          graphics/effect-cache.c
+          graphics/effect-cache.h
           graphics/effect-parser.c
           graphics/effect-parser.h
           graphics/half.h
@@ -149,6 +153,8 @@ target_sources(
   PRIVATE media-io/audio-io.c
           media-io/audio-io.h
           media-io/audio-math.h
+          media-io/audio-mix.c
+          media-io/audio-mix.h
           media-io/audio-resampler.h
           media-io/audio-resampler-ffmpeg.c
           media-io/format-conversion.c
@@ -256,7 +262,6 @@ target_link_libraries(
           FFmpeg::avutil
           FFmpeg::swscale
           FFmpeg::swresample
-          Jansson::Jansson
           OBS::caption
           OBS::libobs-version
           Uthash::Uthash
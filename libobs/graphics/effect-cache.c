@@ -0,0 +1,886 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include "../util/platform.h"
+#include "../util/dstr.h"
+#include "../util/serializer.h"
+#include "../util/file-serializer.h"
+#include "../obs-config.h"
+#include "effect-cache.h"
+#include "effect-parser.h"
+#include "effect.h"
+
+#define CACHE_MAGIC 0x4345424F /* "OBEC" */
+#define CACHE_VERSION 1
+#define CACHE_NULL_STRING 0xFFFFFFFF
+#define CACHE_DIR_NAME "effect-cache"
+
+/* ------------------------------------------------------------------------- */
+
+static void effect_cache_param_free(struct effect_cache_param *param)
+{
+	bfree(param->name);
+	da_free(param->default_val);
+
+	for (size_t i = 0; i < param->annotations.num; i++)
+		effect_cache_param_free(param->annotations.array + i);
+	da_free(param->annotations);
+}
+
+static void effect_cache_shader_free(struct effect_cache_shader *shader)
+{
+	bfree(shader->location);
+	bfree(shader->source);
+
+	for (size_t i = 0; i < shader->params.num; i++)
+		bfree(shader->params.array[i]);
+	da_free(shader->params);
+}
+
+static void effect_cache_technique_free(struct effect_cache_technique *tech)
+{
+	for (size_t i = 0; i < tech->passes.num; i++) {
+		struct effect_cache_pass *pass = tech->passes.array + i;
+
+		bfree(pass->name);
+		effect_cache_shader_free(&pass->vertex);
+		effect_cache_shader_free(&pass->pixel);
+	}
+
+	bfree(tech->name);
+	da_free(tech->passes);
+}
+
+void effect_cache_data_free(struct effect_cache_data *data)
+{
+	size_t i;
+
+	for (i = 0; i < data->params.num; i++)
+		effect_cache_param_free(data->params.array + i);
+	for (i = 0; i < data->techniques.num; i++)
+		effect_cache_technique_free(data->techniques.array + i);
+	for (i = 0; i < data->includes.num; i++)
+		bfree(data->includes.array[i]);
+
+	da_free(data->params);
+	da_free(data->techniques);
+	da_free(data->includes);
+}
+
+bool effect_cache_data_parse(struct effect_cache_data *data,
+			     const char *effect_string, const char *file,
+			     const char *preprocessor, char **error_string)
+{
+	struct effect_parser parser;
+	bool success;
+
+	ep_init(&parser);
+
+	success = ep_parse_source(&parser, effect_string, file, preprocessor);
+	if (success) {
+		*data = parser.data;
+		memset(&parser.data, 0, sizeof(parser.data));
+
+	} else if (error_string) {
+		*error_string = error_data_buildstring(&parser.cfp.error_list);
+	}
+
+	ep_free(&parser);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+static void debug_get_default_value(struct gs_effect_param *param, char *buffer,
+				    unsigned long long buf_size)
+{
+	if (param->default_val.num == 0) {
+		snprintf(buffer, buf_size, "(null)");
+		return;
+	}
+
+	switch (param->type) {
+	case GS_SHADER_PARAM_STRING:
+		snprintf(buffer, buf_size, "'%.*s'", param->default_val.num,
+			 param->default_val.array);
+		break;
+	case GS_SHADER_PARAM_INT:
+		snprintf(buffer, buf_size, "%ld",
+			 *(int *)(param->default_val.array + 0));
+		break;
+	case GS_SHADER_PARAM_INT2:
+		snprintf(buffer, buf_size, "%ld,%ld",
+			 *(int *)(param->default_val.array + 0),
+			 *(int *)(param->default_val.array + 4));
+		break;
+	case GS_SHADER_PARAM_INT3:
+		snprintf(buffer, buf_size, "%ld,%ld,%ld",
+			 *(int *)(param->default_val.array + 0),
+			 *(int *)(param->default_val.array + 4),
+			 *(int *)(param->default_val.array + 8));
+		break;
+	case GS_SHADER_PARAM_INT4:
+		snprintf(buffer, buf_size, "%ld,%ld,%ld,%ld",
+			 *(int *)(param->default_val.array + 0),
+			 *(int *)(param->default_val.array + 4),
+			 *(int *)(param->default_val.array + 8),
+			 *(int *)(param->default_val.array + 12));
+		break;
+	case GS_SHADER_PARAM_FLOAT:
+		snprintf(buffer, buf_size, "%e",
+			 *(float *)(param->default_val.array + 0));
+		break;
+	case GS_SHADER_PARAM_VEC2:
+		snprintf(buffer, buf_size, "%e,%e",
+			 *(float *)(param->default_val.array + 0),
+			 *(float *)(param->default_val.array + 4));
+		break;
+	case GS_SHADER_PARAM_VEC3:
+		snprintf(buffer, buf_size, "%e,%e,%e",
+			 *(float *)(param->default_val.array + 0),
+			 *(float *)(param->default_val.array + 4),
+			 *(float *)(param->default_val.array + 8));
+		break;
+	case GS_SHADER_PARAM_VEC4:
+		snprintf(buffer, buf_size, "%e,%e,%e,%e",
+			 *(float *)(param->default_val.array + 0),
+			 *(float *)(param->default_val.array + 4),
+			 *(float *)(param->default_val.array + 8),
+			 *(float *)(param->default_val.array + 12));
+		break;
+	case GS_SHADER_PARAM_MATRIX4X4:
+		snprintf(buffer, buf_size,
+			 "[[%e,%e,%e,%e],[%e,%e,%e,%e],"
+			 "[%e,%e,%e,%e],[%e,%e,%e,%e]]",
+			 *(float *)(param->default_val.array + 0),
+			 *(float *)(param->default_val.array + 4),
+			 *(float *)(param->default_val.array + 8),
+			 *(float *)(param->default_val.array + 12),
+			 *(float *)(param->default_val.array + 16),
+			 *(float *)(param->default_val.array + 20),
+			 *(float *)(param->default_val.array + 24),
+			 *(float *)(param->default_val.array + 28),
+			 *(float *)(param->default_val.array + 32),
+			 *(float *)(param->default_val.array + 36),
+			 *(float *)(param->default_val.array + 40),
+			 *(float *)(param->default_val.array + 44),
+			 *(float *)(param->default_val.array + 48),
+			 *(float *)(param->default_val.array + 52),
+			 *(float *)(param->default_val.array + 56),
+			 *(float *)(param->default_val.array + 60));
+		break;
+	case GS_SHADER_PARAM_BOOL:
+		snprintf(buffer, buf_size, "%s",
+			 (*param->default_val.array) != 0 ? "true\0"
+							  : "false\0");
+		break;
+	case GS_SHADER_PARAM_UNKNOWN:
+	case GS_SHADER_PARAM_TEXTURE:
+		snprintf(buffer, buf_size, "<unknown>");
+		break;
+	}
+}
+
+static void debug_param(struct gs_effect_param *param, unsigned long long idx,
+			const char *offset)
+{
+	char _debug_type[4096];
+	switch (param->type) {
+	case GS_SHADER_PARAM_STRING:
+		snprintf(_debug_type, sizeof(_debug_type), "string");
+		break;
+	case GS_SHADER_PARAM_INT:
+		snprintf(_debug_type, sizeof(_debug_type), "int");
+		break;
+	case GS_SHADER_PARAM_INT2:
+		snprintf(_debug_type, sizeof(_debug_type), "int2");
+		break;
+	case GS_SHADER_PARAM_INT3:
+		snprintf(_debug_type, sizeof(_debug_type), "int3");
+		break;
+	case GS_SHADER_PARAM_INT4:
+		snprintf(_debug_type, sizeof(_debug_type), "int4");
+		break;
+	case GS_SHADER_PARAM_FLOAT:
+		snprintf(_debug_type, sizeof(_debug_type), "float");
+		break;
+	case GS_SHADER_PARAM_VEC2:
+		snprintf(_debug_type, sizeof(_debug_type), "float2");
+		break;
+	case GS_SHADER_PARAM_VEC3:
+		snprintf(_debug_type, sizeof(_debug_type), "float3");
+		break;
+	case GS_SHADER_PARAM_VEC4:
+		snprintf(_debug_type, sizeof(_debug_type), "float4");
+		break;
+	case GS_SHADER_PARAM_MATRIX4X4:
+		snprintf(_debug_type, sizeof(_debug_type), "float4x4");
+		break;
+	case GS_SHADER_PARAM_BOOL:
+		snprintf(_debug_type, sizeof(_debug_type), "bool");
+		break;
+	case GS_SHADER_PARAM_UNKNOWN:
+		snprintf(_debug_type, sizeof(_debug_type), "unknown");
+		break;
+	case GS_SHADER_PARAM_TEXTURE:
+		snprintf(_debug_type, sizeof(_debug_type), "texture");
+		break;
+	}
+
+	char _debug_buf[4096];
+	debug_get_default_value(param, _debug_buf, sizeof(_debug_buf));
+	if (param->annotations.num > 0) {
+		blog(LOG_DEBUG,
+		     "%s[%4lld] %.*s '%s' with value %.*s and %lld annotations:",
+		     offset, idx, sizeof(_debug_type), _debug_type, param->name,
+		     sizeof(_debug_buf), _debug_buf, param->annotations.num);
+	} else {
+		blog(LOG_DEBUG, "%s[%4lld] %.*s '%s' with value %.*s.", offset,
+		     idx, sizeof(_debug_type), _debug_type, param->name,
+		     sizeof(_debug_buf), _debug_buf);
+	}
+}
+#endif
+
+static void create_param(gs_effect_t *effect, struct gs_effect_param *param,
+			 const struct effect_cache_param *param_in,
+			 enum effect_section section)
+{
+	param->name = bstrdup(param_in->name);
+	param->section = section;
+	param->type = param_in->type;
+	param->effect = effect;
+	da_copy(param->default_val, param_in->default_val);
+
+	da_resize(param->annotations, param_in->annotations.num);
+
+	for (size_t i = 0; i < param_in->annotations.num; i++) {
+		create_param(effect, param->annotations.array + i,
+			     param_in->annotations.array + i,
+			     EFFECT_ANNOTATION);
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+		debug_param(param->annotations.array + i, i, "\t\t");
+#endif
+	}
+}
+
+static bool create_shader(gs_effect_t *effect,
+			  const struct effect_cache_shader *shader_in,
+			  enum gs_shader_type type, gs_shader_t **p_shader,
+			  pass_shaderparam_array_t *pass_params,
+			  effect_cache_error_t error_cb, void *param)
+{
+	gs_shader_t *shader = NULL;
+	char *errors = NULL;
+
+	if (type == GS_SHADER_VERTEX)
+		shader = gs_vertexshader_create(shader_in->source,
+						shader_in->location, &errors);
+	else if (type == GS_SHADER_PIXEL)
+		shader = gs_pixelshader_create(shader_in->source,
+					       shader_in->location, &errors);
+
+	if (errors && strlen(errors) && error_cb)
+		error_cb(param, errors);
+	bfree(errors);
+
+	*p_shader = shader;
+	if (!shader)
+		return false;
+
+	da_resize(*pass_params, shader_in->params.num);
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		const char *name = shader_in->params.array[i];
+		struct pass_shaderparam *sparam = pass_params->array + i;
+
+		sparam->eparam = gs_effect_get_param_by_name(effect, name);
+		sparam->sparam = gs_shader_get_param_by_name(shader, name);
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+		debug_param(sparam->eparam, i, "\t\t\t\t");
+#endif
+
+		if (!sparam->sparam) {
+			blog(LOG_ERROR, "Effect shader parameter not found");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool create_technique(gs_effect_t *effect,
+			     struct gs_effect_technique *tech,
+			     const struct effect_cache_technique *tech_in,
+			     effect_cache_error_t error_cb, void *param)
+{
+	bool success = true;
+
+	tech->name = bstrdup(tech_in->name);
+	tech->section = EFFECT_TECHNIQUE;
+	tech->effect = effect;
+
+	da_resize(tech->passes, tech_in->passes.num);
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+	blog(LOG_DEBUG, "\tTechnique '%s' has %lld passes:", tech->name,
+	     tech->passes.num);
+#endif
+
+	for (size_t i = 0; i < tech->passes.num; i++) {
+		struct gs_effect_pass *pass = tech->passes.array + i;
+		const struct effect_cache_pass *pass_in =
+			tech_in->passes.array + i;
+
+		pass->name = bstrdup(pass_in->name);
+		pass->section = EFFECT_PASS;
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+		blog(LOG_DEBUG, "\t\t[%4lld] Pass '%s':", i, pass->name);
+#endif
+
+		if (!create_shader(effect, &pass_in->vertex, GS_SHADER_VERTEX,
+				   &pass->vertshader, &pass->vertshader_params,
+				   error_cb, param)) {
+			success = false;
+			blog(LOG_ERROR,
+			     "Pass (%zu) <%s> missing vertex shader!", i,
+			     pass->name ? pass->name : "");
+		}
+		if (!create_shader(effect, &pass_in->pixel, GS_SHADER_PIXEL,
+				   &pass->pixelshader,
+				   &pass->pixelshader_params, error_cb,
+				   param)) {
+			success = false;
+			blog(LOG_ERROR, "Pass (%zu) <%s> missing pixel shader!",
+			     i, pass->name ? pass->name : "");
+		}
+	}
+
+	return success;
+}
+
+bool effect_cache_data_create(gs_effect_t *effect,
+			      const struct effect_cache_data *data,
+			      effect_cache_error_t error_cb, void *param)
+{
+	bool success = true;
+	size_t i;
+
+	da_resize(effect->params, data->params.num);
+	da_resize(effect->techniques, data->techniques.num);
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+	blog(LOG_DEBUG, "Shader has %lld parameters:", data->params.num);
+#endif
+
+	for (i = 0; i < data->params.num; i++) {
+		struct gs_effect_param *eparam = effect->params.array + i;
+
+		create_param(effect, eparam, data->params.array + i,
+			     EFFECT_PARAM);
+
+		if (strcmp(eparam->name, "ViewProj") == 0)
+			effect->view_proj = eparam;
+		else if (strcmp(eparam->name, "World") == 0)
+			effect->world = eparam;
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+		debug_param(eparam, i, "\t");
+#endif
+	}
+
+#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
+	blog(LOG_DEBUG, "Shader has %lld techniques:", data->techniques.num);
+#endif
+
+	for (i = 0; i < data->techniques.num; i++) {
+		if (!create_technique(effect, effect->techniques.array + i,
+				      data->techniques.array + i, error_cb,
+				      param))
+			success = false;
+	}
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* cache files */
+
+static inline uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static inline uint64_t hash_string(const char *str)
+{
+	return hash_data(0xcbf29ce484222325ULL, str, strlen(str));
+}
+
+static void remove_dir(const char *path)
+{
+	struct dstr entry_path = {0};
+	struct os_dirent *entry;
+	os_dir_t *dir = os_opendir(path);
+
+	if (!dir)
+		return;
+
+	while ((entry = os_readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") == 0 ||
+		    strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		dstr_printf(&entry_path, "%s/%s", path, entry->d_name);
+		if (entry->directory)
+			remove_dir(entry_path.array);
+		else
+			os_unlink(entry_path.array);
+	}
+
+	os_closedir(dir);
+	dstr_free(&entry_path);
+	os_rmdir(path);
+}
+
+/* removes the caches of other versions.  only the directory the cache owns
+ * is looked at, base_dir may be shared with anything else */
+static void remove_stale_caches(const char *cache_dir, const char *current)
+{
+	struct dstr path = {0};
+	struct os_dirent *entry;
+	os_dir_t *dir = os_opendir(cache_dir);
+
+	if (!dir)
+		return;
+
+	while ((entry = os_readdir(dir)) != NULL) {
+		const char *name = entry->d_name;
+		unsigned major, minor, patch, version;
+
+		if (!entry->directory || strcmp(name, current) == 0 ||
+		    sscanf(name, "%u.%u.%u-%u", &major, &minor, &patch,
+			   &version) != 4)
+			continue;
+
+		dstr_printf(&path, "%s/%s", cache_dir, name);
+		remove_dir(path.array);
+	}
+
+	os_closedir(dir);
+	dstr_free(&path);
+}
+
+char *effect_cache_dir_open(const char *base_dir, const char *preprocessor)
+{
+	struct dstr cache_dir = {0};
+	struct dstr version = {0};
+	struct dstr backend = {0};
+	struct dstr path = {0};
+
+	dstr_printf(&cache_dir, "%s/" CACHE_DIR_NAME, base_dir);
+	dstr_printf(&version, "%d.%d.%d-%d", LIBOBS_API_MAJOR_VER,
+		    LIBOBS_API_MINOR_VER, LIBOBS_API_PATCH_VER, CACHE_VERSION);
+
+	remove_stale_caches(cache_dir.array, version.array);
+
+	/* backends share the version directory, so that switching between
+	 * them doesn't throw away the other's cache */
+	while (preprocessor && *preprocessor == '_')
+		preprocessor++;
+
+	dstr_copy(&backend, preprocessor && *preprocessor ? preprocessor
+							   : "default");
+	dstr_to_lower(&backend);
+
+	dstr_printf(&path, "%s/%s/%s", cache_dir.array, version.array,
+		    backend.array);
+	dstr_free(&cache_dir);
+	dstr_free(&version);
+	dstr_free(&backend);
+
+	if (os_mkdirs(path.array) == MKDIR_ERROR) {
+		dstr_free(&path);
+		return NULL;
+	}
+
+	return path.array;
+}
+
+char *effect_cache_file_path(const char *dir, const char *effect_string,
+			     const char *file, const char *preprocessor)
+{
+	struct dstr path = {0};
+	uint64_t hash = hash_string(effect_string);
+
+	/* includes are resolved relative to the effect's path, so the same
+	 * text in another location may not produce the same effect */
+	if (preprocessor)
+		hash = hash_data(hash, preprocessor, strlen(preprocessor) + 1);
+	if (file)
+		hash = hash_data(hash, file, strlen(file) + 1);
+
+	dstr_printf(&path, "%s/%016llx.effect", dir, (unsigned long long)hash);
+	return path.array;
+}
+
+static void write_string(struct serializer *s, const char *str)
+{
+	if (!str) {
+		s_wl32(s, CACHE_NULL_STRING);
+		return;
+	}
+
+	uint32_t len = (uint32_t)strlen(str);
+	s_wl32(s, len);
+	s_write(s, str, len);
+}
+
+static void write_param(struct serializer *s,
+			const struct effect_cache_param *param)
+{
+	write_string(s, param->name);
+	s_wl32(s, (uint32_t)param->type);
+	s_wl32(s, (uint32_t)param->default_val.num);
+	s_write(s, param->default_val.array, param->default_val.num);
+
+	s_wl32(s, (uint32_t)param->annotations.num);
+	for (size_t i = 0; i < param->annotations.num; i++)
+		write_param(s, param->annotations.array + i);
+}
+
+static void write_shader(struct serializer *s,
+			 const struct effect_cache_shader *shader)
+{
+	write_string(s, shader->location);
+	write_string(s, shader->source);
+
+	s_wl32(s, (uint32_t)shader->params.num);
+	for (size_t i = 0; i < shader->params.num; i++)
+		write_string(s, shader->params.array[i]);
+}
+
+bool effect_cache_data_save(const struct effect_cache_data *data,
+			    const char *cache_file, const char *effect_string,
+			    const char *preprocessor)
+{
+	struct serializer s;
+	size_t i, j;
+
+	/* hash the includes first, there's no point in writing anything if
+	 * one of them can't be read back */
+	uint64_t *include_hashes =
+		bmalloc(sizeof(uint64_t) * 2 * (data->includes.num + 1));
+
+	for (i = 0; i < data->includes.num; i++) {
+		char *include =
+			os_quick_read_utf8_file(data->includes.array[i]);
+		if (!include) {
+			bfree(include_hashes);
+			return false;
+		}
+
+		include_hashes[i * 2] = hash_string(include);
+		include_hashes[i * 2 + 1] = strlen(include);
+		bfree(include);
+	}
+
+	if (!file_output_serializer_init_safe(&s, cache_file, "tmp")) {
+		blog(LOG_DEBUG, "Could not write effect cache file '%s'",
+		     cache_file);
+		bfree(include_hashes);
+		return false;
+	}
+
+	s_wl32(&s, CACHE_MAGIC);
+	s_wl32(&s, CACHE_VERSION);
+	s_wl32(&s, LIBOBS_API_VER);
+	write_string(&s, preprocessor);
+	s_wl64(&s, hash_string(effect_string));
+	s_wl64(&s, strlen(effect_string));
+
+	s_wl32(&s, (uint32_t)data->includes.num);
+	for (i = 0; i < data->includes.num; i++) {
+		write_string(&s, data->includes.array[i]);
+		s_wl64(&s, include_hashes[i * 2]);
+		s_wl64(&s, include_hashes[i * 2 + 1]);
+	}
+
+	s_wl32(&s, (uint32_t)data->params.num);
+	for (i = 0; i < data->params.num; i++)
+		write_param(&s, data->params.array + i);
+
+	s_wl32(&s, (uint32_t)data->techniques.num);
+	for (i = 0; i < data->techniques.num; i++) {
+		const struct effect_cache_technique *tech =
+			data->techniques.array + i;
+
+		write_string(&s, tech->name);
+		s_wl32(&s, (uint32_t)tech->passes.num);
+
+		for (j = 0; j < tech->passes.num; j++) {
+			const struct effect_cache_pass *pass =
+				tech->passes.array + j;
+
+			write_string(&s, pass->name);
+			write_shader(&s, &pass->vertex);
+			write_shader(&s, &pass->pixel);
+		}
+	}
+
+	/* a truncated file won't have this, so it is never loaded */
+	s_wl32(&s, CACHE_MAGIC);
+
+	file_output_serializer_free(&s);
+	bfree(include_hashes);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct cache_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	bool error;
+};
+
+static bool read_data(struct cache_reader *r, void *out, size_t size)
+{
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return false;
+	}
+
+	if (size)
+		memcpy(out, r->data + r->pos, size);
+	r->pos += size;
+	return true;
+}
+
+static uint32_t read_u32(struct cache_reader *r)
+{
+	uint8_t b[4];
+	if (!read_data(r, b, sizeof(b)))
+		return 0;
+
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+	       ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t read_u64(struct cache_reader *r)
+{
+	uint64_t low = read_u32(r);
+	uint64_t high = read_u32(r);
+	return low | (high << 32);
+}
+
+/* reads an element count, which can never be more than the bytes left */
+static size_t read_count(struct cache_reader *r)
+{
+	uint32_t count = read_u32(r);
+	if (count > r->size - r->pos) {
+		r->error = true;
+		return 0;
+	}
+
+	return count;
+}
+
+static char *read_string(struct cache_reader *r)
+{
+	uint32_t len = read_u32(r);
+	char *str;
+
+	if (r->error || len == CACHE_NULL_STRING)
+		return NULL;
+	if (len > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	str = bmalloc(len + 1);
+	read_data(r, str, len);
+	str[len] = 0;
+	return str;
+}
+
+static void read_param(struct cache_reader *r,
+		       struct effect_cache_param *param)
+{
+	param->name = read_string(r);
+	param->type = (enum gs_shader_param_type)read_u32(r);
+
+	da_resize(param->default_val, read_count(r));
+	read_data(r, param->default_val.array, param->default_val.num);
+
+	da_resize(param->annotations, read_count(r));
+	for (size_t i = 0; i < param->annotations.num && !r->error; i++)
+		read_param(r, param->annotations.array + i);
+
+	if (!param->name)
+		r->error = true;
+}
+
+static void read_shader(struct cache_reader *r,
+			struct effect_cache_shader *shader)
+{
+	shader->location = read_string(r);
+	shader->source = read_string(r);
+
+	da_resize(shader->params, read_count(r));
+	for (size_t i = 0; i < shader->params.num && !r->error; i++) {
+		shader->params.array[i] = read_string(r);
+		if (!shader->params.array[i])
+			r->error = true;
+	}
+}
+
+static bool includes_unchanged(struct cache_reader *r,
+			       struct effect_cache_data *data)
+{
+	da_resize(data->includes, read_count(r));
+
+	for (size_t i = 0; i < data->includes.num && !r->error; i++) {
+		char *path = read_string(r);
+		uint64_t hash = read_u64(r);
+		uint64_t len = read_u64(r);
+		char *include;
+
+		data->includes.array[i] = path;
+		if (r->error || !path)
+			return false;
+
+		include = os_quick_read_utf8_file(path);
+		if (!include)
+			return false;
+
+		bool unchanged = strlen(include) == len &&
+				 hash_string(include) == hash;
+		bfree(include);
+
+		if (!unchanged)
+			return false;
+	}
+
+	return !r->error;
+}
+
+static bool read_header(struct cache_reader *r, const char *effect_string,
+			const char *preprocessor)
+{
+	if (read_u32(r) != CACHE_MAGIC || read_u32(r) != CACHE_VERSION ||
+	    read_u32(r) != LIBOBS_API_VER)
+		return false;
+
+	char *cached_preprocessor = read_string(r);
+	bool match = !r->error &&
+		     (cached_preprocessor && preprocessor
+			      ? strcmp(cached_preprocessor, preprocessor) == 0
+			      : cached_preprocessor == preprocessor);
+	bfree(cached_preprocessor);
+
+	return match && read_u64(r) == hash_string(effect_string) &&
+	       read_u64(r) == strlen(effect_string) && !r->error;
+}
+
+static bool read_effect(struct cache_reader *r,
+			struct effect_cache_data *data)
+{
+	size_t i, j;
+
+	da_resize(data->params, read_count(r));
+	for (i = 0; i < data->params.num && !r->error; i++)
+		read_param(r, data->params.array + i);
+
+	da_resize(data->techniques, read_count(r));
+	for (i = 0; i < data->techniques.num && !r->error; i++) {
+		struct effect_cache_technique *tech =
+			data->techniques.array + i;
+
+		tech->name = read_string(r);
+		da_resize(tech->passes, read_count(r));
+
+		for (j = 0; j < tech->passes.num && !r->error; j++) {
+			struct effect_cache_pass *pass =
+				tech->passes.array + j;
+
+			pass->name = read_string(r);
+			read_shader(r, &pass->vertex);
+			read_shader(r, &pass->pixel);
+		}
+	}
+
+	return read_u32(r) == CACHE_MAGIC && !r->error && r->pos == r->size;
+}
+
+static uint8_t *read_cache_file(const char *cache_file, size_t *p_size)
+{
+	FILE *file = os_fopen(cache_file, "rb");
+	uint8_t *data = NULL;
+	int64_t size;
+
+	if (!file)
+		return NULL;
+
+	size = os_fgetsize(file);
+	if (size > 0) {
+		data = bmalloc((size_t)size);
+		if (fread(data, 1, (size_t)size, file) != (size_t)size) {
+			bfree(data);
+			data = NULL;
+		}
+	}
+
+	fclose(file);
+	*p_size = (size_t)size;
+	return data;
+}
+
+bool effect_cache_data_load(struct effect_cache_data *data,
+			    const char *cache_file, const char *effect_string,
+			    const char *preprocessor)
+{
+	struct cache_reader r = {0};
+	bool success;
+
+	memset(data, 0, sizeof(*data));
+
+	r.data = read_cache_file(cache_file, &r.size);
+	if (!r.data)
+		return false;
+
+	success = read_header(&r, effect_string, preprocessor) &&
+		  includes_unchanged(&r, data) && read_effect(&r, data);
+
+	if (!success)
+		effect_cache_data_free(data);
+
+	bfree((void *)r.data);
+	return success;
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/darray.h"
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Everything the effect parser produces for an effect: its parameters and
+ * the generated shader text of each technique's passes.  This can be written
+ * to and read back from an on-disk cache, which lets effects that have not
+ * changed skip the parser entirely.
+ */
+
+/* ------------------------------------------------------------------------- */
+
+struct effect_cache_param {
+	char *name;
+	enum gs_shader_param_type type;
+	DARRAY(uint8_t) default_val;
+	DARRAY(struct effect_cache_param) annotations;
+};
+
+struct effect_cache_shader {
+	char *location;
+	char *source;
+	DARRAY(char *) params;
+};
+
+struct effect_cache_pass {
+	char *name;
+	struct effect_cache_shader vertex;
+	struct effect_cache_shader pixel;
+};
+
+struct effect_cache_technique {
+	char *name;
+	DARRAY(struct effect_cache_pass) passes;
+};
+
+struct effect_cache_data {
+	DARRAY(struct effect_cache_param) params;
+	DARRAY(struct effect_cache_technique) techniques;
+
+	/* files pulled in with #include, checked when loading from cache */
+	DARRAY(char *) includes;
+};
+
+typedef void (*effect_cache_error_t)(void *param, const char *errors);
+
+EXPORT void effect_cache_data_free(struct effect_cache_data *data);
+
+/**
+ * Parses an effect and generates its shader text.  Does not require a
+ * graphics context, the preprocessor name of the graphics backend to
+ * generate the shaders for is given instead.
+ */
+EXPORT bool effect_cache_data_parse(struct effect_cache_data *data,
+				    const char *effect_string,
+				    const char *file, const char *preprocessor,
+				    char **error_string);
+
+/**
+ * Creates and returns the directory within base_dir/effect-cache that effects
+ * of this libobs version and the given graphics backend are cached in.
+ * Caches of other versions in base_dir/effect-cache are deleted, nothing else
+ * in base_dir is touched.  Returns NULL on failure.
+ */
+EXPORT char *effect_cache_dir_open(const char *base_dir,
+				   const char *preprocessor);
+
+/** Returns the cache file for an effect's text, path and graphics backend */
+EXPORT char *effect_cache_file_path(const char *dir, const char *effect_string,
+				    const char *file,
+				    const char *preprocessor);
+
+/**
+ * Reads an effect from a cache file, failing if it was written for different
+ * effect text, by a different version, or if any of its includes changed.
+ */
+EXPORT bool effect_cache_data_load(struct effect_cache_data *data,
+				   const char *cache_file,
+				   const char *effect_string,
+				   const char *preprocessor);
+
+EXPORT bool effect_cache_data_save(const struct effect_cache_data *data,
+				   const char *cache_file,
+				   const char *effect_string,
+				   const char *preprocessor);
+
+/**
+ * Creates the parameters, techniques and shaders of an effect.  Requires a
+ * graphics context.  Shader compiler errors are passed to error_cb if set.
+ */
+extern bool effect_cache_data_create(gs_effect_t *effect,
+				     const struct effect_cache_data *data,
+				     effect_cache_error_t error_cb,
+				     void *param);
+
+#ifdef __cplusplus
+}
+#endif
@@ -70,6 +70,8 @@ void ep_free(struct effect_parser *ep)
 	for (i = 0; i < ep->techniques.num; i++)
 		ep_technique_free(ep->techniques.array + i);
 
+	effect_cache_data_free(&ep->data);
+
 	ep->cur_pass = NULL;
 	cf_parser_free(&ep->cfp);
 	da_free(ep->params);
@@ -1244,172 +1246,9 @@ error:
 	bfree(name);
 }
 
-static bool ep_compile(struct effect_parser *ep);
-
-extern const char *gs_preprocessor_name(void);
+static void ep_generate(struct effect_parser *ep);
 
 #if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-static void debug_get_default_value(struct gs_effect_param *param, char *buffer,
-				    unsigned long long buf_size)
-{
-	if (param->default_val.num == 0) {
-		snprintf(buffer, buf_size, "(null)");
-		return;
-	}
-
-	switch (param->type) {
-	case GS_SHADER_PARAM_STRING:
-		snprintf(buffer, buf_size, "'%.*s'", param->default_val.num,
-			 param->default_val.array);
-		break;
-	case GS_SHADER_PARAM_INT:
-		snprintf(buffer, buf_size, "%ld",
-			 *(int *)(param->default_val.array + 0));
-		break;
-	case GS_SHADER_PARAM_INT2:
-		snprintf(buffer, buf_size, "%ld,%ld",
-			 *(int *)(param->default_val.array + 0),
-			 *(int *)(param->default_val.array + 4));
-		break;
-	case GS_SHADER_PARAM_INT3:
-		snprintf(buffer, buf_size, "%ld,%ld,%ld",
-			 *(int *)(param->default_val.array + 0),
-			 *(int *)(param->default_val.array + 4),
-			 *(int *)(param->default_val.array + 8));
-		break;
-	case GS_SHADER_PARAM_INT4:
-		snprintf(buffer, buf_size, "%ld,%ld,%ld,%ld",
-			 *(int *)(param->default_val.array + 0),
-			 *(int *)(param->default_val.array + 4),
-			 *(int *)(param->default_val.array + 8),
-			 *(int *)(param->default_val.array + 12));
-		break;
-	case GS_SHADER_PARAM_FLOAT:
-		snprintf(buffer, buf_size, "%e",
-			 *(float *)(param->default_val.array + 0));
-		break;
-	case GS_SHADER_PARAM_VEC2:
-		snprintf(buffer, buf_size, "%e,%e",
-			 *(float *)(param->default_val.array + 0),
-			 *(float *)(param->default_val.array + 4));
-		break;
-	case GS_SHADER_PARAM_VEC3:
-		snprintf(buffer, buf_size, "%e,%e,%e",
-			 *(float *)(param->default_val.array + 0),
-			 *(float *)(param->default_val.array + 4),
-			 *(float *)(param->default_val.array + 8));
-		break;
-	case GS_SHADER_PARAM_VEC4:
-		snprintf(buffer, buf_size, "%e,%e,%e,%e",
-			 *(float *)(param->default_val.array + 0),
-			 *(float *)(param->default_val.array + 4),
-			 *(float *)(param->default_val.array + 8),
-			 *(float *)(param->default_val.array + 12));
-		break;
-	case GS_SHADER_PARAM_MATRIX4X4:
-		snprintf(buffer, buf_size,
-			 "[[%e,%e,%e,%e],[%e,%e,%e,%e],"
-			 "[%e,%e,%e,%e],[%e,%e,%e,%e]]",
-			 *(float *)(param->default_val.array + 0),
-			 *(float *)(param->default_val.array + 4),
-			 *(float *)(param->default_val.array + 8),
-			 *(float *)(param->default_val.array + 12),
-			 *(float *)(param->default_val.array + 16),
-			 *(float *)(param->default_val.array + 20),
-			 *(float *)(param->default_val.array + 24),
-			 *(float *)(param->default_val.array + 28),
-			 *(float *)(param->default_val.array + 32),
-			 *(float *)(param->default_val.array + 36),
-			 *(float *)(param->default_val.array + 40),
-			 *(float *)(param->default_val.array + 44),
-			 *(float *)(param->default_val.array + 48),
-			 *(float *)(param->default_val.array + 52),
-			 *(float *)(param->default_val.array + 56),
-			 *(float *)(param->default_val.array + 60));
-		break;
-	case GS_SHADER_PARAM_BOOL:
-		snprintf(buffer, buf_size, "%s",
-			 (*param->default_val.array) != 0 ? "true\0"
-							  : "false\0");
-		break;
-	case GS_SHADER_PARAM_UNKNOWN:
-	case GS_SHADER_PARAM_TEXTURE:
-		snprintf(buffer, buf_size, "<unknown>");
-		break;
-	}
-}
-
-static void debug_param(struct gs_effect_param *param,
-			struct ep_param *param_in, unsigned long long idx,
-			const char *offset)
-{
-	char _debug_type[4096];
-	switch (param->type) {
-	case GS_SHADER_PARAM_STRING:
-		snprintf(_debug_type, sizeof(_debug_type), "string");
-		break;
-	case GS_SHADER_PARAM_INT:
-		snprintf(_debug_type, sizeof(_debug_type), "int");
-		break;
-	case GS_SHADER_PARAM_INT2:
-		snprintf(_debug_type, sizeof(_debug_type), "int2");
-		break;
-	case GS_SHADER_PARAM_INT3:
-		snprintf(_debug_type, sizeof(_debug_type), "int3");
-		break;
-	case GS_SHADER_PARAM_INT4:
-		snprintf(_debug_type, sizeof(_debug_type), "int4");
-		break;
-	case GS_SHADER_PARAM_FLOAT:
-		snprintf(_debug_type, sizeof(_debug_type), "float");
-		break;
-	case GS_SHADER_PARAM_VEC2:
-		snprintf(_debug_type, sizeof(_debug_type), "float2");
-		break;
-	case GS_SHADER_PARAM_VEC3:
-		snprintf(_debug_type, sizeof(_debug_type), "float3");
-		break;
-	case GS_SHADER_PARAM_VEC4:
-		snprintf(_debug_type, sizeof(_debug_type), "float4");
-		break;
-	case GS_SHADER_PARAM_MATRIX4X4:
-		snprintf(_debug_type, sizeof(_debug_type), "float4x4");
-		break;
-	case GS_SHADER_PARAM_BOOL:
-		snprintf(_debug_type, sizeof(_debug_type), "bool");
-		break;
-	case GS_SHADER_PARAM_UNKNOWN:
-		snprintf(_debug_type, sizeof(_debug_type), "unknown");
-		break;
-	case GS_SHADER_PARAM_TEXTURE:
-		snprintf(_debug_type, sizeof(_debug_type), "texture");
-		break;
-	}
-
-	char _debug_buf[4096];
-	debug_get_default_value(param, _debug_buf, sizeof(_debug_buf));
-	if (param->annotations.num > 0) {
-		blog(LOG_DEBUG,
-		     "%s[%4lld] %.*s '%s' with value %.*s and %lld annotations:",
-		     offset, idx, sizeof(_debug_type), _debug_type, param->name,
-		     sizeof(_debug_buf), _debug_buf, param->annotations.num);
-	} else {
-		blog(LOG_DEBUG, "%s[%4lld] %.*s '%s' with value %.*s.", offset,
-		     idx, sizeof(_debug_type), _debug_type, param->name,
-		     sizeof(_debug_buf), _debug_buf);
-	}
-}
-
-static void debug_param_annotation(struct gs_effect_param *param,
-				   struct ep_param *param_in,
-				   unsigned long long idx, const char *offset)
-{
-	char _debug_buf[4096];
-	debug_get_default_value(param, _debug_buf, sizeof(_debug_buf));
-	blog(LOG_DEBUG, "%s[%4lld] %s '%s' with value %.*s", offset, idx,
-	     param_in->type, param->name, sizeof(_debug_buf), _debug_buf);
-}
-
 static void debug_print_string(const char *offset, const char *str)
 {
 	// Bypass 4096 limit in def_log_handler.
@@ -1444,25 +1283,22 @@ static void debug_print_string(const char *offset, const char *str)
 }
 #endif
 
-bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
-	      const char *effect_string, const char *file)
+bool ep_parse_source(struct effect_parser *ep, const char *effect_string,
+		     const char *file, const char *preprocessor)
 {
 	bool success;
 
-	const char *graphics_preprocessor = gs_preprocessor_name();
-
-	if (graphics_preprocessor) {
+	if (preprocessor) {
 		struct cf_def def;
 
 		cf_def_init(&def);
-		def.name.str.array = graphics_preprocessor;
-		def.name.str.len = strlen(graphics_preprocessor);
+		def.name.str.array = preprocessor;
+		def.name.str.len = strlen(preprocessor);
 
 		strref_copy(&def.name.unmerged_str, &def.name.str);
 		cf_preprocessor_add_def(&ep->cfp.pp, &def);
 	}
 
-	ep->effect = effect;
 	if (!cf_parser_parse(&ep->cfp, effect_string, file))
 		return false;
 
@@ -1502,7 +1338,29 @@ bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
 
 	success = !error_data_has_errors(&ep->cfp.error_list);
 	if (success)
-		success = ep_compile(ep);
+		ep_generate(ep);
+
+	return success;
+}
+
+static void ep_shader_error(void *param, const char *errors)
+{
+	struct effect_parser *ep = param;
+	cf_adderror(&ep->cfp, "Error creating shader: $1", LEX_ERROR, errors,
+		    NULL, NULL);
+}
+
+bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
+	      const char *effect_string, const char *file)
+{
+	bool success;
+
+	ep->effect = effect;
+	success = ep_parse_source(ep, effect_string, file,
+				  gs_preprocessor_name());
+	if (success)
+		success = effect_cache_data_create(effect, &ep->data,
+						   ep_shader_error, ep);
 
 #if defined(_DEBUG) && defined(_DEBUG_SHADERS)
 	blog(LOG_DEBUG,
@@ -1829,111 +1687,28 @@ static void ep_makeshaderstring(struct effect_parser *ep, struct dstr *shader,
 	ep_reset_written(ep);
 }
 
-static void ep_compile_annotations(ep_param_array_t *ep_annotations,
-				   gs_effect_param_array_t *gsp_annotations,
-				   struct effect_parser *ep)
-{
-	da_resize(*gsp_annotations, ep_annotations->num);
-
-	size_t i;
-	for (i = 0; i < ep_annotations->num; i++) {
-		struct gs_effect_param *param = gsp_annotations->array + i;
-		struct ep_param *param_in = ep_annotations->array + i;
-
-		param->name = bstrdup(param_in->name);
-		param->section = EFFECT_ANNOTATION;
-		param->effect = ep->effect;
-		da_move(param->default_val, param_in->default_val);
-
-		param->type = get_effect_param_type(param_in->type);
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-		debug_param(param, param_in, i, "\t\t");
-#endif
-	}
-}
-
-static void
-ep_compile_param_annotations(struct ep_param *ep_param_input,
-			     struct gs_effect_param *gs_effect_input,
-			     struct effect_parser *ep)
+static void ep_generate_param(struct effect_cache_param *param,
+			      struct ep_param *param_in)
 {
-	ep_compile_annotations(&(ep_param_input->annotations),
-			       &(gs_effect_input->annotations), ep);
-}
-
-static void ep_compile_param(struct effect_parser *ep, size_t idx)
-{
-	struct gs_effect_param *param;
-	struct ep_param *param_in;
-
-	param = ep->effect->params.array + idx;
-	param_in = ep->params.array + idx;
-	param_in->param = param;
-
 	param->name = bstrdup(param_in->name);
-	param->section = EFFECT_PARAM;
-	param->effect = ep->effect;
-	da_move(param->default_val, param_in->default_val);
-
 	param->type = get_effect_param_type(param_in->type);
+	da_move(param->default_val, param_in->default_val);
 
-	if (strcmp(param_in->name, "ViewProj") == 0)
-		ep->effect->view_proj = param;
-	else if (strcmp(param_in->name, "World") == 0)
-		ep->effect->world = param;
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-	debug_param(param, param_in, idx, "\t");
-#endif
-
-	ep_compile_param_annotations(param_in, param, ep);
-}
-
-static bool ep_compile_pass_shaderparams(struct effect_parser *ep,
-					 pass_shaderparam_array_t *pass_params,
-					 dstr_array_t *used_params,
-					 gs_shader_t *shader)
-{
-	size_t i;
-	da_resize(*pass_params, used_params->num);
-
-	for (i = 0; i < pass_params->num; i++) {
-		struct dstr *param_name = used_params->array + i;
-		struct pass_shaderparam *param = pass_params->array + i;
-
-		param->eparam = gs_effect_get_param_by_name(ep->effect,
-							    param_name->array);
-		param->sparam =
-			gs_shader_get_param_by_name(shader, param_name->array);
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-		debug_param(param->eparam, 0, i, "\t\t\t\t");
-#endif
-
-		if (!param->sparam) {
-			blog(LOG_ERROR, "Effect shader parameter not found");
-			return false;
-		}
-	}
+	da_resize(param->annotations, param_in->annotations.num);
 
-	return true;
+	for (size_t i = 0; i < param_in->annotations.num; i++)
+		ep_generate_param(param->annotations.array + i,
+				  param_in->annotations.array + i);
 }
 
-static inline bool ep_compile_pass_shader(struct effect_parser *ep,
-					  struct gs_effect_technique *tech,
-					  struct gs_effect_pass *pass,
-					  struct ep_pass *pass_in,
-					  size_t pass_idx,
-					  enum gs_shader_type type)
+static void ep_generate_shader(struct effect_parser *ep,
+			       struct effect_cache_shader *shader,
+			       const char *tech_name, struct ep_pass *pass_in,
+			       size_t pass_idx, enum gs_shader_type type)
 {
 	struct dstr shader_str;
 	struct dstr location;
 	dstr_array_t used_params;
-	pass_shaderparam_array_t *pass_params = NULL;
-	gs_shader_t *shader = NULL;
-	bool success = true;
-	char *errors = NULL;
 
 	dstr_init(&shader_str);
 	da_init(used_params);
@@ -1948,144 +1723,69 @@ static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 		dstr_cat(&location, " (Geometry ");*/
 
 	assert(pass_idx <= UINT_MAX);
-	dstr_catf(&location, "shader, technique %s, pass %u)", tech->name,
+	dstr_catf(&location, "shader, technique %s, pass %u)", tech_name,
 		  (unsigned)pass_idx);
 
-	if (type == GS_SHADER_VERTEX) {
+	if (type == GS_SHADER_VERTEX)
 		ep_makeshaderstring(ep, &shader_str, &pass_in->vertex_program,
 				    &used_params);
-
-		pass->vertshader = gs_vertexshader_create(
-			shader_str.array, location.array, &errors);
-
-		shader = pass->vertshader;
-		pass_params = &pass->vertshader_params;
-	} else if (type == GS_SHADER_PIXEL) {
+	else if (type == GS_SHADER_PIXEL)
 		ep_makeshaderstring(ep, &shader_str, &pass_in->fragment_program,
 				    &used_params);
 
-		pass->pixelshader = gs_pixelshader_create(
-			shader_str.array, location.array, &errors);
-
-		shader = pass->pixelshader;
-		pass_params = &pass->pixelshader_params;
-	}
-
-	if (errors && strlen(errors)) {
-		cf_adderror(&ep->cfp, "Error creating shader: $1", LEX_ERROR,
-			    errors, NULL, NULL);
-	}
-	bfree(errors);
-
 #if defined(_DEBUG) && defined(_DEBUG_SHADERS)
 	blog(LOG_DEBUG, "\t\t\t%s Shader:",
 	     type == GS_SHADER_VERTEX ? "Vertex" : "Fragment");
 	blog(LOG_DEBUG, "\t\t\tCode:");
 	debug_print_string("\t\t\t\t\t", shader_str.array);
-	blog(LOG_DEBUG, "\t\t\tParameters:");
-#endif
-
-	if (shader)
-		success = ep_compile_pass_shaderparams(ep, pass_params,
-						       &used_params, shader);
-	else
-		success = false;
-
-	dstr_free(&location);
-	dstr_array_free(used_params.array, used_params.num);
-	da_free(used_params);
-	dstr_free(&shader_str);
-
-	return success;
-}
-
-static bool ep_compile_pass(struct effect_parser *ep,
-			    struct gs_effect_technique *tech,
-			    struct ep_technique *tech_in, size_t idx)
-{
-	struct gs_effect_pass *pass;
-	struct ep_pass *pass_in;
-	bool success = true;
-
-	pass = tech->passes.array + idx;
-	pass_in = tech_in->passes.array + idx;
-
-	pass->name = bstrdup(pass_in->name);
-	pass->section = EFFECT_PASS;
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-	blog(LOG_DEBUG, "\t\t[%4lld] Pass '%s':", idx, pass->name);
 #endif
 
-	if (!ep_compile_pass_shader(ep, tech, pass, pass_in, idx,
-				    GS_SHADER_VERTEX)) {
-		success = false;
-		blog(LOG_ERROR, "Pass (%zu) <%s> missing vertex shader!", idx,
-		     pass->name ? pass->name : "");
-	}
-	if (!ep_compile_pass_shader(ep, tech, pass, pass_in, idx,
-				    GS_SHADER_PIXEL)) {
-		success = false;
-		blog(LOG_ERROR, "Pass (%zu) <%s> missing pixel shader!", idx,
-		     pass->name ? pass->name : "");
-	}
-	return success;
-}
+	shader->location = location.array;
+	shader->source = shader_str.array;
 
-static inline bool ep_compile_technique(struct effect_parser *ep, size_t idx)
-{
-	struct gs_effect_technique *tech;
-	struct ep_technique *tech_in;
-	bool success = true;
-	size_t i;
+	/* the parameter names are handed over as-is */
+	da_resize(shader->params, used_params.num);
+	for (size_t i = 0; i < used_params.num; i++)
+		shader->params.array[i] = used_params.array[i].array;
 
-	tech = ep->effect->techniques.array + idx;
-	tech_in = ep->techniques.array + idx;
-
-	tech->name = bstrdup(tech_in->name);
-	tech->section = EFFECT_TECHNIQUE;
-	tech->effect = ep->effect;
-
-	da_resize(tech->passes, tech_in->passes.num);
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-	blog(LOG_DEBUG, "\t[%4lld] Technique '%s' has %lld passes:", idx,
-	     tech->name, tech->passes.num);
-#endif
-
-	for (i = 0; i < tech->passes.num; i++) {
-		if (!ep_compile_pass(ep, tech, tech_in, i))
-			success = false;
-	}
-
-	return success;
+	da_free(used_params);
 }
 
-static bool ep_compile(struct effect_parser *ep)
+/* Writes out everything needed to create the effect: its parameters and the
+ * shader text of each pass.  This is what gets stored in the effect cache. */
+static void ep_generate(struct effect_parser *ep)
 {
-	bool success = true;
-	size_t i;
-
-	assert(ep->effect);
-
-	da_resize(ep->effect->params, ep->params.num);
-	da_resize(ep->effect->techniques, ep->techniques.num);
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-	blog(LOG_DEBUG, "Shader has %lld parameters:", ep->params.num);
-#endif
+	struct effect_cache_data *data = &ep->data;
+	size_t i, j;
 
+	da_resize(data->params, ep->params.num);
 	for (i = 0; i < ep->params.num; i++)
-		ep_compile_param(ep, i);
-
-#if defined(_DEBUG) && defined(_DEBUG_SHADERS)
-	blog(LOG_DEBUG, "Shader has %lld techniques:", ep->techniques.num);
-#endif
+		ep_generate_param(data->params.array + i, ep->params.array + i);
 
+	da_resize(data->techniques, ep->techniques.num);
 	for (i = 0; i < ep->techniques.num; i++) {
-		if (!ep_compile_technique(ep, i))
-			success = false;
+		struct effect_cache_technique *tech =
+			data->techniques.array + i;
+		struct ep_technique *tech_in = ep->techniques.array + i;
+
+		tech->name = bstrdup(tech_in->name);
+		da_resize(tech->passes, tech_in->passes.num);
+
+		for (j = 0; j < tech_in->passes.num; j++) {
+			struct effect_cache_pass *pass = tech->passes.array + j;
+			struct ep_pass *pass_in = tech_in->passes.array + j;
+
+			pass->name = bstrdup(pass_in->name);
+			ep_generate_shader(ep, &pass->vertex, tech->name,
+					   pass_in, j, GS_SHADER_VERTEX);
+			ep_generate_shader(ep, &pass->pixel, tech->name,
+					   pass_in, j, GS_SHADER_PIXEL);
+		}
 	}
 
-	return success;
+	for (i = 0; i < ep->cfp.pp.dependencies.num; i++) {
+		struct cf_lexer *dep = ep->cfp.pp.dependencies.array + i;
+		char *file = bstrdup(dep->file);
+		da_push_back(data->includes, &file);
+	}
 }
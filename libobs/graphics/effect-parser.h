@@ -21,6 +21,7 @@
 #include "../util/cf-parser.h"
 #include "graphics.h"
 #include "shader-parser.h"
+#include "effect-cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -266,6 +267,9 @@ struct effect_parser {
 	DARRAY(struct ep_sampler) samplers;
 	DARRAY(struct ep_technique) techniques;
 
+	/* generated parameters and shaders */
+	struct effect_cache_data data;
+
 	/* internal vars */
 	DARRAY(struct cf_lexer) files;
 	cf_token_array_t tokens;
@@ -283,6 +287,7 @@ static inline void ep_init(struct effect_parser *ep)
 	da_init(ep->techniques);
 	da_init(ep->files);
 	da_init(ep->tokens);
+	memset(&ep->data, 0, sizeof(ep->data));
 
 	ep->cur_pass = NULL;
 	cf_parser_init(&ep->cfp);
@@ -290,9 +295,16 @@ static inline void ep_init(struct effect_parser *ep)
 
 extern void ep_free(struct effect_parser *ep);
 
+extern const char *gs_preprocessor_name(void);
+
 extern bool ep_parse(struct effect_parser *ep, gs_effect_t *effect,
 		     const char *effect_string, const char *file);
 
+/* parses and generates shaders without creating the effect */
+extern bool ep_parse_source(struct effect_parser *ep,
+			    const char *effect_string, const char *file,
+			    const char *preprocessor);
+
 #ifdef __cplusplus
 }
 #endif
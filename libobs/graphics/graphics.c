@@ -251,6 +251,7 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	bfree(graphics->effect_cache_dir);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -831,6 +832,34 @@ gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
 	return effect;
 }
 
+static bool load_cached_effect(gs_effect_t *effect, const char *cache_file,
+			       const char *effect_string,
+			       const char *preprocessor)
+{
+	struct effect_cache_data data;
+	bool success;
+
+	if (!effect_cache_data_load(&data, cache_file, effect_string,
+				    preprocessor))
+		return false;
+
+	success = effect_cache_data_create(effect, &data, NULL, NULL);
+	effect_cache_data_free(&data);
+
+	/* let the parser try again from scratch and report the errors */
+	if (!success) {
+		char *effect_path = effect->effect_path;
+		effect->effect_path = NULL;
+
+		effect_free(effect);
+		effect_init(effect);
+		effect->graphics = thread_graphics;
+		effect->effect_path = effect_path;
+	}
+
+	return success;
+}
+
 gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 			      char **error_string)
 {
@@ -839,13 +868,31 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 
 	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
 	struct effect_parser parser;
-	bool success;
+	const char *preprocessor = gs_preprocessor_name();
+	char *cache_file = NULL;
+	bool success = false;
 
 	effect->graphics = thread_graphics;
 	effect->effect_path = bstrdup(filename);
 
+	if (filename && thread_graphics->effect_cache_dir) {
+		cache_file = effect_cache_file_path(
+			thread_graphics->effect_cache_dir, effect_string,
+			filename, preprocessor);
+		success = load_cached_effect(effect, cache_file, effect_string,
+					     preprocessor);
+	}
+
 	ep_init(&parser);
-	success = ep_parse(&parser, effect, effect_string, filename);
+
+	if (!success) {
+		success = ep_parse(&parser, effect, effect_string, filename);
+
+		if (success && cache_file)
+			effect_cache_data_save(&parser.data, cache_file,
+					       effect_string, preprocessor);
+	}
+
 	if (!success) {
 		if (error_string)
 			*error_string =
@@ -867,9 +914,30 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	}
 
 	ep_free(&parser);
+	bfree(cache_file);
 	return effect;
 }
 
+void gs_set_effect_cache_dir(const char *dir)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_set_effect_cache_dir"))
+		return;
+
+	bfree(graphics->effect_cache_dir);
+	graphics->effect_cache_dir = NULL;
+
+	if (dir && *dir) {
+		graphics->effect_cache_dir =
+			effect_cache_dir_open(dir, gs_preprocessor_name());
+		if (!graphics->effect_cache_dir)
+			blog(LOG_WARNING, "Could not create effect cache "
+					  "directory in '%s'",
+			     dir);
+	}
+}
+
 gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 					      char **error_string)
 {
@@ -576,6 +576,14 @@ EXPORT gs_effect_t *gs_effect_create_from_file(const char *file,
 EXPORT gs_effect_t *gs_effect_create(const char *effect_string,
 				     const char *filename, char **error_string);
 
+/**
+ * Sets the directory parsed effects are cached in.  Effects created from a
+ * file are loaded from the cache if neither the file nor its includes have
+ * changed, skipping the effect parser.  Caches written by other libobs
+ * versions in the directory are deleted.  NULL disables the cache.
+ */
+EXPORT void gs_set_effect_cache_dir(const char *dir);
+
 EXPORT gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 						     char **error_string);
 EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
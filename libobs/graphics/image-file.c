@@ -19,6 +19,8 @@
 #include "../util/base.h"
 #include "../util/platform.h"
 #include "../util/dstr.h"
+#include "../util/task.h"
+#include "../util/threading.h"
 #include "vec4.h"
 
 #define blog(level, format, ...) \
@@ -74,7 +76,8 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
 			      uint64_t *mem_usage,
-			      enum gs_image_alpha_mode alpha_mode)
+			      enum gs_image_alpha_mode alpha_mode,
+			      bool streaming)
 {
 	bool is_animated_gif = true;
 	gif_result result;
@@ -138,22 +141,27 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 	if (image->is_animated_gif) {
 		gif_decode_frame(&image->gif, 0);
 
-		image->animation_frame_cache =
-			alloc_mem(image, mem_usage,
-				  image->gif.frame_count * sizeof(uint8_t *));
-		image->animation_frame_data = alloc_mem(
-			image, mem_usage, get_full_decoded_gif_size(image));
+		/* streamed gifs are decoded by the gif cache as they play */
+		if (!streaming) {
+			image->animation_frame_cache = alloc_mem(
+				image, mem_usage,
+				image->gif.frame_count * sizeof(uint8_t *));
+			image->animation_frame_data =
+				alloc_mem(image, mem_usage,
+					  get_full_decoded_gif_size(image));
+
+			for (unsigned int i = 0; i < image->gif.frame_count;
+			     i++) {
+				if (gif_decode_frame(&image->gif, i) != GIF_OK)
+					blog(LOG_WARNING,
+					     "Couldn't decode frame %u "
+					     "of '%s'",
+					     i, path);
+			}
 
-		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				blog(LOG_WARNING,
-				     "Couldn't decode frame %u "
-				     "of '%s'",
-				     i, path);
+			gif_decode_frame(&image->gif, 0);
 		}
 
-		gif_decode_frame(&image->gif, 0);
-
 		image->cx = (uint32_t)image->gif.width;
 		image->cy = (uint32_t)image->gif.height;
 		image->format = GS_RGBA;
@@ -163,7 +171,9 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 			*mem_usage += size;
 		}
 
-		if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
+		if (streaming) {
+			/* the gif cache premultiplies its own copies */
+		} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
 			gs_premultiply_xyza_srgb_loop(image->gif.frame_image,
 						      (size_t)image->cx *
 							      image->cy);
@@ -194,7 +204,8 @@ not_animated:
 static void gs_image_file_init_internal(gs_image_file_t *image,
 					const char *file, uint64_t *mem_usage,
 					enum gs_color_space *space,
-					enum gs_image_alpha_mode alpha_mode)
+					enum gs_image_alpha_mode alpha_mode,
+					bool gif_streaming)
 {
 	size_t len;
 
@@ -209,7 +220,8 @@ static void gs_image_file_init_internal(gs_image_file_t *image,
 	len = strlen(file);
 
 	if (len > 4 && astrcmpi(file + len - 4, ".gif") == 0) {
-		if (init_animated_gif(image, file, mem_usage, alpha_mode)) {
+		if (init_animated_gif(image, file, mem_usage, alpha_mode,
+				      gif_streaming)) {
 			return;
 		}
 	}
@@ -234,7 +246,7 @@ void gs_image_file_init(gs_image_file_t *image, const char *file)
 {
 	enum gs_color_space unused;
 	gs_image_file_init_internal(image, file, NULL, &unused,
-				    GS_IMAGE_ALPHA_STRAIGHT);
+				    GS_IMAGE_ALPHA_STRAIGHT, false);
 }
 
 void gs_image_file_free(gs_image_file_t *image)
@@ -261,7 +273,7 @@ void gs_image_file2_init(gs_image_file2_t *if2, const char *file)
 {
 	enum gs_color_space unused;
 	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage, &unused,
-				    GS_IMAGE_ALPHA_STRAIGHT);
+				    GS_IMAGE_ALPHA_STRAIGHT, false);
 }
 
 void gs_image_file3_init(gs_image_file3_t *if3, const char *file,
@@ -270,7 +282,7 @@ void gs_image_file3_init(gs_image_file3_t *if3, const char *file,
 	enum gs_color_space unused;
 	gs_image_file_init_internal(&if3->image2.image, file,
 				    &if3->image2.mem_usage, &unused,
-				    alpha_mode);
+				    alpha_mode, false);
 	if3->alpha_mode = alpha_mode;
 }
 
@@ -279,7 +291,7 @@ void gs_image_file4_init(gs_image_file4_t *if4, const char *file,
 {
 	gs_image_file_init_internal(&if4->image3.image2.image, file,
 				    &if4->image3.image2.mem_usage, &if4->space,
-				    alpha_mode);
+				    alpha_mode, false);
 	if4->image3.alpha_mode = alpha_mode;
 }
 
@@ -378,6 +390,12 @@ static void decode_new_frame(gs_image_file_t *image, int new_frame,
 	image->cur_frame = new_frame;
 }
 
+static inline int get_loop_count(gs_image_file_t *image)
+{
+	int loops = image->gif.loop_count;
+	return loops >= 0xFFFF ? 0 : loops;
+}
+
 static bool gs_image_file_tick_internal(gs_image_file_t *image,
 					uint64_t elapsed_time_ns,
 					enum gs_image_alpha_mode alpha_mode)
@@ -387,9 +405,7 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 	if (!image->is_animated_gif || !image->loaded)
 		return false;
 
-	loops = image->gif.loop_count;
-	if (loops >= 0xFFFF)
-		loops = 0;
+	loops = get_loop_count(image);
 
 	if (!loops || image->cur_loop < loops) {
 		int new_frame =
@@ -463,3 +479,620 @@ void gs_image_file4_update_texture(gs_image_file4_t *if4)
 	gs_image_file_update_texture_internal(&if4->image3.image2.image,
 					      if4->image3.alpha_mode);
 }
+
+/* ------------------------------------------------------------------------- */
+/* gif cache                                                                 */
+
+#define GIF_LOOKAHEAD_FRAMES 8
+#define GIF_DECODE_BATCH 4
+#define GIF_PALETTE_SIZE (256 * sizeof(uint32_t))
+#define GIF_PALETTE_HASH_BITS 10
+#define GIF_PALETTE_HASH_SIZE (1 << GIF_PALETTE_HASH_BITS)
+
+enum gif_frame_state {
+	GIF_FRAME_EMPTY,
+	GIF_FRAME_READY,
+	GIF_FRAME_FAILED,
+};
+
+struct gif_cache_frame {
+	uint8_t *data;
+	size_t size;
+	uint64_t last_used;
+	enum gif_frame_state state;
+	bool paletted;
+	bool busy; /* being uploaded, so it can't be evicted */
+};
+
+struct gs_gif_cache {
+	gs_image_file_t *image;
+	enum gs_image_alpha_mode alpha_mode;
+	uint64_t limit;
+	bool palette;
+	os_task_queue_t *queue;
+
+	/* only used by the decode task */
+	int decode_pos;
+	uint8_t *scratch;
+
+	pthread_mutex_t mutex;
+	os_event_t *idle_event;
+	struct gif_cache_frame *frames;
+	uint64_t used_bytes;
+	uint64_t use_count;
+	int want_frame;
+	int uploaded_frame;
+	bool blocked;
+	bool queued;
+	bool stop;
+};
+
+/* every gif shares one decode thread */
+static pthread_mutex_t gif_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static os_task_queue_t *gif_queue = NULL;
+static long gif_queue_refs = 0;
+
+static os_task_queue_t *gif_queue_acquire(void)
+{
+	os_task_queue_t *queue;
+
+	pthread_mutex_lock(&gif_queue_mutex);
+	if (!gif_queue)
+		gif_queue = os_task_queue_create();
+	if (gif_queue)
+		gif_queue_refs++;
+	queue = gif_queue;
+	pthread_mutex_unlock(&gif_queue_mutex);
+
+	return queue;
+}
+
+static void gif_queue_release(void)
+{
+	os_task_queue_t *queue = NULL;
+
+	pthread_mutex_lock(&gif_queue_mutex);
+	if (--gif_queue_refs == 0) {
+		queue = gif_queue;
+		gif_queue = NULL;
+	}
+	pthread_mutex_unlock(&gif_queue_mutex);
+
+	os_task_queue_destroy(queue);
+}
+
+static inline int get_frame_count(struct gs_gif_cache *cache)
+{
+	return (int)cache->image->gif.frame_count;
+}
+
+static inline int get_lookahead(struct gs_gif_cache *cache)
+{
+	int count = get_frame_count(cache);
+	return count < GIF_LOOKAHEAD_FRAMES ? count : GIF_LOOKAHEAD_FRAMES;
+}
+
+/* how many frames ahead of playback a frame is */
+static inline int get_distance(struct gs_gif_cache *cache, int frame)
+{
+	int count = get_frame_count(cache);
+	return (frame - cache->want_frame + count) % count;
+}
+
+static int get_missing_frame(struct gs_gif_cache *cache)
+{
+	if (cache->stop || cache->blocked)
+		return -1;
+
+	/* the current frame may have been dropped once it was uploaded */
+	for (int i = cache->uploaded_frame == cache->want_frame ? 1 : 0;
+	     i < get_lookahead(cache); i++) {
+		int frame = (cache->want_frame + i) % get_frame_count(cache);
+		if (cache->frames[frame].state == GIF_FRAME_EMPTY)
+			return frame;
+	}
+
+	return -1;
+}
+
+static void evict_frame(struct gs_gif_cache *cache, int frame)
+{
+	struct gif_cache_frame *f = &cache->frames[frame];
+
+	cache->used_bytes -= f->size;
+	bfree(f->data);
+	memset(f, 0, sizeof(*f));
+}
+
+/* frames that will be needed soon can push out the least recently used
+ * frames, then frames that will be needed later than them, while any other
+ * frame is only kept if there is room for it */
+static int find_victim(struct gs_gif_cache *cache, int frame)
+{
+	const int lookahead = get_lookahead(cache);
+	const int distance = get_distance(cache, frame);
+	int victim = -1;
+
+	if (distance >= lookahead)
+		return -1;
+
+	for (int i = 0; i < get_frame_count(cache); i++) {
+		struct gif_cache_frame *f = &cache->frames[i];
+
+		if (f->state != GIF_FRAME_READY || f->busy ||
+		    get_distance(cache, i) < lookahead)
+			continue;
+		if (victim == -1 ||
+		    f->last_used < cache->frames[victim].last_used)
+			victim = i;
+	}
+
+	if (victim != -1)
+		return victim;
+
+	for (int i = lookahead - 1; i > distance; i--) {
+		int ahead = (cache->want_frame + i) % get_frame_count(cache);
+		if (cache->frames[ahead].state == GIF_FRAME_READY &&
+		    !cache->frames[ahead].busy)
+			return ahead;
+	}
+
+	/* the texture already holds the current frame */
+	if (distance > 0 && cache->uploaded_frame == cache->want_frame &&
+	    cache->frames[cache->want_frame].state == GIF_FRAME_READY &&
+	    !cache->frames[cache->want_frame].busy)
+		return cache->want_frame;
+
+	return -1;
+}
+
+static bool insert_frame(struct gs_gif_cache *cache, int frame, uint8_t *data,
+			 size_t size, bool paletted)
+{
+	struct gif_cache_frame *f = &cache->frames[frame];
+
+	/* always keep at least one frame, however low the limit is */
+	while (cache->limit && cache->used_bytes &&
+	       cache->used_bytes + size > cache->limit) {
+		int victim = find_victim(cache, frame);
+		if (victim == -1)
+			return false;
+
+		evict_frame(cache, victim);
+	}
+
+	f->data = data;
+	f->size = size;
+	f->paletted = paletted;
+	f->state = GIF_FRAME_READY;
+	f->last_used = ++cache->use_count;
+	cache->used_bytes += size;
+	return true;
+}
+
+/* stores the palette followed by one index per pixel, if the frame doesn't
+ * use more than 256 colors */
+static uint8_t *palettize_frame(const uint8_t *rgba, size_t area)
+{
+	uint32_t keys[GIF_PALETTE_HASH_SIZE];
+	int16_t indices[GIF_PALETTE_HASH_SIZE];
+	uint8_t *data = bmalloc(GIF_PALETTE_SIZE + area);
+	uint32_t *palette = (uint32_t *)data;
+	uint8_t *out = data + GIF_PALETTE_SIZE;
+	uint32_t last_color = 0;
+	int last_index = -1;
+	int colors = 0;
+
+	memset(indices, 0xFF, sizeof(indices));
+
+	for (size_t i = 0; i < area; i++) {
+		uint32_t color;
+		uint32_t hash;
+
+		memcpy(&color, rgba + i * 4, sizeof(color));
+
+		if (last_index != -1 && color == last_color) {
+			out[i] = (uint8_t)last_index;
+			continue;
+		}
+
+		hash = (color * 2654435761U) >> (32 - GIF_PALETTE_HASH_BITS);
+		while (indices[hash] != -1 && keys[hash] != color)
+			hash = (hash + 1) & (GIF_PALETTE_HASH_SIZE - 1);
+
+		if (indices[hash] == -1) {
+			if (colors == 256) {
+				bfree(data);
+				return NULL;
+			}
+
+			keys[hash] = color;
+			indices[hash] = (int16_t)colors;
+			palette[colors++] = color;
+		}
+
+		last_color = color;
+		last_index = indices[hash];
+		out[i] = (uint8_t)last_index;
+	}
+
+	return data;
+}
+
+static void store_frame(struct gs_gif_cache *cache, int frame)
+{
+	gs_image_file_t *image = cache->image;
+	const size_t area = (size_t)image->cx * image->cy;
+	const uint8_t *src = image->gif.frame_image;
+	uint8_t *data;
+	size_t size = area * 4;
+	bool paletted = false;
+	bool needed;
+	bool success;
+
+	/* frames that are only passed through on the way to the ones that are
+	 * needed aren't worth copying if they would just be dropped */
+	pthread_mutex_lock(&cache->mutex);
+	needed = cache->frames[frame].state == GIF_FRAME_EMPTY &&
+		 (!cache->limit ||
+		  get_distance(cache, frame) < get_lookahead(cache) ||
+		  cache->used_bytes + size <= cache->limit);
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (!needed)
+		return;
+
+	data = cache->scratch ? cache->scratch : bmalloc(size);
+	cache->scratch = NULL;
+
+	if (cache->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+		gs_premultiply_xyza_srgb_loop_restrict(data, src, area);
+	else if (cache->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+		gs_premultiply_xyza_loop_restrict(data, src, area);
+	else
+		memcpy(data, src, size);
+
+	if (cache->palette) {
+		uint8_t *indexed = palettize_frame(data, area);
+		if (indexed) {
+			cache->scratch = data;
+			data = indexed;
+			size = GIF_PALETTE_SIZE + area;
+			paletted = true;
+		}
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	success = insert_frame(cache, frame, data, size, paletted);
+	if (!success && get_distance(cache, frame) < get_lookahead(cache))
+		cache->blocked = true;
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (!success)
+		bfree(data);
+}
+
+static void decode_frame(struct gs_gif_cache *cache, int frame)
+{
+	gif_result result = gif_decode_frame(&cache->image->gif, frame);
+
+	cache->decode_pos = frame;
+
+	if (result == GIF_OK) {
+		store_frame(cache, frame);
+		return;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	if (cache->frames[frame].state == GIF_FRAME_EMPTY)
+		cache->frames[frame].state = GIF_FRAME_FAILED;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+static void gif_cache_decode_task(void *param)
+{
+	struct gs_gif_cache *cache = param;
+
+	/* decodes a few frames at a time so gifs take turns */
+	for (int i = 0; i < GIF_DECODE_BATCH; i++) {
+		int frame;
+
+		pthread_mutex_lock(&cache->mutex);
+		frame = get_missing_frame(cache);
+		pthread_mutex_unlock(&cache->mutex);
+
+		if (frame == -1)
+			break;
+
+		/* gif frames can only be decoded in order, but the last
+		 * decoded frame is still on the canvas */
+		if (frame == cache->decode_pos)
+			store_frame(cache, frame);
+		else if (frame > cache->decode_pos)
+			decode_frame(cache, cache->decode_pos + 1);
+		else
+			decode_frame(cache, 0);
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	if (cache->queue && get_missing_frame(cache) != -1) {
+		os_task_queue_queue_task(cache->queue, gif_cache_decode_task,
+					 cache);
+	} else {
+		cache->queued = false;
+		os_event_signal(cache->idle_event);
+	}
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/* returns true if the caller needs to decode on its own thread, which only
+ * happens if the decode thread couldn't be created */
+static bool schedule_decode(struct gs_gif_cache *cache)
+{
+	if (cache->queued || get_missing_frame(cache) == -1)
+		return false;
+
+	cache->queued = true;
+	os_event_reset(cache->idle_event);
+
+	if (!cache->queue)
+		return true;
+
+	os_task_queue_queue_task(cache->queue, gif_cache_decode_task, cache);
+	return false;
+}
+
+static inline void set_want_frame(struct gs_gif_cache *cache, int frame)
+{
+	if (cache->want_frame != frame) {
+		cache->want_frame = frame;
+		cache->blocked = false;
+	}
+}
+
+static bool gif_cache_update(struct gs_gif_cache *cache, int frame)
+{
+	bool ready;
+	bool decode;
+
+	pthread_mutex_lock(&cache->mutex);
+	set_want_frame(cache, frame);
+	ready = cache->frames[frame].state == GIF_FRAME_READY &&
+		cache->uploaded_frame != frame;
+	decode = schedule_decode(cache);
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (decode)
+		gif_cache_decode_task(cache);
+
+	return ready;
+}
+
+static void upload_paletted(gs_texture_t *tex, const uint8_t *data,
+			    uint32_t cx, uint32_t cy)
+{
+	const uint32_t *palette = (const uint32_t *)data;
+	const uint8_t *indices = data + GIF_PALETTE_SIZE;
+	uint8_t *ptr;
+	uint32_t linesize;
+
+	if (!gs_texture_map(tex, &ptr, &linesize))
+		return;
+
+	for (uint32_t y = 0; y < cy; y++) {
+		uint32_t *row = (uint32_t *)(ptr + (size_t)y * linesize);
+		const uint8_t *in = indices + (size_t)y * cx;
+
+		for (uint32_t x = 0; x < cx; x++)
+			row[x] = palette[in[x]];
+	}
+
+	gs_texture_unmap(tex);
+}
+
+/* never waits on decoding: if the frame isn't ready yet, the texture keeps
+ * the last frame until a later tick.  the frame is pinned instead of holding
+ * the mutex while uploading, so the decode thread can keep going */
+static void gif_cache_upload(struct gs_gif_cache *cache, gs_texture_t *tex,
+			     int frame)
+{
+	gs_image_file_t *image = cache->image;
+	struct gif_cache_frame *f;
+	const uint8_t *data = NULL;
+	bool paletted = false;
+	bool decode;
+
+	pthread_mutex_lock(&cache->mutex);
+	set_want_frame(cache, frame);
+
+	f = &cache->frames[frame];
+	if (f->state == GIF_FRAME_READY) {
+		data = f->data;
+		paletted = f->paletted;
+		f->busy = true;
+		f->last_used = ++cache->use_count;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (data && paletted)
+		upload_paletted(tex, data, image->cx, image->cy);
+	else if (data)
+		gs_texture_set_image(tex, data, image->cx * 4, false);
+
+	pthread_mutex_lock(&cache->mutex);
+	if (data) {
+		f->busy = false;
+		cache->uploaded_frame = frame;
+	}
+
+	decode = schedule_decode(cache);
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (decode)
+		gif_cache_decode_task(cache);
+}
+
+static struct gs_gif_cache *
+gif_cache_create(gs_image_file_t *image, enum gs_image_alpha_mode alpha_mode,
+		 uint64_t limit, bool palette)
+{
+	struct gs_gif_cache *cache = bzalloc(sizeof(*cache));
+
+	if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+		bfree(cache);
+		return NULL;
+	}
+	if (os_event_init(&cache->idle_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		pthread_mutex_destroy(&cache->mutex);
+		bfree(cache);
+		return NULL;
+	}
+
+	cache->image = image;
+	cache->alpha_mode = alpha_mode;
+	cache->limit = limit;
+	cache->palette = palette;
+	cache->frames = bzalloc(image->gif.frame_count *
+				sizeof(struct gif_cache_frame));
+	cache->uploaded_frame = -1;
+
+	cache->queue = gif_queue_acquire();
+
+	/* the first frame was decoded when the gif was loaded */
+	store_frame(cache, 0);
+	return cache;
+}
+
+static void gif_cache_destroy(struct gs_gif_cache *cache)
+{
+	bool queued;
+
+	if (!cache)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->stop = true;
+	queued = cache->queued;
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (queued) {
+		os_event_wait(cache->idle_event);
+
+		/* the task signals while holding the mutex */
+		pthread_mutex_lock(&cache->mutex);
+		pthread_mutex_unlock(&cache->mutex);
+	}
+
+	if (cache->queue)
+		gif_queue_release();
+
+	for (int i = 0; i < get_frame_count(cache); i++)
+		bfree(cache->frames[i].data);
+	bfree(cache->frames);
+	bfree(cache->scratch);
+
+	os_event_destroy(cache->idle_event);
+	pthread_mutex_destroy(&cache->mutex);
+	bfree(cache);
+}
+
+void gs_image_file5_init(gs_image_file5_t *if5, const char *file,
+			 enum gs_image_alpha_mode alpha_mode,
+			 uint64_t gif_cache_limit, bool gif_palette)
+{
+	gs_image_file_t *image = &if5->image4.image3.image2.image;
+	uint64_t *mem_usage = &if5->image4.image3.image2.mem_usage;
+	uint64_t prev_mem_usage = *mem_usage;
+
+	if5->gif_cache = NULL;
+	gs_image_file_init_internal(image, file, mem_usage, &if5->image4.space,
+				    alpha_mode, true);
+	if5->image4.image3.alpha_mode = alpha_mode;
+
+	if (image->loaded && image->is_animated_gif) {
+		uint64_t full_size = (uint64_t)get_full_decoded_gif_size(image);
+
+		if5->gif_cache = gif_cache_create(image, alpha_mode,
+						  gif_cache_limit, gif_palette);
+
+		/* without the cache, the tick and update functions of file4
+		 * need every frame decoded up front */
+		if (!if5->gif_cache) {
+			blog(LOG_WARNING,
+			     "Failed to create gif cache, '%s' will be fully "
+			     "decoded instead",
+			     file);
+			gs_image_file_free(image);
+			*mem_usage = prev_mem_usage;
+			gs_image_file_init_internal(image, file, mem_usage,
+						    &if5->image4.space,
+						    alpha_mode, false);
+			return;
+		}
+
+		if (!if5->gif_cache->queue)
+			blog(LOG_WARNING,
+			     "Failed to create decode thread, '%s' will be "
+			     "decoded while rendering",
+			     file);
+		*mem_usage += gif_cache_limit && gif_cache_limit < full_size
+				      ? gif_cache_limit
+				      : full_size;
+	}
+}
+
+void gs_image_file5_free(gs_image_file5_t *if5)
+{
+	/* stops decoding before the gif itself is freed */
+	gif_cache_destroy(if5->gif_cache);
+	if5->gif_cache = NULL;
+
+	gs_image_file4_free(&if5->image4);
+}
+
+void gs_image_file5_init_texture(gs_image_file5_t *if5)
+{
+	gs_image_file_t *image = &if5->image4.image3.image2.image;
+
+	if (!if5->gif_cache) {
+		gs_image_file4_init_texture(&if5->image4);
+		return;
+	}
+
+	image->texture = gs_texture_create(image->cx, image->cy, image->format,
+					   1, NULL, GS_DYNAMIC);
+	if (image->texture)
+		gif_cache_upload(if5->gif_cache, image->texture,
+				 image->cur_frame);
+}
+
+bool gs_image_file5_tick(gs_image_file5_t *if5, uint64_t elapsed_time_ns)
+{
+	gs_image_file_t *image = &if5->image4.image3.image2.image;
+	int loops;
+
+	if (!if5->gif_cache)
+		return gs_image_file4_tick(&if5->image4, elapsed_time_ns);
+
+	loops = get_loop_count(image);
+
+	if (!loops || image->cur_loop < loops)
+		image->cur_frame =
+			calculate_new_frame(image, elapsed_time_ns, loops);
+
+	return gif_cache_update(if5->gif_cache, image->cur_frame);
+}
+
+void gs_image_file5_update_texture(gs_image_file5_t *if5)
+{
+	gs_image_file_t *image = &if5->image4.image3.image2.image;
+
+	if (!if5->gif_cache) {
+		gs_image_file4_update_texture(&if5->image4);
+		return;
+	}
+
+	if (image->texture)
+		gif_cache_upload(if5->gif_cache, image->texture,
+				 image->cur_frame);
+}
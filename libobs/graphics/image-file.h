@@ -61,10 +61,20 @@ struct gs_image_file4 {
 	enum gs_color_space space;
 };
 
+struct gs_gif_cache;
+
+/* animated gifs are decoded ahead of playback on a background thread, and
+ * only a limited amount of decoded frames are kept in memory */
+struct gs_image_file5 {
+	struct gs_image_file4 image4;
+	struct gs_gif_cache *gif_cache;
+};
+
 typedef struct gs_image_file gs_image_file_t;
 typedef struct gs_image_file2 gs_image_file2_t;
 typedef struct gs_image_file3 gs_image_file3_t;
 typedef struct gs_image_file4 gs_image_file4_t;
+typedef struct gs_image_file5 gs_image_file5_t;
 
 EXPORT void gs_image_file_init(gs_image_file_t *image, const char *file);
 EXPORT void gs_image_file_free(gs_image_file_t *image);
@@ -94,6 +104,19 @@ EXPORT bool gs_image_file4_tick(gs_image_file4_t *if4,
 				uint64_t elapsed_time_ns);
 EXPORT void gs_image_file4_update_texture(gs_image_file4_t *if4);
 
+/* gif_cache_limit is the number of bytes of decoded frames to keep, or 0 to
+ * keep every frame.  with gif_palette set, frames with no more than 256
+ * colors are kept as palette indices, and expanded when uploaded */
+EXPORT void gs_image_file5_init(gs_image_file5_t *if5, const char *file,
+				enum gs_image_alpha_mode alpha_mode,
+				uint64_t gif_cache_limit, bool gif_palette);
+EXPORT void gs_image_file5_free(gs_image_file5_t *if5);
+EXPORT void gs_image_file5_init_texture(gs_image_file5_t *if5);
+
+EXPORT bool gs_image_file5_tick(gs_image_file5_t *if5,
+				uint64_t elapsed_time_ns);
+EXPORT void gs_image_file5_update_texture(gs_image_file5_t *if5);
+
 static void gs_image_file2_free(gs_image_file2_t *if2)
 {
 	gs_image_file_free(&if2->image);
@@ -0,0 +1,122 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix.h"
+
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+/* the AVX path is only built for x86 targets with native SSE2, where
+ * sse-intrin.h doesn't emulate SSE through SIMDe.  ARM64EC defines _M_X64
+ * but has no AVX.  immintrin.h has to come first, as SIMDe's aliases for the
+ * SSE4 intrinsics would otherwise clash with its declarations */
+#if (defined(_M_X64) && !defined(_M_ARM64EC)) || defined(_M_IX86) || \
+	((defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__))
+#define AUDIO_MIX_AVX
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+#endif
+
+#include "../util/sse-intrin.h"
+
+typedef void (*mix_func_t)(float *dst, const float *src, size_t count);
+
+static void mix_float_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128 a0 = _mm_add_ps(_mm_loadu_ps(dst + i),
+				       _mm_loadu_ps(src + i));
+		__m128 a1 = _mm_add_ps(_mm_loadu_ps(dst + i + 4),
+				       _mm_loadu_ps(src + i + 4));
+		__m128 a2 = _mm_add_ps(_mm_loadu_ps(dst + i + 8),
+				       _mm_loadu_ps(src + i + 8));
+		__m128 a3 = _mm_add_ps(_mm_loadu_ps(dst + i + 12),
+				       _mm_loadu_ps(src + i + 12));
+		_mm_storeu_ps(dst + i, a0);
+		_mm_storeu_ps(dst + i + 4, a1);
+		_mm_storeu_ps(dst + i + 8, a2);
+		_mm_storeu_ps(dst + i + 12, a3);
+	}
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+						  _mm_loadu_ps(src + i)));
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+#ifdef AUDIO_MIX_AVX
+TARGET_AVX static void mix_float_avx(float *dst, const float *src,
+				     size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m256 a0 = _mm256_add_ps(_mm256_loadu_ps(dst + i),
+					  _mm256_loadu_ps(src + i));
+		__m256 a1 = _mm256_add_ps(_mm256_loadu_ps(dst + i + 8),
+					  _mm256_loadu_ps(src + i + 8));
+		__m256 a2 = _mm256_add_ps(_mm256_loadu_ps(dst + i + 16),
+					  _mm256_loadu_ps(src + i + 16));
+		__m256 a3 = _mm256_add_ps(_mm256_loadu_ps(dst + i + 24),
+					  _mm256_loadu_ps(src + i + 24));
+		_mm256_storeu_ps(dst + i, a0);
+		_mm256_storeu_ps(dst + i + 8, a1);
+		_mm256_storeu_ps(dst + i + 16, a2);
+		_mm256_storeu_ps(dst + i + 24, a3);
+	}
+
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(dst + i,
+				 _mm256_add_ps(_mm256_loadu_ps(dst + i),
+					       _mm256_loadu_ps(src + i)));
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+#endif
+
+static mix_func_t get_mix_func(void)
+{
+#ifdef AUDIO_MIX_AVX
+	if (os_cpu_has_avx())
+		return mix_float_avx;
+#endif
+	return mix_float_sse;
+}
+
+void audio_mix_float(float *dst, const float *src, size_t count)
+{
+	static volatile long resolved = 0;
+	static mix_func_t mix_func = mix_float_sse;
+
+	/* racing threads resolve to the same function, so this is benign */
+	if (!os_atomic_load_long(&resolved)) {
+		mix_func = get_mix_func();
+		os_atomic_set_long(&resolved, 1);
+	}
+
+	mix_func(dst, src, count);
+}
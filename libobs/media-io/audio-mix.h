@@ -0,0 +1,36 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Adds count floats from src to dst (dst[i] += src[i]).
+ *
+ * Uses SSE, or AVX when the CPU supports it.  Each element is a single
+ * IEEE addition, so the result is bit-for-bit identical to a scalar loop.
+ */
+EXPORT void audio_mix_float(float *dst, const float *src, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
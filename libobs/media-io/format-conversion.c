@@ -15,8 +15,29 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <string.h>
+
 #include "format-conversion.h"
 
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+/* the AVX2 kernels are only built for x86 targets with native SSE2, where
+ * sse-intrin.h doesn't emulate SSE through SIMDe, the same as in
+ * audio-mix.c.  immintrin.h has to come first */
+#if (defined(_M_X64) && !defined(_M_ARM64EC)) || defined(_M_IX86) || \
+	((defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__))
+#define FORMAT_CONVERSION_AVX2
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
 #include "../util/sse-intrin.h"
 
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
@@ -90,9 +111,28 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static bool use_avx2(void)
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	static volatile long avx2 = -1;
+	long val = os_atomic_load_long(&avx2);
+
+	/* racing threads detect the same thing, so this is benign */
+	if (val == -1) {
+		val = os_cpu_has_avx2() ? 1 : 0;
+		os_atomic_set_long(&avx2, val);
+	}
+
+	return val == 1;
+#else
+	return false;
+#endif
+}
+
+static void compress_uyvx_to_i420_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -127,9 +167,10 @@ void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static void compress_uyvx_to_nv12_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *chroma_plane = output[1];
@@ -200,9 +241,10 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize)
+static void decompress_420_c(const uint8_t *const input[],
+			     const uint32_t in_linesize[], uint32_t start_y,
+			     uint32_t end_y, uint8_t *output,
+			     uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = in_linesize[0] / 2;
@@ -234,9 +276,10 @@ void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
 	}
 }
 
-void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
-		     uint32_t start_y, uint32_t end_y, uint8_t *output,
-		     uint32_t out_linesize)
+static void decompress_nv12_c(const uint8_t *const input[],
+			      const uint32_t in_linesize[], uint32_t start_y,
+			      uint32_t end_y, uint8_t *output,
+			      uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
@@ -267,9 +310,9 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 	}
 }
 
-void decompress_422(const uint8_t *input, uint32_t in_linesize,
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize, bool leading_lum)
+static void decompress_422_c(const uint8_t *input, uint32_t in_linesize,
+			     uint32_t start_y, uint32_t end_y, uint8_t *output,
+			     uint32_t out_linesize, bool leading_lum)
 {
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
 	uint32_t y;
@@ -316,3 +359,1111 @@ void decompress_422(const uint8_t *input, uint32_t in_linesize,
 		}
 	}
 }
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef FORMAT_CONVERSION_AVX2
+/* the AVX2 versions are byte for byte identical to the SSE2 and C versions,
+ * they just handle 16 pixels per iteration instead of 4 or 2 */
+
+TARGET_AVX2 static inline __m256i uyvx_lum_avx2(__m256i line)
+{
+	return _mm256_and_si256(_mm256_srli_epi32(line, 8),
+				_mm256_set1_epi32(0xFF));
+}
+
+/* packs the 32-bit luma values of 16 pixels from each of two rows */
+TARGET_AVX2 static inline void store_lum_avx2(uint8_t *lum0, uint8_t *lum1,
+					      __m256i a1, __m256i b1,
+					      __m256i a2, __m256i b2)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i lum = _mm256_packus_epi16(_mm256_packus_epi32(a1, b1),
+					  _mm256_packus_epi32(a2, b2));
+
+	lum = _mm256_permutevar8x32_epi32(lum, order);
+	_mm_storeu_si128((__m128i *)lum0, _mm256_castsi256_si128(lum));
+	if (lum1)
+		_mm_storeu_si128((__m128i *)lum1,
+				 _mm256_extracti128_si256(lum, 1));
+}
+
+/* averages the chroma of 8 2x2 blocks of packed 444, leaving the U and V of
+ * each block in the low and high 16 bits of a 32-bit lane */
+TARGET_AVX2 static inline __m256i avg_uv_avx2(__m256i a1, __m256i b1,
+					      __m256i a2, __m256i b2)
+{
+	const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	__m256i a = _mm256_add_epi16(_mm256_and_si256(a1, mask),
+				     _mm256_and_si256(a2, mask));
+	__m256i b = _mm256_add_epi16(_mm256_and_si256(b1, mask),
+				     _mm256_and_si256(b2, mask));
+	__m256i sum = _mm256_hadd_epi32(a, b);
+
+	sum = _mm256_permutevar8x32_epi32(sum, order);
+	return _mm256_srli_epi16(sum, 2);
+}
+
+TARGET_AVX2 static void compress_uyvx_to_i420_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *u_plane = output[1];
+	uint8_t *v_plane = output[2];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	const __m256i uv_split =
+		_mm256_setr_epi8(0, 2, 4, 6, 1, 3, 5, 7, 8, 10, 12, 14, 9, 11,
+				 13, 15, 0, 2, 4, 6, 1, 3, 5, 7, 8, 10, 12, 14,
+				 9, 11, 13, 15);
+	const __m256i uv_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x >> 1);
+
+			__m256i a1 = _mm256_loadu_si256((const __m256i *)img);
+			__m256i b1 = _mm256_loadu_si256(
+				(const __m256i *)(img + 32));
+			__m256i a2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+			__m256i b2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize + 32));
+			__m256i uv;
+			__m128i uv_128;
+
+			store_lum_avx2(lum_plane + lum_pos0,
+				       lum_plane + lum_pos1, uyvx_lum_avx2(a1),
+				       uyvx_lum_avx2(b1), uyvx_lum_avx2(a2),
+				       uyvx_lum_avx2(b2));
+
+			uv = avg_uv_avx2(a1, b1, a2, b2);
+			uv = _mm256_packus_epi16(uv, uv);
+			uv = _mm256_shuffle_epi8(uv, uv_split);
+			uv = _mm256_permutevar8x32_epi32(uv, uv_order);
+			uv_128 = _mm256_castsi256_si128(uv);
+
+			_mm_storel_epi64((__m128i *)(u_plane + chroma_pos),
+					 uv_128);
+			_mm_storel_epi64((__m128i *)(v_plane + chroma_pos),
+					 _mm_srli_si128(uv_128, 8));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i *)img);
+			__m128i line2 = _mm_load_si128(
+				(const __m128i *)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1, line1, line2,
+				   lum_mask, 1);
+			pack_ch_2plane(u_plane, v_plane,
+				       chroma_y_pos + (x >> 1), line1, line2,
+				       uv_mask);
+		}
+	}
+}
+
+TARGET_AVX2 static void compress_uyvx_to_nv12_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i a1 = _mm256_loadu_si256((const __m256i *)img);
+			__m256i b1 = _mm256_loadu_si256(
+				(const __m256i *)(img + 32));
+			__m256i a2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+			__m256i b2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize + 32));
+			__m256i uv;
+
+			store_lum_avx2(lum_plane + lum_pos0,
+				       lum_plane + lum_pos1, uyvx_lum_avx2(a1),
+				       uyvx_lum_avx2(b1), uyvx_lum_avx2(a2),
+				       uyvx_lum_avx2(b2));
+
+			uv = avg_uv_avx2(a1, b1, a2, b2);
+			uv = _mm256_packus_epi16(uv, uv);
+			uv = _mm256_permute4x64_epi64(uv,
+						       _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128(
+				(__m128i *)(chroma_plane + chroma_y_pos + x),
+				_mm256_castsi256_si128(uv));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i *)img);
+			__m128i line2 = _mm_load_si128(
+				(const __m128i *)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1, line1, line2,
+				   lum_mask, 1);
+			pack_ch_1plane(chroma_plane, chroma_y_pos + x, line1,
+				       line2, uv_mask);
+		}
+	}
+}
+
+/* expands 16 luma values and 8 chroma values into 16 packed 444 pixels */
+TARGET_AVX2 static inline void expand_line_avx2(uint32_t *output,
+						const uint8_t *lum,
+						__m128i chroma, bool lum_high)
+{
+	__m128i lum_128 = _mm_loadu_si128((const __m128i *)lum);
+	__m256i lum_lo = _mm256_cvtepu8_epi32(lum_128);
+	__m256i lum_hi = _mm256_cvtepu8_epi32(_mm_srli_si128(lum_128, 8));
+	__m256i uv_lo =
+		_mm256_cvtepu16_epi32(_mm_unpacklo_epi16(chroma, chroma));
+	__m256i uv_hi =
+		_mm256_cvtepu16_epi32(_mm_unpackhi_epi16(chroma, chroma));
+
+	if (lum_high) {
+		lum_lo = _mm256_slli_epi32(lum_lo, 16);
+		lum_hi = _mm256_slli_epi32(lum_hi, 16);
+	} else {
+		uv_lo = _mm256_slli_epi32(uv_lo, 8);
+		uv_hi = _mm256_slli_epi32(uv_hi, 8);
+	}
+
+	_mm256_storeu_si256((__m256i *)output, _mm256_or_si256(lum_lo, uv_lo));
+	_mm256_storeu_si256((__m256i *)(output + 8),
+			    _mm256_or_si256(lum_hi, uv_hi));
+}
+
+TARGET_AVX2 static void decompress_420_avx2(const uint8_t *const input[],
+					    const uint32_t in_linesize[],
+					    uint32_t start_y, uint32_t end_y,
+					    uint8_t *output,
+					    uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y / 2;
+	uint32_t width_d2 = in_linesize[0] / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i uv = _mm_unpacklo_epi8(
+				_mm_loadl_epi64((const __m128i *)(chroma1 + x)),
+				_mm_loadl_epi64(
+					(const __m128i *)(chroma0 + x)));
+
+			expand_line_avx2(output0 + x * 2, lum0 + x * 2, uv,
+					 true);
+			expand_line_avx2(output1 + x * 2, lum1 + x * 2, uv,
+					 true);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | chroma1[x];
+
+			output0[x * 2] = (lum0[x * 2] << 16) | out;
+			output0[x * 2 + 1] = (lum0[x * 2 + 1] << 16) | out;
+
+			output1[x * 2] = (lum1[x * 2] << 16) | out;
+			output1[x * 2 + 1] = (lum1[x * 2 + 1] << 16) | out;
+		}
+	}
+}
+
+TARGET_AVX2 static void decompress_nv12_avx2(const uint8_t *const input[],
+					     const uint32_t in_linesize[],
+					     uint32_t start_y, uint32_t end_y,
+					     uint8_t *output,
+					     uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i uv = _mm_loadu_si128(
+				(const __m128i *)(chroma + x));
+
+			expand_line_avx2(output0 + x * 2, lum0 + x * 2, uv,
+					 false);
+			expand_line_avx2(output1 + x * 2, lum1 + x * 2, uv,
+					 false);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x * 2] = lum0[x * 2] | out;
+			output0[x * 2 + 1] = lum0[x * 2 + 1] | out;
+
+			output1[x * 2] = lum1[x * 2] | out;
+			output1[x * 2 + 1] = lum1[x * 2 + 1] | out;
+		}
+	}
+}
+
+TARGET_AVX2 static void decompress_422_avx2(const uint8_t *input,
+					    uint32_t in_linesize,
+					    uint32_t start_y, uint32_t end_y,
+					    uint8_t *output,
+					    uint32_t out_linesize,
+					    bool leading_lum)
+{
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
+	uint32_t y;
+
+	/* each dword is output once as is, then with its other luma value */
+	const __m256i shuffle =
+		leading_lum
+			? _mm256_setr_epi8(0, 1, 2, 3, 2, 1, 2, 3, 4, 5, 6, 7,
+					   6, 5, 6, 7, 8, 9, 10, 11, 10, 9, 10,
+					   11, 12, 13, 14, 15, 14, 13, 14, 15)
+			: _mm256_setr_epi8(0, 1, 2, 3, 0, 3, 2, 3, 4, 5, 6, 7,
+					   4, 7, 6, 7, 8, 9, 10, 11, 8, 11, 10,
+					   11, 12, 13, 14, 15, 12, 15, 14, 15);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32 =
+			(const uint32_t *)(input + y * in_linesize);
+		uint32_t *output32 = (uint32_t *)(output + y * out_linesize);
+		uint32_t x;
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			const __m128i *in = (const __m128i *)(input32 + x);
+			__m256i dw = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128(in));
+
+			_mm256_storeu_si256((__m256i *)(output32 + x * 2),
+					    _mm256_shuffle_epi8(dw, shuffle));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t dw = input32[x];
+
+			output32[x * 2] = dw;
+			if (leading_lum) {
+				dw &= 0xFFFFFF00;
+				dw |= (uint8_t)(dw >> 16);
+			} else {
+				dw &= 0xFFFF00FF;
+				dw |= (dw >> 16) & 0xFF00;
+			}
+			output32[x * 2 + 1] = dw;
+		}
+	}
+}
+#endif
+
+void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		compress_uyvx_to_i420_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+	compress_uyvx_to_i420_sse2(input, in_linesize, start_y, end_y, output,
+				   out_linesize);
+}
+
+void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		compress_uyvx_to_nv12_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+	compress_uyvx_to_nv12_sse2(input, in_linesize, start_y, end_y, output,
+				   out_linesize);
+}
+
+void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize)
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		decompress_420_avx2(input, in_linesize, start_y, end_y, output,
+				    out_linesize);
+		return;
+	}
+#endif
+	decompress_420_c(input, in_linesize, start_y, end_y, output,
+			 out_linesize);
+}
+
+void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
+		     uint32_t start_y, uint32_t end_y, uint8_t *output,
+		     uint32_t out_linesize)
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		decompress_nv12_avx2(input, in_linesize, start_y, end_y, output,
+				     out_linesize);
+		return;
+	}
+#endif
+	decompress_nv12_c(input, in_linesize, start_y, end_y, output,
+			  out_linesize);
+}
+
+void decompress_422(const uint8_t *input, uint32_t in_linesize,
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize, bool leading_lum)
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		decompress_422_avx2(input, in_linesize, start_y, end_y, output,
+				    out_linesize, leading_lum);
+		return;
+	}
+#endif
+	decompress_422_c(input, in_linesize, start_y, end_y, output,
+			 out_linesize, leading_lum);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* fixed point RGB to YUV.  luma is calculated per pixel, and chroma from the
+ * sum of a 2x2 block of pixels, which is why it's shifted by two more bits */
+#define COEFF_BITS 14
+#define UV_SHIFT (COEFF_BITS + 2)
+
+struct bgra_coeffs {
+	int16_t y[4]; /* in BGRA order, alpha is always 0 */
+	int16_t u[4];
+	int16_t v[4];
+	int32_t y_offset;
+	int32_t uv_offset;
+};
+
+static inline int16_t to_fixed(double val)
+{
+	val *= (double)(1 << COEFF_BITS);
+	return (int16_t)(val < 0.0 ? val - 0.5 : val + 0.5);
+}
+
+static void get_bgra_coeffs(struct bgra_coeffs *coeffs,
+			    enum video_colorspace colorspace,
+			    enum video_range_type range)
+{
+	double kr, kb, kg;
+	double y_scale = 1.0;
+	double uv_scale = 1.0;
+	int32_t y_min = 0;
+
+	switch (colorspace) {
+	case VIDEO_CS_601:
+		kr = 0.299;
+		kb = 0.114;
+		break;
+	case VIDEO_CS_2100_PQ:
+	case VIDEO_CS_2100_HLG:
+		kr = 0.2627;
+		kb = 0.0593;
+		break;
+	default:
+		kr = 0.2126;
+		kb = 0.0722;
+	}
+
+	kg = 1.0 - kr - kb;
+
+	if (range != VIDEO_RANGE_FULL) {
+		y_scale = 219.0 / 255.0;
+		uv_scale = 224.0 / 255.0;
+		y_min = 16;
+	}
+
+	coeffs->y[0] = to_fixed(kb * y_scale);
+	coeffs->y[1] = to_fixed(kg * y_scale);
+	coeffs->y[2] = to_fixed(kr * y_scale);
+	coeffs->y[3] = 0;
+
+	coeffs->u[0] = to_fixed(0.5 * uv_scale);
+	coeffs->u[1] = to_fixed(-kg / (2.0 * (1.0 - kb)) * uv_scale);
+	coeffs->u[2] = to_fixed(-kr / (2.0 * (1.0 - kb)) * uv_scale);
+	coeffs->u[3] = 0;
+
+	coeffs->v[0] = to_fixed(-kb / (2.0 * (1.0 - kr)) * uv_scale);
+	coeffs->v[1] = to_fixed(-kg / (2.0 * (1.0 - kr)) * uv_scale);
+	coeffs->v[2] = to_fixed(0.5 * uv_scale);
+	coeffs->v[3] = 0;
+
+	/* the offsets include rounding, and keep every sum positive */
+	coeffs->y_offset = (y_min << COEFF_BITS) + (1 << (COEFF_BITS - 1));
+	coeffs->uv_offset = (128 << UV_SHIFT) + (1 << (UV_SHIFT - 1));
+}
+
+static inline uint8_t clamp_uint8(int32_t val)
+{
+	return val > 255 ? 255 : (uint8_t)val;
+}
+
+static inline uint8_t bgra_lum(const struct bgra_coeffs *coeffs,
+			       const uint8_t *pixel)
+{
+	return clamp_uint8((coeffs->y[0] * pixel[0] + coeffs->y[1] * pixel[1] +
+			    coeffs->y[2] * pixel[2] + coeffs->y_offset) >>
+			   COEFF_BITS);
+}
+
+/* the chroma plane of an odd width frame may not have room for the chroma of
+ * the last column */
+static inline uint32_t get_uv_width(uint32_t width, uint32_t uv_linesize)
+{
+	return min_uint32((width + 1) & ~1, uv_linesize & ~1);
+}
+
+/* converts a pair of rows starting at x.  line1 is the same as line0 and lum1
+ * is NULL for the last row of a frame with an odd height */
+static inline void compress_bgra_rows(const struct bgra_coeffs *coeffs,
+				      const uint8_t *line0,
+				      const uint8_t *line1, uint8_t *lum0,
+				      uint8_t *lum1, uint8_t *chroma,
+				      uint32_t x, uint32_t width,
+				      uint32_t uv_width)
+{
+	for (; x < width; x += 2) {
+		const uint8_t *pixel0 = line0 + x * 4;
+		const uint8_t *pixel1 = line1 + x * 4;
+		uint32_t next = x + 1 < width ? 4 : 0;
+		int32_t b, g, r;
+
+		lum0[x] = bgra_lum(coeffs, pixel0);
+		if (next)
+			lum0[x + 1] = bgra_lum(coeffs, pixel0 + 4);
+		if (lum1) {
+			lum1[x] = bgra_lum(coeffs, pixel1);
+			if (next)
+				lum1[x + 1] = bgra_lum(coeffs, pixel1 + 4);
+		}
+
+		if (x >= uv_width)
+			continue;
+
+		b = pixel0[0] + pixel0[next] + pixel1[0] + pixel1[next];
+		g = pixel0[1] + pixel0[next + 1] + pixel1[1] +
+		    pixel1[next + 1];
+		r = pixel0[2] + pixel0[next + 2] + pixel1[2] +
+		    pixel1[next + 2];
+
+		chroma[x] =
+			clamp_uint8((coeffs->u[0] * b + coeffs->u[1] * g +
+				     coeffs->u[2] * r + coeffs->uv_offset) >>
+				    UV_SHIFT);
+		chroma[x + 1] =
+			clamp_uint8((coeffs->v[0] * b + coeffs->v[1] * g +
+				     coeffs->v[2] * r + coeffs->uv_offset) >>
+				    UV_SHIFT);
+	}
+}
+
+static void compress_bgra_to_nv12_c(const uint8_t *input, uint32_t in_linesize,
+				    uint32_t start_y, uint32_t end_y,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[],
+				    const struct bgra_coeffs *coeffs)
+{
+	uint32_t width = min_uint32(in_linesize / 4, out_linesize[0]);
+	uint32_t uv_width = get_uv_width(width, out_linesize[1]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line0 = input + y * in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *chroma = output[1] + (y >> 1) * out_linesize[1];
+		bool last = y + 1 >= end_y;
+
+		compress_bgra_rows(coeffs, line0,
+				   last ? line0 : line0 + in_linesize, lum0,
+				   last ? NULL : lum0 + out_linesize[0], chroma,
+				   0, width, uv_width);
+	}
+}
+
+static void convert_i010_to_p010_c(const uint8_t *const input[],
+				   const uint32_t in_linesize[],
+				   uint32_t start_y, uint32_t end_y,
+				   uint8_t *output[],
+				   const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize[0]) / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[1] / 2, out_linesize[1] / 4);
+	uint32_t y, x;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint16_t *lum_in =
+			(const uint16_t *)(input[0] + y * in_linesize[0]);
+		uint16_t *lum_out =
+			(uint16_t *)(output[0] + y * out_linesize[0]);
+		const uint16_t *u_in, *v_in;
+		uint16_t *uv_out;
+
+		for (x = 0; x < width; x++)
+			lum_out[x] = (uint16_t)(lum_in[x] << 6);
+
+		if (y & 1)
+			continue;
+
+		u_in = (const uint16_t *)(input[1] + (y >> 1) * in_linesize[1]);
+		v_in = (const uint16_t *)(input[2] + (y >> 1) * in_linesize[2]);
+		uv_out = (uint16_t *)(output[1] + (y >> 1) * out_linesize[1]);
+
+		for (x = 0; x < width_d2; x++) {
+			uv_out[x * 2] = (uint16_t)(u_in[x] << 6);
+			uv_out[x * 2 + 1] = (uint16_t)(v_in[x] << 6);
+		}
+	}
+}
+
+static void convert_p010_to_i010_c(const uint8_t *const input[],
+				   const uint32_t in_linesize[],
+				   uint32_t start_y, uint32_t end_y,
+				   uint8_t *output[],
+				   const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize[0]) / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[1] / 4, out_linesize[1] / 2);
+	uint32_t y, x;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint16_t *lum_in =
+			(const uint16_t *)(input[0] + y * in_linesize[0]);
+		uint16_t *lum_out =
+			(uint16_t *)(output[0] + y * out_linesize[0]);
+		const uint16_t *uv_in;
+		uint16_t *u_out, *v_out;
+
+		for (x = 0; x < width; x++)
+			lum_out[x] = lum_in[x] >> 6;
+
+		if (y & 1)
+			continue;
+
+		uv_in = (const uint16_t *)(input[1] +
+					    (y >> 1) * in_linesize[1]);
+		u_out = (uint16_t *)(output[1] + (y >> 1) * out_linesize[1]);
+		v_out = (uint16_t *)(output[2] + (y >> 1) * out_linesize[2]);
+
+		for (x = 0; x < width_d2; x++) {
+			u_out[x] = uv_in[x * 2] >> 6;
+			v_out[x] = uv_in[x * 2 + 1] >> 6;
+		}
+	}
+}
+
+#ifdef FORMAT_CONVERSION_AVX2
+TARGET_AVX2 static inline __m256i load_coeffs_avx2(const int16_t coeffs[4])
+{
+	int64_t val;
+
+	memcpy(&val, coeffs, sizeof(val));
+	return _mm256_set1_epi64x(val);
+}
+
+/* calculates the luma of 8 pixels */
+TARGET_AVX2 static inline __m256i bgra_lum_avx2(__m256i pixels,
+						__m256i coeffs,
+						__m256i offset)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero),
+				       coeffs);
+	__m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero),
+				       coeffs);
+
+	return _mm256_srai_epi32(
+		_mm256_add_epi32(_mm256_hadd_epi32(lo, hi), offset),
+		COEFF_BITS);
+}
+
+/* calculates the chroma of 4 2x2 blocks, leaving them interleaved as U and V
+ * in 32-bit lanes */
+TARGET_AVX2 static inline __m256i bgra_uv_avx2(__m256i line0, __m256i line1,
+					       __m256i u_coeffs,
+					       __m256i v_coeffs,
+					       __m256i offset)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(line0, zero),
+				      _mm256_unpacklo_epi8(line1, zero));
+	__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(line0, zero),
+				      _mm256_unpackhi_epi8(line1, zero));
+	__m256i sum, uv;
+
+	lo = _mm256_add_epi16(lo, _mm256_shuffle_epi32(
+					  lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm256_add_epi16(hi, _mm256_shuffle_epi32(
+					  hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm256_unpacklo_epi64(lo, hi);
+
+	uv = _mm256_hadd_epi32(_mm256_madd_epi16(sum, u_coeffs),
+			       _mm256_madd_epi16(sum, v_coeffs));
+	uv = _mm256_srai_epi32(_mm256_add_epi32(uv, offset), UV_SHIFT);
+	return _mm256_shuffle_epi32(uv, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+TARGET_AVX2 static void compress_bgra_to_nv12_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[],
+	const struct bgra_coeffs *coeffs)
+{
+	uint32_t width = min_uint32(in_linesize / 4, out_linesize[0]);
+	uint32_t uv_width = get_uv_width(width, out_linesize[1]);
+	uint32_t vec_width = min_uint32(width, uv_width);
+	uint32_t y;
+
+	const __m256i y_coeffs = load_coeffs_avx2(coeffs->y);
+	const __m256i u_coeffs = load_coeffs_avx2(coeffs->u);
+	const __m256i v_coeffs = load_coeffs_avx2(coeffs->v);
+	const __m256i y_offset = _mm256_set1_epi32(coeffs->y_offset);
+	const __m256i uv_offset = _mm256_set1_epi32(coeffs->uv_offset);
+	const __m256i uv_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line0 = input + y * in_linesize;
+		const uint8_t *line1 = line0 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *chroma = output[1] + (y >> 1) * out_linesize[1];
+		uint32_t x;
+
+		if (y + 1 >= end_y) {
+			line1 = line0;
+			lum1 = NULL;
+		}
+
+		for (x = 0; x + 16 <= vec_width; x += 16) {
+			__m256i a1 = _mm256_loadu_si256(
+				(const __m256i *)(line0 + x * 4));
+			__m256i b1 = _mm256_loadu_si256(
+				(const __m256i *)(line0 + x * 4 + 32));
+			__m256i a2 = _mm256_loadu_si256(
+				(const __m256i *)(line1 + x * 4));
+			__m256i b2 = _mm256_loadu_si256(
+				(const __m256i *)(line1 + x * 4 + 32));
+			__m256i uv_a, uv_b, uv;
+
+			store_lum_avx2(lum0 + x, lum1 ? lum1 + x : NULL,
+				       bgra_lum_avx2(a1, y_coeffs, y_offset),
+				       bgra_lum_avx2(b1, y_coeffs, y_offset),
+				       bgra_lum_avx2(a2, y_coeffs, y_offset),
+				       bgra_lum_avx2(b2, y_coeffs, y_offset));
+
+			uv_a = bgra_uv_avx2(a1, a2, u_coeffs, v_coeffs,
+					    uv_offset);
+			uv_b = bgra_uv_avx2(b1, b2, u_coeffs, v_coeffs,
+					    uv_offset);
+			uv = _mm256_packus_epi32(uv_a, uv_b);
+			uv = _mm256_packus_epi16(uv, uv);
+			uv = _mm256_permutevar8x32_epi32(uv, uv_order);
+			_mm_storeu_si128((__m128i *)(chroma + x),
+					 _mm256_castsi256_si128(uv));
+		}
+
+		compress_bgra_rows(coeffs, line0, line1, lum0, lum1, chroma, x,
+				   width, uv_width);
+	}
+}
+
+TARGET_AVX2 static void convert_i010_to_p010_avx2(
+	const uint8_t *const input[], const uint32_t in_linesize[],
+	uint32_t start_y, uint32_t end_y, uint8_t *output[],
+	const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize[0]) / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[1] / 2, out_linesize[1] / 4);
+	uint32_t y, x;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint16_t *lum_in =
+			(const uint16_t *)(input[0] + y * in_linesize[0]);
+		uint16_t *lum_out =
+			(uint16_t *)(output[0] + y * out_linesize[0]);
+		const uint16_t *u_in, *v_in;
+		uint16_t *uv_out;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			__m256i lum = _mm256_loadu_si256(
+				(const __m256i *)(lum_in + x));
+			_mm256_storeu_si256((__m256i *)(lum_out + x),
+					    _mm256_slli_epi16(lum, 6));
+		}
+		for (; x < width; x++)
+			lum_out[x] = (uint16_t)(lum_in[x] << 6);
+
+		if (y & 1)
+			continue;
+
+		u_in = (const uint16_t *)(input[1] + (y >> 1) * in_linesize[1]);
+		v_in = (const uint16_t *)(input[2] + (y >> 1) * in_linesize[2]);
+		uv_out = (uint16_t *)(output[1] + (y >> 1) * out_linesize[1]);
+
+		for (x = 0; x + 16 <= width_d2; x += 16) {
+			__m256i u = _mm256_slli_epi16(
+				_mm256_loadu_si256((const __m256i *)(u_in + x)),
+				6);
+			__m256i v = _mm256_slli_epi16(
+				_mm256_loadu_si256((const __m256i *)(v_in + x)),
+				6);
+			__m256i lo = _mm256_unpacklo_epi16(u, v);
+			__m256i hi = _mm256_unpackhi_epi16(u, v);
+
+			_mm256_storeu_si256(
+				(__m256i *)(uv_out + x * 2),
+				_mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256(
+				(__m256i *)(uv_out + x * 2 + 16),
+				_mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+		for (; x < width_d2; x++) {
+			uv_out[x * 2] = (uint16_t)(u_in[x] << 6);
+			uv_out[x * 2 + 1] = (uint16_t)(v_in[x] << 6);
+		}
+	}
+}
+
+TARGET_AVX2 static void convert_p010_to_i010_avx2(
+	const uint8_t *const input[], const uint32_t in_linesize[],
+	uint32_t start_y, uint32_t end_y, uint8_t *output[],
+	const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize[0], out_linesize[0]) / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[1] / 4, out_linesize[1] / 2);
+	uint32_t y, x;
+
+	const __m256i u_mask = _mm256_set1_epi32(0xFFFF);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint16_t *lum_in =
+			(const uint16_t *)(input[0] + y * in_linesize[0]);
+		uint16_t *lum_out =
+			(uint16_t *)(output[0] + y * out_linesize[0]);
+		const uint16_t *uv_in;
+		uint16_t *u_out, *v_out;
+
+		for (x = 0; x + 16 <= width; x += 16) {
+			__m256i lum = _mm256_loadu_si256(
+				(const __m256i *)(lum_in + x));
+			_mm256_storeu_si256((__m256i *)(lum_out + x),
+					    _mm256_srli_epi16(lum, 6));
+		}
+		for (; x < width; x++)
+			lum_out[x] = lum_in[x] >> 6;
+
+		if (y & 1)
+			continue;
+
+		uv_in = (const uint16_t *)(input[1] +
+					    (y >> 1) * in_linesize[1]);
+		u_out = (uint16_t *)(output[1] + (y >> 1) * out_linesize[1]);
+		v_out = (uint16_t *)(output[2] + (y >> 1) * out_linesize[2]);
+
+		for (x = 0; x + 16 <= width_d2; x += 16) {
+			__m256i a = _mm256_loadu_si256(
+				(const __m256i *)(uv_in + x * 2));
+			__m256i b = _mm256_loadu_si256(
+				(const __m256i *)(uv_in + x * 2 + 16));
+			__m256i u = _mm256_packus_epi32(
+				_mm256_and_si256(a, u_mask),
+				_mm256_and_si256(b, u_mask));
+			__m256i v = _mm256_packus_epi32(
+				_mm256_srli_epi32(a, 16),
+				_mm256_srli_epi32(b, 16));
+
+			u = _mm256_permute4x64_epi64(u,
+						     _MM_SHUFFLE(3, 1, 2, 0));
+			v = _mm256_permute4x64_epi64(v,
+						     _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i *)(u_out + x),
+					    _mm256_srli_epi16(u, 6));
+			_mm256_storeu_si256((__m256i *)(v_out + x),
+					    _mm256_srli_epi16(v, 6));
+		}
+		for (; x < width_d2; x++) {
+			u_out[x] = uv_in[x * 2] >> 6;
+			v_out[x] = uv_in[x * 2 + 1] >> 6;
+		}
+	}
+}
+#endif
+
+void compress_bgra_to_nv12(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[],
+			   enum video_colorspace colorspace,
+			   enum video_range_type range)
+{
+	struct bgra_coeffs coeffs;
+
+	get_bgra_coeffs(&coeffs, colorspace, range);
+
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		compress_bgra_to_nv12_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize, &coeffs);
+		return;
+	}
+#endif
+	compress_bgra_to_nv12_c(input, in_linesize, start_y, end_y, output,
+				out_linesize, &coeffs);
+}
+
+void convert_i010_to_p010(const uint8_t *const input[],
+			  const uint32_t in_linesize[], uint32_t start_y,
+			  uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		convert_i010_to_p010_avx2(input, in_linesize, start_y, end_y,
+					  output, out_linesize);
+		return;
+	}
+#endif
+	convert_i010_to_p010_c(input, in_linesize, start_y, end_y, output,
+			       out_linesize);
+}
+
+void convert_p010_to_i010(const uint8_t *const input[],
+			  const uint32_t in_linesize[], uint32_t start_y,
+			  uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (use_avx2()) {
+		convert_p010_to_i010_avx2(input, in_linesize, start_y, end_y,
+					  output, out_linesize);
+		return;
+	}
+#endif
+	convert_p010_to_i010_c(input, in_linesize, start_y, end_y, output,
+			       out_linesize);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* conversion is memory bound, so more threads than this don't help much */
+#define MAX_AUTO_THREADS 4
+
+/* smallest slice worth waking a thread for */
+#define MIN_SLICE_HEIGHT 64
+
+struct conversion_worker {
+	struct format_conversion_pool *pool;
+	pthread_t thread;
+	os_sem_t *start;
+	uint32_t slice;
+};
+
+struct format_conversion_pool {
+	pthread_mutex_t mutex;
+	os_event_t *done;
+	volatile long remaining;
+	volatile bool exit;
+
+	format_conversion_slice_t func;
+	void *param;
+	uint32_t height;
+	uint32_t slice_height;
+
+	size_t num_workers;
+	struct conversion_worker *workers;
+};
+
+static void run_slice(struct format_conversion_pool *pool, uint32_t slice)
+{
+	uint32_t start_y = slice * pool->slice_height;
+	uint32_t end_y = start_y + pool->slice_height;
+
+	if (end_y > pool->height)
+		end_y = pool->height;
+	if (start_y < end_y)
+		pool->func(pool->param, start_y, end_y);
+}
+
+static void *conversion_worker_thread(void *data)
+{
+	struct conversion_worker *worker = data;
+	struct format_conversion_pool *pool = worker->pool;
+
+	os_set_thread_name("format-conversion: worker");
+
+	while (os_sem_wait(worker->start) == 0) {
+		if (os_atomic_load_bool(&pool->exit))
+			break;
+
+		run_slice(pool, worker->slice);
+
+		if (os_atomic_dec_long(&pool->remaining) == 0)
+			os_event_signal(pool->done);
+	}
+
+	return NULL;
+}
+
+format_conversion_pool_t *format_conversion_pool_create(size_t threads)
+{
+	struct format_conversion_pool *pool;
+
+	if (!threads) {
+		int cores = os_get_physical_cores();
+		threads = cores > 0 ? (size_t)cores : 1;
+		if (threads > MAX_AUTO_THREADS)
+			threads = MAX_AUTO_THREADS;
+	}
+
+	pool = bzalloc(sizeof(struct format_conversion_pool));
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+	if (os_event_init(&pool->done, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&pool->mutex);
+		bfree(pool);
+		return NULL;
+	}
+
+	/* the calling thread converts the first slice */
+	pool->workers = bzalloc(sizeof(struct conversion_worker) * threads);
+
+	for (size_t i = 0; i + 1 < threads; i++) {
+		struct conversion_worker *worker = &pool->workers[i];
+
+		worker->pool = pool;
+		worker->slice = (uint32_t)i + 1;
+
+		if (os_sem_init(&worker->start, 0) != 0)
+			break;
+		if (pthread_create(&worker->thread, NULL,
+				   conversion_worker_thread, worker) != 0) {
+			os_sem_destroy(worker->start);
+			break;
+		}
+
+		pool->num_workers++;
+	}
+
+	return pool;
+}
+
+void format_conversion_pool_destroy(format_conversion_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	os_atomic_set_bool(&pool->exit, true);
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct conversion_worker *worker = &pool->workers[i];
+
+		os_sem_post(worker->start);
+		pthread_join(worker->thread, NULL);
+		os_sem_destroy(worker->start);
+	}
+
+	os_event_destroy(pool->done);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->workers);
+	bfree(pool);
+}
+
+void format_conversion_pool_run(format_conversion_pool_t *pool,
+				uint32_t height, format_conversion_slice_t func,
+				void *param)
+{
+	uint32_t slices;
+
+	if (!pool || !pool->num_workers || height < MIN_SLICE_HEIGHT * 2) {
+		func(param, 0, height);
+		return;
+	}
+
+	slices = height / MIN_SLICE_HEIGHT;
+	if (slices > pool->num_workers + 1)
+		slices = (uint32_t)pool->num_workers + 1;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->func = func;
+	pool->param = param;
+	pool->height = height;
+	pool->slice_height = ((height + slices - 1) / slices + 1) & ~1;
+
+	os_atomic_set_long(&pool->remaining, (long)slices - 1);
+	for (uint32_t i = 0; i + 1 < slices; i++)
+		os_sem_post(pool->workers[i].start);
+
+	run_slice(pool, 0);
+	os_event_wait(pool->done);
+
+	pthread_mutex_unlock(&pool->mutex);
+}
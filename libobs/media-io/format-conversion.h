@@ -18,6 +18,7 @@
 #pragma once
 
 #include "../util/c99defs.h"
+#include "video-io.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,6 +57,49 @@ EXPORT void decompress_422(const uint8_t *input, uint32_t in_linesize,
 			   uint32_t start_y, uint32_t end_y, uint8_t *output,
 			   uint32_t out_linesize, bool leading_lum);
 
+/*
+ * Functions for converting between planar and semi-planar 10-bit YUV, and
+ * from 32-bit RGB to NV12
+ */
+
+EXPORT void compress_bgra_to_nv12(const uint8_t *input, uint32_t in_linesize,
+				  uint32_t start_y, uint32_t end_y,
+				  uint8_t *output[],
+				  const uint32_t out_linesize[],
+				  enum video_colorspace colorspace,
+				  enum video_range_type range);
+
+EXPORT void convert_i010_to_p010(const uint8_t *const input[],
+				 const uint32_t in_linesize[], uint32_t start_y,
+				 uint32_t end_y, uint8_t *output[],
+				 const uint32_t out_linesize[]);
+
+EXPORT void convert_p010_to_i010(const uint8_t *const input[],
+				 const uint32_t in_linesize[], uint32_t start_y,
+				 uint32_t end_y, uint8_t *output[],
+				 const uint32_t out_linesize[]);
+
+/*
+ * Runs a conversion over horizontal slices of a frame on a small pool of
+ * worker threads, with the calling thread converting the first slice.
+ * Slices always start on an even row, so 4:2:0 formats can be converted two
+ * rows at a time.  A NULL pool converts the whole frame on the calling thread.
+ */
+
+typedef struct format_conversion_pool format_conversion_pool_t;
+
+typedef void (*format_conversion_slice_t)(void *param, uint32_t start_y,
+					  uint32_t end_y);
+
+/** Creates a pool with the given number of threads, or 0 to pick one */
+EXPORT format_conversion_pool_t *format_conversion_pool_create(size_t threads);
+EXPORT void format_conversion_pool_destroy(format_conversion_pool_t *pool);
+
+EXPORT void format_conversion_pool_run(format_conversion_pool_t *pool,
+				       uint32_t height,
+				       format_conversion_slice_t func,
+				       void *param);
+
 #ifdef __cplusplus
 }
 #endif
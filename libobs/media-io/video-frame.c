@@ -190,22 +190,18 @@ void video_frame_get_plane_heights(uint32_t heights[MAX_AV_PLANES],
 	}
 }
 
-void video_frame_init(struct video_frame *frame, enum video_format format,
-		      uint32_t width, uint32_t height)
+static size_t get_frame_layout(enum video_format format, uint32_t width,
+			       uint32_t height,
+			       uint32_t linesizes[MAX_AV_PLANES],
+			       uint32_t heights[MAX_AV_PLANES],
+			       size_t offsets[MAX_AV_PLANES])
 {
 	size_t size = 0;
-	uint32_t linesizes[MAX_AV_PLANES];
-	uint32_t heights[MAX_AV_PLANES];
-	size_t offsets[MAX_AV_PLANES];
 	int alignment = base_get_alignment();
 
-	if (!frame)
-		return;
-
-	memset(frame, 0, sizeof(struct video_frame));
-	memset(linesizes, 0, sizeof(linesizes));
-	memset(heights, 0, sizeof(heights));
-	memset(offsets, 0, sizeof(offsets));
+	memset(linesizes, 0, sizeof(uint32_t) * MAX_AV_PLANES);
+	memset(heights, 0, sizeof(uint32_t) * MAX_AV_PLANES);
+	memset(offsets, 0, sizeof(size_t) * MAX_AV_PLANES);
 
 	/* determine linesizes for each plane */
 	video_frame_get_linesizes(linesizes, format, width);
@@ -223,8 +219,26 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[i] = size;
 	}
 
-	/* allocate memory */
-	frame->data[0] = bmalloc(size);
+	return size;
+}
+
+size_t video_frame_get_data_size(enum video_format format, uint32_t width,
+				 uint32_t height)
+{
+	uint32_t linesizes[MAX_AV_PLANES];
+	uint32_t heights[MAX_AV_PLANES];
+	size_t offsets[MAX_AV_PLANES];
+
+	return get_frame_layout(format, width, height, linesizes, heights,
+				offsets);
+}
+
+static void set_frame_planes(struct video_frame *frame, uint8_t *data,
+			     const uint32_t linesizes[MAX_AV_PLANES],
+			     const uint32_t heights[MAX_AV_PLANES],
+			     const size_t offsets[MAX_AV_PLANES])
+{
+	frame->data[0] = data;
 	frame->linesize[0] = linesizes[0];
 
 	/* apply plane data pointers according to offsets */
@@ -236,6 +250,42 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	}
 }
 
+void video_frame_init(struct video_frame *frame, enum video_format format,
+		      uint32_t width, uint32_t height)
+{
+	uint32_t linesizes[MAX_AV_PLANES];
+	uint32_t heights[MAX_AV_PLANES];
+	size_t offsets[MAX_AV_PLANES];
+	size_t size;
+
+	if (!frame)
+		return;
+
+	memset(frame, 0, sizeof(struct video_frame));
+
+	size = get_frame_layout(format, width, height, linesizes, heights,
+				offsets);
+
+	/* allocate memory */
+	set_frame_planes(frame, bmalloc(size), linesizes, heights, offsets);
+}
+
+void video_frame_init_data(struct video_frame *frame, enum video_format format,
+			   uint32_t width, uint32_t height, uint8_t *data)
+{
+	uint32_t linesizes[MAX_AV_PLANES];
+	uint32_t heights[MAX_AV_PLANES];
+	size_t offsets[MAX_AV_PLANES];
+
+	if (!frame)
+		return;
+
+	memset(frame, 0, sizeof(struct video_frame));
+
+	get_frame_layout(format, width, height, linesizes, heights, offsets);
+	set_frame_planes(frame, data, linesizes, heights, offsets);
+}
+
 void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
 		      enum video_format format, uint32_t cy)
 {
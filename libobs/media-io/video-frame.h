@@ -33,6 +33,18 @@ EXPORT void video_frame_init(struct video_frame *frame,
 			     enum video_format format, uint32_t width,
 			     uint32_t height);
 
+/** Returns the size of the buffer video_frame_init allocates for a frame */
+EXPORT size_t video_frame_get_data_size(enum video_format format,
+					uint32_t width, uint32_t height);
+
+/**
+ * Sets up the planes of a frame in an existing buffer, which must be at least
+ * video_frame_get_data_size bytes and aligned like bmalloc memory.
+ */
+EXPORT void video_frame_init_data(struct video_frame *frame,
+				  enum video_format format, uint32_t width,
+				  uint32_t height, uint8_t *data);
+
 static inline void video_frame_free(struct video_frame *frame)
 {
 	if (frame) {
@@ -17,10 +17,12 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <limits.h>
 #include "../util/bmem.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
 #include "../util/threading.h"
+#include "../util/task.h"
 #include "../util/darray.h"
 #include "../util/util_uint64.h"
 
@@ -36,13 +38,29 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
-	int count;
+	volatile long skipped;
+	volatile long count;
+
+	/* one reference for the video thread, plus one for every delivery
+	 * queued to an input in parallel delivery mode */
+	volatile long refs;
+	bool released;
+};
+
+/* conversions that don't need scaling and are done by the format conversion
+ * kernels instead of the scaler, sliced across the output's conversion pool */
+enum conversion_fast_path {
+	FAST_PATH_NONE,
+	FAST_PATH_BGRA_TO_NV12,
+	FAST_PATH_I010_TO_P010,
+	FAST_PATH_P010_TO_I010,
 };
 
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
+	enum conversion_fast_path fast_path;
+	format_conversion_pool_t *pool;
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
 	int cur_frame;
 
@@ -58,20 +76,35 @@ struct video_input {
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
+
+	volatile bool removed;
+
+	/* parallel delivery mode only */
+	os_task_queue_t *queue;
+	volatile long queued_frames;
+
+	/* time in microseconds from a frame being ready on the video thread
+	 * until it was handed to this input, for the most recently delivered
+	 * frame.  only long atomics are available on every platform, hence
+	 * microseconds rather than nanoseconds */
+	volatile long lag_us;
 };
 
 static inline void video_input_free(struct video_input *input)
 {
+	/* drains any frames still queued for this input */
+	os_task_queue_destroy(input->queue);
+
 	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
 		video_frame_free(&input->frame[i]);
 	video_scaler_destroy(input->scaler);
+	bfree(input);
 }
 
 struct video_output {
 	struct video_output_info info;
 
 	pthread_t thread;
-	pthread_mutex_t data_mutex;
 	bool stop;
 
 	os_sem_t *update_semaphore;
@@ -79,28 +112,90 @@ struct video_output {
 	volatile long skipped_frames;
 	volatile long total_frames;
 
+	/* inputs is the authoritative list and is only touched with
+	 * input_mutex held.  The video thread never takes input_mutex while
+	 * calling back into inputs: it iterates one of the two immutable
+	 * input_lists snapshots instead, selected by cur_input_list.
+	 * inputs_seq is odd while the video thread is iterating a snapshot,
+	 * which lets writers wait until the previous snapshot is retired
+	 * before reusing it or freeing inputs that were removed from it. */
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
-
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	pthread_mutex_t input_write_mutex;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_input *) input_lists[2];
+	DARRAY(struct video_input *) removed_inputs;
+	volatile long cur_input_list;
+	volatile long inputs_seq;
+	volatile bool inputs_dirty;
+
+	/* single-producer/single-consumer frame ring: the graphics thread
+	 * owns last_added, the video thread delivers from cur_added, and
+	 * available_frames is the number of free slots.  first_added is the
+	 * oldest slot that is still referenced; it only trails cur_added in
+	 * parallel delivery mode, where inputs may still hold older frames
+	 * and release_mutex serializes recycling them in order. */
+	volatile long available_frames;
+	volatile long first_added;
+	volatile long last_added;
+	long cur_added;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
+	volatile bool parallel;
+	volatile bool fast_conversion;
+	pthread_mutex_t release_mutex;
+	const char *delivery_name;
+
 	struct video_output *parent;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
+
+	/* created with the first input that uses a conversion fast path */
+	format_conversion_pool_t *conversion_pool;
 };
 
 /* ------------------------------------------------------------------------- */
 
+struct conversion_slice {
+	const struct video_input *input;
+	const struct video_data *data;
+	struct video_frame *frame;
+};
+
+static void convert_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct conversion_slice *slice = param;
+	const struct video_scale_info *conversion = &slice->input->conversion;
+	const uint8_t *const *data = (const uint8_t *const *)slice->data->data;
+	const uint32_t *linesize = slice->data->linesize;
+	struct video_frame *frame = slice->frame;
+
+	switch (slice->input->fast_path) {
+	case FAST_PATH_BGRA_TO_NV12:
+		compress_bgra_to_nv12(data[0], linesize[0], start_y, end_y,
+				      frame->data, frame->linesize,
+				      conversion->colorspace,
+				      conversion->range);
+		break;
+	case FAST_PATH_I010_TO_P010:
+		convert_i010_to_p010(data, linesize, start_y, end_y,
+				     frame->data, frame->linesize);
+		break;
+	case FAST_PATH_P010_TO_I010:
+		convert_p010_to_i010(data, linesize, start_y, end_y,
+				     frame->data, frame->linesize);
+		break;
+	case FAST_PATH_NONE:
+		break;
+	}
+}
+
 static inline bool scale_video_output(struct video_input *input,
 				      struct video_data *data)
 {
 	bool success = true;
 
-	if (input->scaler) {
+	if (input->scaler || input->fast_path != FAST_PATH_NONE) {
 		struct video_frame *frame;
 
 		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
@@ -108,10 +203,21 @@ static inline bool scale_video_output(struct video_input *input,
 
 		frame = &input->frame[input->cur_frame];
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+		if (input->fast_path != FAST_PATH_NONE) {
+			struct conversion_slice slice = {input, data, frame};
+
+			/* inputs delivered in parallel take turns using the
+			 * pool, they would only compete for memory bandwidth
+			 * otherwise */
+			format_conversion_pool_run(input->pool,
+						   input->conversion.height,
+						   convert_slice, &slice);
+		} else {
+			success = video_scaler_scale(
+				input->scaler, frame->data, frame->linesize,
+				(const uint8_t *const *)data->data,
+				data->linesize);
+		}
 
 		if (success) {
 			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
@@ -126,28 +232,166 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+static void video_output_release_frame(struct video_output *video,
+				       struct cached_frame_info *cfi)
+{
+	long first_added;
+
+	if (os_atomic_dec_long(&cfi->refs) != 0)
+		return;
+
+	if (!os_atomic_load_bool(&video->parallel)) {
+		/* only the video thread holds references, so frames are
+		 * always released in order */
+		first_added = os_atomic_load_long(&video->first_added);
+		if (++first_added == (long)video->info.cache_size)
+			first_added = 0;
+
+		os_atomic_set_long(&video->first_added, first_added);
+		os_atomic_inc_long(&video->available_frames);
+		return;
+	}
+
+	pthread_mutex_lock(&video->release_mutex);
+
+	cfi->released = true;
+	first_added = os_atomic_load_long(&video->first_added);
+
+	while (video->cache[first_added].released) {
+		video->cache[first_added].released = false;
+		if (++first_added == (long)video->info.cache_size)
+			first_added = 0;
+
+		os_atomic_set_long(&video->first_added, first_added);
+		os_atomic_inc_long(&video->available_frames);
+	}
+
+	pthread_mutex_unlock(&video->release_mutex);
+}
+
+struct video_delivery {
+	struct video_output *video;
+	struct video_input *input;
+	struct cached_frame_info *frame_info;
+	struct video_data frame;
+	uint64_t ready_ts;
+};
+
+static inline void set_input_lag(struct video_input *input, uint64_t ready_ts)
+{
+	uint64_t lag_us = (os_gettime_ns() - ready_ts) / 1000;
+	if (lag_us > LONG_MAX)
+		lag_us = LONG_MAX;
+	os_atomic_set_long(&input->lag_us, (long)lag_us);
+}
+
+static void video_input_deliver(void *param)
+{
+	struct video_delivery *delivery = param;
+	struct video_output *video = delivery->video;
+	struct video_input *input = delivery->input;
+
+	if (!os_atomic_load_bool(&input->removed)) {
+		profile_start(video->delivery_name);
+
+		set_input_lag(input, delivery->ready_ts);
+		if (scale_video_output(input, &delivery->frame))
+			input->callback(input->param, &delivery->frame);
+
+		profile_end(video->delivery_name);
+		profile_reenable_thread();
+	}
+
+	os_atomic_dec_long(&input->queued_frames);
+	video_output_release_frame(video, delivery->frame_info);
+	bfree(delivery);
+}
+
+static inline void video_input_queue_frame(struct video_output *video,
+					   struct video_input *input,
+					   struct cached_frame_info *frame_info,
+					   const struct video_data *frame,
+					   uint64_t ready_ts)
+{
+	struct video_delivery *delivery = bmalloc(sizeof(*delivery));
+	delivery->video = video;
+	delivery->input = input;
+	delivery->frame_info = frame_info;
+	delivery->frame = *frame;
+	delivery->ready_ts = ready_ts;
+
+	os_atomic_inc_long(&frame_info->refs);
+	os_atomic_inc_long(&input->queued_frames);
+	os_task_queue_queue_task(input->queue, video_input_deliver, delivery);
+}
+
+static inline bool video_output_on_thread(const struct video_output *video)
+{
+	return pthread_equal(pthread_self(), video->thread) != 0;
+}
+
+/* must be called with input_mutex held */
+static void video_input_list_publish(struct video_output *video)
+{
+	long next = !os_atomic_load_long(&video->cur_input_list);
+
+	da_copy(video->input_lists[next], video->inputs);
+	os_atomic_set_long(&video->cur_input_list, next);
+}
+
+/* waits until the video thread is no longer iterating a snapshot that was
+ * taken before the most recent publish */
+static void video_input_list_sync(struct video_output *video)
+{
+	long seq = os_atomic_load_long(&video->inputs_seq);
+	if ((seq & 1) == 0)
+		return;
+
+	while (os_atomic_load_long(&video->inputs_seq) == seq)
+		os_sleep_ms(1);
+}
+
+/* called from the video thread outside of input iteration to apply
+ * connects/disconnects that were made from within input callbacks */
+static void video_input_list_update(struct video_output *video)
+{
+	pthread_mutex_lock(&video->input_mutex);
+
+	os_atomic_set_bool(&video->inputs_dirty, false);
+	video_input_list_publish(video);
+
+	for (size_t i = 0; i < video->removed_inputs.num; i++)
+		video_input_free(video->removed_inputs.array[i]);
+	da_resize(video->removed_inputs, 0);
+
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
 	bool complete;
-	bool skipped;
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	frame_info = &video->cache[video->first_added];
-
-	pthread_mutex_unlock(&video->data_mutex);
+	frame_info = &video->cache[video->cur_added];
+	uint64_t ready_ts = os_gettime_ns();
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->input_mutex);
+	os_atomic_inc_long(&video->inputs_seq);
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+	long list_idx = os_atomic_load_long(&video->cur_input_list);
+	struct video_input **inputs = video->input_lists[list_idx].array;
+	size_t num_inputs = video->input_lists[list_idx].num;
+
+	for (size_t i = 0; i < num_inputs; i++) {
+		struct video_input *input = inputs[i];
 		struct video_data frame = frame_info->frame;
 
+		if (os_atomic_load_bool(&input->removed))
+			continue;
+
 		// an explicit counter is used instead of remainder calculation
 		// to allow multiple encoders started at the same time to start on
 		// the same frame
@@ -159,38 +403,51 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (skip)
 			continue;
 
+		if (input->queue) {
+			video_input_queue_frame(video, input, frame_info,
+						&frame, ready_ts);
+			continue;
+		}
+
+		set_input_lag(input, ready_ts);
 		if (scale_video_output(input, &frame))
 			input->callback(input->param, &frame);
 	}
 
-	pthread_mutex_unlock(&video->input_mutex);
+	os_atomic_inc_long(&video->inputs_seq);
 
-	/* -------------------------------- */
+	if (os_atomic_load_bool(&video->inputs_dirty))
+		video_input_list_update(video);
 
-	pthread_mutex_lock(&video->data_mutex);
+	/* -------------------------------- */
 
 	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+		if (++video->cur_added == (long)video->info.cache_size)
+			video->cur_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
+		video_output_release_frame(video, frame_info);
+
+	} else if (os_atomic_load_long(&frame_info->skipped) > 0) {
+		os_atomic_dec_long(&frame_info->skipped);
 		os_atomic_inc_long(&video->skipped_frames);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	return complete;
 }
 
+/* video outputs can be used without libobs having been started (e.g. by the
+ * tests), in which case there is no name store to keep the name in */
+static const char *store_profiler_name(const char *format, const char *name)
+{
+	profiler_name_store_t *store = obs_get_profiler_name_store();
+	return store ? profile_store_name(store, format, name) : format;
+}
+
 static void *video_thread(void *param)
 {
 	struct video_output *video = param;
@@ -198,8 +455,7 @@ static void *video_thread(void *param)
 	os_set_thread_name("video-io: video thread");
 
 	const char *video_thread_name =
-		profile_store_name(obs_get_profiler_name_store(),
-				   "video_thread(%s)", video->info.name);
+		store_profiler_name("video_thread(%s)", video->info.name);
 
 	while (os_sem_wait(video->update_semaphore) == 0) {
 		if (video->stop)
@@ -232,6 +488,11 @@ static inline void init_cache(struct video_output *video)
 	if (video->info.cache_size > MAX_CACHE_SIZE)
 		video->info.cache_size = MAX_CACHE_SIZE;
 
+	/* the frame ring needs at least two slots so that the slot repeated
+	 * by a full ring is never the one the video thread is finishing */
+	if (video->info.cache_size < 2)
+		video->info.cache_size = 2;
+
 	for (size_t i = 0; i < video->info.cache_size; i++) {
 		struct video_frame *frame;
 		frame = (struct video_frame *)&video->cache[i];
@@ -240,7 +501,10 @@ static inline void init_cache(struct video_output *video)
 				 video->info.height);
 	}
 
-	video->available_frames = video->info.cache_size;
+	video->available_frames = (long)video->info.cache_size;
+	video->first_added = 0;
+	video->cur_added = 0;
+	video->last_added = (long)video->info.cache_size - 1;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -258,26 +522,34 @@ int video_output_open(video_t **video, struct video_output_info *info)
 	out->frame_time =
 		util_mul_div64(1000000000ULL, info->fps_den, info->fps_num);
 
-	if (pthread_mutex_init_recursive(&out->data_mutex) != 0)
-		goto fail0;
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
+		goto fail0;
+	if (pthread_mutex_init(&out->input_write_mutex, NULL) != 0)
 		goto fail1;
-	if (os_sem_init(&out->update_semaphore, 0) != 0)
+	if (pthread_mutex_init(&out->release_mutex, NULL) != 0)
 		goto fail2;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail3;
 
+	out->delivery_name =
+		store_profiler_name("video_delivery(%s)", info->name);
+
+	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+		goto fail4;
+
 	init_cache(out);
 
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
 
-fail3:
+fail4:
 	os_sem_destroy(out->update_semaphore);
+fail3:
+	pthread_mutex_destroy(&out->release_mutex);
 fail2:
-	pthread_mutex_destroy(&out->input_mutex);
+	pthread_mutex_destroy(&out->input_write_mutex);
 fail1:
-	pthread_mutex_destroy(&out->data_mutex);
+	pthread_mutex_destroy(&out->input_mutex);
 fail0:
 	bfree(out);
 	return VIDEO_OUTPUT_FAIL;
@@ -293,16 +565,24 @@ void video_output_close(video_t *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
+	for (size_t i = 0; i < video->removed_inputs.num; i++)
+		video_input_free(video->removed_inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->input_lists[0]);
+	da_free(video->input_lists[1]);
+	da_free(video->removed_inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
 
+	format_conversion_pool_destroy(video->conversion_pool);
+
 	pthread_mutex_unlock(&video->input_mutex);
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutex_destroy(&video->input_write_mutex);
+	pthread_mutex_destroy(&video->release_mutex);
 
 	bfree(video);
 }
@@ -313,7 +593,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -348,6 +628,48 @@ static bool match_space(enum video_colorspace a, enum video_colorspace b)
 	       (collapse_space(a) == collapse_space(b));
 }
 
+/* the fast path kernels average 2x2 blocks for chroma rather than filtering
+ * it the way swscale does, so they are only used when enabled */
+static enum conversion_fast_path
+get_fast_path(const struct video_output *video,
+	      const struct video_scale_info *conversion)
+{
+	const struct video_output_info *info = &video->info;
+	bool same_space = match_range(conversion->range, info->range) &&
+			  match_space(conversion->colorspace, info->colorspace);
+
+	if (!os_atomic_load_bool(&video->fast_conversion))
+		return FAST_PATH_NONE;
+
+	if (conversion->width != info->width ||
+	    conversion->height != info->height)
+		return FAST_PATH_NONE;
+
+	switch (info->format) {
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		if (conversion->format == VIDEO_FORMAT_NV12 &&
+		    (conversion->colorspace == VIDEO_CS_DEFAULT ||
+		     conversion->colorspace == VIDEO_CS_601 ||
+		     conversion->colorspace == VIDEO_CS_709 ||
+		     conversion->colorspace == VIDEO_CS_SRGB))
+			return FAST_PATH_BGRA_TO_NV12;
+		break;
+	case VIDEO_FORMAT_I010:
+		if (conversion->format == VIDEO_FORMAT_P010 && same_space)
+			return FAST_PATH_I010_TO_P010;
+		break;
+	case VIDEO_FORMAT_P010:
+		if (conversion->format == VIDEO_FORMAT_I010 && same_space)
+			return FAST_PATH_P010_TO_I010;
+		break;
+	default:
+		break;
+	}
+
+	return FAST_PATH_NONE;
+}
+
 static inline bool video_input_init(struct video_input *input,
 				    struct video_output *video)
 {
@@ -363,10 +685,27 @@ static inline bool video_input_init(struct video_input *input,
 						.range = video->info.range,
 						.colorspace =
 							video->info.colorspace};
+		int ret = VIDEO_SCALER_SUCCESS;
+
+		input->fast_path = get_fast_path(video, &input->conversion);
+
+		if (input->fast_path != FAST_PATH_NONE) {
+			if (!video->conversion_pool)
+				video->conversion_pool =
+					format_conversion_pool_create(0);
+			input->pool = video->conversion_pool;
+
+			blog(LOG_DEBUG,
+			     "video_input_init: Converting %s to %s "
+			     "without the scaler",
+			     get_video_format_name(from.format),
+			     get_video_format_name(input->conversion.format));
+		} else {
+			ret = video_scaler_create(&input->scaler,
+						  &input->conversion, &from,
+						  VIDEO_SCALE_FAST_BILINEAR);
+		}
 
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
 		if (ret != VIDEO_SCALER_SUCCESS) {
 			if (ret == VIDEO_SCALER_BAD_CONVERSION)
 				blog(LOG_ERROR, "video_input_init: Bad "
@@ -427,33 +766,42 @@ bool video_output_connect2(
 	if (!video || !callback || frame_rate_divisor == 0)
 		return false;
 
+	/* when called from within an input callback, the snapshot being
+	 * iterated can't be replaced, so let the video thread publish the
+	 * change itself once it's done with the current frame */
+	bool on_thread = video_output_on_thread(video);
+	if (!on_thread)
+		pthread_mutex_lock(&video->input_write_mutex);
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->callback = callback;
+		input->param = param;
 
-		input.frame_rate_divisor = frame_rate_divisor;
+		input->frame_rate_divisor = frame_rate_divisor;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
-			input.conversion.range = video->info.range;
-			input.conversion.colorspace = video->info.colorspace;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
+			input->conversion.range = video->info.range;
+			input->conversion.colorspace = video->info.colorspace;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
+		if (success && os_atomic_load_bool(&video->parallel)) {
+			input->queue = os_task_queue_create();
+			success = input->queue != NULL;
+		}
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -462,11 +810,23 @@ bool video_output_connect2(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+
+			if (on_thread)
+				os_atomic_set_bool(&video->inputs_dirty, true);
+			else
+				video_input_list_publish(video);
+		} else {
+			video_input_free(input);
 		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
+	if (!on_thread) {
+		video_input_list_sync(video);
+		pthread_mutex_unlock(&video->input_write_mutex);
+	}
+
 	return success;
 }
 
@@ -497,11 +857,16 @@ void video_output_disconnect(video_t *video,
 
 	video = get_root(video);
 
+	struct video_input *removed = NULL;
+	bool on_thread = video_output_on_thread(video);
+	if (!on_thread)
+		pthread_mutex_lock(&video->input_write_mutex);
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		removed = video->inputs.array[idx];
+		os_atomic_set_bool(&removed->removed, true);
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -510,9 +875,124 @@ void video_output_disconnect(video_t *video,
 				log_skipped(video);
 			}
 		}
+
+		if (on_thread) {
+			da_push_back(video->removed_inputs, &removed);
+			os_atomic_set_bool(&video->inputs_dirty, true);
+			removed = NULL;
+		} else {
+			video_input_list_publish(video);
+		}
+	}
+
+	/* an input disconnecting itself from its own delivery thread can't
+	 * drain its own queue, so leave that to the video thread */
+	if (removed && removed->queue &&
+	    os_task_queue_inside(removed->queue)) {
+		da_push_back(video->removed_inputs, &removed);
+		os_atomic_set_bool(&video->inputs_dirty, true);
+		removed = NULL;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (!on_thread) {
+		/* the callback may still be running with the old snapshot */
+		video_input_list_sync(video);
+		if (removed)
+			video_input_free(removed);
+		pthread_mutex_unlock(&video->input_write_mutex);
+	}
+}
+
+bool video_output_set_parallel_delivery(video_t *video, bool enable)
+{
+	bool success = false;
+
+	if (!video)
+		return false;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->input_write_mutex);
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (!video->inputs.num && !video->removed_inputs.num) {
+		os_atomic_set_bool(&video->parallel, enable);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	pthread_mutex_unlock(&video->input_write_mutex);
+
+	return success;
+}
+
+bool video_output_parallel_delivery(const video_t *video)
+{
+	return video ? os_atomic_load_bool(&get_const_root(video)->parallel)
+		     : false;
+}
+
+void video_output_set_fast_conversion(video_t *video, bool enable)
+{
+	if (video)
+		os_atomic_set_bool(&get_root(video)->fast_conversion, enable);
+}
+
+bool video_output_fast_conversion(const video_t *video)
+{
+	return video ? os_atomic_load_bool(
+			       &get_const_root(video)->fast_conversion)
+		     : false;
+}
+
+uint32_t video_output_get_input_queue_depth(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param)
+{
+	uint32_t depth = 0;
+
+	if (!video)
+		return 0;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		depth = (uint32_t)os_atomic_load_long(
+			&video->inputs.array[idx]->queued_frames);
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return depth;
+}
+
+uint64_t video_output_get_input_lag(video_t *video,
+				    void (*callback)(void *param,
+						     struct video_data *frame),
+				    void *param)
+{
+	uint64_t lag = 0;
+
+	if (!video)
+		return 0;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		lag = (uint64_t)os_atomic_load_long(
+			      &video->inputs.array[idx]->lag_us) *
+		      1000;
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return lag;
 }
 
 bool video_output_active(const video_t *video)
@@ -527,43 +1007,66 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+static inline void atomic_add_long(volatile long *val, long add)
+{
+	long cur = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &cur, cur + add))
+		;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video)
 		return false;
 
 	video = get_root(video);
 
-	pthread_mutex_lock(&video->data_mutex);
+	for (;;) {
+		long last_added = os_atomic_load_long(&video->last_added);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+		if (os_atomic_load_long(&video->available_frames) != 0) {
+			if (++last_added == (long)video->info.cache_size)
+				last_added = 0;
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+			cfi = &video->cache[last_added];
+			cfi->frame.timestamp = timestamp;
+			os_atomic_set_long(&cfi->refs, 1);
+			os_atomic_set_long(&cfi->skipped, 0);
+			os_atomic_set_long(&cfi->count, count);
+			os_atomic_set_long(&video->last_added, last_added);
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
+			memcpy(frame, &cfi->frame, sizeof(*frame));
+			return true;
+		}
 
-		memcpy(frame, &cfi->frame, sizeof(*frame));
+		/* ring is full, so repeat the newest frame.  if the video
+		 * thread finished with that frame in the meantime, a slot has
+		 * just been freed up, so try again. */
+		cfi = &video->cache[last_added];
+		atomic_add_long(&cfi->skipped, count);
+
+		long cur_count = os_atomic_load_long(&cfi->count);
+		while (cur_count > 0) {
+			if (os_atomic_compare_exchange_long(
+				    &cfi->count, &cur_count, cur_count + count))
+				return false;
+		}
 
-		locked = true;
+		/* in parallel delivery mode the video thread can be done with
+		 * every cached frame while inputs still hold all of them, in
+		 * which case there's nothing left to repeat: drop the frame */
+		if (os_atomic_load_bool(&video->parallel) &&
+		    os_atomic_load_long(&video->available_frames) == 0) {
+			for (int i = 0; i < count; i++) {
+				os_atomic_inc_long(&video->skipped_frames);
+				os_atomic_inc_long(&video->total_frames);
+			}
+			return false;
+		}
 	}
-
-	pthread_mutex_unlock(&video->data_mutex);
-
-	return locked;
 }
 
 void video_output_unlock_frame(video_t *video)
@@ -573,12 +1076,8 @@ void video_output_unlock_frame(video_t *video)
 
 	video = get_root(video);
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	video->available_frames--;
+	os_atomic_dec_long(&video->available_frames);
 	os_sem_post(video->update_semaphore);
-
-	pthread_mutex_unlock(&video->data_mutex);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
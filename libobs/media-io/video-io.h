@@ -337,6 +337,38 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/**
+ * Delivers frames to each connected input on its own thread instead of
+ * calling every input in turn on the video thread, so that one slow input
+ * does not delay the others.  Can only be changed while no inputs are
+ * connected; returns false otherwise.
+ */
+EXPORT bool video_output_set_parallel_delivery(video_t *video, bool enable);
+EXPORT bool video_output_parallel_delivery(const video_t *video);
+
+/**
+ * Converts BGRA/BGRX to NV12 and between I010 and P010 with dedicated
+ * kernels instead of the scaler when the size does not change.  Chroma is
+ * averaged over 2x2 blocks, so the output differs slightly from the
+ * scaler's.  Only affects inputs connected after it is changed.
+ */
+EXPORT void video_output_set_fast_conversion(video_t *video, bool enable);
+EXPORT bool video_output_fast_conversion(const video_t *video);
+
+/** Number of frames queued but not yet delivered to an input */
+EXPORT uint32_t video_output_get_input_queue_depth(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param);
+/**
+ * Time in nanoseconds (with microsecond precision) between the most recent
+ * frame becoming ready and it being handed to an input
+ */
+EXPORT uint64_t
+video_output_get_input_lag(video_t *video,
+			   void (*callback)(void *param,
+					    struct video_data *frame),
+			   void *param);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
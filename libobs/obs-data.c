@@ -27,7 +27,9 @@
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
 
 struct obs_data_item {
 	volatile long ref;
@@ -459,156 +461,837 @@ obs_data_item_set_autoselect_data(struct obs_data_item **p_item,
 
 /* ------------------------------------------------------------------------- */
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json);
+/* JSON reading, straight into obs_data items.  Accepts and rejects the same
+ * documents jansson did with JSON_REJECT_DUPLICATES. */
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+#define JSON_MAX_DEPTH 2048
+
+/* a key with a null value, which is not stored but still counts when
+ * checking for duplicate keys */
+struct json_null_key {
+	size_t offset;
+	size_t len;
+	unsigned int hash;
+};
+
+struct json_parser {
+	const char *start;
+	const char *pos;
+	const char *error;
+	int depth;
+
+	struct dstr key;
+	struct dstr str;
+
+	/* null keys of the objects being parsed, from the innermost one's
+	 * first_null on */
+	DARRAY(struct json_null_key) nulls;
+	struct dstr null_names;
+	size_t first_null;
+};
+
+static struct obs_data_item *get_item_key(struct obs_data *data,
+					 const obs_data_key_t *key);
+
+static inline bool json_error(struct json_parser *p, const char *error)
 {
-	const char *item_key;
-	json_t *jitem;
+	if (!p->error)
+		p->error = error;
+	return false;
+}
+
+static inline void json_skip_ws(struct json_parser *p)
+{
+	while (*p->pos == ' ' || *p->pos == '\t' || *p->pos == '\n' ||
+	       *p->pos == '\r')
+		p->pos++;
+}
+
+/* returns the length of the UTF-8 sequence at str, or 0 if invalid */
+static size_t json_utf8_len(const uint8_t *str, size_t max, int32_t *p_cp)
+{
+	uint8_t u = str[0];
+	int32_t cp;
+	size_t len;
+
+	if (u < 0x80) {
+		if (p_cp)
+			*p_cp = u;
+		return 1;
+	} else if (u >= 0xC2 && u <= 0xDF) {
+		len = 2;
+		cp = u & 0x1F;
+	} else if (u >= 0xE0 && u <= 0xEF) {
+		len = 3;
+		cp = u & 0xF;
+	} else if (u >= 0xF0 && u <= 0xF4) {
+		len = 4;
+		cp = u & 0x7;
+	} else {
+		return 0;
+	}
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+	if (len > max)
+		return 0;
+
+	for (size_t i = 1; i < len; i++) {
+		if (str[i] < 0x80 || str[i] > 0xBF)
+			return 0;
+		cp = (cp << 6) | (str[i] & 0x3F);
 	}
+
+	if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return 0;
+	if ((len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000))
+		return 0;
+
+	if (p_cp)
+		*p_cp = cp;
+	return len;
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-					    json_t *jobj)
+static bool json_utf8_valid(const char *str, size_t len)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	const uint8_t *pos = (const uint8_t *)str;
+	const uint8_t *end = pos + len;
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	while (pos < end) {
+		if (*pos < 0x80) {
+			pos++;
+			continue;
+		}
+
+		size_t n = json_utf8_len(pos, (size_t)(end - pos), NULL);
+		if (!n)
+			return false;
+		pos += n;
+	}
+
+	return true;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-				    json_t *jarray)
+static inline int json_hex_digit(char c)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+static bool json_parse_hex4(struct json_parser *p, int32_t *val)
+{
+	*val = 0;
 
-		if (!json_is_object(jitem))
-			continue;
+	for (int i = 0; i < 4; i++) {
+		int digit = json_hex_digit(p->pos[i]);
+		if (digit < 0)
+			return json_error(p, "invalid escape");
+		*val = (*val << 4) | digit;
+	}
+
+	p->pos += 4;
+	return true;
+}
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+static void json_cat_codepoint(struct dstr *str, int32_t cp)
+{
+	char buf[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		buf[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		buf[0] = (char)(0xC0 | (cp >> 6));
+		buf[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		buf[0] = (char)(0xE0 | (cp >> 12));
+		buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		buf[0] = (char)(0xF0 | (cp >> 18));
+		buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	dstr_ncat(str, buf, len);
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json)
+static bool json_parse_escape(struct json_parser *p, struct dstr *out)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	int32_t cp;
+	char c = *(p->pos++);
+
+	switch (c) {
+	case '"':
+	case '\\':
+	case '/':
+		dstr_cat_ch(out, c);
+		return true;
+	case 'b':
+		dstr_cat_ch(out, '\b');
+		return true;
+	case 'f':
+		dstr_cat_ch(out, '\f');
+		return true;
+	case 'n':
+		dstr_cat_ch(out, '\n');
+		return true;
+	case 'r':
+		dstr_cat_ch(out, '\r');
+		return true;
+	case 't':
+		dstr_cat_ch(out, '\t');
+		return true;
+	case 'u':
+		break;
+	default:
+		return json_error(p, "invalid escape");
+	}
+
+	if (!json_parse_hex4(p, &cp))
+		return false;
+
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		int32_t low;
+
+		if (p->pos[0] != '\\' || p->pos[1] != 'u')
+			return json_error(p, "invalid Unicode escape");
+
+		p->pos += 2;
+		if (!json_parse_hex4(p, &low))
+			return false;
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_error(p, "invalid Unicode escape");
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_error(p, "invalid Unicode escape");
+
+	} else if (cp == 0) {
+		return json_error(p, "\\u0000 is not allowed");
+	}
+
+	json_cat_codepoint(out, cp);
+	return true;
 }
 
-/* ------------------------------------------------------------------------- */
+static bool json_parse_string(struct json_parser *p, struct dstr *out)
+{
+	const char *run;
+
+	/* reserved up front, so empty strings are "" rather than NULL */
+	out->len = 0;
+	out->array[0] = 0;
+	p->pos++;
+
+	for (;;) {
+		run = p->pos;
+		while ((uint8_t)*p->pos >= 0x20 && (uint8_t)*p->pos < 0x80 &&
+		       *p->pos != '"' && *p->pos != '\\')
+			p->pos++;
+
+		if (p->pos != run)
+			dstr_ncat(out, run, (size_t)(p->pos - run));
+
+		uint8_t c = (uint8_t)*p->pos;
+
+		if (c == '"') {
+			p->pos++;
+			return true;
+
+		} else if (c == '\\') {
+			p->pos++;
+			if (!json_parse_escape(p, out))
+				return false;
+
+		} else if (c >= 0x80) {
+			size_t len = json_utf8_len((const uint8_t *)p->pos, 4,
+						   NULL);
+			if (!len)
+				return json_error(p, "invalid UTF-8");
+
+			dstr_ncat(out, p->pos, len);
+			p->pos += len;
+
+		} else if (c == 0) {
+			return json_error(p, "premature end of input");
+
+		} else {
+			return json_error(p, "control character in string");
+		}
+	}
+}
 
-static inline void set_json_string(json_t *json, const char *name,
-				   obs_data_item_t *item)
+static double json_strtod(const char *str, size_t len)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	const char *point = localeconv()->decimal_point;
+	struct dstr copy = {0};
+	double val;
+	char *dot;
+
+	if (*point == '.')
+		return strtod(str, NULL);
+
+	dstr_ncopy(&copy, str, len);
+	dot = strchr(copy.array, '.');
+	if (dot)
+		*dot = *point;
+
+	val = strtod(copy.array, NULL);
+	dstr_free(&copy);
+	return val;
 }
 
-static inline void set_json_number(json_t *json, const char *name,
-				   obs_data_item_t *item)
+static bool json_parse_number(struct json_parser *p,
+			      struct obs_data_number *num)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	const char *start = p->pos;
+	bool real = false;
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
+	if (*p->pos == '-')
+		p->pos++;
+
+	if (*p->pos == '0') {
+		p->pos++;
+		if (*p->pos >= '0' && *p->pos <= '9')
+			return json_error(p, "invalid token");
+	} else if (*p->pos >= '1' && *p->pos <= '9') {
+		while (*p->pos >= '0' && *p->pos <= '9')
+			p->pos++;
 	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+		return json_error(p, "invalid token");
+	}
+
+	if (*p->pos == '.') {
+		real = true;
+		p->pos++;
+		if (*p->pos < '0' || *p->pos > '9')
+			return json_error(p, "invalid token");
+		while (*p->pos >= '0' && *p->pos <= '9')
+			p->pos++;
+	}
+
+	if (*p->pos == 'e' || *p->pos == 'E') {
+		real = true;
+		p->pos++;
+		if (*p->pos == '+' || *p->pos == '-')
+			p->pos++;
+		if (*p->pos < '0' || *p->pos > '9')
+			return json_error(p, "invalid token");
+		while (*p->pos >= '0' && *p->pos <= '9')
+			p->pos++;
 	}
+
+	errno = 0;
+
+	if (real) {
+		num->type = OBS_DATA_NUM_DOUBLE;
+		num->double_val = json_strtod(start, (size_t)(p->pos - start));
+		if (errno == ERANGE && (num->double_val == HUGE_VAL ||
+					num->double_val == -HUGE_VAL))
+			return json_error(p, "real number overflow");
+	} else {
+		num->type = OBS_DATA_NUM_INT;
+		num->int_val = strtoll(start, NULL, 10);
+		if (errno == ERANGE)
+			return json_error(p, "too big integer");
+	}
+
+	return true;
+}
+
+static inline bool json_parse_literal(struct json_parser *p,
+				      const char *literal, size_t len)
+{
+	if (strncmp(p->pos, literal, len) != 0)
+		return json_error(p, "invalid token");
+
+	p->pos += len;
+	return true;
 }
 
-static inline void set_json_bool(json_t *json, const char *name,
-				 obs_data_item_t *item)
+static bool json_key_seen(struct json_parser *p, obs_data_t *data,
+			  const obs_data_key_t *key)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	if (get_item_key(data, key))
+		return true;
+
+	for (size_t i = p->first_null; i < p->nulls.num; i++) {
+		struct json_null_key *null = p->nulls.array + i;
+
+		if (null->hash == key->hash && null->len == key->len &&
+		    (!key->len ||
+		     memcmp(p->null_names.array + null->offset, key->name,
+			    key->len) == 0))
+			return true;
+	}
+
+	return false;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults);
+static bool json_add_null(struct json_parser *p, obs_data_t *data)
+{
+	obs_data_key_t key = obs_data_key_create(p->key.array);
+	struct json_null_key *null;
 
-static inline void set_json_obj(json_t *json, const char *name,
-				obs_data_item_t *item, bool with_defaults)
+	if (json_key_seen(p, data, &key))
+		return json_error(p, "duplicate object key");
+
+	null = da_push_back_new(p->nulls);
+	null->offset = p->null_names.len;
+	null->len = key.len;
+	null->hash = key.hash;
+	dstr_ncat(&p->null_names, key.name, key.len);
+	return true;
+}
+
+/* adds the value under the key last parsed into p->key */
+static obs_data_item_t *json_add_item(struct json_parser *p, obs_data_t *data,
+				      const void *ptr, size_t size,
+				      enum obs_data_type type)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj, with_defaults));
-	obs_data_release(obj);
+	obs_data_key_t key = obs_data_key_create(p->key.array);
+	struct obs_data_item *item;
+
+	if (json_key_seen(p, data, &key)) {
+		json_error(p, "duplicate object key");
+		return NULL;
+	}
+
+	item = obs_data_item_create(key.name, ptr, size, type, false, false);
+	item->parent = data;
+	HASH_ADD_KEYPTR_BYHASHVALUE(hh, data->items, item->name,
+				    (unsigned)key.len, key.hash, item);
+	return item;
+}
+
+static bool json_parse_object(struct json_parser *p, obs_data_t *data);
+static bool json_parse_array(struct json_parser *p, obs_data_array_t *array);
+
+/* parses a value into data under the current key, or discards it if data
+ * is NULL.  discarded objects are still parsed into an object of their own
+ * so that their keys are checked for duplicates. */
+static bool json_parse_value(struct json_parser *p, obs_data_t *data)
+{
+	struct obs_data_number num;
+	bool val;
+
+	switch (*p->pos) {
+	case '{': {
+		obs_data_t *obj = obs_data_create();
+		bool success = true;
+
+		if (data)
+			success = !!json_add_item(p, data, &obj,
+						  sizeof(obs_data_t *),
+						  OBS_DATA_OBJECT);
+
+		success = success && json_parse_object(p, obj);
+		obs_data_release(obj);
+		return success;
+	}
+	case '[': {
+		obs_data_array_t *array = data ? obs_data_array_create() : NULL;
+		bool success = true;
+
+		if (array)
+			success = !!json_add_item(p, data, &array,
+						  sizeof(obs_data_array_t *),
+						  OBS_DATA_ARRAY);
+
+		success = success && json_parse_array(p, array);
+		obs_data_array_release(array);
+		return success;
+	}
+	case '"':
+		if (!json_parse_string(p, &p->str))
+			return false;
+		return !data || json_add_item(p, data, p->str.array,
+					      p->str.len + 1, OBS_DATA_STRING);
+	case 't':
+		val = true;
+		if (!json_parse_literal(p, "true", 4))
+			return false;
+		return !data || json_add_item(p, data, &val, sizeof(bool),
+					      OBS_DATA_BOOLEAN);
+	case 'f':
+		val = false;
+		if (!json_parse_literal(p, "false", 5))
+			return false;
+		return !data || json_add_item(p, data, &val, sizeof(bool),
+					      OBS_DATA_BOOLEAN);
+	case 'n':
+		/* nulls are left out, but their keys are remembered */
+		if (!json_parse_literal(p, "null", 4))
+			return false;
+		return !data || json_add_null(p, data);
+	default:
+		if (!json_parse_number(p, &num))
+			return false;
+		return !data || json_add_item(p, data, &num, sizeof(num),
+					      OBS_DATA_NUMBER);
+	}
+}
+
+static bool json_parse_object(struct json_parser *p, obs_data_t *data)
+{
+	size_t prev_first_null = p->first_null;
+
+	if (++p->depth > JSON_MAX_DEPTH)
+		return json_error(p, "maximum parsing depth reached");
+
+	p->pos++;
+	json_skip_ws(p);
+
+	if (*p->pos == '}') {
+		p->pos++;
+		p->depth--;
+		return true;
+	}
+
+	p->first_null = p->nulls.num;
+
+	for (;;) {
+		if (*p->pos != '"')
+			return json_error(p, "string or '}' expected");
+		if (!json_parse_string(p, &p->key))
+			return false;
+
+		json_skip_ws(p);
+		if (*p->pos != ':')
+			return json_error(p, "':' expected");
+
+		p->pos++;
+		json_skip_ws(p);
+		if (!json_parse_value(p, data))
+			return false;
+
+		json_skip_ws(p);
+		if (*p->pos == '}')
+			break;
+		if (*p->pos != ',')
+			return json_error(p, "'}' expected");
+
+		p->pos++;
+		json_skip_ws(p);
+	}
+
+	if (p->nulls.num > p->first_null) {
+		size_t names_len = p->nulls.array[p->first_null].offset;
+		dstr_resize(&p->null_names, names_len);
+		da_resize(p->nulls, p->first_null);
+	}
+	p->first_null = prev_first_null;
+
+	p->pos++;
+	p->depth--;
+	return true;
+}
+
+/* only objects are kept from arrays */
+static bool json_parse_array(struct json_parser *p, obs_data_array_t *array)
+{
+	if (++p->depth > JSON_MAX_DEPTH)
+		return json_error(p, "maximum parsing depth reached");
+
+	p->pos++;
+	json_skip_ws(p);
+
+	if (*p->pos == ']') {
+		p->pos++;
+		p->depth--;
+		return true;
+	}
+
+	for (;;) {
+		if (*p->pos == '{' && array) {
+			obs_data_t *obj = obs_data_create();
+			bool success = json_parse_object(p, obj);
+
+			if (success)
+				obs_data_array_push_back(array, obj);
+			obs_data_release(obj);
+
+			if (!success)
+				return false;
+
+		} else if (!json_parse_value(p, NULL)) {
+			return false;
+		}
+
+		json_skip_ws(p);
+		if (*p->pos == ']')
+			break;
+		if (*p->pos != ',')
+			return json_error(p, "']' expected");
+
+		p->pos++;
+		json_skip_ws(p);
+	}
+
+	p->pos++;
+	p->depth--;
+	return true;
+}
+
+static bool json_parse(struct json_parser *p, obs_data_t *data)
+{
+	bool success;
+
+	json_skip_ws(p);
+
+	if (*p->pos == '{')
+		success = json_parse_object(p, data);
+	else if (*p->pos == '[')
+		success = json_parse_array(p, NULL);
+	else
+		return json_error(p, "'[' or '{' expected");
+
+	if (!success)
+		return false;
+
+	json_skip_ws(p);
+	if (*p->pos)
+		return json_error(p, "end of file expected");
+
+	return true;
+}
+
+static int json_error_line(struct json_parser *p)
+{
+	int line = 1;
+
+	for (const char *pos = p->start; pos < p->pos; pos++) {
+		if (*pos == '\n')
+			line++;
+	}
+
+	return line;
+}
+
+/* ------------------------------------------------------------------------- */
+/* JSON writing, straight from obs_data items.  The output is byte for byte
+ * what jansson produced with JSON_PRESERVE_ORDER and either JSON_COMPACT or
+ * JSON_INDENT(4), including leaving out values it could not represent. */
+
+struct json_writer {
+	struct dstr out;
+	bool pretty;
+	bool with_defaults;
+};
+
+static inline void json_write_indent(struct json_writer *w, int depth)
+{
+	static const char spaces[] = "                                ";
+	size_t count = (size_t)depth * 4;
+
+	if (!w->pretty)
+		return;
+
+	dstr_cat_ch(&w->out, '\n');
+
+	while (count) {
+		size_t len = count < sizeof(spaces) - 1 ? count
+							 : sizeof(spaces) - 1;
+		dstr_ncat(&w->out, spaces, len);
+		count -= len;
+	}
+}
+
+static void json_write_string(struct json_writer *w, const char *str)
+{
+	const char *run = str;
+	char seq[8];
+
+	dstr_cat_ch(&w->out, '"');
+
+	for (;; str++) {
+		uint8_t c = (uint8_t)*str;
+		const char *esc;
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		if (str != run)
+			dstr_ncat(&w->out, run, (size_t)(str - run));
+		if (!c)
+			break;
+
+		switch (c) {
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '\b':
+			esc = "\\b";
+			break;
+		case '\f':
+			esc = "\\f";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		default:
+			snprintf(seq, sizeof(seq), "\\u%04X", (unsigned)c);
+			esc = seq;
+		}
+
+		dstr_cat(&w->out, esc);
+		run = str + 1;
+	}
+
+	dstr_cat_ch(&w->out, '"');
 }
 
-static inline void set_json_array(json_t *json, const char *name,
-				  obs_data_item_t *item, bool with_defaults)
+static void json_write_int(struct json_writer *w, long long val)
+{
+	char buf[24];
+	char *pos = buf + sizeof(buf);
+	unsigned long long uval = val < 0 ? 0ULL - (unsigned long long)val
+					  : (unsigned long long)val;
+
+	do {
+		*(--pos) = (char)('0' + uval % 10);
+		uval /= 10;
+	} while (uval);
+
+	if (val < 0)
+		*(--pos) = '-';
+
+	dstr_ncat(&w->out, pos, (size_t)(buf + sizeof(buf) - pos));
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data,
+			   int depth);
+
+static void json_write_array(struct json_writer *w, obs_data_array_t *array,
+			     int depth)
 {
-	json_t *jarray = json_array();
-	obs_data_array_t *array = obs_data_item_get_array(item);
 	size_t count = obs_data_array_count(array);
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t *jitem = obs_data_to_json(sub_item, with_defaults);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+	dstr_cat_ch(&w->out, '[');
+	if (!count) {
+		dstr_cat_ch(&w->out, ']');
+		return;
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *obj = obs_data_array_item(array, i);
+
+		if (i)
+			dstr_cat_ch(&w->out, ',');
+		json_write_indent(w, depth + 1);
+		json_write_obj(w, obj, depth + 1);
+		obs_data_release(obj);
+	}
+
+	json_write_indent(w, depth);
+	dstr_cat_ch(&w->out, ']');
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults)
+static void json_write_obj(struct json_writer *w, obs_data_t *data, int depth)
 {
-	json_t *json = json_object();
+	struct obs_data_item *item, *temp;
+	bool empty = true;
 
-	obs_data_item_t *item = NULL;
-	obs_data_item_t *temp = NULL;
+	dstr_cat_ch(&w->out, '{');
+
+	if (!data) {
+		dstr_cat_ch(&w->out, '}');
+		return;
+	}
 
 	HASH_ITER (hh, data->items, item, temp) {
-		enum obs_data_type type = obs_data_item_gettype(item);
+		enum obs_data_type type = item->type;
 		const char *name = get_item_name(item);
+		const char *str = NULL;
+		double val = 0.0;
+		bool is_int = false;
 
-		if (!with_defaults && !obs_data_item_has_user_value(item))
+		if (!w->with_defaults && !obs_data_item_has_user_value(item))
+			continue;
+		if (!json_utf8_valid(name, strlen(name)))
 			continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item, with_defaults);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item, with_defaults);
+		/* jansson refused values it could not represent, leaving
+		 * out the key */
+		if (type == OBS_DATA_STRING) {
+			str = obs_data_item_get_string(item);
+			if (!json_utf8_valid(str, strlen(str)))
+				continue;
+
+		} else if (type == OBS_DATA_NUMBER) {
+			is_int = obs_data_item_numtype(item) ==
+				 OBS_DATA_NUM_INT;
+			if (!is_int) {
+				val = obs_data_item_get_double(item);
+				if (isnan(val) || isinf(val))
+					continue;
+			}
+
+		} else if (type != OBS_DATA_BOOLEAN &&
+			   type != OBS_DATA_OBJECT && type != OBS_DATA_ARRAY) {
+			continue;
+		}
+
+		if (!empty)
+			dstr_cat_ch(&w->out, ',');
+		json_write_indent(w, depth + 1);
+		empty = false;
+
+		json_write_string(w, name);
+		dstr_cat(&w->out, w->pretty ? ": " : ":");
+
+		if (type == OBS_DATA_STRING) {
+			json_write_string(w, str);
+
+		} else if (type == OBS_DATA_NUMBER) {
+			if (is_int) {
+				json_write_int(w, obs_data_item_get_int(item));
+			} else {
+				char buf[64];
+				int len = os_dtostr(val, buf, sizeof(buf));
+				if (len > 0)
+					dstr_ncat(&w->out, buf, (size_t)len);
+			}
+
+		} else if (type == OBS_DATA_BOOLEAN) {
+			dstr_cat(&w->out, obs_data_item_get_bool(item)
+						  ? "true"
+						  : "false");
+
+		} else if (type == OBS_DATA_OBJECT) {
+			obs_data_t *obj = obs_data_item_get_obj(item);
+			json_write_obj(w, obj, depth + 1);
+			obs_data_release(obj);
+
+		} else {
+			obs_data_array_t *array = obs_data_item_get_array(item);
+			json_write_array(w, array, depth + 1);
+			obs_data_array_release(array);
+		}
 	}
 
-	return json;
+	if (!empty)
+		json_write_indent(w, depth);
+	dstr_cat_ch(&w->out, '}');
 }
 
 /* ------------------------------------------------------------------------- */
@@ -624,22 +1307,25 @@ obs_data_t *obs_data_create()
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
 	obs_data_t *data = obs_data_create();
+	struct json_parser p = {0};
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	p.start = p.pos = json_string ? json_string : "";
+	dstr_reserve(&p.key, 64);
+	dstr_reserve(&p.str, 256);
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
+	if (!json_parse(&p, data)) {
 		blog(LOG_ERROR,
 		     "obs-data.c: [obs_data_create_from_json] "
 		     "Failed reading json string (%d): %s",
-		     error.line, error.text);
+		     json_error_line(&p), p.error);
 		obs_data_release(data);
 		data = NULL;
 	}
 
+	dstr_free(&p.key);
+	dstr_free(&p.str);
+	dstr_free(&p.null_names);
+	da_free(p.nulls);
 	return data;
 }
 
@@ -702,8 +1388,7 @@ static inline void obs_data_destroy(struct obs_data *data)
 		obs_data_item_release(&item);
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -722,20 +1407,15 @@ static const char *obs_data_get_json_internal(obs_data_t *data, bool pretty,
 	if (!data)
 		return NULL;
 
-	size_t flags = JSON_PRESERVE_ORDER;
-
-	if (pretty)
-		flags |= JSON_INDENT(4);
-	else
-		flags |= JSON_COMPACT;
+	struct json_writer w = {0};
+	w.pretty = pretty;
+	w.with_defaults = with_defaults;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
+	bfree(data->json);
 	data->json = NULL;
 
-	json_t *root = obs_data_to_json(data, with_defaults);
-	data->json = json_dumps(root, flags);
-	json_decref(root);
+	json_write_obj(&w, data, 0);
+	data->json = w.out.array;
 
 	return data->json;
 }
@@ -894,16 +1574,32 @@ obs_data_t *obs_data_get_defaults(obs_data_t *data)
 	return defaults;
 }
 
-static struct obs_data_item *get_item(struct obs_data *data, const char *name)
+static struct obs_data_item *get_item_key(struct obs_data *data,
+					 const obs_data_key_t *key)
 {
 	if (!data)
 		return NULL;
 
 	struct obs_data_item *item;
-	HASH_FIND_STR(data->items, name, item);
+	HASH_FIND_BYHASHVALUE(hh, data->items, key->name, (unsigned)key->len,
+			      key->hash, item);
 	return item;
 }
 
+/* names are hashed on every call rather than interned: a shared table of
+ * names would need a lock or an atomic hash map in front of every lookup,
+ * which costs more than hashing a short name, and would grow with every key
+ * ever loaded from a file.  callers that look up the same keys often can
+ * create an obs_data_key_t once instead. */
+static struct obs_data_item *get_item(struct obs_data *data, const char *name)
+{
+	if (!data)
+		return NULL;
+
+	obs_data_key_t key = obs_data_key_create(name);
+	return get_item_key(data, &key);
+}
+
 static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 			  const char *name, const void *ptr, size_t size,
 			  enum obs_data_type type, bool default_data,
@@ -1914,6 +2610,104 @@ obs_data_array_t *obs_data_item_get_autoselect_array(obs_data_item_t *item)
 	return data_item_get_array(item, get_item_autoselect_array);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Pre-hashed keys */
+
+obs_data_key_t obs_data_key_create(const char *name)
+{
+	obs_data_key_t key = {name, 0, 0};
+	unsigned hash;
+
+	if (name) {
+		key.len = strlen(name);
+		HASH_VALUE(name, (unsigned)key.len, hash);
+		key.hash = hash;
+	}
+
+	return key;
+}
+
+obs_data_item_t *obs_data_item_bykey(obs_data_t *data,
+				     const obs_data_key_t *key)
+{
+	struct obs_data_item *item = get_item_key(data, key);
+	if (item)
+		os_atomic_inc_long(&item->ref);
+	return item;
+}
+
+const char *obs_data_get_string_key(obs_data_t *data,
+				    const obs_data_key_t *key)
+{
+	return obs_data_item_get_string(get_item_key(data, key));
+}
+
+long long obs_data_get_int_key(obs_data_t *data, const obs_data_key_t *key)
+{
+	return obs_data_item_get_int(get_item_key(data, key));
+}
+
+double obs_data_get_double_key(obs_data_t *data, const obs_data_key_t *key)
+{
+	return obs_data_item_get_double(get_item_key(data, key));
+}
+
+bool obs_data_get_bool_key(obs_data_t *data, const obs_data_key_t *key)
+{
+	return obs_data_item_get_bool(get_item_key(data, key));
+}
+
+obs_data_t *obs_data_get_obj_key(obs_data_t *data, const obs_data_key_t *key)
+{
+	return obs_data_item_get_obj(get_item_key(data, key));
+}
+
+obs_data_array_t *obs_data_get_array_key(obs_data_t *data,
+					 const obs_data_key_t *key)
+{
+	return obs_data_item_get_array(get_item_key(data, key));
+}
+
+void obs_data_fields_init(struct obs_data_field *fields, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		fields[i].key = obs_data_key_create(fields[i].key.name);
+}
+
+void obs_data_get_fields(obs_data_t *data, const struct obs_data_field *fields,
+			 size_t count, void *out)
+{
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_data_field *field = fields + i;
+		uint8_t *ptr = (uint8_t *)out + field->offset;
+		struct obs_data_item *item;
+
+		/* not initialized with obs_data_fields_init */
+		if (!field->key.len) {
+			obs_data_key_t key =
+				obs_data_key_create(field->key.name);
+			item = get_item_key(data, &key);
+		} else {
+			item = get_item_key(data, &field->key);
+		}
+
+		switch (field->type) {
+		case OBS_DATA_FIELD_STRING:
+			*(const char **)ptr = obs_data_item_get_string(item);
+			break;
+		case OBS_DATA_FIELD_INT:
+			*(long long *)ptr = obs_data_item_get_int(item);
+			break;
+		case OBS_DATA_FIELD_DOUBLE:
+			*(double *)ptr = obs_data_item_get_double(item);
+			break;
+		case OBS_DATA_FIELD_BOOL:
+			*(bool *)ptr = obs_data_item_get_bool(item);
+			break;
+		}
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 /* Helper functions for certain structures */
 
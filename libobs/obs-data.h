@@ -279,6 +279,77 @@ EXPORT obs_data_t *obs_data_item_get_autoselect_obj(obs_data_item_t *item);
 EXPORT obs_data_array_t *
 obs_data_item_get_autoselect_array(obs_data_item_t *item);
 
+/* ------------------------------------------------------------------------- */
+/* Pre-hashed keys
+ *
+ * For settings read often, e.g. on every update, a key can be created once
+ * and used instead of the name to skip measuring and hashing it on every
+ * lookup.  The name is not copied and must outlive the key.  Functions that
+ * take a name still measure and hash it on every call.
+ */
+
+struct obs_data_key {
+	const char *name;
+	size_t len;
+	unsigned int hash;
+};
+typedef struct obs_data_key obs_data_key_t;
+
+EXPORT obs_data_key_t obs_data_key_create(const char *name);
+
+EXPORT obs_data_item_t *obs_data_item_bykey(obs_data_t *data,
+					    const obs_data_key_t *key);
+
+EXPORT const char *obs_data_get_string_key(obs_data_t *data,
+					   const obs_data_key_t *key);
+EXPORT long long obs_data_get_int_key(obs_data_t *data,
+				      const obs_data_key_t *key);
+EXPORT double obs_data_get_double_key(obs_data_t *data,
+				      const obs_data_key_t *key);
+EXPORT bool obs_data_get_bool_key(obs_data_t *data, const obs_data_key_t *key);
+EXPORT obs_data_t *obs_data_get_obj_key(obs_data_t *data,
+					const obs_data_key_t *key);
+EXPORT obs_data_array_t *obs_data_get_array_key(obs_data_t *data,
+						const obs_data_key_t *key);
+
+/*
+ * Batched get
+ *
+ * Reads several values into a struct in one call, e.g.:
+ *
+ *   static struct obs_data_field fields[] = {
+ *           OBS_DATA_FIELD("width", OBS_DATA_FIELD_INT, struct cfg, width),
+ *           OBS_DATA_FIELD("path", OBS_DATA_FIELD_STRING, struct cfg, path),
+ *   };
+ *
+ *   obs_data_fields_init(fields, 2);  (once)
+ *   obs_data_get_fields(settings, fields, 2, &cfg);
+ *
+ * Strings are written as const char *, ints as long long, doubles as double
+ * and bools as bool.  Strings point into the data object.
+ */
+
+enum obs_data_field_type {
+	OBS_DATA_FIELD_STRING,
+	OBS_DATA_FIELD_INT,
+	OBS_DATA_FIELD_DOUBLE,
+	OBS_DATA_FIELD_BOOL,
+};
+
+struct obs_data_field {
+	obs_data_key_t key;
+	enum obs_data_field_type type;
+	size_t offset;
+};
+
+#define OBS_DATA_FIELD(name, type, st, member) \
+	{{name, 0, 0}, type, offsetof(st, member)}
+
+EXPORT void obs_data_fields_init(struct obs_data_field *fields, size_t count);
+EXPORT void obs_data_get_fields(obs_data_t *data,
+				const struct obs_data_field *fields,
+				size_t count, void *out);
+
 /* ------------------------------------------------------------------------- */
 /* Helper functions for certain structures */
 EXPORT void obs_data_set_vec2(obs_data_t *data, const char *name,
@@ -0,0 +1,339 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include "media-io/video-frame.h"
+#include "obs-internal.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define MIN_CLASS_STEP 4096
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+#define DEFAULT_MAX_IDLE_BYTES (256ULL * 1024 * 1024)
+#define IDLE_TIMEOUT_NS 10000000000ULL
+#define TRIM_INTERVAL_NS 1000000000ULL
+
+/* the buffer size is kept with the frame, as the frame's format can be
+ * changed while it is being reused */
+struct pooled_frame {
+	struct obs_source_frame frame;
+	size_t buffer_size;
+
+	/* set for wrapped frames, which don't own their data */
+	obs_source_frame_release_t release;
+	void *release_param;
+};
+
+bool obs_frame_pool_init(struct obs_frame_pool *pool)
+{
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+
+	da_init(pool->classes);
+	pool->max_idle_bytes = DEFAULT_MAX_IDLE_BYTES;
+	return true;
+}
+
+static void trim_pool(struct obs_frame_pool *pool, uint64_t max_idle_bytes,
+		      uint64_t idle_since);
+
+void obs_frame_pool_free(struct obs_frame_pool *pool)
+{
+	trim_pool(pool, 0, 0);
+
+	if (pool->allocations) {
+		blog(LOG_INFO,
+		     "Async frame pool: %" PRIu64 " allocations, "
+		     "%.1f%% served from the pool, %" PRIu64
+		     " MB still in use",
+		     pool->allocations,
+		     (double)pool->hits * 100.0 / (double)pool->allocations,
+		     pool->resident_bytes / (1024 * 1024));
+	}
+
+	for (size_t i = 0; i < pool->classes.num; i++)
+		da_free(pool->classes.array[i].buffers);
+	da_free(pool->classes);
+
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+/* four classes per power of two, so at most a quarter of a buffer is unused */
+static inline size_t get_class_size(size_t size)
+{
+	size_t step = MIN_CLASS_STEP;
+
+	while (step * 8 <= size)
+		step *= 2;
+
+	return (size + step - 1) & ~(step - 1);
+}
+
+static struct obs_frame_pool_class *get_class(struct obs_frame_pool *pool,
+					      size_t size)
+{
+	struct obs_frame_pool_class *fpc;
+
+	for (size_t i = 0; i < pool->classes.num; i++) {
+		fpc = pool->classes.array + i;
+		if (fpc->size == size)
+			return fpc;
+	}
+
+	fpc = da_push_back_new(pool->classes);
+	fpc->size = size;
+	return fpc;
+}
+
+/* frees the least recently used buffers until no more than max_idle_bytes
+ * are idle, as well as any buffers that have been idle since before
+ * idle_since */
+static void trim_pool(struct obs_frame_pool *pool, uint64_t max_idle_bytes,
+		      uint64_t idle_since)
+{
+	for (;;) {
+		struct obs_frame_pool_class *oldest = NULL;
+
+		/* buffers are appended as they become idle, so the first one
+		 * in each class is the oldest */
+		for (size_t i = 0; i < pool->classes.num; i++) {
+			struct obs_frame_pool_class *fpc =
+				pool->classes.array + i;
+
+			if (fpc->buffers.num &&
+			    (!oldest || fpc->buffers.array[0].idle_since <
+						oldest->buffers.array[0]
+							.idle_since))
+				oldest = fpc;
+		}
+
+		if (!oldest)
+			break;
+		if (pool->idle_bytes <= max_idle_bytes &&
+		    oldest->buffers.array[0].idle_since >= idle_since)
+			break;
+
+		bfree(oldest->buffers.array[0].data);
+		da_erase(oldest->buffers, 0);
+
+		pool->idle_bytes -= oldest->size;
+		pool->resident_bytes -= oldest->size;
+		pool->trimmed_bytes += oldest->size;
+	}
+}
+
+static inline void advise_hugepages(uint8_t *data, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	uintptr_t start = ((uintptr_t)data + HUGEPAGE_SIZE - 1) &
+			  ~(uintptr_t)(HUGEPAGE_SIZE - 1);
+	uintptr_t end = ((uintptr_t)data + size) &
+			~(uintptr_t)(HUGEPAGE_SIZE - 1);
+
+	if (end > start)
+		madvise((void *)start, end - start, MADV_HUGEPAGE);
+#else
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+#endif
+}
+
+static uint8_t *pool_alloc(struct obs_frame_pool *pool, size_t size)
+{
+	struct obs_frame_pool_class *fpc;
+	uint8_t *data = NULL;
+	bool hugepages;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	fpc = get_class(pool, size);
+	pool->allocations++;
+
+	if (fpc->buffers.num) {
+		/* the most recently used buffer is the most likely to still
+		 * be in cache */
+		data = fpc->buffers.array[fpc->buffers.num - 1].data;
+		da_pop_back(fpc->buffers);
+
+		pool->idle_bytes -= size;
+		pool->hits++;
+	} else {
+		pool->resident_bytes += size;
+	}
+
+	hugepages = pool->hugepages;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!data) {
+		data = bmalloc(size);
+		if (hugepages && size >= HUGEPAGE_SIZE)
+			advise_hugepages(data, size);
+	}
+
+	return data;
+}
+
+static void pool_release(struct obs_frame_pool *pool, uint8_t *data,
+			 size_t size)
+{
+	struct obs_frame_pool_buffer buffer = {data, os_gettime_ns()};
+
+	pthread_mutex_lock(&pool->mutex);
+
+	da_push_back(get_class(pool, size)->buffers, &buffer);
+	pool->idle_bytes += size;
+
+	if (pool->idle_bytes > pool->max_idle_bytes)
+		trim_pool(pool, pool->max_idle_bytes, 0);
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_frame_pool_tick(uint64_t sys_time)
+{
+	struct obs_frame_pool *pool = &obs->frame_pool;
+
+	if (sys_time - pool->last_trim_time < TRIM_INTERVAL_NS)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (sys_time > IDLE_TIMEOUT_NS)
+		trim_pool(pool, pool->max_idle_bytes,
+			  sys_time - IDLE_TIMEOUT_NS);
+	pool->last_trim_time = sys_time;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+struct obs_source_frame *obs_frame_pool_create_frame(enum video_format format,
+						     uint32_t width,
+						     uint32_t height)
+{
+	struct pooled_frame *pf = bzalloc(sizeof(struct pooled_frame));
+	struct obs_source_frame *frame = &pf->frame;
+	struct video_frame vid_frame;
+	size_t size;
+
+	size = video_frame_get_data_size(format, width, height);
+	pf->buffer_size = get_class_size(size);
+
+	video_frame_init_data(&vid_frame, format, width, height,
+			      pool_alloc(&obs->frame_pool, pf->buffer_size));
+
+	frame->format = format;
+	frame->width = width;
+	frame->height = height;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i] = vid_frame.data[i];
+		frame->linesize[i] = vid_frame.linesize[i];
+	}
+
+	return frame;
+}
+
+struct obs_source_frame *
+obs_frame_pool_wrap_frame(const struct obs_source_frame *frame,
+			  obs_source_frame_release_t release, void *param)
+{
+	struct pooled_frame *pf = bmalloc(sizeof(struct pooled_frame));
+
+	pf->frame = *frame;
+	pf->frame.refs = 0;
+	pf->frame.prev_frame = false;
+	pf->buffer_size = 0;
+	pf->release = release;
+	pf->release_param = param;
+	return &pf->frame;
+}
+
+void obs_frame_pool_destroy_frame(struct obs_source_frame *frame)
+{
+	struct pooled_frame *pf = (struct pooled_frame *)frame;
+
+	if (!frame)
+		return;
+
+	if (pf->release)
+		pf->release(pf->release_param);
+	else if (obs && frame->data[0])
+		pool_release(&obs->frame_pool, frame->data[0],
+			     pf->buffer_size);
+	else
+		bfree(frame->data[0]);
+
+	bfree(pf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs || !stats)
+		return;
+
+	pool = &obs->frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->allocations = pool->allocations;
+	stats->hits = pool->hits;
+	stats->resident_bytes = pool->resident_bytes;
+	stats->idle_bytes = pool->idle_bytes;
+	stats->trimmed_bytes = pool->trimmed_bytes;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_frame_pool_limit(uint64_t max_idle_bytes)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs)
+		return;
+
+	pool = &obs->frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->max_idle_bytes = max_idle_bytes;
+	trim_pool(pool, max_idle_bytes, 0);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_frame_pool_hugepages(bool enable)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->frame_pool.mutex);
+	obs->frame_pool.hugepages = enable;
+	pthread_mutex_unlock(&obs->frame_pool.mutex);
+}
+
+void obs_frame_pool_trim(void)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->frame_pool.mutex);
+	trim_pool(&obs->frame_pool, 0, 0);
+	pthread_mutex_unlock(&obs->frame_pool.mutex);
+}
@@ -0,0 +1,653 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "obs-interleave.h"
+#include "obs-internal.h"
+
+/* ------------------------------------------------------------------------- */
+/* interleave buffer
+ *
+ * Packets waiting to be interleaved are kept in one dts-sorted FIFO per
+ * encoder track, and the interleaved order is a k-way merge of those FIFOs:
+ * lowest dts first, video before audio on equal dts, then by track index.
+ * With at most MAX_INTERLEAVED_TRACKS tracks, finding the next packet is a
+ * scan over a handful of FIFO heads, and sending it doesn't move any of the
+ * other queued packets. */
+
+struct interleaved_cursor {
+	size_t pos[MAX_INTERLEAVED_TRACKS];
+};
+
+static inline struct interleaved_track *
+get_interleaved_track(struct packet_interleaver *il, enum obs_encoder_type type,
+		      size_t track_idx)
+{
+	size_t idx = type == OBS_ENCODER_VIDEO
+			     ? track_idx
+			     : MAX_OUTPUT_VIDEO_ENCODERS + track_idx;
+	return &il->tracks[idx];
+}
+
+static inline size_t
+interleaved_track_size(const struct interleaved_track *track)
+{
+	return track->packets.num - track->first;
+}
+
+static inline struct encoder_packet *
+interleaved_track_at(struct interleaved_track *track, size_t idx)
+{
+	return idx < interleaved_track_size(track)
+		       ? &track->packets.array[track->first + idx]
+		       : NULL;
+}
+
+static inline bool interleaved_packet_before(const struct encoder_packet *a,
+					     const struct encoder_packet *b)
+{
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec;
+	if (a->type != b->type)
+		return a->type == OBS_ENCODER_VIDEO;
+	return a->track_idx < b->track_idx;
+}
+
+/* returns the packet after the cursor in interleaved order and advances the
+ * cursor past it */
+static struct encoder_packet *
+interleaved_cursor_next(struct packet_interleaver *il,
+			struct interleaved_cursor *cursor)
+{
+	struct encoder_packet *next = NULL;
+	size_t next_track = 0;
+
+	for (size_t i = 0; i < MAX_INTERLEAVED_TRACKS; i++) {
+		struct encoder_packet *packet =
+			interleaved_track_at(&il->tracks[i], cursor->pos[i]);
+
+		if (packet &&
+		    (!next || interleaved_packet_before(packet, next))) {
+			next = packet;
+			next_track = i;
+		}
+	}
+
+	if (next)
+		cursor->pos[next_track]++;
+	return next;
+}
+
+static struct interleaved_track *
+first_interleaved_track(struct packet_interleaver *il)
+{
+	struct interleaved_track *first = NULL;
+
+	for (size_t i = 0; i < MAX_INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track = &il->tracks[i];
+
+		if (!interleaved_track_size(track))
+			continue;
+		if (!first || interleaved_packet_before(
+				      interleaved_track_at(track, 0),
+				      interleaved_track_at(first, 0)))
+			first = track;
+	}
+
+	return first;
+}
+
+/* removes the first packet of a track without releasing it */
+static void pop_interleaved_packet(struct packet_interleaver *il,
+				   struct interleaved_track *track)
+{
+	il->num--;
+
+	if (++track->first == track->packets.num) {
+		da_resize(track->packets, 0);
+		track->first = 0;
+
+	} else if (track->first >= 32 &&
+		   track->first * 2 >= track->packets.num) {
+		da_erase_range(track->packets, 0, track->first);
+		track->first = 0;
+	}
+}
+
+static inline void insert_interleaved_packet(struct packet_interleaver *il,
+					     struct encoder_packet *out)
+{
+	struct interleaved_track *track =
+		get_interleaved_track(il, out->type, out->track_idx);
+	size_t idx = track->packets.num;
+
+	/* packets of a track almost always arrive in dts order, so this
+	 * is normally a push to the back */
+	while (idx > track->first &&
+	       track->packets.array[idx - 1].dts_usec > out->dts_usec)
+		idx--;
+
+	da_insert(track->packets, idx, out);
+	il->num++;
+}
+
+static void discard_to_idx(struct packet_interleaver *il, size_t idx)
+{
+	for (size_t i = 0; i < idx; i++) {
+		struct interleaved_track *track = first_interleaved_track(il);
+		if (!track)
+			break;
+
+		obs_encoder_packet_release(interleaved_track_at(track, 0));
+		pop_interleaved_packet(il, track);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* timestamps */
+
+static inline bool started(const struct packet_interleaver *il)
+{
+	if (!il->received_audio)
+		return false;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (il->video_tracks[i] && !il->received_video[i])
+			return false;
+	}
+
+	return true;
+}
+
+static inline void check_received(struct packet_interleaver *il,
+				  struct encoder_packet *out)
+{
+	if (out->type == OBS_ENCODER_VIDEO)
+		il->received_video[out->track_idx] = true;
+	else
+		il->received_audio = true;
+}
+
+static inline void
+apply_interleaved_packet_offset(struct packet_interleaver *il,
+				struct encoder_packet *out)
+{
+	int64_t offset;
+
+	/* audio and video need to start at timestamp 0, and the encoders
+	 * may not currently be at 0 when we get data.  so, we store the
+	 * current dts as offset and subtract that value from the dts/pts
+	 * of the output packet. */
+	offset = (out->type == OBS_ENCODER_VIDEO)
+			 ? il->video_offsets[out->track_idx]
+			 : il->audio_offsets[out->track_idx];
+
+	out->dts -= offset;
+	out->pts -= offset;
+
+	/* convert the newly adjusted dts to relative dts time to ensure proper
+	 * interleaving.  if we're using an audio encoder that's already been
+	 * started on another output, then the first audio packet may not be
+	 * quite perfectly synced up in terms of system time (and there's
+	 * nothing we can really do about that), but it will always at least be
+	 * within a 23ish millisecond threshold (at least for AAC) */
+	out->dts_usec = packet_dts_usec(out);
+}
+
+static inline bool has_higher_opposing_ts(struct packet_interleaver *il,
+					  struct encoder_packet *packet)
+{
+	bool has_higher = true;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (!il->video_tracks[i] ||
+		    (packet->type == OBS_ENCODER_VIDEO &&
+		     i == packet->track_idx))
+			continue;
+		has_higher = has_higher &&
+			     il->highest_video_ts[i] > packet->dts_usec;
+	}
+
+	return packet->type == OBS_ENCODER_AUDIO
+		       ? has_higher
+		       : (has_higher &&
+			  il->highest_audio_ts > packet->dts_usec);
+}
+
+static inline void set_higher_ts(struct packet_interleaver *il,
+				 struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (il->highest_video_ts[packet->track_idx] < packet->dts_usec)
+			il->highest_video_ts[packet->track_idx] =
+				packet->dts_usec;
+	} else {
+		if (il->highest_audio_ts < packet->dts_usec)
+			il->highest_audio_ts = packet->dts_usec;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* startup */
+
+static bool get_first_audio_track(const struct packet_interleaver *il,
+				  size_t *index)
+{
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (il->audio_tracks[i]) {
+			*index = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool get_first_video_track(const struct packet_interleaver *il,
+				  size_t *index)
+{
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (il->video_tracks[i]) {
+			*index = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static inline struct encoder_packet *
+find_first_packet_type(struct packet_interleaver *il,
+		       enum obs_encoder_type type, size_t audio_idx)
+{
+	struct interleaved_track *track =
+		get_interleaved_track(il, type, audio_idx);
+	return interleaved_track_at(track, 0);
+}
+
+static inline struct encoder_packet *
+find_last_packet_type(struct packet_interleaver *il,
+		      enum obs_encoder_type type, size_t audio_idx)
+{
+	struct interleaved_track *track =
+		get_interleaved_track(il, type, audio_idx);
+	size_t size = interleaved_track_size(track);
+	return size ? interleaved_track_at(track, size - 1) : NULL;
+}
+
+/* returns the position of the first packet of a track in interleaved
+ * order; only used while starting up, when the buffer is small */
+static int find_first_packet_type_idx(struct packet_interleaver *il,
+				      enum obs_encoder_type type, size_t idx)
+{
+	struct encoder_packet *first = find_first_packet_type(il, type, idx);
+	struct interleaved_cursor cursor = {0};
+
+	if (!first)
+		return -1;
+
+	for (size_t i = 0; i < il->num; i++) {
+		if (interleaved_cursor_next(il, &cursor) == first)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+/* gets the point where audio and video are closest together */
+static size_t get_interleaved_start_idx(struct packet_interleaver *il)
+{
+	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
+	struct encoder_packet *first_video =
+		find_first_packet_type(il, OBS_ENCODER_VIDEO, 0);
+	struct interleaved_cursor cursor = {0};
+	size_t video_idx = DARRAY_INVALID;
+	size_t idx = 0;
+
+	for (size_t i = 0; i < il->num; i++) {
+		struct encoder_packet *packet =
+			interleaved_cursor_next(il, &cursor);
+		int64_t diff;
+
+		if (packet->type != OBS_ENCODER_AUDIO) {
+			if (packet == first_video)
+				video_idx = i;
+			continue;
+		}
+
+		diff = llabs(packet->dts_usec - first_video->dts_usec);
+		if (diff < closest_diff) {
+			closest_diff = diff;
+			idx = i;
+		}
+	}
+
+	return video_idx < idx ? video_idx : idx;
+}
+
+static int prune_premature_packets(struct packet_interleaver *il)
+{
+	struct encoder_packet *video;
+	int video_idx;
+	int max_idx;
+	int64_t duration_usec, max_audio_duration_usec = 0;
+	int64_t max_diff = 0;
+	int64_t diff = 0;
+	int audio_encoders = 0;
+
+	video_idx = find_first_packet_type_idx(il, OBS_ENCODER_VIDEO, 0);
+	if (video_idx == -1)
+		return -1;
+
+	max_idx = video_idx;
+	video = find_first_packet_type(il, OBS_ENCODER_VIDEO, 0);
+	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		struct encoder_packet *audio;
+		int audio_idx;
+		int64_t audio_duration_usec = 0;
+
+		if (!il->audio_tracks[i])
+			continue;
+		audio_encoders++;
+
+		audio_idx = find_first_packet_type_idx(il, OBS_ENCODER_AUDIO,
+						       i);
+		if (audio_idx == -1) {
+			il->received_audio = false;
+			return -1;
+		}
+
+		audio = find_first_packet_type(il, OBS_ENCODER_AUDIO, i);
+		if (audio_idx > max_idx)
+			max_idx = audio_idx;
+
+		diff = audio->dts_usec - video->dts_usec;
+		if (diff > max_diff)
+			max_diff = diff;
+
+		audio_duration_usec = il->audio_durations_usec[i];
+		if (audio_duration_usec > max_audio_duration_usec)
+			max_audio_duration_usec = audio_duration_usec;
+	}
+
+	/* Once multiple audio encoders are running they are almost always out
+	 * of phase by ~Xms. If users change their video to > 100fps then it
+	 * becomes probable that this phase difference will be larger than the
+	 * video duration preventing us from ever finding a synchronization
+	 * point due to their larger frame duration. Instead give up on a tight
+	 * video sync. */
+	if (audio_encoders > 1 && duration_usec < max_audio_duration_usec) {
+		duration_usec = max_audio_duration_usec;
+	}
+
+	return diff > duration_usec ? max_idx + 1 : 0;
+}
+
+#define DEBUG_STARTING_PACKETS 0
+
+static bool prune_interleaved_packets(struct packet_interleaver *il)
+{
+	size_t start_idx = 0;
+	int prune_start = prune_premature_packets(il);
+
+#if DEBUG_STARTING_PACKETS == 1
+	struct interleaved_cursor cursor = {0};
+
+	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
+	for (size_t i = 0; i < il->num; i++) {
+		struct encoder_packet *packet =
+			interleaved_cursor_next(il, &cursor);
+		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
+		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
+		     (int)packet->track_idx, packet->dts_usec,
+		     (int)i < prune_start ? "true" : "false");
+	}
+#endif
+
+	/* prunes the first video packet if it's too far away from audio */
+	if (prune_start == -1)
+		return false;
+	else if (prune_start != 0)
+		start_idx = (size_t)prune_start;
+	else
+		start_idx = get_interleaved_start_idx(il);
+
+	if (start_idx)
+		discard_to_idx(il, start_idx);
+
+	return true;
+}
+
+static bool get_audio_and_video_packets(struct packet_interleaver *il,
+					struct encoder_packet **video,
+					struct encoder_packet **audio)
+{
+	bool found_video = false;
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (il->video_tracks[i]) {
+			video[i] = find_first_packet_type(il, OBS_ENCODER_VIDEO,
+							  i);
+			if (!video[i]) {
+				il->received_video[i] = false;
+				return false;
+			} else {
+				found_video = true;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (il->audio_tracks[i]) {
+			audio[i] = find_first_packet_type(il, OBS_ENCODER_AUDIO,
+							  i);
+			if (!audio[i]) {
+				il->received_audio = false;
+				return false;
+			}
+		}
+	}
+
+	return found_video;
+}
+
+static bool initialize_interleaved_packets(struct packet_interleaver *il)
+{
+	struct encoder_packet *video[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
+	struct encoder_packet *audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+	struct encoder_packet *last_audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+	size_t start_idx;
+	size_t first_audio_idx;
+	size_t first_video_idx;
+
+	if (!get_first_audio_track(il, &first_audio_idx))
+		return false;
+	if (!get_first_video_track(il, &first_video_idx))
+		return false;
+
+	if (!get_audio_and_video_packets(il, video, audio))
+		return false;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (il->audio_tracks[i]) {
+			last_audio[i] =
+				find_last_packet_type(il, OBS_ENCODER_AUDIO, i);
+		}
+	}
+
+	/* ensure that there is audio past the first video packet */
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (il->audio_tracks[i]) {
+			if (last_audio[i]->dts_usec <
+			    video[first_video_idx]->dts_usec) {
+				il->received_audio = false;
+				return false;
+			}
+		}
+	}
+
+	/* clear out excess starting audio if it hasn't been already */
+	start_idx = get_interleaved_start_idx(il);
+	if (start_idx) {
+		discard_to_idx(il, start_idx);
+		if (!get_audio_and_video_packets(il, video, audio))
+			return false;
+	}
+
+	/* get new offsets */
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (il->video_tracks[i]) {
+			il->video_offsets[i] = video[i]->pts;
+		}
+	}
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (il->audio_tracks[i] && audio[i]->dts > 0) {
+			il->audio_offsets[i] = audio[i]->dts;
+		}
+	}
+#if DEBUG_STARTING_PACKETS == 1
+	int64_t v = video[first_video_idx]->dts_usec;
+	int64_t a = audio[first_audio_idx]->dts_usec;
+	int64_t diff = v - a;
+
+	blog(LOG_DEBUG, "offset for video: %lld, audio: %lld, diff: %lldms", v,
+	     a, diff / 1000LL);
+#endif
+
+	/* subtract offsets from highest TS offset variables */
+	il->highest_audio_ts -= audio[first_audio_idx]->dts_usec;
+
+	/* apply new offsets to all existing packet DTS/PTS values */
+	for (size_t i = 0; i < MAX_INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track = &il->tracks[i];
+
+		for (size_t j = track->first; j < track->packets.num; j++)
+			apply_interleaved_packet_offset(
+				il, &track->packets.array[j]);
+	}
+
+	return true;
+}
+
+static void resort_interleaved_packets(struct packet_interleaver *il)
+{
+	/* offsets are applied per track, so each track's FIFO stays sorted
+	 * and only the interleaved (merged) order changes, which needs no
+	 * work here */
+	for (size_t i = 0; i < MAX_INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track = &il->tracks[i];
+
+		for (size_t j = track->first; j < track->packets.num; j++)
+			set_higher_ts(il, &track->packets.array[j]);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+void packet_interleaver_reset(struct packet_interleaver *il)
+{
+	for (size_t i = 0; i < MAX_INTERLEAVED_TRACKS; i++) {
+		struct interleaved_track *track = &il->tracks[i];
+
+		for (size_t j = track->first; j < track->packets.num; j++)
+			obs_encoder_packet_release(track->packets.array + j);
+		da_free(track->packets);
+		track->first = 0;
+	}
+
+	il->num = 0;
+	il->received_audio = false;
+	il->highest_audio_ts = 0;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		il->received_video[i] = false;
+		il->video_offsets[i] = 0;
+		il->highest_video_ts[i] = INT64_MIN;
+	}
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++)
+		il->audio_offsets[i] = 0;
+}
+
+bool packet_interleaver_push(struct packet_interleaver *il,
+			     struct encoder_packet *packet)
+{
+	bool was_started = started(il);
+
+	if (was_started)
+		apply_interleaved_packet_offset(il, packet);
+	else
+		check_received(il, packet);
+
+	insert_interleaved_packet(il, packet);
+
+	/* when both video and audio have been received, we're ready
+	 * to start sending out packets (one at a time) */
+	if (!started(il))
+		return false;
+
+	if (!was_started) {
+		if (!prune_interleaved_packets(il))
+			return false;
+		if (!initialize_interleaved_packets(il))
+			return false;
+
+		resort_interleaved_packets(il);
+	} else {
+		set_higher_ts(il, packet);
+	}
+
+	return true;
+}
+
+bool packet_interleaver_pop(struct packet_interleaver *il,
+			    struct encoder_packet *packet)
+{
+	struct interleaved_track *track = first_interleaved_track(il);
+	if (!track)
+		return false;
+
+	*packet = *interleaved_track_at(track, 0);
+
+	/* do not send an interleaved packet if there's no packet of the
+	 * opposing type of a higher timestamp in the interleave buffer.
+	 * this ensures that the timestamps are monotonic */
+	if (!has_higher_opposing_ts(il, packet))
+		return false;
+
+	pop_interleaved_packet(il, track);
+	return true;
+}
+
+void packet_interleaver_discard_before(struct packet_interleaver *il,
+				       int64_t dts_usec)
+{
+	size_t idx = 0;
+	struct interleaved_cursor cursor = {0};
+
+	for (; idx < il->num; idx++) {
+		struct encoder_packet *p = interleaved_cursor_next(il, &cursor);
+
+		if (p->dts_usec >= dts_usec)
+			break;
+	}
+
+	if (idx)
+		discard_to_idx(il, idx);
+}
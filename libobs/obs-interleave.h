@@ -0,0 +1,92 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/darray.h"
+#include "obs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interleaves the encoded packets of an output's video and audio tracks into
+ * a single stream with monotonic timestamps.  Until every track has
+ * received its first packet, packets are only buffered; after that the
+ * buffer is pruned to where audio and video line up, the timestamps of
+ * every track are offset to start at zero, and packets become available in
+ * interleaved order once every other track has a packet with a higher
+ * timestamp.
+ *
+ * Not thread safe; the output serializes access with its interleave mutex.
+ */
+
+/* packets of one encoder track waiting to be interleaved, sorted by dts.
+ * packets before 'first' have already been sent and are compacted lazily */
+struct interleaved_track {
+	DARRAY(struct encoder_packet) packets;
+	size_t first;
+};
+
+#define MAX_INTERLEAVED_TRACKS \
+	(MAX_OUTPUT_VIDEO_ENCODERS + MAX_OUTPUT_AUDIO_ENCODERS)
+
+struct packet_interleaver {
+	struct interleaved_track tracks[MAX_INTERLEAVED_TRACKS];
+	size_t num;
+
+	/* tracks that have an encoder, and the duration of an audio frame of
+	 * each audio track.  set by the output before it starts */
+	bool video_tracks[MAX_OUTPUT_VIDEO_ENCODERS];
+	bool audio_tracks[MAX_OUTPUT_AUDIO_ENCODERS];
+	int64_t audio_durations_usec[MAX_OUTPUT_AUDIO_ENCODERS];
+
+	bool received_video[MAX_OUTPUT_VIDEO_ENCODERS];
+	bool received_audio;
+	int64_t video_offsets[MAX_OUTPUT_VIDEO_ENCODERS];
+	int64_t audio_offsets[MAX_OUTPUT_AUDIO_ENCODERS];
+	int64_t highest_audio_ts;
+	int64_t highest_video_ts[MAX_OUTPUT_VIDEO_ENCODERS];
+};
+
+/** Releases all buffered packets and returns to the not-started state */
+void packet_interleaver_reset(struct packet_interleaver *il);
+
+/**
+ * Takes ownership of a packet, whose track_idx must be set.  Returns true if
+ * the interleaver is started and a packet may be available from
+ * packet_interleaver_pop.
+ */
+bool packet_interleaver_push(struct packet_interleaver *il,
+			     struct encoder_packet *packet);
+
+/**
+ * Removes the next packet in interleaved order and passes ownership of it to
+ * the caller.  Returns false if there is none, or if sending it could make
+ * the timestamps of the stream non-monotonic.
+ */
+bool packet_interleaver_pop(struct packet_interleaver *il,
+			    struct encoder_packet *packet);
+
+/** Releases buffered packets that come before the given dts */
+void packet_interleaver_discard_before(struct packet_interleaver *il,
+				       int64_t dts_usec);
+
+#ifdef __cplusplus
+}
+#endif
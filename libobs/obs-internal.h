@@ -37,6 +37,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #include <obsversion.h>
 #include <caption/caption.h>
@@ -104,6 +105,10 @@ struct obs_module {
 	void *module;
 	bool loaded;
 
+	uint64_t open_ns;
+	uint64_t locale_ns;
+	uint64_t load_ns;
+
 	bool (*load)(void);
 	void (*unload)(void);
 	void (*post_load)(void);
@@ -358,6 +363,9 @@ struct obs_core_video {
 	float sdr_white_level;
 	float hdr_nominal_peak_level;
 
+	bool parallel_delivery;
+	bool fast_conversion;
+
 	pthread_mutex_t task_mutex;
 	struct deque tasks;
 
@@ -466,12 +474,55 @@ struct obs_core_hotkeys {
 	char *sceneitem_hide;
 };
 
+/* buffers for async source frames, shared between all sources */
+struct obs_frame_pool_buffer {
+	uint8_t *data;
+	uint64_t idle_since;
+};
+
+struct obs_frame_pool_class {
+	size_t size;
+	DARRAY(struct obs_frame_pool_buffer) buffers;
+};
+
+struct obs_frame_pool {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_frame_pool_class) classes;
+
+	uint64_t max_idle_bytes;
+	bool hugepages;
+	uint64_t last_trim_time;
+
+	uint64_t allocations;
+	uint64_t hits;
+	uint64_t resident_bytes;
+	uint64_t idle_bytes;
+	uint64_t trimmed_bytes;
+};
+
 typedef DARRAY(struct obs_source_info) obs_source_info_array_t;
 
+/* signals that sources emit often, hashed once on startup */
+struct obs_source_signal_ids {
+	struct signal_id source_update;
+	struct signal_id update;
+	struct signal_id source_volume;
+	struct signal_id volume;
+	struct signal_id media_play;
+	struct signal_id media_pause;
+	struct signal_id media_restart;
+	struct signal_id media_stopped;
+	struct signal_id media_next;
+	struct signal_id media_previous;
+	struct signal_id media_started;
+	struct signal_id media_ended;
+};
+
 struct obs_core {
 	struct obs_module *first_module;
 	DARRAY(struct obs_module_path) module_paths;
 	DARRAY(char *) safe_modules;
+	bool parallel_module_loading;
 
 	obs_source_info_array_t source_types;
 	obs_source_info_array_t input_types;
@@ -483,9 +534,11 @@ struct obs_core {
 
 	signal_handler_t *signals;
 	proc_handler_t *procs;
+	struct obs_source_signal_ids source_signals;
 
 	char *locale;
 	char *module_config_path;
+	char *effect_cache_dir;
 	bool name_store_owned;
 	profiler_name_store_t *name_store;
 
@@ -495,6 +548,7 @@ struct obs_core {
 	struct obs_core_audio audio;
 	struct obs_core_data data;
 	struct obs_core_hotkeys hotkeys;
+	struct obs_frame_pool frame_pool;
 
 	os_task_queue_t *destruction_task_thread;
 
@@ -538,6 +592,25 @@ extern void stop_raw_video(video_t *video,
 					    struct video_data *frame),
 			   void *param);
 
+/* ------------------------------------------------------------------------- */
+/* async frame pool */
+
+extern bool obs_frame_pool_init(struct obs_frame_pool *pool);
+extern void obs_frame_pool_free(struct obs_frame_pool *pool);
+extern void obs_frame_pool_tick(uint64_t sys_time);
+
+/* frames created with these must also be destroyed with them */
+extern struct obs_source_frame *
+obs_frame_pool_create_frame(enum video_format format, uint32_t width,
+			    uint32_t height);
+extern void obs_frame_pool_destroy_frame(struct obs_source_frame *frame);
+
+/* wraps a frame whose data is owned by the caller, calling release instead of
+ * freeing the data when destroyed */
+extern struct obs_source_frame *
+obs_frame_pool_wrap_frame(const struct obs_source_frame *frame,
+			  obs_source_frame_release_t release, void *param);
+
 /* ------------------------------------------------------------------------- */
 /* obs shared context data */
 
@@ -660,6 +733,7 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+	bool borrowed;
 };
 
 enum audio_action_type {
@@ -953,6 +1027,23 @@ static inline void obs_source_dosignal(struct obs_source *source,
 				      &data);
 }
 
+static inline void
+obs_source_dosignal_id(struct obs_source *source,
+		       const struct signal_id *signal_obs,
+		       const struct signal_id *signal_source)
+{
+	struct calldata data;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&data, stack, sizeof(stack));
+	calldata_set_ptr(&data, "source", source);
+	if (signal_obs && !source->context.private)
+		signal_handler_signal_id(obs->signals, signal_obs, &data);
+	if (signal_source)
+		signal_handler_signal_id(source->context.signals,
+					 signal_source, &data);
+}
+
 /* maximum timestamp variance in nanoseconds */
 #define MAX_TS_VAR 2000000000ULL
 
@@ -1123,19 +1214,13 @@ struct obs_output {
 	/* indicates ownership of the info.id buffer */
 	bool owns_info_id;
 
-	bool received_video[MAX_OUTPUT_VIDEO_ENCODERS];
 	DARRAY(struct keyframe_group_data) keyframe_group_tracking;
-	bool received_audio;
 	volatile bool data_active;
 	volatile bool end_data_capture_thread_active;
-	int64_t video_offsets[MAX_OUTPUT_VIDEO_ENCODERS];
-	int64_t audio_offsets[MAX_OUTPUT_AUDIO_ENCODERS];
-	int64_t highest_audio_ts;
-	int64_t highest_video_ts[MAX_OUTPUT_VIDEO_ENCODERS];
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct packet_interleaver interleaver;
 	int stop_code;
 
 	int reconnect_retry_sec;
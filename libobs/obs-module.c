@@ -80,14 +80,9 @@ const char *obs_module_get_locale_text(const obs_module_t *mod,
 
 static inline char *get_module_name(const char *file)
 {
-	static size_t ext_len = 0;
+	size_t ext_len = strlen(get_module_extension());
 	struct dstr name = {0};
 
-	if (ext_len == 0) {
-		const char *ext = get_module_extension();
-		ext_len = strlen(ext);
-	}
-
 	dstr_copy(&name, file);
 	dstr_resize(&name, name.len - ext_len);
 	return name.array;
@@ -97,15 +92,11 @@ static inline char *get_module_name(const char *file)
 extern void reset_win32_symbol_paths(void);
 #endif
 
-int obs_open_module(obs_module_t **module, const char *path,
-		    const char *data_path)
+static int open_module_file(struct obs_module *mod, const char *path,
+			    const char *data_path)
 {
-	struct obs_module mod = {0};
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
 #ifdef __APPLE__
 	/* HACK: Do not load obsolete obs-browser build on macOS; the
 	 * obs-browser plugin used to live in the Application Support
@@ -117,35 +108,66 @@ int obs_open_module(obs_module_t **module, const char *path,
 	}
 #endif
 
-	blog(LOG_DEBUG, "---------------------------------");
-
-	mod.module = os_dlopen(path);
-	if (!mod.module) {
+	mod->module = os_dlopen(path);
+	if (!mod->module) {
 		blog(LOG_WARNING, "Module '%s' not loaded", path);
 		return MODULE_FILE_NOT_FOUND;
 	}
 
-	errorcode = load_module_exports(&mod, path);
+	errorcode = load_module_exports(mod, path);
 	if (errorcode != MODULE_SUCCESS)
 		return errorcode;
 
-	mod.bin_path = bstrdup(path);
-	mod.file = strrchr(mod.bin_path, '/');
-	mod.file = (!mod.file) ? mod.bin_path : (mod.file + 1);
-	mod.mod_name = get_module_name(mod.file);
-	mod.data_path = bstrdup(data_path);
-	mod.next = obs->first_module;
+	mod->bin_path = bstrdup(path);
+	mod->file = strrchr(mod->bin_path, '/');
+	mod->file = (!mod->file) ? mod->bin_path : (mod->file + 1);
+	mod->mod_name = get_module_name(mod->file);
+	mod->data_path = bstrdup(data_path);
+	return MODULE_SUCCESS;
+}
+
+static void set_module_locale(struct obs_module *mod)
+{
+	uint64_t start = os_gettime_ns();
+
+	if (mod->set_locale)
+		mod->set_locale(obs->locale);
 
-	if (mod.file) {
-		blog(LOG_DEBUG, "Loading module: %s", mod.file);
+	mod->locale_ns = os_gettime_ns() - start;
+}
+
+static void add_module(struct obs_module *mod)
+{
+	if (mod->file) {
+		blog(LOG_DEBUG, "Loading module: %s", mod->file);
 	}
 
+	mod->next = obs->first_module;
+	obs->first_module = mod;
+}
+
+int obs_open_module(obs_module_t **module, const char *path,
+		    const char *data_path)
+{
+	struct obs_module mod = {0};
+	uint64_t start = os_gettime_ns();
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	blog(LOG_DEBUG, "---------------------------------");
+
+	errorcode = open_module_file(&mod, path, data_path);
+	if (errorcode != MODULE_SUCCESS)
+		return errorcode;
+
+	mod.open_ns = os_gettime_ns() - start;
+
 	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
+	add_module(*module);
 	mod.set_pointer(*module);
-
-	if (mod.set_locale)
-		mod.set_locale(obs->locale);
+	set_module_locale(*module);
 
 	return MODULE_SUCCESS;
 }
@@ -162,7 +184,10 @@ bool obs_init_module(obs_module_t *module)
 				   "obs_init_module(%s)", module->file);
 	profile_start(profile_name);
 
+	uint64_t start = os_gettime_ns();
 	module->loaded = module->load();
+	module->load_ns = os_gettime_ns() - start;
+
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'",
 		     module->file);
@@ -179,6 +204,60 @@ void obs_log_loaded_modules(void)
 		blog(LOG_INFO, "    %s", mod->file);
 }
 
+bool obs_get_module_load_time(obs_module_t *module,
+			      struct obs_module_load_time *time)
+{
+	if (!module || !time)
+		return false;
+
+	time->open_ns = module->open_ns;
+	time->locale_ns = module->locale_ns;
+	time->load_ns = module->load_ns;
+	return true;
+}
+
+static inline uint64_t module_load_total(const struct obs_module *mod)
+{
+	return mod->open_ns + mod->locale_ns + mod->load_ns;
+}
+
+static int cmp_module_load_time(const void *a, const void *b)
+{
+	uint64_t total_a = module_load_total(*(struct obs_module *const *)a);
+	uint64_t total_b = module_load_total(*(struct obs_module *const *)b);
+
+	return total_a < total_b ? 1 : (total_a > total_b ? -1 : 0);
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+void obs_log_module_load_times(void)
+{
+	DARRAY(struct obs_module *) mods;
+	da_init(mods);
+
+	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
+		da_push_back(mods, &mod);
+
+	if (mods.num)
+		qsort(mods.array, mods.num, sizeof(*mods.array),
+		      cmp_module_load_time);
+
+	blog(LOG_INFO, "  Module load times (open/locale/load):");
+
+	for (size_t i = 0; i < mods.num; i++) {
+		struct obs_module *mod = mods.array[i];
+		blog(LOG_INFO, "    %s: %.2f ms (%.2f/%.2f/%.2f)", mod->file,
+		     ns_to_ms(module_load_total(mod)), ns_to_ms(mod->open_ns),
+		     ns_to_ms(mod->locale_ns), ns_to_ms(mod->load_ns));
+	}
+
+	da_free(mods);
+}
+
 const char *obs_get_module_file_name(obs_module_t *module)
 {
 	return module ? module->file : NULL;
@@ -283,6 +362,12 @@ void obs_add_safe_module(const char *name)
 	da_push_back(obs->safe_modules, &item);
 }
 
+void obs_set_parallel_module_loading(bool enable)
+{
+	if (obs)
+		obs->parallel_module_loading = enable;
+}
+
 extern void get_plugin_info(const char *path, bool *is_obs_plugin,
 			    bool *can_load);
 
@@ -304,26 +389,29 @@ static bool is_safe_module(const char *name)
 	return false;
 }
 
-static void load_all_callback(void *param, const struct obs_module_info2 *info)
+static void add_load_failure(struct fail_info *fail_info, const char *name)
 {
-	struct fail_info *fail_info = param;
-	obs_module_t *module;
-
-	bool is_obs_plugin;
-	bool can_load_obs_plugin;
-
-	get_plugin_info(info->bin_path, &is_obs_plugin, &can_load_obs_plugin);
+	if (fail_info) {
+		dstr_cat(&fail_info->fail_modules, name);
+		dstr_cat(&fail_info->fail_modules, ";");
+		fail_info->fail_count++;
+	}
+}
 
+static bool can_open_module(const struct obs_module_info2 *info,
+			    bool is_obs_plugin, bool can_load_obs_plugin,
+			    struct fail_info *fail_info)
+{
 	if (!is_obs_plugin) {
 		blog(LOG_WARNING, "Skipping module '%s', not an OBS plugin",
 		     info->bin_path);
-		return;
+		return false;
 	}
 
 	if (!is_safe_module(info->name)) {
 		blog(LOG_WARNING, "Skipping module '%s', not on safe list",
 		     info->name);
-		return;
+		return false;
 	}
 
 	if (!can_load_obs_plugin) {
@@ -331,46 +419,75 @@ static void load_all_callback(void *param, const struct obs_module_info2 *info)
 		     "Skipping module '%s' due to possible "
 		     "import conflicts",
 		     info->bin_path);
-		goto load_failure;
+		add_load_failure(fail_info, info->name);
+		return false;
 	}
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
+	return true;
+}
+
+static bool module_opened(int code, const struct obs_module_info2 *info,
+			  struct fail_info *fail_info)
+{
 	switch (code) {
 	case MODULE_MISSING_EXPORTS:
 		blog(LOG_DEBUG,
 		     "Failed to load module file '%s', not an OBS plugin",
 		     info->bin_path);
-		return;
+		return false;
 	case MODULE_FILE_NOT_FOUND:
 		blog(LOG_DEBUG,
 		     "Failed to load module file '%s', file not found",
 		     info->bin_path);
-		return;
+		return false;
 	case MODULE_ERROR:
 		blog(LOG_DEBUG, "Failed to load module file '%s'",
 		     info->bin_path);
-		goto load_failure;
+		add_load_failure(fail_info, info->name);
+		return false;
 	case MODULE_INCOMPATIBLE_VER:
 		blog(LOG_DEBUG,
 		     "Failed to load module file '%s', incompatible version",
 		     info->bin_path);
-		goto load_failure;
+		add_load_failure(fail_info, info->name);
+		return false;
 	case MODULE_HARDCODED_SKIP:
-		return;
+		return false;
 	}
 
+	return true;
+}
+
+static void load_all_callback(void *param, const struct obs_module_info2 *info)
+{
+	struct fail_info *fail_info = param;
+	obs_module_t *module;
+
+	bool is_obs_plugin;
+	bool can_load_obs_plugin;
+
+	get_plugin_info(info->bin_path, &is_obs_plugin, &can_load_obs_plugin);
+
+	if (!can_open_module(info, is_obs_plugin, can_load_obs_plugin,
+			     fail_info))
+		return;
+
+	int code = obs_open_module(&module, info->bin_path, info->data_path);
+	if (!module_opened(code, info, fail_info))
+		return;
+
 	if (!obs_init_module(module))
 		free_module(module);
+}
 
-	UNUSED_PARAMETER(param);
-	return;
+static void load_all_modules_parallel(struct fail_info *fail_info);
 
-load_failure:
-	if (fail_info) {
-		dstr_cat(&fail_info->fail_modules, info->name);
-		dstr_cat(&fail_info->fail_modules, ";");
-		fail_info->fail_count++;
-	}
+static void load_all_modules(struct fail_info *fail_info)
+{
+	if (obs->parallel_module_loading)
+		load_all_modules_parallel(fail_info);
+	else
+		obs_find_modules2(load_all_callback, fail_info);
 }
 
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
@@ -381,7 +498,7 @@ static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 void obs_load_all_modules(void)
 {
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules2(load_all_callback, NULL);
+	load_all_modules(NULL);
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
@@ -398,7 +515,7 @@ void obs_load_all_modules2(struct obs_module_failure_info *mfi)
 	memset(mfi, 0, sizeof(*mfi));
 
 	profile_start(obs_load_all_modules2_name);
-	obs_find_modules2(load_all_callback, &fail_info);
+	load_all_modules(&fail_info);
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
@@ -536,42 +653,53 @@ static void process_found_module(struct obs_module_path *omp, const char *path,
 	dstr_free(&parsed_bin_path);
 }
 
-static void find_modules_in_path(struct obs_module_path *omp,
-				 obs_find_module_callback2_t callback,
-				 void *param)
+static bool glob_module_path(struct obs_module_path *omp, os_glob_t **gi,
+			     bool *search_directories)
 {
 	struct dstr search_path = {0};
 	char *module_start;
-	bool search_directories = false;
-	os_glob_t *gi;
+	bool success;
 
+	*search_directories = false;
 	dstr_copy(&search_path, omp->bin);
 
 	module_start = strstr(search_path.array, "%module%");
 	if (module_start) {
 		dstr_resize(&search_path, module_start - search_path.array);
-		search_directories = true;
+		*search_directories = true;
 	}
 
 	if (!dstr_is_empty(&search_path) && dstr_end(&search_path) != '/')
 		dstr_cat_ch(&search_path, '/');
 
 	dstr_cat_ch(&search_path, '*');
-	if (!search_directories)
+	if (!*search_directories)
 		dstr_cat(&search_path, get_module_extension());
 
-	if (os_glob(search_path.array, 0, &gi) == 0) {
-		for (size_t i = 0; i < gi->gl_pathc; i++) {
-			if (search_directories == gi->gl_pathv[i].directory)
-				process_found_module(omp, gi->gl_pathv[i].path,
-						     search_directories,
-						     callback, param);
-		}
+	success = os_glob(search_path.array, 0, gi) == 0;
 
-		os_globfree(gi);
+	dstr_free(&search_path);
+	return success;
+}
+
+static void find_modules_in_path(struct obs_module_path *omp,
+				 obs_find_module_callback2_t callback,
+				 void *param)
+{
+	bool search_directories;
+	os_glob_t *gi;
+
+	if (!glob_module_path(omp, &gi, &search_directories))
+		return;
+
+	for (size_t i = 0; i < gi->gl_pathc; i++) {
+		if (search_directories == gi->gl_pathv[i].directory)
+			process_found_module(omp, gi->gl_pathv[i].path,
+					     search_directories, callback,
+					     param);
 	}
 
-	dstr_free(&search_path);
+	os_globfree(gi);
 }
 
 void obs_find_modules2(obs_find_module_callback2_t callback, void *param)
@@ -604,6 +732,218 @@ void obs_enum_modules(obs_enum_module_callback_t callback, void *param)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* parallel loading */
+
+#define MIN_MODULE_THREADS 4
+#define MAX_MODULE_THREADS 8
+
+#ifdef _WIN32
+/* os_dlopen points the DLL search path at the module's own directory, and
+ * libraries loaded later by obs_module_load may still rely on that, so
+ * modules are opened right before they are loaded just like before */
+#define OPEN_MODULES_IN_PARALLEL false
+#else
+#define OPEN_MODULES_IN_PARALLEL true
+#endif
+
+struct module_job {
+	struct obs_module_path omp;
+	char *path;
+	bool directory;
+
+	char *name;
+	char *bin_path;
+	char *data_path;
+	bool is_obs_plugin;
+	bool can_load;
+
+	int code;
+	struct obs_module *module;
+	os_event_t *done;
+};
+
+struct module_jobs {
+	DARRAY(struct module_job) jobs;
+	volatile long next;
+};
+
+static void module_job_found(void *param, const struct obs_module_info2 *info)
+{
+	struct module_job *job = param;
+
+	job->name = bstrdup(info->name);
+	job->bin_path = bstrdup(info->bin_path);
+	job->data_path = bstrdup(info->data_path);
+}
+
+/* everything up to obs_module_load, which has to happen in order */
+static void run_module_job(struct module_job *job)
+{
+	struct obs_module mod = {0};
+	uint64_t start = os_gettime_ns();
+
+	process_found_module(&job->omp, job->path, job->directory,
+			     module_job_found, job);
+	if (!job->name)
+		return;
+
+	get_plugin_info(job->bin_path, &job->is_obs_plugin, &job->can_load);
+
+	if (!OPEN_MODULES_IN_PARALLEL || !job->is_obs_plugin ||
+	    !job->can_load || !is_safe_module(job->name))
+		return;
+
+	job->code = open_module_file(&mod, job->bin_path, job->data_path);
+	if (job->code != MODULE_SUCCESS)
+		return;
+
+	mod.open_ns = os_gettime_ns() - start;
+
+	job->module = bmemdup(&mod, sizeof(mod));
+	mod.set_pointer(job->module);
+	set_module_locale(job->module);
+}
+
+static void *module_job_thread(void *data)
+{
+	struct module_jobs *jobs = data;
+
+	os_set_thread_name("libobs: module loader");
+
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&jobs->next) - 1;
+		if (idx >= jobs->jobs.num)
+			break;
+
+		run_module_job(jobs->jobs.array + idx);
+		os_event_signal(jobs->jobs.array[idx].done);
+	}
+
+	return NULL;
+}
+
+static void find_module_jobs(struct module_jobs *jobs)
+{
+	for (size_t i = 0; i < obs->module_paths.num; i++) {
+		struct obs_module_path *omp = obs->module_paths.array + i;
+		bool search_directories;
+		os_glob_t *gi;
+
+		if (!glob_module_path(omp, &gi, &search_directories))
+			continue;
+
+		for (size_t j = 0; j < gi->gl_pathc; j++) {
+			if (search_directories != gi->gl_pathv[j].directory)
+				continue;
+
+			struct module_job *job = da_push_back_new(jobs->jobs);
+			job->omp = *omp;
+			job->path = bstrdup(gi->gl_pathv[j].path);
+			job->directory = search_directories;
+			os_event_init(&job->done, OS_EVENT_TYPE_MANUAL);
+		}
+
+		os_globfree(gi);
+	}
+}
+
+static void register_module_job(struct module_job *job,
+				 struct fail_info *fail_info)
+{
+	struct obs_module_info2 info;
+	obs_module_t *module = job->module;
+	int code = job->code;
+
+	if (!job->name)
+		return;
+
+	info.bin_path = job->bin_path;
+	info.data_path = job->data_path;
+	info.name = job->name;
+
+	if (!can_open_module(&info, job->is_obs_plugin, job->can_load,
+			     fail_info))
+		return;
+
+	if (OPEN_MODULES_IN_PARALLEL) {
+		blog(LOG_DEBUG, "---------------------------------");
+		if (code == MODULE_SUCCESS)
+			add_module(module);
+	} else {
+		code = obs_open_module(&module, info.bin_path, info.data_path);
+	}
+
+	if (!module_opened(code, &info, fail_info))
+		return;
+
+	if (!obs_init_module(module))
+		free_module(module);
+}
+
+static void free_module_jobs(struct module_jobs *jobs)
+{
+	for (size_t i = 0; i < jobs->jobs.num; i++) {
+		struct module_job *job = jobs->jobs.array + i;
+
+		os_event_destroy(job->done);
+		bfree(job->path);
+		bfree(job->name);
+		bfree(job->bin_path);
+		bfree(job->data_path);
+	}
+
+	da_free(jobs->jobs);
+}
+
+static void load_all_modules_parallel(struct fail_info *fail_info)
+{
+	struct module_jobs jobs = {0};
+	pthread_t threads[MAX_MODULE_THREADS];
+	size_t num_threads = 0;
+	size_t max_threads;
+	uint64_t start = os_gettime_ns();
+
+	find_module_jobs(&jobs);
+
+	/* most of the time is spent waiting on the disk and the dynamic
+	 * loader, so use a few threads even with few cores */
+	max_threads = (size_t)os_get_logical_cores();
+	if (max_threads < MIN_MODULE_THREADS)
+		max_threads = MIN_MODULE_THREADS;
+	if (max_threads > MAX_MODULE_THREADS)
+		max_threads = MAX_MODULE_THREADS;
+	if (max_threads > jobs.jobs.num)
+		max_threads = jobs.jobs.num;
+
+	for (size_t i = 0; i < max_threads; i++) {
+		if (pthread_create(&threads[num_threads], NULL,
+				   module_job_thread, &jobs) == 0)
+			num_threads++;
+	}
+
+	/* modules are registered in the order they were found while the
+	 * threads keep opening the ones after them */
+	for (size_t i = 0; i < jobs.jobs.num; i++) {
+		struct module_job *job = jobs.jobs.array + i;
+
+		if (num_threads)
+			os_event_wait(job->done);
+		else
+			run_module_job(job);
+
+		register_module_job(job, fail_info);
+	}
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	blog(LOG_INFO, "Loaded modules in %.2f ms using %zu threads",
+	     ns_to_ms(os_gettime_ns() - start), num_threads);
+
+	free_module_jobs(&jobs);
+}
+
 void free_module(struct obs_module *mod)
 {
 	if (!mod)
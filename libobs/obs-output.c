@@ -236,14 +236,6 @@ fail:
 	return NULL;
 }
 
-static inline void free_packets(struct obs_output *output)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
-}
-
 static inline void clear_raw_audio_buffers(obs_output_t *output)
 {
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
@@ -284,7 +276,7 @@ void obs_output_destroy(obs_output_t *output)
 		if (output->context.data)
 			output->info.destroy(output->context.data);
 
-		free_packets(output);
+		packet_interleaver_reset(&output->interleaver);
 
 		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
 			if (output->video_encoders[i]) {
@@ -657,22 +649,6 @@ static inline bool pause_can_stop(struct pause_data *pause)
 	return !!pause->ts_start && !pause->ts_end;
 }
 
-static bool get_first_audio_encoder_index(const struct obs_output *output,
-					  size_t *index)
-{
-	if (!index)
-		return false;
-
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		if (output->audio_encoders[i]) {
-			*index = i;
-			return true;
-		}
-	}
-
-	return false;
-}
-
 static bool get_first_video_encoder_index(const struct obs_output *output,
 					  size_t *index)
 {
@@ -1454,63 +1430,6 @@ static size_t get_encoder_index(const struct obs_output *output,
 	return 0;
 }
 
-static inline void check_received(struct obs_output *output,
-				  struct encoder_packet *out)
-{
-	if (out->type == OBS_ENCODER_VIDEO) {
-		if (!output->received_video[out->track_idx])
-			output->received_video[out->track_idx] = true;
-	} else {
-		if (!output->received_audio)
-			output->received_audio = true;
-	}
-}
-
-static inline void apply_interleaved_packet_offset(struct obs_output *output,
-						   struct encoder_packet *out)
-{
-	int64_t offset;
-
-	/* audio and video need to start at timestamp 0, and the encoders
-	 * may not currently be at 0 when we get data.  so, we store the
-	 * current dts as offset and subtract that value from the dts/pts
-	 * of the output packet. */
-	offset = (out->type == OBS_ENCODER_VIDEO)
-			 ? output->video_offsets[out->track_idx]
-			 : output->audio_offsets[out->track_idx];
-
-	out->dts -= offset;
-	out->pts -= offset;
-
-	/* convert the newly adjusted dts to relative dts time to ensure proper
-	 * interleaving.  if we're using an audio encoder that's already been
-	 * started on another output, then the first audio packet may not be
-	 * quite perfectly synced up in terms of system time (and there's
-	 * nothing we can really do about that), but it will always at least be
-	 * within a 23ish millisecond threshold (at least for AAC) */
-	out->dts_usec = packet_dts_usec(out);
-}
-
-static inline bool has_higher_opposing_ts(struct obs_output *output,
-					  struct encoder_packet *packet)
-{
-	bool has_higher = true;
-
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (!output->video_encoders[i] ||
-		    (packet->type == OBS_ENCODER_VIDEO &&
-		     i == packet->track_idx))
-			continue;
-		has_higher = has_higher &&
-			     output->highest_video_ts[i] > packet->dts_usec;
-	}
-
-	return packet->type == OBS_ENCODER_AUDIO
-		       ? has_higher
-		       : (has_higher &&
-			  output->highest_audio_ts > packet->dts_usec);
-}
-
 static size_t extract_itut_t35_buffer_from_sei(sei_t *sei, uint8_t **data_out)
 {
 	if (!sei || !sei->head) {
@@ -1725,16 +1644,11 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet out;
 
-	/* do not send an interleaved packet if there's no packet of the
-	 * opposing type of a higher timestamp in the interleave buffer.
-	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!packet_interleaver_pop(&output->interleaver, &out))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
-
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
 
@@ -1775,384 +1689,6 @@ static inline void send_interleaved(struct obs_output *output)
 	obs_encoder_packet_release(&out);
 }
 
-static inline void set_higher_ts(struct obs_output *output,
-				 struct encoder_packet *packet)
-{
-	if (packet->type == OBS_ENCODER_VIDEO) {
-		if (output->highest_video_ts[packet->track_idx] <
-		    packet->dts_usec)
-			output->highest_video_ts[packet->track_idx] =
-				packet->dts_usec;
-	} else {
-		if (output->highest_audio_ts < packet->dts_usec)
-			output->highest_audio_ts = packet->dts_usec;
-	}
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
-
-/* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
-{
-	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
-	struct encoder_packet *first_video =
-		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
-
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
-		}
-	}
-
-	return video_idx < idx ? video_idx : idx;
-}
-
-static int64_t get_encoder_duration(struct obs_encoder *encoder)
-{
-	return (encoder->timebase_num * 1000000LL / encoder->timebase_den) *
-	       encoder->framesize;
-}
-
-static int prune_premature_packets(struct obs_output *output)
-{
-	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
-	int64_t duration_usec, max_audio_duration_usec = 0;
-	int64_t max_diff = 0;
-	int64_t diff = 0;
-	int audio_encoders = 0;
-
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1)
-		return -1;
-
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
-	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
-
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		struct encoder_packet *audio;
-		int audio_idx;
-		int64_t audio_duration_usec = 0;
-
-		if (!output->audio_encoders[i])
-			continue;
-		audio_encoders++;
-
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
-			output->received_audio = false;
-			return -1;
-		}
-
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
-
-		diff = audio->dts_usec - video->dts_usec;
-		if (diff > max_diff)
-			max_diff = diff;
-
-		audio_duration_usec =
-			get_encoder_duration(output->audio_encoders[i]);
-		if (audio_duration_usec > max_audio_duration_usec)
-			max_audio_duration_usec = audio_duration_usec;
-	}
-
-	/* Once multiple audio encoders are running they are almost always out
-	 * of phase by ~Xms. If users change their video to > 100fps then it
-	 * becomes probable that this phase difference will be larger than the
-	 * video duration preventing us from ever finding a synchronization
-	 * point due to their larger frame duration. Instead give up on a tight
-	 * video sync. */
-	if (audio_encoders > 1 && duration_usec < max_audio_duration_usec) {
-		duration_usec = max_audio_duration_usec;
-	}
-
-	return diff > duration_usec ? max_idx + 1 : 0;
-}
-
-static void discard_to_idx(struct obs_output *output, size_t idx)
-{
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
-
-	da_erase_range(output->interleaved_packets, 0, idx);
-}
-
-#define DEBUG_STARTING_PACKETS 0
-
-static bool prune_interleaved_packets(struct obs_output *output)
-{
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
-
-#if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
-	}
-#endif
-
-	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
-		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
-	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
-
-	return true;
-}
-
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type, size_t idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type && packet->track_idx == idx)
-			return (int)i;
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type, size_t idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type && packet->track_idx == idx)
-			return (int)(i - 1);
-	}
-
-	return -1;
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static bool get_audio_and_video_packets(struct obs_output *output,
-					struct encoder_packet **video,
-					struct encoder_packet **audio)
-{
-	bool found_video = false;
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (output->video_encoders[i]) {
-			video[i] = find_first_packet_type(output,
-							  OBS_ENCODER_VIDEO, i);
-			if (!video[i]) {
-				output->received_video[i] = false;
-				return false;
-			} else {
-				found_video = true;
-			}
-		}
-	}
-
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		if (output->audio_encoders[i]) {
-			audio[i] = find_first_packet_type(output,
-							  OBS_ENCODER_AUDIO, i);
-			if (!audio[i]) {
-				output->received_audio = false;
-				return false;
-			}
-		}
-	}
-
-	return found_video;
-}
-
-static bool initialize_interleaved_packets(struct obs_output *output)
-{
-	struct encoder_packet *video[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
-	struct encoder_packet *audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
-	struct encoder_packet *last_audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
-	size_t start_idx;
-	size_t first_audio_idx;
-	size_t first_video_idx;
-
-	if (!get_first_audio_encoder_index(output, &first_audio_idx))
-		return false;
-	if (!get_first_video_encoder_index(output, &first_video_idx))
-		return false;
-
-	if (!get_audio_and_video_packets(output, video, audio))
-		return false;
-
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		if (output->audio_encoders[i]) {
-			last_audio[i] = find_last_packet_type(
-				output, OBS_ENCODER_AUDIO, i);
-		}
-	}
-
-	/* ensure that there is audio past the first video packet */
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		if (output->audio_encoders[i]) {
-			if (last_audio[i]->dts_usec <
-			    video[first_video_idx]->dts_usec) {
-				output->received_audio = false;
-				return false;
-			}
-		}
-	}
-
-	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
-		if (!get_audio_and_video_packets(output, video, audio))
-			return false;
-	}
-
-	/* get new offsets */
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (output->video_encoders[i]) {
-			output->video_offsets[i] = video[i]->pts;
-		}
-	}
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
-		if (output->audio_encoders[i] && audio[i]->dts > 0) {
-			output->audio_offsets[i] = audio[i]->dts;
-		}
-	}
-#if DEBUG_STARTING_PACKETS == 1
-	int64_t v = video[first_video_idx]->dts_usec;
-	int64_t a = audio[first_audio_idx]->dts_usec;
-	int64_t diff = v - a;
-
-	blog(LOG_DEBUG,
-	     "output '%s' offset for video: %lld, audio: %lld, "
-	     "diff: %lldms",
-	     output->context.name, v, a, diff / 1000LL);
-#endif
-
-	/* subtract offsets from highest TS offset variables */
-	output->highest_audio_ts -= audio[first_audio_idx]->dts_usec;
-
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
-
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		// sort video packets with same DTS by track index,
-		// to prevent the pruning logic from removing additional
-		// video tracks
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO &&
-		    cur_packet->type == OBS_ENCODER_VIDEO &&
-		    out->track_idx > cur_packet->track_idx)
-			continue;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
-	}
-
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++) {
-		set_higher_ts(output, &old_array.array[i]);
-
-		insert_interleaved_packet(output, &old_array.array[i]);
-	}
-
-	da_free(old_array);
-}
-
-static void discard_unused_audio_packets(struct obs_output *output,
-					 int64_t dts_usec)
-{
-	size_t idx = 0;
-
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
-	}
-
-	if (idx)
-		discard_to_idx(output, idx);
-}
-
 static bool purge_encoder_group_keyframe_data(obs_output_t *output, size_t idx)
 {
 	struct keyframe_group_data *data =
@@ -2236,8 +1772,6 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 {
 	struct obs_output *output = data;
 	struct encoder_packet out;
-	bool was_started;
-	bool received_video;
 
 	if (!active(output))
 		return;
@@ -2248,8 +1782,10 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 
 	/* if first video frame is not a keyframe, discard until received */
 	if (packet->type == OBS_ENCODER_VIDEO &&
-	    !output->received_video[packet->track_idx] && !packet->keyframe) {
-		discard_unused_audio_packets(output, packet->dts_usec);
+	    !output->interleaver.received_video[packet->track_idx] &&
+	    !packet->keyframe) {
+		packet_interleaver_discard_before(&output->interleaver,
+						  packet->dts_usec);
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
 		if (output->active_delay_ns)
@@ -2257,52 +1793,15 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 		return;
 	}
 
-	received_video = true;
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (output->video_encoders[i])
-			received_video = received_video &&
-					 output->received_video[i];
-	}
-
 	check_encoder_group_keyframe_alignment(output, packet);
 
-	was_started = output->received_audio && received_video;
-
 	if (output->active_delay_ns)
 		out = *packet;
 	else
 		obs_encoder_packet_create_instance(&out, packet);
 
-	if (was_started)
-		apply_interleaved_packet_offset(output, &out);
-	else
-		check_received(output, packet);
-
-	insert_interleaved_packet(output, &out);
-
-	received_video = true;
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (output->video_encoders[i])
-			received_video = received_video &&
-					 output->received_video[i];
-	}
-
-	/* when both video and audio have been received, we're ready
-	 * to start sending out packets (one at a time) */
-	if (output->received_audio && received_video) {
-		if (!was_started) {
-			if (prune_interleaved_packets(output)) {
-				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
-					send_interleaved(output);
-				}
-			}
-		} else {
-			set_higher_ts(output, &out);
-
-			send_interleaved(output);
-		}
-	}
+	if (packet_interleaver_push(&output->interleaver, &out))
+		send_interleaved(output);
 
 	pthread_mutex_unlock(&output->interleaved_mutex);
 }
@@ -2475,20 +1974,28 @@ static inline void start_raw_audio(obs_output_t *output)
 	}
 }
 
+static int64_t get_encoder_duration(struct obs_encoder *encoder)
+{
+	return (encoder->timebase_num * 1000000LL / encoder->timebase_den) *
+	       encoder->framesize;
+}
+
 static void reset_packet_data(obs_output_t *output)
 {
-	output->received_audio = false;
-	output->highest_audio_ts = 0;
+	struct packet_interleaver *il = &output->interleaver;
 
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		output->received_video[i] = false;
-		output->video_offsets[i] = 0;
-		output->highest_video_ts[i] = INT64_MIN;
-	}
-	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++)
-		output->audio_offsets[i] = 0;
+	packet_interleaver_reset(il);
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++)
+		il->video_tracks[i] = !!output->video_encoders[i];
 
-	free_packets(output);
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		struct obs_encoder *encoder = output->audio_encoders[i];
+
+		il->audio_tracks[i] = !!encoder;
+		il->audio_durations_usec[i] =
+			encoder ? get_encoder_duration(encoder) : 0;
+	}
 }
 
 static inline bool preserve_active(struct obs_output *output)
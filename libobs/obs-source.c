@@ -621,7 +621,7 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		obs_frame_pool_destroy_frame(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -729,7 +729,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	bfree(source->audio_output_buf[0][0]);
 	bfree(source->audio_mix_buf[0]);
 
-	obs_source_frame_destroy(source->async_preload_frame);
+	obs_frame_pool_destroy_frame(source->async_preload_frame);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_free(source);
@@ -982,7 +982,9 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
-		obs_source_dosignal(source, "source_update", "update");
+		obs_source_dosignal_id(source,
+				       &obs->source_signals.source_update,
+				       &obs->source_signals.update);
 	}
 }
 
@@ -1000,7 +1002,9 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
-		obs_source_dosignal(source, "source_update", "update");
+		obs_source_dosignal_id(source,
+				       &obs->source_signals.source_update,
+				       &obs->source_signals.update);
 	}
 }
 
@@ -1217,6 +1221,7 @@ static void filter_frame(obs_source_t *source,
 
 void process_media_actions(obs_source_t *source)
 {
+	const struct obs_source_signal_ids *ids = &obs->source_signals;
 	struct media_action action = {0};
 
 	for (;;) {
@@ -1237,28 +1242,33 @@ void process_media_actions(obs_source_t *source)
 						      action.pause);
 
 			if (action.pause)
-				obs_source_dosignal(source, NULL,
-						    "media_pause");
+				obs_source_dosignal_id(source, NULL,
+						       &ids->media_pause);
 			else
-				obs_source_dosignal(source, NULL, "media_play");
+				obs_source_dosignal_id(source, NULL,
+						       &ids->media_play);
 			break;
 
 		case MEDIA_ACTION_RESTART:
 			source->info.media_restart(source->context.data);
-			obs_source_dosignal(source, NULL, "media_restart");
+			obs_source_dosignal_id(source, NULL,
+					       &ids->media_restart);
 			break;
 
 		case MEDIA_ACTION_STOP:
 			source->info.media_stop(source->context.data);
-			obs_source_dosignal(source, NULL, "media_stopped");
+			obs_source_dosignal_id(source, NULL,
+					       &ids->media_stopped);
 			break;
 		case MEDIA_ACTION_NEXT:
 			source->info.media_next(source->context.data);
-			obs_source_dosignal(source, NULL, "media_next");
+			obs_source_dosignal_id(source, NULL,
+					       &ids->media_next);
 			break;
 		case MEDIA_ACTION_PREVIOUS:
 			source->info.media_previous(source->context.data);
-			obs_source_dosignal(source, NULL, "media_previous");
+			obs_source_dosignal_id(source, NULL,
+					       &ids->media_previous);
 			break;
 		case MEDIA_ACTION_SET_TIME:
 			source->info.media_set_time(source->context.data,
@@ -1268,6 +1278,19 @@ void process_media_actions(obs_source_t *source)
 	}
 }
 
+/* borrowed frames are never reused, so they are given back to their owner as
+ * soon as they're no longer used */
+static void release_borrowed_frames(obs_source_t *source)
+{
+	for (size_t i = source->async_cache.num; i > 0; i--) {
+		struct async_frame *af = &source->async_cache.array[i - 1];
+		if (af->borrowed && !af->used) {
+			obs_source_frame_decref(af->frame);
+			da_erase(source->async_cache, i - 1);
+		}
+	}
+}
+
 static void async_tick(obs_source_t *source)
 {
 	uint64_t sys_time = obs->video.video_time;
@@ -1295,6 +1318,8 @@ static void async_tick(obs_source_t *source)
 		source->async_update_texture =
 			set_async_texture_size(source, source->cur_async_frame);
 
+	release_borrowed_frames(source);
+
 	pthread_mutex_unlock(&source->async_mutex);
 }
 
@@ -3624,7 +3649,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				obs_frame_pool_destroy_frame(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -3632,9 +3657,10 @@ static void clean_cache(obs_source_t *source)
 }
 
 #define MAX_ASYNC_FRAMES 30
-//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
+//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_frame_pool_destroy_frame(output)
 static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+cache_video(struct obs_source *source, const struct obs_source_frame *frame,
+	    obs_source_frame_release_t release, void *param)
 {
 	struct obs_source_frame *new_frame = NULL;
 
@@ -3658,7 +3684,9 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	source->async_cache_full_range = frame->full_range;
 	source->async_cache_trc = frame->trc;
 
-	for (size_t i = 0; i < source->async_cache.num; i++) {
+	release_borrowed_frames(source);
+
+	for (size_t i = 0; !release && i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
 		if (!af->used) {
 			new_frame = af->frame;
@@ -3674,10 +3702,15 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
+		if (release)
+			new_frame = obs_frame_pool_wrap_frame(frame, release,
+							      param);
+		else
+			new_frame = obs_frame_pool_create_frame(
+				format, frame->width, frame->height);
 		new_af.frame = new_frame;
 		new_af.used = true;
+		new_af.borrowed = release != NULL;
 		new_af.unused_count = 0;
 		new_frame->refs = 1;
 
@@ -3688,17 +3721,23 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	pthread_mutex_unlock(&source->async_mutex);
 
-	copy_frame_data(new_frame, frame);
+	if (!release)
+		copy_frame_data(new_frame, frame);
 
 	return new_frame;
 }
 
 static void
 obs_source_output_video_internal(obs_source_t *source,
-				 const struct obs_source_frame *frame)
+				 const struct obs_source_frame *frame,
+				 obs_source_frame_release_t release,
+				 void *param)
 {
-	if (!obs_source_valid(source, "obs_source_output_video"))
+	if (!obs_source_valid(source, "obs_source_output_video")) {
+		if (release)
+			release(param);
 		return;
+	}
 
 	if (!frame) {
 		pthread_mutex_lock(&source->async_mutex);
@@ -3709,13 +3748,19 @@ obs_source_output_video_internal(obs_source_t *source,
 		return;
 	}
 
-	struct obs_source_frame *output = cache_video(source, frame);
+	struct obs_source_frame *output =
+		cache_video(source, frame, release, param);
+
+	if (!output && release) {
+		release(param);
+		return;
+	}
 
 	/* ------------------------------------------- */
 	pthread_mutex_lock(&source->async_mutex);
 	if (output) {
 		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
+			obs_frame_pool_destroy_frame(output);
 			output = NULL;
 		} else {
 			da_push_back(source->async_frames, &output);
@@ -3731,7 +3776,7 @@ void obs_source_output_video(obs_source_t *source,
 	if (destroying(source))
 		return;
 	if (!frame) {
-		obs_source_output_video_internal(source, NULL);
+		obs_source_output_video_internal(source, NULL, NULL, NULL);
 		return;
 	}
 
@@ -3739,7 +3784,7 @@ void obs_source_output_video(obs_source_t *source,
 	new_frame.full_range =
 		format_is_yuv(frame->format) ? new_frame.full_range : true;
 
-	obs_source_output_video_internal(source, &new_frame);
+	obs_source_output_video_internal(source, &new_frame, NULL, NULL);
 }
 
 void obs_source_output_video2(obs_source_t *source,
@@ -3748,7 +3793,7 @@ void obs_source_output_video2(obs_source_t *source,
 	if (destroying(source))
 		return;
 	if (!frame) {
-		obs_source_output_video_internal(source, NULL);
+		obs_source_output_video_internal(source, NULL, NULL, NULL);
 		return;
 	}
 
@@ -3778,7 +3823,28 @@ void obs_source_output_video2(obs_source_t *source,
 	memcpy(&new_frame.color_range_max, &frame->color_range_max,
 	       sizeof(frame->color_range_max));
 
-	obs_source_output_video_internal(source, &new_frame);
+	obs_source_output_video_internal(source, &new_frame, NULL, NULL);
+}
+
+void obs_source_output_video_borrowed(obs_source_t *source,
+				      const struct obs_source_frame *frame,
+				      obs_source_frame_release_t release,
+				      void *param)
+{
+	if (!obs_ptr_valid(frame, "obs_source_output_video_borrowed"))
+		return;
+	if (!obs_ptr_valid(release, "obs_source_output_video_borrowed"))
+		return;
+	if (destroying(source)) {
+		release(param);
+		return;
+	}
+
+	struct obs_source_frame new_frame = *frame;
+	new_frame.full_range =
+		format_is_yuv(frame->format) ? new_frame.full_range : true;
+
+	obs_source_output_video_internal(source, &new_frame, release, param);
 }
 
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
@@ -3857,8 +3923,8 @@ obs_source_preload_video_internal(obs_source_t *source,
 		return;
 
 	if (preload_frame_changed(source, frame)) {
-		obs_source_frame_destroy(source->async_preload_frame);
-		source->async_preload_frame = obs_source_frame_create(
+		obs_frame_pool_destroy_frame(source->async_preload_frame);
+		source->async_preload_frame = obs_frame_pool_create_frame(
 			frame->format, frame->width, frame->height);
 	}
 
@@ -3964,8 +4030,8 @@ obs_source_set_video_frame_internal(obs_source_t *source,
 	obs_enter_graphics();
 
 	if (preload_frame_changed(source, frame)) {
-		obs_source_frame_destroy(source->async_preload_frame);
-		source->async_preload_frame = obs_source_frame_create(
+		obs_frame_pool_destroy_frame(source->async_preload_frame);
+		source->async_preload_frame = obs_frame_pool_create_frame(
 			frame->format, frame->width, frame->height);
 	}
 
@@ -4414,14 +4480,16 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		obs_frame_pool_destroy_frame(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
-		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
-		else
+		if (os_atomic_dec_long(&frame->refs) == 0) {
+			obs_frame_pool_destroy_frame(frame);
+		} else {
 			remove_async_frame(source, frame);
+			release_borrowed_frames(source);
+		}
 
 		pthread_mutex_unlock(&source->async_mutex);
 	}
@@ -4753,10 +4821,12 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
 
-		signal_handler_signal(source->context.signals, "volume", &data);
+		signal_handler_signal_id(source->context.signals,
+					 &obs->source_signals.volume, &data);
 		if (!source->context.private)
-			signal_handler_signal(obs->signals, "source_volume",
-					      &data);
+			signal_handler_signal_id(
+				obs->signals,
+				&obs->source_signals.source_volume, &data);
 
 		volume = (float)calldata_float(&data, "volume");
 
@@ -6214,7 +6284,8 @@ void obs_source_media_started(obs_source_t *source)
 	if ((source->info.output_flags & OBS_SOURCE_CONTROLLABLE_MEDIA) == 0)
 		return;
 
-	obs_source_dosignal(source, NULL, "media_started");
+	obs_source_dosignal_id(source, NULL,
+			       &obs->source_signals.media_started);
 }
 
 void obs_source_media_ended(obs_source_t *source)
@@ -6224,7 +6295,8 @@ void obs_source_media_ended(obs_source_t *source)
 	if ((source->info.output_flags & OBS_SOURCE_CONTROLLABLE_MEDIA) == 0)
 		return;
 
-	obs_source_dosignal(source, NULL, "media_ended");
+	obs_source_dosignal_id(source, NULL,
+			       &obs->source_signals.media_ended);
 }
 
 obs_data_array_t *obs_source_backup_filters(obs_source_t *source)
@@ -81,6 +81,9 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 		obs_source_release(s);
 	}
 
+	/* free frame buffers that haven't been used in a while */
+	obs_frame_pool_tick(cur_time);
+
 	return cur_time;
 }
 
@@ -567,6 +567,9 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	profile_start(shader_comp_name);
 	gs_enter_context(video->graphics);
 
+	if (obs->effect_cache_dir)
+		gs_set_effect_cache_dir(obs->effect_cache_dir);
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
 	bfree(filename);
@@ -710,6 +713,11 @@ static int obs_init_video_mix(struct obs_video_info *ovi,
 		return OBS_VIDEO_FAIL;
 	}
 
+	video_output_set_parallel_delivery(video->video,
+					   obs->video.parallel_delivery);
+	video_output_set_fast_conversion(video->video,
+					 obs->video.fast_conversion);
+
 	if (pthread_mutex_init(&video->gpu_encoder_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
 
@@ -1137,8 +1145,30 @@ static const char *obs_signals[] = {
 	NULL,
 };
 
+#define SOURCE_SIGNAL_ID(name) ids->name = signal_id_create(#name)
+
+static void obs_init_source_signal_ids(struct obs_source_signal_ids *ids)
+{
+	SOURCE_SIGNAL_ID(source_update);
+	SOURCE_SIGNAL_ID(update);
+	SOURCE_SIGNAL_ID(source_volume);
+	SOURCE_SIGNAL_ID(volume);
+	SOURCE_SIGNAL_ID(media_play);
+	SOURCE_SIGNAL_ID(media_pause);
+	SOURCE_SIGNAL_ID(media_restart);
+	SOURCE_SIGNAL_ID(media_stopped);
+	SOURCE_SIGNAL_ID(media_next);
+	SOURCE_SIGNAL_ID(media_previous);
+	SOURCE_SIGNAL_ID(media_started);
+	SOURCE_SIGNAL_ID(media_ended);
+}
+
+#undef SOURCE_SIGNAL_ID
+
 static inline bool obs_init_handlers(void)
 {
+	obs_init_source_signal_ids(&obs->source_signals);
+
 	obs->signals = signal_handler_create();
 	if (!obs->signals)
 		return false;
@@ -1251,6 +1281,7 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	pthread_mutex_init_value(&obs->video.task_mutex);
 	pthread_mutex_init_value(&obs->video.encoder_group_mutex);
 	pthread_mutex_init_value(&obs->video.mixes_mutex);
+	pthread_mutex_init_value(&obs->frame_pool.mutex);
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -1267,6 +1298,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 		return false;
 	if (!obs_init_hotkeys())
 		return false;
+	if (!obs_frame_pool_init(&obs->frame_pool))
+		return false;
 
 	obs->destruction_task_thread = os_task_queue_create();
 	if (!obs->destruction_task_thread)
@@ -1464,7 +1497,10 @@ void obs_shutdown(void)
 	if (obs->name_store_owned)
 		profiler_name_store_free(obs->name_store);
 
+	obs_frame_pool_free(&obs->frame_pool);
+
 	bfree(obs->module_config_path);
+	bfree(obs->effect_cache_dir);
 	bfree(obs->locale);
 	bfree(obs);
 	obs = NULL;
@@ -1513,6 +1549,33 @@ const char *obs_get_locale(void)
 	return obs->locale;
 }
 
+void obs_set_effect_cache_dir(const char *dir)
+{
+	if (!obs)
+		return;
+
+	bfree(obs->effect_cache_dir);
+	obs->effect_cache_dir = bstrdup(dir);
+
+	if (obs->video.graphics) {
+		gs_enter_context(obs->video.graphics);
+		gs_set_effect_cache_dir(dir);
+		gs_leave_context();
+	}
+}
+
+void obs_set_video_parallel_delivery(bool enable)
+{
+	if (obs)
+		obs->video.parallel_delivery = enable;
+}
+
+void obs_set_video_fast_conversion(bool enable)
+{
+	if (obs)
+		obs->video.fast_conversion = enable;
+}
+
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
@@ -2900,7 +2963,7 @@ void obs_context_data_setname_ht(struct obs_context_data *context,
 
 profiler_name_store_t *obs_get_profiler_name_store(void)
 {
-	return obs->name_store;
+	return obs ? obs->name_store : NULL;
 }
 
 uint64_t obs_get_video_frame_time(void)
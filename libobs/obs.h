@@ -418,6 +418,27 @@ EXPORT profiler_name_store_t *obs_get_profiler_name_store(void);
  */
 EXPORT int obs_reset_video(struct obs_video_info *ovi);
 
+/**
+ * Sets the directory parsed effects are cached in, so that effects which have
+ * not changed do not need to be parsed again the next time they are created.
+ * Should be called before obs_reset_video.  NULL disables the cache.
+ */
+EXPORT void obs_set_effect_cache_dir(const char *dir);
+
+/**
+ * Makes raw video outputs deliver frames to each encoder on its own thread,
+ * so that a slow encoder doesn't hold up the others.  Takes effect the next
+ * time obs_reset_video is called.
+ */
+EXPORT void obs_set_video_parallel_delivery(bool enable);
+
+/**
+ * Lets raw video outputs convert BGRA to NV12 and between I010 and P010
+ * without the scaler, at the cost of slightly different chroma filtering.
+ * Takes effect the next time obs_reset_video is called.
+ */
+EXPORT void obs_set_video_fast_conversion(bool enable);
+
 /**
  * Sets base audio output format/channels/samples/etc
  *
@@ -490,6 +511,19 @@ EXPORT const char *obs_module_get_locale_text(const obs_module_t *mod,
 /** Logs loaded modules */
 EXPORT void obs_log_loaded_modules(void);
 
+struct obs_module_load_time {
+	uint64_t open_ns;   /**< discovery, dlopen and exports */
+	uint64_t locale_ns; /**< obs_module_set_locale */
+	uint64_t load_ns;   /**< obs_module_load */
+};
+
+/** Returns how long each stage of loading the module took */
+EXPORT bool obs_get_module_load_time(obs_module_t *module,
+				     struct obs_module_load_time *time);
+
+/** Logs how long each loaded module took to load, slowest first */
+EXPORT void obs_log_module_load_times(void);
+
 /** Returns the module file name */
 EXPORT const char *obs_get_module_file_name(obs_module_t *module);
 
@@ -527,6 +561,13 @@ EXPORT void obs_add_module_path(const char *bin, const char *data);
  */
 EXPORT void obs_add_safe_module(const char *name);
 
+/**
+ * Makes obs_load_all_modules find, open and load the locale of modules on a
+ * pool of threads.  obs_module_load is still called on the calling thread,
+ * in the same order as when loading them one after another.
+ */
+EXPORT void obs_set_parallel_module_loading(bool enable);
+
 /** Automatically loads all modules from module paths (convenience function) */
 EXPORT void obs_load_all_modules(void);
 
@@ -1443,6 +1484,27 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+typedef void (*obs_source_frame_release_t)(void *param);
+
+/**
+ * Outputs asynchronous video data without copying it.  The frame's data must
+ * stay valid until release is called, which happens once the frame has been
+ * uploaded or dropped.  release is always called exactly once, even if the
+ * frame could not be queued.
+ *
+ * release may be called from any thread, including from within this function,
+ * and possibly after the source has been destroyed, so it must not rely on the
+ * source's data or call back into the source.
+ *
+ * NOTE: Non-YUV formats will always be treated as full range with this
+ * function, as with obs_source_output_video.
+ */
+EXPORT void
+obs_source_output_video_borrowed(obs_source_t *source,
+				 const struct obs_source_frame *frame,
+				 obs_source_frame_release_t release,
+				 void *param);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -2770,6 +2832,32 @@ static inline void obs_source_frame_destroy(struct obs_source_frame *frame)
 EXPORT void obs_source_frame_copy(struct obs_source_frame *dst,
 				  const struct obs_source_frame *src);
 
+/* ------------------------------------------------------------------------- */
+/* Async frame pool
+ *
+ *   Frames output by async sources are copied into buffers from a pool shared
+ * by all sources, which are kept around after use so that changes in
+ * resolution or format do not cause large allocations every time. */
+
+struct obs_frame_pool_stats {
+	uint64_t allocations;    /**< Frame buffers requested */
+	uint64_t hits;           /**< Requests served by an idle buffer */
+	uint64_t resident_bytes; /**< Size of all buffers, in use or idle */
+	uint64_t idle_bytes;     /**< Size of idle buffers */
+	uint64_t trimmed_bytes;  /**< Size of idle buffers freed so far */
+};
+
+EXPORT void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats);
+
+/** Sets how many bytes of idle buffers are kept, freeing the oldest first */
+EXPORT void obs_set_frame_pool_limit(uint64_t max_idle_bytes);
+
+/** Requests transparent huge pages for large frame buffers where supported */
+EXPORT void obs_set_frame_pool_hugepages(bool enable);
+
+/** Frees all idle buffers, for example when the system is low on memory */
+EXPORT void obs_frame_pool_trim(void);
+
 /* ------------------------------------------------------------------------- */
 /* Get source icon type */
 EXPORT enum obs_icon_type obs_source_get_icon_type(const char *id);
@@ -23,6 +23,20 @@
 #include "deque.h"
 #include "dstr.h"
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 static const size_t DEFAULT_BUF_SIZE = 256ULL * 1048576ULL; // 256 MiB
 static const size_t DEFAULT_CHUNK_SIZE = 1048576;           // 1 MiB
 
@@ -34,6 +48,20 @@ struct io_header {
 	uint64_t data_length;
 };
 
+#ifdef HAVE_IO_URING
+#define URING_CHUNKS 4
+
+struct file_output_data;
+
+struct uring_chunk {
+	struct file_output_data *out;
+	unsigned char *data;
+	struct iovec iov;
+	uint64_t offset;
+	bool busy;
+};
+#endif
+
 struct io_buffer {
 	bool active;
 	bool shutdown_requested;
@@ -48,6 +76,15 @@ struct io_buffer {
 
 	size_t buffer_size;
 	size_t chunk_size;
+
+#ifdef HAVE_IO_URING
+	/* chunks are written asynchronously through the shared io_uring
+	 * instead of with fwrite, with up to URING_CHUNKS in flight */
+	bool uring;
+	struct uring_chunk chunks[URING_CHUNKS];
+	long in_flight;
+	os_event_t *write_done_event;
+#endif
 };
 
 struct file_output_data {
@@ -55,6 +92,378 @@ struct file_output_data {
 	struct io_buffer io;
 };
 
+#ifdef HAVE_IO_URING
+/* ========================================================================== */
+/* Shared io_uring used by all open files, with a single completion thread    */
+
+/* URING_MAX_FILES * URING_CHUNKS writes in flight at most, which keeps the
+ * completion queue (twice the size of the submission queue) from ever
+ * overflowing */
+#define URING_ENTRIES 64
+#define URING_MAX_FILES 16
+
+static struct {
+	int fd;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+
+	pthread_t thread;
+	pthread_mutex_t submit_mutex;
+	long refs;
+	bool unavailable;
+	bool disabled;
+} uring = {.fd = -1};
+
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool uring_submit(struct uring_chunk *chunk)
+{
+	int ret;
+
+	pthread_mutex_lock(&uring.submit_mutex);
+
+	unsigned tail = *uring.sq_tail;
+	unsigned idx = tail & *uring.sq_mask;
+	struct io_uring_sqe *sqe = &uring.sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	if (chunk) {
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->fd = fileno(chunk->out->io.output_file);
+		sqe->addr = (uintptr_t)&chunk->iov;
+		sqe->len = 1;
+		sqe->off = chunk->offset;
+	} else {
+		/* wakes up the completion thread to exit */
+		sqe->opcode = IORING_OP_NOP;
+	}
+	sqe->user_data = (uintptr_t)chunk;
+
+	uring.sq_array[idx] = idx;
+	__atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	for (;;) {
+		ret = (int)syscall(__NR_io_uring_enter, uring.fd, 1, 0, 0, NULL,
+				   0);
+		if (ret >= 0 || (errno != EINTR && errno != EAGAIN))
+			break;
+
+		os_sleep_ms(1);
+	}
+
+	pthread_mutex_unlock(&uring.submit_mutex);
+	return ret == 1;
+}
+
+static void uring_chunk_done(struct uring_chunk *chunk, int res)
+{
+	struct file_output_data *out = chunk->out;
+
+	if (res > 0 && (size_t)res < chunk->iov.iov_len) {
+		/* short write, send the rest */
+		chunk->iov.iov_base = (uint8_t *)chunk->iov.iov_base + res;
+		chunk->iov.iov_len -= res;
+		chunk->offset += res;
+		if (uring_submit(chunk))
+			return;
+		res = -EIO;
+	}
+
+	if (res <= 0) {
+		blog(LOG_ERROR, "Error writing to '%s': %s",
+		     out->filename.array, strerror(res ? -res : EIO));
+		os_atomic_set_bool(&out->io.output_error, true);
+	}
+
+	pthread_mutex_lock(&out->io.data_mutex);
+	chunk->busy = false;
+	out->io.in_flight--;
+	os_event_signal(out->io.write_done_event);
+	pthread_mutex_unlock(&out->io.data_mutex);
+}
+
+static void *uring_thread(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	os_set_thread_name("buffered writer completion thread");
+
+	for (;;) {
+		unsigned head = *uring.cq_head;
+
+		if (head == __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE)) {
+			syscall(__NR_io_uring_enter, uring.fd, 0, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+			continue;
+		}
+
+		struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+		struct uring_chunk *chunk =
+			(struct uring_chunk *)(uintptr_t)cqe->user_data;
+		int res = cqe->res;
+
+		__atomic_store_n(uring.cq_head, head + 1, __ATOMIC_RELEASE);
+
+		if (!chunk)
+			break;
+
+		uring_chunk_done(chunk, res);
+	}
+
+	return NULL;
+}
+
+static void uring_unmap(void)
+{
+	if (uring.sqes)
+		munmap(uring.sqes, uring.sqes_size);
+	if (uring.cq_ptr && uring.cq_ptr != uring.sq_ptr)
+		munmap(uring.cq_ptr, uring.cq_size);
+	if (uring.sq_ptr)
+		munmap(uring.sq_ptr, uring.sq_size);
+	if (uring.fd != -1)
+		close(uring.fd);
+
+	uring.sqes = NULL;
+	uring.cq_ptr = NULL;
+	uring.sq_ptr = NULL;
+	uring.fd = -1;
+}
+
+static bool uring_init(void)
+{
+	struct io_uring_params p = {0};
+
+	uring.fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if (uring.fd < 0) {
+		blog(LOG_INFO, "io_uring not available (%s), using "
+			       "synchronous file writes",
+		     strerror(errno));
+		uring.fd = -1;
+		return false;
+	}
+
+	uring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	uring.cq_size = p.cq_off.cqes +
+			p.cq_entries * sizeof(struct io_uring_cqe);
+	uring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap) {
+		if (uring.cq_size > uring.sq_size)
+			uring.sq_size = uring.cq_size;
+		uring.cq_size = uring.sq_size;
+	}
+
+	uring.sq_ptr = mmap(NULL, uring.sq_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, uring.fd,
+			    IORING_OFF_SQ_RING);
+	if (uring.sq_ptr == MAP_FAILED) {
+		uring.sq_ptr = NULL;
+		goto fail;
+	}
+
+	if (single_mmap) {
+		uring.cq_ptr = uring.sq_ptr;
+	} else {
+		uring.cq_ptr = mmap(NULL, uring.cq_size,
+				    PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, uring.fd,
+				    IORING_OFF_CQ_RING);
+		if (uring.cq_ptr == MAP_FAILED) {
+			uring.cq_ptr = NULL;
+			goto fail;
+		}
+	}
+
+	uring.sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, uring.fd,
+			  IORING_OFF_SQES);
+	if (uring.sqes == MAP_FAILED) {
+		uring.sqes = NULL;
+		goto fail;
+	}
+
+	uint8_t *sq = uring.sq_ptr;
+	uint8_t *cq = uring.cq_ptr;
+	uring.sq_head = (unsigned *)(sq + p.sq_off.head);
+	uring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	uring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	uring.sq_array = (unsigned *)(sq + p.sq_off.array);
+	uring.cq_head = (unsigned *)(cq + p.cq_off.head);
+	uring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	uring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	pthread_mutex_init(&uring.submit_mutex, NULL);
+	if (pthread_create(&uring.thread, NULL, uring_thread, NULL) != 0) {
+		pthread_mutex_destroy(&uring.submit_mutex);
+		goto fail;
+	}
+
+	return true;
+
+fail:
+	blog(LOG_WARNING, "Failed to set up io_uring, using synchronous "
+			  "file writes");
+	uring_unmap();
+	return false;
+}
+
+static bool uring_acquire(void)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&uring_mutex);
+
+	if (uring.unavailable || uring.disabled ||
+	    uring.refs >= URING_MAX_FILES)
+		goto exit;
+
+	if (!uring.refs && !uring_init()) {
+		/* don't retry for every file */
+		uring.unavailable = true;
+		goto exit;
+	}
+
+	uring.refs++;
+	success = true;
+
+exit:
+	pthread_mutex_unlock(&uring_mutex);
+	return success;
+}
+
+static void uring_release(void)
+{
+	pthread_mutex_lock(&uring_mutex);
+
+	if (--uring.refs == 0) {
+		if (uring_submit(NULL))
+			pthread_join(uring.thread, NULL);
+		else
+			pthread_cancel(uring.thread);
+
+		pthread_mutex_destroy(&uring.submit_mutex);
+		uring_unmap();
+	}
+
+	pthread_mutex_unlock(&uring_mutex);
+}
+
+/* Waits until no more than max_in_flight chunks of this file are being
+ * written */
+static void uring_wait(struct file_output_data *out, long max_in_flight)
+{
+	pthread_mutex_lock(&out->io.data_mutex);
+	while (out->io.in_flight > max_in_flight) {
+		pthread_mutex_unlock(&out->io.data_mutex);
+		os_event_wait(out->io.write_done_event);
+		pthread_mutex_lock(&out->io.data_mutex);
+	}
+	pthread_mutex_unlock(&out->io.data_mutex);
+}
+
+/* Queues a chunk for writing and returns a free chunk to fill next */
+static unsigned char *uring_write_chunk(struct file_output_data *out,
+					unsigned char *data, size_t size,
+					uint64_t offset, bool drain)
+{
+	struct uring_chunk *chunk = NULL;
+
+	for (size_t i = 0; i < URING_CHUNKS; i++) {
+		if (out->io.chunks[i].data == data) {
+			chunk = &out->io.chunks[i];
+			break;
+		}
+	}
+
+	/* writes can complete in any order, so anything that may overlap
+	 * with earlier data (i.e. after a seek) has to wait for those */
+	if (drain)
+		uring_wait(out, 0);
+
+	chunk->iov.iov_base = data;
+	chunk->iov.iov_len = size;
+	chunk->offset = offset;
+
+	pthread_mutex_lock(&out->io.data_mutex);
+	chunk->busy = true;
+	out->io.in_flight++;
+	pthread_mutex_unlock(&out->io.data_mutex);
+
+	if (!uring_submit(chunk)) {
+		blog(LOG_ERROR, "Error queuing write to '%s': %s",
+		     out->filename.array, strerror(errno));
+		os_atomic_set_bool(&out->io.output_error, true);
+
+		pthread_mutex_lock(&out->io.data_mutex);
+		chunk->busy = false;
+		out->io.in_flight--;
+		pthread_mutex_unlock(&out->io.data_mutex);
+		return NULL;
+	}
+
+	uring_wait(out, URING_CHUNKS - 1);
+
+	if (os_atomic_load_bool(&out->io.output_error))
+		return NULL;
+
+	pthread_mutex_lock(&out->io.data_mutex);
+	for (size_t i = 0; i < URING_CHUNKS; i++) {
+		if (!out->io.chunks[i].busy) {
+			chunk = &out->io.chunks[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&out->io.data_mutex);
+
+	return chunk->data;
+}
+
+static bool uring_file_init(struct file_output_data *out)
+{
+	if (!uring_acquire())
+		return false;
+
+	for (size_t i = 0; i < URING_CHUNKS; i++) {
+		out->io.chunks[i].out = out;
+		out->io.chunks[i].data = bmalloc(out->io.chunk_size);
+	}
+
+	os_event_init(&out->io.write_done_event, OS_EVENT_TYPE_AUTO);
+	out->io.uring = true;
+	return true;
+}
+
+static void uring_file_free(struct file_output_data *out)
+{
+	if (!out->io.uring)
+		return;
+
+	uring_wait(out, 0);
+	uring_release();
+
+	for (size_t i = 0; i < URING_CHUNKS; i++)
+		bfree(out->io.chunks[i].data);
+
+	os_event_destroy(out->io.write_done_event);
+	out->io.uring = false;
+}
+#endif
+
 static void *io_thread(void *opaque)
 {
 	struct file_output_data *out = opaque;
@@ -64,7 +473,13 @@ static void *io_thread(void *opaque)
 	size_t chunk_used = 0;
 	size_t chunk_size = out->io.chunk_size;
 
-	unsigned char *chunk = bmalloc(chunk_size);
+	unsigned char *chunk;
+#ifdef HAVE_IO_URING
+	if (out->io.uring)
+		chunk = out->io.chunks[0].data;
+	else
+#endif
+		chunk = bmalloc(chunk_size);
 	if (!chunk) {
 		os_atomic_set_bool(&out->io.output_error, true);
 		fprintf(stderr, "Error allocating memory for output\n");
@@ -82,6 +497,10 @@ static void *io_thread(void *opaque)
 	uint64_t current_seek_position = 0;
 	uint64_t next_seek_position;
 
+	// File offset of the start of the current chunk
+	uint64_t write_position = 0;
+	bool drain = false;
+
 	for (;;) {
 		// Wait for data to be written to the buffer
 		os_event_wait(out->io.new_data_available_event);
@@ -171,8 +590,15 @@ static void *io_thread(void *opaque)
 
 			// Seek if we need to
 			if (want_seek) {
-				os_fseeki64(out->io.output_file,
-					    next_seek_position, SEEK_SET);
+#ifdef HAVE_IO_URING
+				if (!out->io.uring)
+#endif
+					os_fseeki64(out->io.output_file,
+						    next_seek_position,
+						    SEEK_SET);
+
+				write_position = next_seek_position;
+				drain = true;
 
 				// Update the next virtual position, making sure to take
 				// into account the size of the chunk we're about to write.
@@ -189,6 +615,24 @@ static void *io_thread(void *opaque)
 				}
 			}
 
+#ifdef HAVE_IO_URING
+			// Queue the current chunk and continue with another
+			if (out->io.uring) {
+				chunk = uring_write_chunk(out, chunk,
+							  chunk_used,
+							  write_position,
+							  drain);
+				if (!chunk)
+					goto error;
+
+				write_position += chunk_used;
+				chunk_used = 0;
+				force_flush_chunk = false;
+				drain = false;
+				continue;
+			}
+#endif
+
 			// Write the current chunk to the output file
 			size_t bytes_written = fwrite(chunk, 1, chunk_used,
 						      out->io.output_file);
@@ -202,8 +646,10 @@ static void *io_thread(void *opaque)
 				goto error;
 			}
 
+			write_position += chunk_used;
 			chunk_used = 0;
 			force_flush_chunk = false;
+			drain = false;
 		}
 
 		// If this was the last chunk, time to exit
@@ -212,7 +658,11 @@ static void *io_thread(void *opaque)
 	}
 
 error:
-	if (chunk)
+#ifdef HAVE_IO_URING
+	if (out->io.uring)
+		uring_file_free(out);
+	else
+#endif
 		bfree(chunk);
 
 	fclose(out->io.output_file);
@@ -366,6 +816,10 @@ bool buffered_file_serializer_init(struct serializer *s, const char *path,
 
 	pthread_mutex_init(&out->io.data_mutex, NULL);
 
+#ifdef HAVE_IO_URING
+	uring_file_init(out);
+#endif
+
 	os_event_init(&out->io.buffer_space_available_event,
 		      OS_EVENT_TYPE_AUTO);
 	os_event_init(&out->io.new_data_available_event, OS_EVENT_TYPE_AUTO);
@@ -382,6 +836,17 @@ bool buffered_file_serializer_init(struct serializer *s, const char *path,
 	return true;
 }
 
+void buffered_file_serializer_set_io_uring(bool enable)
+{
+#ifdef HAVE_IO_URING
+	pthread_mutex_lock(&uring_mutex);
+	uring.disabled = !enable;
+	pthread_mutex_unlock(&uring_mutex);
+#else
+	UNUSED_PARAMETER(enable);
+#endif
+}
+
 void buffered_file_serializer_free(struct serializer *s)
 {
 	struct file_output_data *out = s->data;
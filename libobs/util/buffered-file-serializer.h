@@ -29,6 +29,11 @@ EXPORT bool buffered_file_serializer_init(struct serializer *s,
 					  size_t chunk_size);
 EXPORT void buffered_file_serializer_free(struct serializer *s);
 
+/* Whether files opened from now on may be written through io_uring where
+ * it is available (Linux), enabled by default.  Files that are already
+ * open keep their backend. */
+EXPORT void buffered_file_serializer_set_io_uring(bool enable);
+
 #ifdef __cplusplus
 }
 #endif
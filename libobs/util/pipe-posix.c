@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <errno.h>
 #include <spawn.h>
@@ -210,3 +211,59 @@ size_t os_process_pipe_write(os_process_pipe_t *pp, const uint8_t *data,
 	}
 	return written;
 }
+
+#define PIPE_MAX_IOV 64
+
+size_t os_process_pipe_writev(os_process_pipe_t *pp,
+			      const struct os_process_pipe_buf *bufs,
+			      size_t count)
+{
+	struct iovec iov[PIPE_MAX_IOV];
+	size_t written = 0;
+	size_t offset = 0;
+	size_t idx = 0;
+	int fd;
+
+	if (!pp) {
+		return 0;
+	}
+	if (pp->read_pipe) {
+		return 0;
+	}
+
+	/* anything written with os_process_pipe_write may still be sitting
+	 * in the stdio buffer */
+	if (fflush(pp->file) != 0)
+		return 0;
+
+	fd = fileno(pp->file);
+
+	while (idx < count) {
+		int num = 0;
+
+		for (size_t i = idx; i < count && num < PIPE_MAX_IOV; i++) {
+			size_t skip = i == idx ? offset : 0;
+			iov[num].iov_base = (void *)(bufs[i].data + skip);
+			iov[num].iov_len = bufs[i].len - skip;
+			num++;
+		}
+
+		ssize_t ret = writev(fd, iov, num);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+
+		written += (size_t)ret;
+
+		size_t left = (size_t)ret;
+		while (idx < count && left >= bufs[idx].len - offset) {
+			left -= bufs[idx].len - offset;
+			offset = 0;
+			idx++;
+		}
+		offset += left;
+	}
+
+	return written;
+}
@@ -291,3 +291,37 @@ size_t os_process_pipe_write(os_process_pipe_t *pp, const uint8_t *data,
 
 	return 0;
 }
+
+size_t os_process_pipe_writev(os_process_pipe_t *pp,
+			      const struct os_process_pipe_buf *bufs,
+			      size_t count)
+{
+	size_t written = 0;
+
+	if (!pp) {
+		return 0;
+	}
+	if (pp->read_pipe) {
+		return 0;
+	}
+
+	/* anonymous pipes have no gather write, write each buffer in turn */
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t *data = bufs[i].data;
+		size_t len = bufs[i].len;
+
+		while (len) {
+			DWORD bytes_written;
+			if (!WriteFile(pp->handle, data, (DWORD)len,
+				       &bytes_written, NULL) ||
+			    !bytes_written)
+				return written;
+
+			data += bytes_written;
+			len -= bytes_written;
+			written += bytes_written;
+		}
+	}
+
+	return written;
+}
@@ -28,6 +28,11 @@ typedef struct os_process_pipe os_process_pipe_t;
 struct os_process_args;
 typedef struct os_process_args os_process_args_t;
 
+struct os_process_pipe_buf {
+	const uint8_t *data;
+	size_t len;
+};
+
 EXPORT os_process_pipe_t *os_process_pipe_create(const char *cmd_line,
 						 const char *type);
 EXPORT os_process_pipe_t *os_process_pipe_create2(const os_process_args_t *args,
@@ -41,6 +46,12 @@ EXPORT size_t os_process_pipe_read_err(os_process_pipe_t *pp, uint8_t *data,
 EXPORT size_t os_process_pipe_write(os_process_pipe_t *pp, const uint8_t *data,
 				    size_t len);
 
+/* Writes several buffers in order with as few system calls as possible.
+ * Returns the total number of bytes written. */
+EXPORT size_t os_process_pipe_writev(os_process_pipe_t *pp,
+				     const struct os_process_pipe_buf *bufs,
+				     size_t count);
+
 EXPORT struct os_process_args *os_process_args_create(const char *executable);
 EXPORT void os_process_args_add_arg(struct os_process_args *args,
 				    const char *arg);
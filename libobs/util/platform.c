@@ -28,6 +28,14 @@
 #include "dstr.h"
 #include "obs.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+#define OS_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -808,3 +816,45 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#if defined(OS_CPU_X86) && defined(_MSC_VER)
+static bool os_cpu_avx_state_enabled(void)
+{
+	int info[4];
+
+	__cpuid(info, 1);
+
+	/* AVX and OSXSAVE, with the OS saving XMM and YMM state */
+	if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 27)) == 0)
+		return false;
+	return (_xgetbv(0) & 6) == 6;
+}
+#endif
+
+bool os_cpu_has_avx(void)
+{
+#if defined(OS_CPU_X86) && defined(_MSC_VER)
+	return os_cpu_avx_state_enabled();
+#elif defined(OS_CPU_X86)
+	return __builtin_cpu_supports("avx");
+#else
+	return false;
+#endif
+}
+
+bool os_cpu_has_avx2(void)
+{
+#if defined(OS_CPU_X86) && defined(_MSC_VER)
+	int info[4];
+
+	if (!os_cpu_avx_state_enabled())
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(OS_CPU_X86)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
@@ -188,6 +188,10 @@ EXPORT void os_breakpoint(void);
 EXPORT int os_get_physical_cores(void);
 EXPORT int os_get_logical_cores(void);
 
+/* runtime CPU instruction set checks, always false on non-x86 CPUs */
+EXPORT bool os_cpu_has_avx(void);
+EXPORT bool os_cpu_has_avx2(void);
+
 EXPORT uint64_t os_get_sys_free_size(void);
 EXPORT uint64_t os_get_sys_total_size(void);
 
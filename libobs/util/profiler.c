@@ -10,10 +10,17 @@
 
 #include <zlib.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 //#define TRACK_OVERHEAD
 
 struct profiler_snapshot {
 	DARRAY(profiler_snapshot_entry_t) roots;
+	bool delta;
 };
 
 struct profiler_snapshot_entry {
@@ -78,12 +85,12 @@ struct profile_entry {
 	DARRAY(profile_entry) children;
 };
 
+typedef DARRAY(profile_entry) profile_entries_t;
+
 typedef struct profile_root_entry profile_root_entry;
 struct profile_root_entry {
-	pthread_mutex_t *mutex;
 	const char *name;
-	profile_entry *entry;
-	profile_call *prev_call;
+	uint64_t expected_time_between_calls;
 };
 
 static inline uint64_t diff_ns_to_usec(uint64_t prev, uint64_t next)
@@ -228,20 +235,12 @@ static profile_entry *get_child(profile_entry *parent, const char *name)
 	return init_entry(da_push_back_new(parent->children), name);
 }
 
-static void merge_call(profile_entry *entry, profile_call *call,
-		       profile_call *prev_call)
+static void merge_call(profile_entry *entry, profile_call *call)
 {
 	const size_t num = call->children.num;
 	for (size_t i = 0; i < num; i++) {
 		profile_call *child = &call->children.array[i];
-		merge_call(get_child(entry, child->name), child, NULL);
-	}
-
-	if (entry->expected_time_between_calls != 0 && prev_call) {
-		migrate_old_entries(&entry->times_between_calls, true);
-		uint64_t usec = diff_ns_to_usec(prev_call->start_time,
-						call->start_time);
-		add_hashmap_entry(&entry->times_between_calls, usec, 1);
+		merge_call(get_child(entry, child->name), child);
 	}
 
 	migrate_old_entries(&entry->times, true);
@@ -256,115 +255,409 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
-static bool enabled = false;
+static volatile bool enabled = false;
+
+/* roots registered with profile_register_root */
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
-void profiler_start(void)
+/* the per-thread trace buffers and live trees are handed back when their
+ * thread exits, the destructors only get a non-NULL marker and look at the
+ * exiting thread's own thread locals */
+static pthread_once_t exit_keys_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_exit_key;
+static pthread_key_t live_exit_key;
+
+static void trace_thread_exit(void *unused);
+static void live_thread_exit(void *unused);
+
+static void create_exit_keys(void)
 {
-	pthread_mutex_lock(&root_mutex);
-	enabled = true;
-	pthread_mutex_unlock(&root_mutex);
+	pthread_key_create(&trace_exit_key, trace_thread_exit);
+	pthread_key_create(&live_exit_key, live_thread_exit);
 }
 
-void profiler_stop(void)
+/* ------------------------------------------------------------------------- */
+/* Event tracing */
+
+enum trace_event_type {
+	TRACE_BEGIN,
+	TRACE_END,
+};
+
+struct trace_event {
+	const char *name;
+	uint64_t time;
+	enum trace_event_type type;
+};
+
+#define TRACE_THREAD_NAME_LEN 64
+
+/* Single writer ring per thread; the writer publishes pos after storing an
+ * event, readers discard anything that may have been overwritten while they
+ * were copying.  Once its thread has exited, a buffer is still exported
+ * until another thread takes it over, so there are never more buffers than
+ * threads that were tracing at the same time */
+struct trace_buffer {
+	long id;
+	char thread_name[TRACE_THREAD_NAME_LEN];
+	size_t capacity;
+	volatile long pos;
+	struct trace_event *events;
+	bool exited;
+};
+
+static volatile bool trace_enabled = false;
+static volatile long trace_generation = 0;
+static size_t trace_capacity = 0;
+static long trace_next_id = 0;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct trace_buffer *) trace_buffers;
+
+static THREAD_LOCAL struct trace_buffer *thread_trace = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+static THREAD_LOCAL char thread_name[TRACE_THREAD_NAME_LEN] = {0};
+
+static struct trace_buffer *get_thread_trace(const char *name)
 {
-	pthread_mutex_lock(&root_mutex);
-	enabled = false;
-	pthread_mutex_unlock(&root_mutex);
+	long generation = os_atomic_load_long(&trace_generation);
+
+	if (thread_trace && thread_trace_generation == generation)
+		return thread_trace;
+
+	struct trace_buffer *buf = NULL;
+
+	pthread_once(&exit_keys_once, create_exit_keys);
+
+	pthread_mutex_lock(&trace_mutex);
+	if (trace_capacity) {
+		for (size_t i = 0; i < trace_buffers.num; i++) {
+			if (trace_buffers.array[i]->exited) {
+				buf = trace_buffers.array[i];
+				break;
+			}
+		}
+
+		if (!buf) {
+			buf = bzalloc(sizeof(*buf));
+			buf->capacity = trace_capacity;
+			buf->events = bmalloc(sizeof(struct trace_event) *
+					      trace_capacity);
+			da_push_back(trace_buffers, &buf);
+		}
+
+		buf->id = ++trace_next_id;
+		buf->pos = 0;
+		buf->exited = false;
+		/* otherwise the first root profiled on a thread usually
+		 * identifies it, e.g. obs_graphics_thread */
+		snprintf(buf->thread_name, sizeof(buf->thread_name), "%s",
+			 *thread_name ? thread_name : (name ? name : ""));
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	thread_trace = buf;
+	thread_trace_generation = generation;
+	if (buf)
+		pthread_setspecific(trace_exit_key, buf);
+	return buf;
 }
 
-void profile_reenable_thread(void)
+static void trace_thread_exit(void *unused)
 {
-	if (thread_enabled)
+	UNUSED_PARAMETER(unused);
+
+	/* the buffer is gone if the generation changed */
+	pthread_mutex_lock(&trace_mutex);
+	if (thread_trace &&
+	    thread_trace_generation == os_atomic_load_long(&trace_generation))
+		thread_trace->exited = true;
+	pthread_mutex_unlock(&trace_mutex);
+
+	thread_trace = NULL;
+}
+
+static inline void trace_event(const char *name, uint64_t time,
+			       enum trace_event_type type)
+{
+	struct trace_buffer *buf = get_thread_trace(name);
+	if (!buf)
 		return;
 
-	pthread_mutex_lock(&root_mutex);
-	thread_enabled = enabled;
-	pthread_mutex_unlock(&root_mutex);
+	long pos = buf->pos;
+	struct trace_event *event = &buf->events[(size_t)pos % buf->capacity];
+	event->name = name;
+	event->time = time;
+	event->type = type;
+	os_atomic_set_long(&buf->pos, pos + 1);
 }
 
-static bool lock_root(void)
+void profiler_name_thread(const char *name)
 {
-	pthread_mutex_lock(&root_mutex);
-	if (!enabled) {
-		pthread_mutex_unlock(&root_mutex);
-		thread_enabled = false;
-		return false;
-	}
+	snprintf(thread_name, sizeof(thread_name), "%s", name ? name : "");
 
-	return true;
+	if (!thread_trace)
+		return;
+
+	/* the buffer may already have been freed if the generation changed,
+	 * which only happens with trace_mutex held */
+	pthread_mutex_lock(&trace_mutex);
+	if (thread_trace_generation == os_atomic_load_long(&trace_generation))
+		memcpy(thread_trace->thread_name, thread_name,
+		       sizeof(thread_name));
+	pthread_mutex_unlock(&trace_mutex);
 }
 
-static profile_root_entry *get_root_entry(const char *name)
+void profiler_trace_start(size_t max_events_per_thread)
 {
-	profile_root_entry *r_entry = NULL;
+	pthread_mutex_lock(&trace_mutex);
+	if (!trace_capacity)
+		trace_capacity = max_events_per_thread
+					 ? max_events_per_thread
+					 : 16384;
+	pthread_mutex_unlock(&trace_mutex);
+
+	os_atomic_set_bool(&trace_enabled, true);
+}
 
-	for (size_t i = 0; i < root_entries.num; i++) {
-		if (root_entries.array[i].name == name) {
-			r_entry = &root_entries.array[i];
+void profiler_trace_stop(void)
+{
+	os_atomic_set_bool(&trace_enabled, false);
+}
+
+static void trace_buffers_free(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+	os_atomic_set_bool(&trace_enabled, false);
+	os_atomic_inc_long(&trace_generation);
+
+	for (size_t i = 0; i < trace_buffers.num; i++) {
+		bfree(trace_buffers.array[i]->events);
+		bfree(trace_buffers.array[i]);
+	}
+	da_free(trace_buffers);
+	trace_capacity = 0;
+	trace_next_id = 0;
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Live statistics */
+
+/* Completed root calls are merged into trees owned by the thread that made
+ * them, which is the only place data is collected.  Snapshots swap those
+ * trees out and merge them into the totals, so profile_end never blocks on
+ * anything other than that thread's own (normally uncontended) mutex.
+ * Trees of threads that have exited are freed by the next snapshot, or
+ * taken over by the next new thread if that comes first */
+struct live_root {
+	profile_entry entry;
+	uint64_t prev_start;
+};
+
+struct live_thread {
+	pthread_mutex_t mutex;
+	DARRAY(struct live_root) roots;
+	bool exited;
+};
+
+static volatile long live_generation = 0;
+static pthread_mutex_t live_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct live_thread *) live_threads;
+
+static THREAD_LOCAL struct live_thread *thread_live = NULL;
+static THREAD_LOCAL long thread_live_generation = 0;
+
+/* everything collected so far, and everything collected since the last
+ * delta snapshot, only accessed with snapshot_mutex held */
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static profile_entries_t total_roots;
+static profile_entries_t delta_roots;
+
+static void free_profile_entry(profile_entry *entry);
+
+static struct live_thread *get_live_thread(void)
+{
+	long generation = os_atomic_load_long(&live_generation);
+
+	if (thread_live && thread_live_generation == generation)
+		return thread_live;
+
+	struct live_thread *thread = NULL;
+
+	pthread_once(&exit_keys_once, create_exit_keys);
+
+	pthread_mutex_lock(&live_mutex);
+	for (size_t i = 0; i < live_threads.num; i++) {
+		if (live_threads.array[i]->exited) {
+			thread = live_threads.array[i];
 			break;
 		}
 	}
 
-	if (!r_entry) {
-		r_entry = da_push_back_new(root_entries);
-		r_entry->mutex = bmalloc(sizeof(pthread_mutex_t));
-		pthread_mutex_init(r_entry->mutex, NULL);
+	if (thread) {
+		/* what it collected is still merged by the next snapshot,
+		 * but the time between calls starts over */
+		pthread_mutex_lock(&thread->mutex);
+		for (size_t i = 0; i < thread->roots.num; i++)
+			thread->roots.array[i].prev_start = 0;
+		thread->exited = false;
+		pthread_mutex_unlock(&thread->mutex);
+	} else {
+		thread = bzalloc(sizeof(*thread));
+		pthread_mutex_init(&thread->mutex, NULL);
+		da_push_back(live_threads, &thread);
+	}
+	pthread_mutex_unlock(&live_mutex);
 
-		r_entry->name = name;
-		r_entry->entry = bzalloc(sizeof(profile_entry));
-		init_entry(r_entry->entry, name);
+	thread_live = thread;
+	thread_live_generation = generation;
+	pthread_setspecific(live_exit_key, thread);
+	return thread;
+}
+
+static void live_thread_exit(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	/* the tree is gone if the generation changed */
+	pthread_mutex_lock(&live_mutex);
+	if (thread_live &&
+	    thread_live_generation == os_atomic_load_long(&live_generation))
+		thread_live->exited = true;
+	pthread_mutex_unlock(&live_mutex);
+
+	thread_live = NULL;
+}
+
+static struct live_root *get_live_root(struct live_thread *thread,
+				       const char *name)
+{
+	for (size_t i = 0; i < thread->roots.num; i++) {
+		if (thread->roots.array[i].entry.name == name)
+			return &thread->roots.array[i];
 	}
 
-	return r_entry;
+	struct live_root *root = da_push_back_new(thread->roots);
+	init_entry(&root->entry, name);
+	return root;
 }
 
-void profile_register_root(const char *name,
-			   uint64_t expected_time_between_calls)
+static void live_merge_call(profile_call *call)
 {
-	if (!lock_root())
-		return;
+	struct live_thread *thread = get_live_thread();
 
-	get_root_entry(name)->entry->expected_time_between_calls =
-		(expected_time_between_calls + 500) / 1000;
-	pthread_mutex_unlock(&root_mutex);
+	pthread_mutex_lock(&thread->mutex);
+
+	struct live_root *root = get_live_root(thread, call->name);
+	merge_call(&root->entry, call);
+
+	if (root->prev_start) {
+		profile_times_table *map = &root->entry.times_between_calls;
+		migrate_old_entries(map, true);
+		add_hashmap_entry(map,
+				  diff_ns_to_usec(root->prev_start,
+						  call->start_time),
+				  1);
+	}
+	root->prev_start = call->start_time;
+
+	pthread_mutex_unlock(&thread->mutex);
 }
 
-static void free_call_context(profile_call *context);
+static void live_thread_free(struct live_thread *thread)
+{
+	pthread_mutex_destroy(&thread->mutex);
+
+	for (size_t i = 0; i < thread->roots.num; i++)
+		free_profile_entry(&thread->roots.array[i].entry);
+	da_free(thread->roots);
+	bfree(thread);
+}
 
-static void merge_context(profile_call *context)
+static void live_threads_free(void)
 {
-	pthread_mutex_t *mutex = NULL;
-	profile_entry *entry = NULL;
-	profile_call *prev_call = NULL;
+	pthread_mutex_lock(&live_mutex);
+	os_atomic_inc_long(&live_generation);
 
-	if (!lock_root()) {
-		free_call_context(context);
-		return;
+	for (size_t i = 0; i < live_threads.num; i++) {
+		struct live_thread *thread = live_threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+		pthread_mutex_unlock(&thread->mutex);
+		live_thread_free(thread);
 	}
+	da_free(live_threads);
+	pthread_mutex_unlock(&live_mutex);
+}
 
-	profile_root_entry *r_entry = get_root_entry(context->name);
+static void free_roots(profile_entries_t *roots)
+{
+	for (size_t i = 0; i < roots->num; i++)
+		free_profile_entry(&roots->array[i]);
+	da_free(*roots);
+}
 
-	mutex = r_entry->mutex;
-	entry = r_entry->entry;
-	prev_call = r_entry->prev_call;
+void profiler_start(void)
+{
+	os_atomic_set_bool(&enabled, true);
+}
 
-	r_entry->prev_call = context;
+void profiler_stop(void)
+{
+	os_atomic_set_bool(&enabled, false);
+}
 
-	pthread_mutex_lock(mutex);
-	pthread_mutex_unlock(&root_mutex);
+void profile_reenable_thread(void)
+{
+	if (thread_enabled)
+		return;
 
-	merge_call(entry, context, prev_call);
+	thread_enabled = os_atomic_load_bool(&enabled);
+}
 
-	pthread_mutex_unlock(mutex);
+static bool check_enabled(void)
+{
+	if (os_atomic_load_bool(&enabled))
+		return true;
 
-	free_call_context(prev_call);
+	thread_enabled = false;
+	return false;
 }
 
+void profile_register_root(const char *name,
+			   uint64_t expected_time_between_calls)
+{
+	profile_root_entry *r_entry = NULL;
+
+	if (!check_enabled())
+		return;
+
+	pthread_mutex_lock(&root_mutex);
+
+	for (size_t i = 0; i < root_entries.num; i++) {
+		if (root_entries.array[i].name == name) {
+			r_entry = &root_entries.array[i];
+			break;
+		}
+	}
+
+	if (!r_entry) {
+		r_entry = da_push_back_new(root_entries);
+		r_entry->name = name;
+	}
+
+	r_entry->expected_time_between_calls =
+		(expected_time_between_calls + 500) / 1000;
+
+	pthread_mutex_unlock(&root_mutex);
+}
+
+static void free_call_context(profile_call *context);
+
 void profile_start(const char *name)
 {
 	if (!thread_enabled)
@@ -390,6 +683,9 @@ void profile_start(const char *name)
 
 	thread_context = call;
 	call->start_time = os_gettime_ns();
+
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_event(name, call->start_time, TRACE_BEGIN);
 }
 
 void profile_end(const char *name)
@@ -429,6 +725,9 @@ void profile_end(const char *name)
 	thread_context = call->parent;
 
 	call->end_time = end;
+
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_event(call->name, end, TRACE_END);
 #ifdef TRACK_OVERHEAD
 	call->overhead_end = os_gettime_ns();
 #endif
@@ -436,7 +735,10 @@ void profile_end(const char *name)
 	if (call->parent)
 		return;
 
-	merge_context(call);
+	if (check_enabled())
+		live_merge_call(call);
+
+	free_call_context(call);
 }
 
 static int profiler_time_entry_compare(const void *first, const void *second)
@@ -801,32 +1103,21 @@ static void free_profile_entry(profile_entry *entry)
 
 void profiler_free(void)
 {
-	DARRAY(profile_root_entry) old_root_entries = {0};
+	os_atomic_set_bool(&enabled, false);
 
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
-	da_move(old_root_entries, root_entries);
+	da_free(root_entries);
 	pthread_mutex_unlock(&root_mutex);
 
-	for (size_t i = 0; i < old_root_entries.num; i++) {
-		profile_root_entry *entry = &old_root_entries.array[i];
-
-		pthread_mutex_lock(entry->mutex);
-		pthread_mutex_unlock(entry->mutex);
-
-		pthread_mutex_destroy(entry->mutex);
-		bfree(entry->mutex);
-		entry->mutex = NULL;
-
-		free_call_context(entry->prev_call);
-
-		free_profile_entry(entry->entry);
-		bfree(entry->entry);
-	}
-
-	da_free(old_root_entries);
+	pthread_mutex_lock(&snapshot_mutex);
+	free_roots(&total_roots);
+	free_roots(&delta_roots);
+	pthread_mutex_unlock(&snapshot_mutex);
 
 	pthread_mutex_destroy(&root_mutex);
+
+	trace_buffers_free();
+	live_threads_free();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -927,19 +1218,150 @@ static void sort_snapshot_entry(profiler_snapshot_entry_t *entry)
 		sort_snapshot_entry(&entry->children.array[i]);
 }
 
-profiler_snapshot_t *profile_snapshot_create(void)
+static void merge_times(profile_times_table *dst, profile_times_table *src)
 {
-	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
+	migrate_old_entries(src, false);
+
+	for (size_t i = 0; i < src->size; i++) {
+		profile_times_table_entry *entry = &src->entries[i];
+		if (!entry->probes)
+			continue;
+
+		migrate_old_entries(dst, true);
+		add_hashmap_entry(dst, entry->entry.time_delta,
+				  entry->entry.count);
+	}
+}
+
+static void merge_entry(profile_entry *dst, profile_entry *src)
+{
+	merge_times(&dst->times, &src->times);
+#ifdef TRACK_OVERHEAD
+	merge_times(&dst->overhead, &src->overhead);
+#endif
+	merge_times(&dst->times_between_calls, &src->times_between_calls);
+
+	for (size_t i = 0; i < src->children.num; i++) {
+		profile_entry *child = &src->children.array[i];
+		merge_entry(get_child(dst, child->name), child);
+	}
+}
+
+static profile_entry *get_root(profile_entries_t *roots, const char *name)
+{
+	for (size_t i = 0; i < roots->num; i++) {
+		if (roots->array[i].name == name)
+			return &roots->array[i];
+	}
+
+	return init_entry(da_push_back_new(*roots), name);
+}
 
+static void set_expected_times(profile_entries_t *roots, bool add_missing)
+{
 	pthread_mutex_lock(&root_mutex);
-	da_reserve(snap->roots, root_entries.num);
 	for (size_t i = 0; i < root_entries.num; i++) {
-		pthread_mutex_lock(root_entries.array[i].mutex);
-		add_entry_to_snapshot(root_entries.array[i].entry,
-				      da_push_back_new(snap->roots));
-		pthread_mutex_unlock(root_entries.array[i].mutex);
+		profile_root_entry *r_entry = &root_entries.array[i];
+		profile_entry *root = NULL;
+
+		if (add_missing) {
+			root = get_root(roots, r_entry->name);
+		} else {
+			for (size_t j = 0; j < roots->num && !root; j++) {
+				if (roots->array[j].name == r_entry->name)
+					root = &roots->array[j];
+			}
+		}
+
+		if (root)
+			root->expected_time_between_calls =
+				r_entry->expected_time_between_calls;
 	}
 	pthread_mutex_unlock(&root_mutex);
+}
+
+/* Moves everything the threads have collected since the last call into
+ * total_roots and delta_roots, snapshot_mutex must be held */
+static void collect_live_threads(void)
+{
+	profile_entries_t swapped = {0};
+
+	/* only swap the trees out while holding the thread mutexes, merging
+	 * them is left until after they have been released */
+	pthread_mutex_lock(&live_mutex);
+	for (size_t i = 0; i < live_threads.num;) {
+		struct live_thread *thread = live_threads.array[i];
+
+		pthread_mutex_lock(&thread->mutex);
+		for (size_t j = 0; j < thread->roots.num; j++) {
+			profile_entry *entry = &thread->roots.array[j].entry;
+
+			da_push_back(swapped, entry);
+			memset(entry, 0, sizeof(*entry));
+			init_entry(entry, swapped.array[swapped.num - 1].name);
+		}
+		pthread_mutex_unlock(&thread->mutex);
+
+		/* nothing can be added to it anymore */
+		if (thread->exited) {
+			live_thread_free(thread);
+			da_erase(live_threads, i);
+		} else {
+			i++;
+		}
+	}
+	pthread_mutex_unlock(&live_mutex);
+
+	for (size_t i = 0; i < swapped.num; i++) {
+		profile_entry *entry = &swapped.array[i];
+
+		merge_entry(get_root(&total_roots, entry->name), entry);
+		merge_entry(get_root(&delta_roots, entry->name), entry);
+	}
+	free_roots(&swapped);
+
+	/* registered roots show up even before they are first called */
+	set_expected_times(&total_roots, true);
+	set_expected_times(&delta_roots, false);
+}
+
+static profiler_snapshot_t *snapshot_from_roots(profile_entries_t *roots)
+{
+	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
+
+	da_reserve(snap->roots, roots->num);
+	for (size_t i = 0; i < roots->num; i++)
+		add_entry_to_snapshot(&roots->array[i],
+				      da_push_back_new(snap->roots));
+
+	return snap;
+}
+
+profiler_snapshot_t *profile_snapshot_create(void)
+{
+	profiler_snapshot_t *snap;
+
+	pthread_mutex_lock(&snapshot_mutex);
+	collect_live_threads();
+	snap = snapshot_from_roots(&total_roots);
+	pthread_mutex_unlock(&snapshot_mutex);
+
+	for (size_t i = 0; i < snap->roots.num; i++)
+		sort_snapshot_entry(&snap->roots.array[i]);
+
+	return snap;
+}
+
+profiler_snapshot_t *profile_snapshot_create_delta(void)
+{
+	profiler_snapshot_t *snap;
+
+	pthread_mutex_lock(&snapshot_mutex);
+	collect_live_threads();
+	snap = snapshot_from_roots(&delta_roots);
+	snap->delta = true;
+	free_roots(&delta_roots);
+	pthread_mutex_unlock(&snapshot_mutex);
 
 	for (size_t i = 0; i < snap->roots.num; i++)
 		sort_snapshot_entry(&snap->roots.array[i]);
@@ -1071,6 +1493,100 @@ bool profiler_snapshot_dump_csv_gz(const profiler_snapshot_t *snap,
 	return true;
 }
 
+static void trace_dump_name(struct dstr *buffer, const char *name)
+{
+	dstr_cat_ch(buffer, '"');
+	for (const char *p = name ? name : ""; *p; p++) {
+		unsigned char ch = (unsigned char)*p;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(buffer, '\\');
+			dstr_cat_ch(buffer, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(buffer, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(buffer, (char)ch);
+		}
+	}
+	dstr_cat_ch(buffer, '"');
+}
+
+static void trace_dump_buffer(FILE *f, struct dstr *buffer,
+			      const struct trace_buffer *buf, bool *first)
+{
+	long end = os_atomic_load_long(&buf->pos);
+	long count = end < (long)buf->capacity ? end : (long)buf->capacity;
+	long start = end - count;
+	struct trace_event *events;
+	size_t depth = 0;
+
+	events = count ? bmalloc(sizeof(struct trace_event) * (size_t)count)
+		       : NULL;
+	for (long i = 0; i < count; i++)
+		events[i] = buf->events[(size_t)(start + i) % buf->capacity];
+
+	/* anything the writer may have overwritten while we were copying is
+	 * dropped, which is always a prefix of what was copied */
+	long valid = os_atomic_load_long(&buf->pos) - (long)buf->capacity + 1;
+	if (valid < start)
+		valid = start;
+
+	dstr_printf(buffer,
+		    "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		    "\"tid\":%ld,\"args\":{\"name\":",
+		    *first ? "" : ",", buf->id);
+	trace_dump_name(buffer, buf->thread_name);
+	dstr_cat(buffer, "}}");
+	fwrite(buffer->array, 1, buffer->len, f);
+	*first = false;
+
+	for (long i = valid - start; i < count; i++) {
+		const struct trace_event *event = &events[i];
+
+		/* the matching begin event was lost to the ring wrapping */
+		if (event->type == TRACE_END) {
+			if (!depth)
+				continue;
+			depth--;
+		} else {
+			depth++;
+		}
+
+		dstr_copy(buffer, ",\n{\"name\":");
+		trace_dump_name(buffer, event->name);
+		dstr_catf(buffer,
+			  ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%ld}",
+			  event->type == TRACE_BEGIN ? 'B' : 'E',
+			  (double)event->time / 1000.0, buf->id);
+		fwrite(buffer->array, 1, buffer->len, f);
+	}
+
+	bfree(events);
+}
+
+bool profiler_trace_dump_json(const char *filename)
+{
+	struct dstr buffer = {0};
+	bool first = true;
+
+	FILE *f = os_fopen(filename, "wb+");
+	if (!f)
+		return false;
+
+	fputs("{\"traceEvents\":[", f);
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_buffers.num; i++)
+		trace_dump_buffer(f, &buffer, trace_buffers.array[i], &first);
+	pthread_mutex_unlock(&trace_mutex);
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+
+	dstr_free(&buffer);
+	fclose(f);
+	return true;
+}
+
 size_t profiler_snapshot_num_roots(profiler_snapshot_t *snap)
 {
 	return snap ? snap->roots.num : 0;
@@ -1180,3 +1696,257 @@ uint64_t profiler_snapshot_entry_overall_between_calls_count(
 {
 	return entry ? entry->overall_between_calls_count : 0;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Prometheus export */
+
+struct prometheus_sample {
+	struct dstr labels;
+	uint64_t calls;
+	uint64_t min_time;
+	uint64_t max_time;
+	uint64_t total_time;
+	uint64_t quantiles[3];
+};
+
+static const double prometheus_quantiles[] = {0.5, 0.9, 0.99};
+
+struct prometheus_context {
+	DARRAY(struct prometheus_sample) samples;
+	struct dstr path;
+};
+
+static void prometheus_escape(struct dstr *buffer, const char *str)
+{
+	for (const char *p = str ? str : ""; *p; p++) {
+		if (*p == '\\')
+			dstr_cat(buffer, "\\\\");
+		else if (*p == '"')
+			dstr_cat(buffer, "\\\"");
+		else if (*p == '\n')
+			dstr_cat(buffer, "\\n");
+		else
+			dstr_cat_ch(buffer, *p);
+	}
+}
+
+/* times are sorted longest first */
+static uint64_t times_quantile(profiler_time_entries_t *times, uint64_t calls,
+			       double quantile)
+{
+	uint64_t above = (uint64_t)(calls * (1. - quantile));
+	uint64_t accu = 0;
+
+	for (size_t i = 0; i < times->num; i++) {
+		accu += times->array[i].count;
+		if (accu > above)
+			return times->array[i].time_delta;
+	}
+
+	return 0;
+}
+
+static bool prometheus_add_entry(void *data, profiler_snapshot_entry_t *entry)
+{
+	struct prometheus_context *ctx = data;
+	profiler_time_entries_t *times = profiler_snapshot_entry_times(entry);
+	size_t path_len = ctx->path.len;
+
+	if (path_len)
+		dstr_cat_ch(&ctx->path, '/');
+	dstr_cat(&ctx->path, profiler_snapshot_entry_name(entry));
+
+	struct prometheus_sample *sample = da_push_back_new(ctx->samples);
+	dstr_cat(&sample->labels, "path=\"");
+	prometheus_escape(&sample->labels, ctx->path.array);
+	dstr_cat(&sample->labels, "\",name=\"");
+	prometheus_escape(&sample->labels,
+			  profiler_snapshot_entry_name(entry));
+	dstr_cat_ch(&sample->labels, '"');
+
+	sample->calls = profiler_snapshot_entry_overall_count(entry);
+	if (sample->calls) {
+		sample->min_time = profiler_snapshot_entry_min_time(entry);
+		sample->max_time = profiler_snapshot_entry_max_time(entry);
+	}
+
+	for (size_t i = 0; i < times->num; i++)
+		sample->total_time +=
+			times->array[i].time_delta * times->array[i].count;
+
+	for (size_t i = 0; i < 3; i++)
+		sample->quantiles[i] = times_quantile(
+			times, sample->calls, prometheus_quantiles[i]);
+
+	profiler_snapshot_enumerate_children(entry, prometheus_add_entry, ctx);
+
+	dstr_resize(&ctx->path, path_len);
+	return true;
+}
+
+static void prometheus_family(struct dstr *out, const char *name,
+			      const char *type, const char *help,
+			      const char *since)
+{
+	dstr_catf(out, "# HELP %s %s %s\n# TYPE %s %s\n", name, help, since,
+		  name, type);
+}
+
+static void prometheus_summary(struct dstr *out,
+			       struct prometheus_context *ctx,
+			       const char *since)
+{
+	prometheus_family(out, "obs_profiler_time_seconds", "summary",
+			  "Call duration quantiles, and the number and "
+			  "combined duration of calls",
+			  since);
+
+	for (size_t i = 0; i < ctx->samples.num; i++) {
+		struct prometheus_sample *sample = &ctx->samples.array[i];
+		const char *labels = sample->labels.array;
+
+		for (size_t j = 0; j < 3; j++)
+			dstr_catf(out,
+				  "obs_profiler_time_seconds{%s,quantile=\"%g\"}"
+				  " %g\n",
+				  labels, prometheus_quantiles[j],
+				  sample->quantiles[j] / 1000000.);
+
+		dstr_catf(out, "obs_profiler_time_seconds_sum{%s} %g\n",
+			  labels, sample->total_time / 1000000.);
+		dstr_catf(out,
+			  "obs_profiler_time_seconds_count{%s} %" PRIu64 "\n",
+			  labels, sample->calls);
+	}
+}
+
+/* the counts of a delta snapshot start over every time, so they can't be a
+ * summary, and every quantile gets a gauge of its own */
+static void prometheus_delta_gauges(struct dstr *out,
+				    struct prometheus_context *ctx,
+				    const char *since)
+{
+	struct dstr name = {0};
+
+	prometheus_family(out, "obs_profiler_calls", "gauge",
+			  "Calls completed", since);
+	for (size_t i = 0; i < ctx->samples.num; i++)
+		dstr_catf(out, "obs_profiler_calls{%s} %" PRIu64 "\n",
+			  ctx->samples.array[i].labels.array,
+			  ctx->samples.array[i].calls);
+
+	prometheus_family(out, "obs_profiler_time_total_seconds", "gauge",
+			  "Combined duration of all calls", since);
+	for (size_t i = 0; i < ctx->samples.num; i++)
+		dstr_catf(out, "obs_profiler_time_total_seconds{%s} %g\n",
+			  ctx->samples.array[i].labels.array,
+			  ctx->samples.array[i].total_time / 1000000.);
+
+	for (size_t j = 0; j < 3; j++) {
+		dstr_printf(&name, "obs_profiler_time_p%g_seconds",
+			    prometheus_quantiles[j] * 100.);
+		prometheus_family(out, name.array, "gauge",
+				  "Call duration quantile", since);
+
+		for (size_t i = 0; i < ctx->samples.num; i++)
+			dstr_catf(out, "%s{%s} %g\n", name.array,
+				  ctx->samples.array[i].labels.array,
+				  ctx->samples.array[i].quantiles[j] /
+					  1000000.);
+	}
+
+	dstr_free(&name);
+}
+
+/* everything since the profiler was started is exported as a summary, a
+ * delta snapshot only as gauges */
+static void prometheus_format(struct dstr *out, profiler_snapshot_t *snap)
+{
+	struct prometheus_context ctx = {0};
+	const char *since = snap->delta ? "since the previous snapshot"
+					: "since the profiler was started";
+
+	profiler_snapshot_enumerate_roots(snap, prometheus_add_entry, &ctx);
+
+	if (snap->delta)
+		prometheus_delta_gauges(out, &ctx, since);
+	else
+		prometheus_summary(out, &ctx, since);
+
+	prometheus_family(out, "obs_profiler_time_min_seconds", "gauge",
+			  "Shortest call duration", since);
+	for (size_t i = 0; i < ctx.samples.num; i++)
+		dstr_catf(out, "obs_profiler_time_min_seconds{%s} %g\n",
+			  ctx.samples.array[i].labels.array,
+			  ctx.samples.array[i].min_time / 1000000.);
+
+	prometheus_family(out, "obs_profiler_time_max_seconds", "gauge",
+			  "Longest call duration", since);
+	for (size_t i = 0; i < ctx.samples.num; i++)
+		dstr_catf(out, "obs_profiler_time_max_seconds{%s} %g\n",
+			  ctx.samples.array[i].labels.array,
+			  ctx.samples.array[i].max_time / 1000000.);
+
+	for (size_t i = 0; i < ctx.samples.num; i++)
+		dstr_free(&ctx.samples.array[i].labels);
+	da_free(ctx.samples);
+	dstr_free(&ctx.path);
+}
+
+#ifndef _WIN32
+static bool prometheus_send(const char *socket_path, const struct dstr *out)
+{
+	struct sockaddr_un addr = {0};
+	bool success = false;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+		return false;
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		return false;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		size_t sent = 0;
+
+		while (sent < out->len) {
+			ssize_t ret = send(fd, out->array + sent,
+					   out->len - sent, MSG_NOSIGNAL);
+			if (ret <= 0)
+				break;
+			sent += (size_t)ret;
+		}
+
+		success = sent == out->len;
+	}
+
+	close(fd);
+	return success;
+}
+#endif
+
+bool profiler_snapshot_dump_prometheus(profiler_snapshot_t *snap,
+				       const char *path)
+{
+	struct dstr out = {0};
+	bool success;
+
+	if (!snap || !path)
+		return false;
+
+	prometheus_format(&out, snap);
+
+#ifndef _WIN32
+	if (strncmp(path, "unix:", 5) == 0)
+		success = prometheus_send(path + 5, &out);
+	else
+#endif
+		success = os_quick_write_utf8_file_safe(path, out.array, out.len,
+							false, "tmp", NULL);
+
+	dstr_free(&out);
+	return success;
+}
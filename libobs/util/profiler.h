@@ -33,6 +33,23 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Event tracing */
+
+/* Records every profile_start/profile_end into a per-thread ring buffer
+ * holding the most recent max_events_per_thread events (0 for the default).
+ * The size is fixed by the first call until profiler_free. */
+EXPORT void profiler_trace_start(size_t max_events_per_thread);
+EXPORT void profiler_trace_stop(void);
+
+/* Names the calling thread in traces, os_set_thread_name does this as well.
+ * Threads without a name are named after the first root profiled on them */
+EXPORT void profiler_name_thread(const char *name);
+
+/* Writes the recorded events in the Chrome trace event format, which can be
+ * loaded in chrome://tracing or Perfetto */
+EXPORT bool profiler_trace_dump_json(const char *filename);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
@@ -69,11 +86,23 @@ typedef bool (*profiler_entry_enum_func)(void *context,
 EXPORT profiler_snapshot_t *profile_snapshot_create(void);
 EXPORT void profile_snapshot_free(profiler_snapshot_t *snap);
 
+/* Returns only the calls completed since the previous call (or since the
+ * profiler was started), combined across threads.  Cheap enough to poll
+ * while the profiler is running, and independent of
+ * profile_snapshot_create. */
+EXPORT profiler_snapshot_t *profile_snapshot_create_delta(void);
+
 EXPORT bool profiler_snapshot_dump_csv(const profiler_snapshot_t *snap,
 				       const char *filename);
 EXPORT bool profiler_snapshot_dump_csv_gz(const profiler_snapshot_t *snap,
 					  const char *filename);
 
+/* Writes call counts and duration statistics in the Prometheus text format.
+ * The file is replaced atomically; on POSIX systems "unix:<path>" sends it to
+ * a listening Unix domain socket instead. */
+EXPORT bool profiler_snapshot_dump_prometheus(profiler_snapshot_t *snap,
+					      const char *path);
+
 EXPORT size_t profiler_snapshot_num_roots(profiler_snapshot_t *snap);
 EXPORT void profiler_snapshot_enumerate_roots(profiler_snapshot_t *snap,
 					      profiler_entry_enum_func func,
@@ -31,6 +31,7 @@
 #endif
 
 #include "bmem.h"
+#include "profiler.h"
 #include "threading.h"
 
 struct os_event_data {
@@ -257,6 +258,8 @@ int os_sem_wait(os_sem_t *sem)
 
 void os_set_thread_name(const char *name)
 {
+	profiler_name_thread(name);
+
 #if defined(__APPLE__)
 	pthread_setname_np(name);
 #elif defined(__FreeBSD__)
@@ -15,6 +15,7 @@
  */
 
 #include "bmem.h"
+#include "profiler.h"
 #include "threading.h"
 #include "util/platform.h"
 
@@ -168,6 +169,8 @@ struct vs_threadname_info {
 
 void os_set_thread_name(const char *name)
 {
+	profiler_name_thread(name);
+
 #ifdef __MINGW32__
 	UNUSED_PARAMETER(name);
 #else
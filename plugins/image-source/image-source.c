@@ -20,6 +20,10 @@ struct image_source {
 	bool persistent;
 	bool is_slide;
 	bool linear_alpha;
+	uint64_t gif_cache_limit;
+	bool gif_palette;
+	uint32_t max_cx;
+	uint32_t max_cy;
 	time_t file_timestamp;
 	float update_time_elapsed;
 	uint64_t last_time;
@@ -28,7 +32,7 @@ struct image_source {
 	volatile bool file_decoded;
 	volatile bool texture_loaded;
 
-	gs_image_file4_t if4;
+	gs_image_file5_t if5;
 };
 
 static time_t get_modified_timestamp(const char *filename)
@@ -45,6 +49,96 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
+/* box filters the decoded image down to fit within max_cx/max_cy, so that
+ * large slides are uploaded at the size they will actually be drawn at */
+static void downscale_image(struct image_source *context)
+{
+	gs_image_file_t *image = &context->if5.image4.image3.image2.image;
+	uint64_t *mem_usage = &context->if5.image4.image3.image2.mem_usage;
+	const uint32_t cx = image->cx;
+	const uint32_t cy = image->cy;
+	uint32_t new_cx;
+	uint32_t new_cy;
+	uint32_t *x_starts;
+	uint32_t *sums;
+	uint8_t *out;
+
+	if (!context->max_cx || !context->max_cy || !image->texture_data ||
+	    gs_get_format_bpp(image->format) != 32)
+		return;
+	if (cx <= context->max_cx && cy <= context->max_cy)
+		return;
+
+	if ((uint64_t)cx * context->max_cy > (uint64_t)cy * context->max_cx) {
+		new_cx = context->max_cx;
+		new_cy = (uint32_t)((uint64_t)cy * context->max_cx / cx);
+	} else {
+		new_cx = (uint32_t)((uint64_t)cx * context->max_cy / cy);
+		new_cy = context->max_cy;
+	}
+
+	if (!new_cx)
+		new_cx = 1;
+	if (!new_cy)
+		new_cy = 1;
+
+	x_starts = bmalloc((new_cx + 1) * sizeof(uint32_t));
+	sums = bmalloc((size_t)new_cx * 4 * sizeof(uint32_t));
+	out = bmalloc((size_t)new_cx * new_cy * 4);
+
+	for (uint32_t x = 0; x <= new_cx; x++)
+		x_starts[x] = (uint32_t)((uint64_t)x * cx / new_cx);
+
+	for (uint32_t y = 0; y < new_cy; y++) {
+		const uint32_t y0 = (uint32_t)((uint64_t)y * cy / new_cy);
+		const uint32_t y1 = (uint32_t)((uint64_t)(y + 1) * cy / new_cy);
+		uint8_t *out_row = out + (size_t)y * new_cx * 4;
+
+		memset(sums, 0, (size_t)new_cx * 4 * sizeof(uint32_t));
+
+		for (uint32_t sy = y0; sy < y1; sy++) {
+			const uint8_t *row =
+				image->texture_data + (size_t)sy * cx * 4;
+
+			for (uint32_t x = 0; x < new_cx; x++) {
+				uint32_t *sum = sums + x * 4;
+
+				for (uint32_t sx = x_starts[x];
+				     sx < x_starts[x + 1]; sx++) {
+					const uint8_t *px = row + sx * 4;
+					sum[0] += px[0];
+					sum[1] += px[1];
+					sum[2] += px[2];
+					sum[3] += px[3];
+				}
+			}
+		}
+
+		for (uint32_t x = 0; x < new_cx; x++) {
+			const uint32_t count =
+				(y1 - y0) * (x_starts[x + 1] - x_starts[x]);
+
+			for (size_t c = 0; c < 4; c++)
+				out_row[x * 4 + c] = (uint8_t)(
+					(sums[x * 4 + c] + count / 2) / count);
+		}
+	}
+
+	debug("downscaled '%s' from %ux%u to %ux%u", context->file, cx, cy,
+	      new_cx, new_cy);
+
+	*mem_usage -= (uint64_t)cx * cy * 4;
+	*mem_usage += (uint64_t)new_cx * new_cy * 4;
+
+	bfree(image->texture_data);
+	image->texture_data = out;
+	image->cx = new_cx;
+	image->cy = new_cy;
+
+	bfree(x_starts);
+	bfree(sums);
+}
+
 void image_source_preload_image(void *data)
 {
 	struct image_source *context = data;
@@ -52,13 +146,21 @@ void image_source_preload_image(void *data)
 		return;
 
 	context->file_timestamp = get_modified_timestamp(context->file);
-	gs_image_file4_init(&context->if4, context->file,
+	gs_image_file5_init(&context->if5, context->file,
 			    context->linear_alpha
 				    ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
-				    : GS_IMAGE_ALPHA_PREMULTIPLY);
+				    : GS_IMAGE_ALPHA_PREMULTIPLY,
+			    context->gif_cache_limit, context->gif_palette);
+	downscale_image(context);
 	os_atomic_set_bool(&context->file_decoded, true);
 }
 
+bool image_source_is_decoded(void *data)
+{
+	struct image_source *context = data;
+	return os_atomic_load_bool(&context->file_decoded);
+}
+
 static void image_source_load_texture(void *data)
 {
 	struct image_source *context = data;
@@ -68,10 +170,10 @@ static void image_source_load_texture(void *data)
 	debug("loading texture '%s'", context->file);
 
 	obs_enter_graphics();
-	gs_image_file4_init_texture(&context->if4);
+	gs_image_file5_init_texture(&context->if5);
 	obs_leave_graphics();
 
-	if (!context->if4.image3.image2.image.loaded)
+	if (!context->if5.image4.image3.image2.image.loaded)
 		warn("failed to load texture '%s'", context->file);
 	context->update_time_elapsed = 0;
 	os_atomic_set_bool(&context->texture_loaded, true);
@@ -84,7 +186,7 @@ static void image_source_unload(void *data)
 	os_atomic_set_bool(&context->texture_loaded, false);
 
 	obs_enter_graphics();
-	gs_image_file4_free(&context->if4);
+	gs_image_file5_free(&context->if5);
 	obs_leave_graphics();
 }
 
@@ -105,12 +207,19 @@ static void image_source_update(void *data, obs_data_t *settings)
 	const bool unload = obs_data_get_bool(settings, "unload");
 	const bool linear_alpha = obs_data_get_bool(settings, "linear_alpha");
 	const bool is_slide = obs_data_get_bool(settings, "is_slide");
+	const long long gif_cache_mb =
+		obs_data_get_int(settings, "gif_cache_mb");
+	const bool gif_palette = obs_data_get_bool(settings, "gif_palette");
 
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
 	context->persistent = !unload;
 	context->linear_alpha = linear_alpha;
+	context->gif_cache_limit = (uint64_t)gif_cache_mb * 1024 * 1024;
+	context->gif_palette = gif_palette;
+	context->max_cx = (uint32_t)obs_data_get_int(settings, "max_width");
+	context->max_cy = (uint32_t)obs_data_get_int(settings, "max_height");
 	context->is_slide = is_slide;
 
 	if (is_slide)
@@ -127,6 +236,8 @@ static void image_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_bool(settings, "unload", false);
 	obs_data_set_default_bool(settings, "linear_alpha", false);
+	obs_data_set_default_int(settings, "gif_cache_mb", 256);
+	obs_data_set_default_bool(settings, "gif_palette", false);
 }
 
 static void image_source_show(void *data)
@@ -149,13 +260,13 @@ static void restart_gif(void *data)
 {
 	struct image_source *context = data;
 
-	if (context->if4.image3.image2.image.is_animated_gif) {
-		context->if4.image3.image2.image.cur_frame = 0;
-		context->if4.image3.image2.image.cur_loop = 0;
-		context->if4.image3.image2.image.cur_time = 0;
+	if (context->if5.image4.image3.image2.image.is_animated_gif) {
+		context->if5.image4.image3.image2.image.cur_frame = 0;
+		context->if5.image4.image3.image2.image.cur_loop = 0;
+		context->if5.image4.image3.image2.image.cur_time = 0;
 
 		obs_enter_graphics();
-		gs_image_file4_update_texture(&context->if4);
+		gs_image_file5_update_texture(&context->if5);
 		obs_leave_graphics();
 
 		context->restart_gif = false;
@@ -191,13 +302,13 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cx;
+	return context->if5.image4.image3.image2.image.cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cy;
+	return context->if5.image4.image3.image2.image.cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
@@ -206,7 +317,8 @@ static void image_source_render(void *data, gs_effect_t *effect)
 	if (!os_atomic_load_bool(&context->texture_loaded))
 		return;
 
-	struct gs_image_file *const image = &context->if4.image3.image2.image;
+	struct gs_image_file *const image =
+		&context->if5.image4.image3.image2.image;
 	gs_texture_t *const texture = image->texture;
 	if (!texture)
 		return;
@@ -254,7 +366,8 @@ static void image_source_tick(void *data, float seconds)
 
 	if (obs_source_showing(context->source)) {
 		if (!context->active) {
-			if (context->if4.image3.image2.image.is_animated_gif)
+			if (context->if5.image4.image3.image2.image
+				    .is_animated_gif)
 				context->last_time = frame_time;
 			context->active = true;
 		}
@@ -272,13 +385,13 @@ static void image_source_tick(void *data, float seconds)
 	}
 
 	if (context->last_time &&
-	    context->if4.image3.image2.image.is_animated_gif) {
+	    context->if5.image4.image3.image2.image.is_animated_gif) {
 		uint64_t elapsed = frame_time - context->last_time;
-		bool updated = gs_image_file4_tick(&context->if4, elapsed);
+		bool updated = gs_image_file5_tick(&context->if5, elapsed);
 
 		if (updated) {
 			obs_enter_graphics();
-			gs_image_file4_update_texture(&context->if4);
+			gs_image_file5_update_texture(&context->if5);
 			obs_leave_graphics();
 		}
 	}
@@ -309,6 +422,7 @@ static obs_properties_t *image_source_properties(void *data)
 	UNUSED_PARAMETER(data);
 
 	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
 
 	obs_properties_add_path(props, "file", obs_module_text("File"),
 				OBS_PATH_FILE, image_filter, NULL);
@@ -317,13 +431,22 @@ static obs_properties_t *image_source_properties(void *data)
 	obs_properties_add_bool(props, "linear_alpha",
 				obs_module_text("LinearAlpha"));
 
+	p = obs_properties_add_int_slider(props, "gif_cache_mb",
+					  obs_module_text("GifCacheSize"), 8,
+					  4096, 8);
+	obs_property_int_set_suffix(p, " MB");
+	obs_property_set_long_description(
+		p, obs_module_text("GifCacheSize.ToolTip"));
+	obs_properties_add_bool(props, "gif_palette",
+				obs_module_text("GifPalette"));
+
 	return props;
 }
 
 uint64_t image_source_get_memory_usage(void *data)
 {
 	struct image_source *s = data;
-	return s->if4.image3.image2.mem_usage;
+	return s->if5.image4.image3.image2.mem_usage;
 }
 
 static void missing_file_callback(void *src, const char *new_path, void *data)
@@ -365,8 +488,9 @@ image_source_get_color_space(void *data, size_t count,
 	UNUSED_PARAMETER(preferred_spaces);
 
 	struct image_source *const s = data;
-	gs_image_file4_t *const if4 = &s->if4;
-	return if4->image3.image2.image.texture ? if4->space : GS_CS_SRGB;
+	gs_image_file5_t *const if5 = &s->if5;
+	return if5->image4.image3.image2.image.texture ? if5->image4.space
+							: GS_CS_SRGB;
 }
 
 static struct obs_source_info image_source_info = {
@@ -13,6 +13,7 @@
 	     obs_source_get_name(ss->source), ##__VA_ARGS__)
 
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
 /* clang-format off */
 
@@ -31,6 +32,8 @@ static const char *S_BEHAVIOR_ALWAYS_PLAY    = "always_play";
 static const char *S_MODE                    = "slide_mode";
 static const char *S_MODE_AUTO               = "mode_auto";
 static const char *S_MODE_MANUAL             = "mode_manual";
+static const char *S_PREFETCH                = "prefetch_count";
+static const char *S_CACHE_SIZE              = "cache_size_mb";
 
 static const char *TR_CUT                    = "cut";
 static const char *TR_FADE                   = "fade";
@@ -53,6 +56,9 @@ static const char *TR_SLIDE                  = "slide";
 #define T_MODE                               T_("SlideMode")
 #define T_MODE_AUTO                          T_("SlideMode.Auto")
 #define T_MODE_MANUAL                        T_("SlideMode.Manual")
+#define T_PREFETCH                           T_("PrefetchCount")
+#define T_CACHE_SIZE                         T_("CacheSize")
+#define T_CACHE_SIZE_TOOLTIP                 T_("CacheSize.ToolTip")
 
 #define T_TR_(text) obs_module_text("SlideShow.Transition." text)
 #define T_TR_CUT                             T_TR_("Cut")
@@ -63,6 +69,8 @@ static const char *TR_SLIDE                  = "slide";
 /* clang-format on */
 
 extern void image_source_preload_image(void *data);
+extern bool image_source_is_decoded(void *data);
+extern uint64_t image_source_get_memory_usage(void *data);
 
 /* ------------------------------------------------------------------------- */
 
@@ -85,6 +93,7 @@ enum behavior {
 };
 
 #define SLIDE_BUFFER_COUNT 5
+#define MAX_DECODE_THREADS 4
 
 struct active_slides {
 	struct deque prev;
@@ -92,9 +101,29 @@ struct active_slides {
 	struct source_data cur;
 };
 
+/* slides that have left the active slides are kept around until the cache
+ * size is exceeded, so going back or looping doesn't decode them again */
+struct cached_slide {
+	struct source_data sd;
+	uint64_t last_used;
+};
+
+typedef DARRAY(struct cached_slide) cached_slide_array_t;
+
+struct prefetch_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t memory;
+	uint64_t peak_memory;
+};
+
 struct slideshow_data {
 	struct active_slides slides;
+	cached_slide_array_t cache;
+	uint64_t use_count;
 	image_file_array_t files;
+	size_t prefetch_count;
+	uint64_t cache_limit;
 	float slide_time;
 	uint32_t tr_speed;
 	const char *tr_name;
@@ -119,7 +148,9 @@ struct slideshow {
 	obs_source_t *source;
 
 	struct slideshow_data data;
-	os_task_queue_t *queue;
+	os_task_queue_t *queues[MAX_DECODE_THREADS];
+	size_t queue_count;
+	size_t next_queue;
 	obs_source_t *transition;
 	uint32_t cx;
 	uint32_t cy;
@@ -129,6 +160,9 @@ struct slideshow {
 	obs_hotkey_id stop_hotkey;
 	obs_hotkey_id next_hotkey;
 	obs_hotkey_id prev_hotkey;
+
+	pthread_mutex_t stats_mutex;
+	struct prefetch_stats stats;
 };
 
 static void set_media_state(void *data, enum obs_media_state state)
@@ -176,6 +210,9 @@ static void free_active_slides(struct active_slides *slides)
 static inline void free_slideshow_data(struct slideshow_data *ssd)
 {
 	free_active_slides(&ssd->slides);
+	for (size_t i = 0; i < ssd->cache.num; i++)
+		free_source_data(&ssd->cache.array[i].sd);
+	da_free(ssd->cache);
 	for (size_t i = 0; i < ssd->files.num; i++)
 		bfree(ssd->files.array[i].path);
 	calldata_free(&ssd->cd);
@@ -232,6 +269,18 @@ static inline void add_file(image_file_array_t *new_files, const char *path)
 
 extern bool valid_extension(const char *ext);
 
+static void record_prefetch(struct slideshow *ss, obs_source_t *source)
+{
+	bool decoded = image_source_is_decoded(obs_obj_get_data(source));
+
+	pthread_mutex_lock(&ss->stats_mutex);
+	if (decoded)
+		ss->stats.hits++;
+	else
+		ss->stats.misses++;
+	pthread_mutex_unlock(&ss->stats_mutex);
+}
+
 /* transition to new source. assumes cur has already been set to new file */
 static void do_transition(void *data, bool to_null)
 {
@@ -254,6 +303,8 @@ static void do_transition(void *data, bool to_null)
 	}
 
 	if (valid && !to_null) {
+		record_prefetch(ss, ssd->slides.cur.source);
+
 		calldata_set_int(&ssd->cd, "index", ssd->slides.cur.slide_idx);
 		calldata_set_string(&ssd->cd, "path", ssd->slides.cur.path);
 
@@ -298,16 +349,22 @@ static inline obs_source_t *create_source_from_file(struct slideshow *ss,
 						    const char *file, bool now)
 {
 	obs_data_t *settings = obs_data_create();
+	os_task_queue_t *queue;
 	obs_source_t *source;
 
 	obs_data_set_string(settings, "file", file);
 	obs_data_set_bool(settings, "unload", false);
 	obs_data_set_bool(settings, "is_slide", !now);
+	obs_data_set_int(settings, "max_width", ss->cx);
+	obs_data_set_int(settings, "max_height", ss->cy);
 	source = obs_source_create_private("image_source", NULL, settings);
 
 	obs_data_release(settings);
 
-	os_task_queue_queue_task(ss->queue, decode_image,
+	/* spread slides across the decode threads so the next few slides
+	 * are decoded at the same time */
+	queue = ss->queues[ss->next_queue++ % ss->queue_count];
+	os_task_queue_queue_task(queue, decode_image,
 				 obs_source_get_weak_source(source));
 
 	return source;
@@ -331,6 +388,139 @@ static struct source_data *find_existing_source(struct active_slides *as,
 	return psd;
 }
 
+/* only decoded slides are counted, as their memory usage is still changing
+ * while they're being decoded */
+static inline uint64_t get_slide_memory(const struct source_data *sd)
+{
+	void *data = sd->source ? obs_obj_get_data(sd->source) : NULL;
+
+	if (!data || !image_source_is_decoded(data))
+		return 0;
+
+	return image_source_get_memory_usage(data);
+}
+
+static uint64_t get_deque_memory(struct deque *buf)
+{
+	size_t count = buf->size / sizeof(struct source_data);
+	uint64_t memory = 0;
+
+	for (size_t i = 0; i < count; i++)
+		memory += get_slide_memory(
+			deque_data(buf, i * sizeof(struct source_data)));
+
+	return memory;
+}
+
+static uint64_t get_memory_usage(struct slideshow_data *ssd)
+{
+	uint64_t memory = get_slide_memory(&ssd->slides.cur);
+
+	memory += get_deque_memory(&ssd->slides.prev);
+	memory += get_deque_memory(&ssd->slides.next);
+
+	for (size_t i = 0; i < ssd->cache.num; i++)
+		memory += get_slide_memory(&ssd->cache.array[i].sd);
+
+	return memory;
+}
+
+static void update_memory_stats(struct slideshow *ss)
+{
+	uint64_t memory = get_memory_usage(&ss->data);
+
+	pthread_mutex_lock(&ss->stats_mutex);
+	ss->stats.memory = memory;
+	if (memory > ss->stats.peak_memory)
+		ss->stats.peak_memory = memory;
+	pthread_mutex_unlock(&ss->stats_mutex);
+}
+
+/* evicts the least recently used cached slides until the memory usage is
+ * within the cache size.  active slides are never evicted */
+static void trim_cache(struct slideshow *ss)
+{
+	struct slideshow_data *ssd = &ss->data;
+	uint64_t memory = get_memory_usage(ssd);
+
+	while (ssd->cache.num && memory > ssd->cache_limit) {
+		size_t oldest = 0;
+
+		for (size_t i = 1; i < ssd->cache.num; i++) {
+			if (ssd->cache.array[i].last_used <
+			    ssd->cache.array[oldest].last_used)
+				oldest = i;
+		}
+
+		memory -= get_slide_memory(&ssd->cache.array[oldest].sd);
+		free_source_data(&ssd->cache.array[oldest].sd);
+		da_erase(ssd->cache, oldest);
+	}
+}
+
+/* moves a slide that is no longer active into the cache */
+static void release_slide(struct slideshow *ss, struct source_data *sd)
+{
+	struct slideshow_data *ssd = &ss->data;
+	struct source_data *active;
+	struct cached_slide *cs;
+
+	if (!sd->source)
+		return;
+
+	active = find_existing_source(&ssd->slides, sd->slide_idx);
+	if (active && active->source == sd->source) {
+		free_source_data(sd);
+		return;
+	}
+
+	for (size_t i = 0; i < ssd->cache.num; i++) {
+		if (ssd->cache.array[i].sd.slide_idx == sd->slide_idx) {
+			free_source_data(sd);
+			return;
+		}
+	}
+
+	cs = da_push_back_new(ssd->cache);
+	cs->sd = *sd;
+	cs->last_used = ++ssd->use_count;
+}
+
+static void release_active_slides(struct slideshow *ss,
+				  struct active_slides *slides)
+{
+	struct source_data sd;
+
+	while (slides->prev.size) {
+		deque_pop_front(&slides->prev, &sd, sizeof(sd));
+		release_slide(ss, &sd);
+	}
+
+	while (slides->next.size) {
+		deque_pop_front(&slides->next, &sd, sizeof(sd));
+		release_slide(ss, &sd);
+	}
+
+	release_slide(ss, &slides->cur);
+
+	deque_free(&slides->prev);
+	deque_free(&slides->next);
+}
+
+static bool take_cached_source(struct slideshow_data *ssd, size_t slide_idx,
+			       struct source_data *sd)
+{
+	for (size_t i = 0; i < ssd->cache.num; i++) {
+		if (ssd->cache.array[i].sd.slide_idx == slide_idx) {
+			*sd = ssd->cache.array[i].sd;
+			da_erase(ssd->cache, i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /* get a new source_data structure and reuse existing sources if possible. *
  * use the 'new' parameter if you want to create a brand new list of       *
  * active sources while still reusing the old list as well.                */
@@ -365,6 +555,9 @@ static struct source_data get_new_source(struct slideshow *ss,
 		}
 	}
 
+	if (take_cached_source(ssd, slide_idx, &sd))
+		return sd;
+
 	/* ----------------------------------------------- */
 	/* and then create a new one if we don't           */
 
@@ -392,7 +585,7 @@ static void restart_slides(struct slideshow *ss)
 		new_slides.cur = get_new_source(ss, &new_slides, start_idx);
 
 		idx = start_idx;
-		for (size_t i = 0; i < SLIDE_BUFFER_COUNT; i++) {
+		for (size_t i = 0; i < ssd->prefetch_count; i++) {
 			idx = get_new_file(ssd, idx, true);
 			sd = get_new_source(ss, &new_slides, idx);
 			deque_push_back(&new_slides.next, &sd, sizeof(sd));
@@ -406,8 +599,10 @@ static void restart_slides(struct slideshow *ss)
 		}
 	}
 
-	free_active_slides(&ssd->slides);
+	struct active_slides old_slides = ssd->slides;
 	ssd->slides = new_slides;
+	release_active_slides(ss, &old_slides);
+	trim_cache(ss);
 }
 
 static void ss_update(void *data, obs_data_t *settings)
@@ -455,6 +650,14 @@ static void ss_update(void *data, obs_data_t *settings)
 	new_data.randomize = obs_data_get_bool(settings, S_RANDOMIZE);
 	new_data.loop = obs_data_get_bool(settings, S_LOOP);
 	new_data.hide = obs_data_get_bool(settings, S_HIDE);
+	new_data.prefetch_count =
+		(size_t)obs_data_get_int(settings, S_PREFETCH);
+	new_data.cache_limit =
+		(uint64_t)obs_data_get_int(settings, S_CACHE_SIZE) * 1024 *
+		1024;
+
+	if (new_data.prefetch_count < 1)
+		new_data.prefetch_count = 1;
 
 	if (!old_data.tr_name || strcmp(tr_name, old_data.tr_name) != 0)
 		new_tr = obs_source_create_private(tr_name, NULL, NULL);
@@ -555,13 +758,15 @@ static void ss_update(void *data, obs_data_t *settings)
 	/* ------------------------------------- */
 	/* update files                          */
 
+	/* slides are downscaled to the bounding size when decoded */
+	ss->cx = cx;
+	ss->cy = cy;
+
 	restart_slides(ss);
 
 	/* ------------------------------------- */
 	/* restart transition                    */
 
-	ss->cx = cx;
-	ss->cy = cy;
 	obs_transition_set_size(ss->transition, cx, cy);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
@@ -638,8 +843,8 @@ static void ss_next_slide(void *data)
 	if (!ssd->files.num || obs_transition_get_time(ss->transition) < 1.0f)
 		return;
 
-	struct source_data *last = deque_data(
-		&slides->next, (SLIDE_BUFFER_COUNT - 1) * sizeof(sd));
+	struct source_data *last =
+		deque_data(&slides->next, slides->next.size - sizeof(sd));
 
 	size_t slide_idx = last->slide_idx;
 	if (ss->data.randomize)
@@ -652,7 +857,8 @@ static void ss_next_slide(void *data)
 	deque_push_back(&slides->prev, &slides->cur, sizeof(sd));
 	deque_pop_front(&slides->next, &slides->cur, sizeof(sd));
 	deque_pop_front(&slides->prev, &sd, sizeof(sd));
-	free_source_data(&sd);
+	release_slide(ss, &sd);
+	trim_cache(ss);
 
 	do_transition(ss, false);
 }
@@ -682,7 +888,8 @@ static void ss_previous_slide(void *data)
 	deque_push_front(&slides->next, &slides->cur, sizeof(sd));
 	deque_pop_back(&slides->prev, &slides->cur, sizeof(sd));
 	deque_pop_back(&slides->next, &sd, sizeof(sd));
-	free_source_data(&sd);
+	release_slide(ss, &sd);
+	trim_cache(ss);
 
 	do_transition(ss, false);
 }
@@ -765,13 +972,44 @@ static void total_slides_proc(void *data, calldata_t *cd)
 	calldata_set_int(cd, "total_files", ss->data.files.num);
 }
 
+static void prefetch_stats_proc(void *data, calldata_t *cd)
+{
+	struct slideshow *ss = data;
+	struct prefetch_stats stats;
+	double hit_rate = 0.0;
+
+	pthread_mutex_lock(&ss->stats_mutex);
+	stats = ss->stats;
+	pthread_mutex_unlock(&ss->stats_mutex);
+
+	if (stats.hits + stats.misses)
+		hit_rate = (double)stats.hits /
+			   (double)(stats.hits + stats.misses);
+
+	calldata_set_int(cd, "hits", (long long)stats.hits);
+	calldata_set_int(cd, "misses", (long long)stats.misses);
+	calldata_set_float(cd, "hit_rate", hit_rate);
+	calldata_set_int(cd, "memory", (long long)stats.memory);
+	calldata_set_int(cd, "peak_memory", (long long)stats.peak_memory);
+}
+
 static void ss_destroy(void *data)
 {
 	struct slideshow *ss = data;
 
-	os_task_queue_destroy(ss->queue);
+	for (size_t i = 0; i < ss->queue_count; i++)
+		os_task_queue_destroy(ss->queues[i]);
+
+	if (ss->stats.hits + ss->stats.misses) {
+		info("%" PRIu64 " of %" PRIu64 " slides were decoded before "
+		     "being shown, peak memory %" PRIu64 " MB",
+		     ss->stats.hits, ss->stats.hits + ss->stats.misses,
+		     ss->stats.peak_memory / (1024 * 1024));
+	}
+
 	obs_source_release(ss->transition);
 	free_slideshow_data(&ss->data);
+	pthread_mutex_destroy(&ss->stats_mutex);
 	bfree(ss);
 }
 
@@ -779,6 +1017,7 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct slideshow *ss = bzalloc(sizeof(*ss));
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	int threads = os_get_logical_cores() / 2;
 
 	ss->source = source;
 
@@ -786,7 +1025,23 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 	ss->data.paused = false;
 	ss->data.stop = false;
 
-	ss->queue = os_task_queue_create();
+	pthread_mutex_init_value(&ss->stats_mutex);
+	if (pthread_mutex_init(&ss->stats_mutex, NULL) != 0)
+		goto error;
+
+	if (threads < 1)
+		threads = 1;
+	else if (threads > MAX_DECODE_THREADS)
+		threads = MAX_DECODE_THREADS;
+
+	for (int i = 0; i < threads; i++) {
+		os_task_queue_t *queue = os_task_queue_create();
+		if (queue)
+			ss->queues[ss->queue_count++] = queue;
+	}
+
+	if (!ss->queue_count)
+		goto error;
 
 	ss->play_pause_hotkey = obs_hotkey_register_source(
 		source, "SlideShow.PlayPause",
@@ -813,6 +1068,11 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 			 current_slide_proc, ss);
 	proc_handler_add(ph, "void total_files(out int total_files)",
 			 total_slides_proc, ss);
+	proc_handler_add(ph,
+			 "void get_prefetch_stats(out int hits, "
+			 "out int misses, out float hit_rate, "
+			 "out int memory, out int peak_memory)",
+			 prefetch_stats_proc, ss);
 
 	signal_handler_t *sh = obs_source_get_signal_handler(ss->source);
 	signal_handler_add(sh, "void slide_changed(int index, string path)");
@@ -821,6 +1081,10 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 
 	UNUSED_PARAMETER(settings);
 	return ss;
+
+error:
+	ss_destroy(ss);
+	return NULL;
 }
 
 static void ss_video_render(void *data, gs_effect_t *effect)
@@ -844,6 +1108,8 @@ static void ss_video_tick(void *data, float seconds)
 	if (!ss->transition || !ssd->slide_time)
 		return;
 
+	update_memory_stats(ss);
+
 	if (ssd->restart_on_activate && ssd->use_cut) {
 		ssd->elapsed = 0.0f;
 		restart_slides(ss);
@@ -973,6 +1239,8 @@ static void ss_defaults(obs_data_t *settings)
 				    S_BEHAVIOR_ALWAYS_PLAY);
 	obs_data_set_default_string(settings, S_MODE, S_MODE_AUTO);
 	obs_data_set_default_bool(settings, S_LOOP, true);
+	obs_data_set_default_int(settings, S_PREFETCH, SLIDE_BUFFER_COUNT);
+	obs_data_set_default_int(settings, S_CACHE_SIZE, 512);
 }
 
 static const char *file_filter = "Image files (*.bmp *.tga *.png *.jpeg *.jpg"
@@ -1034,6 +1302,13 @@ static obs_properties_t *ss_properties(void *data)
 	obs_properties_add_bool(ppts, S_HIDE, T_HIDE);
 	obs_properties_add_bool(ppts, S_RANDOMIZE, T_RANDOMIZE);
 
+	obs_properties_add_int(ppts, S_PREFETCH, T_PREFETCH, 1, 32, 1);
+
+	p = obs_properties_add_int(ppts, S_CACHE_SIZE, T_CACHE_SIZE, 0, 16384,
+				   64);
+	obs_property_int_set_suffix(p, " MB");
+	obs_property_set_long_description(p, T_CACHE_SIZE_TOOLTIP);
+
 	p = obs_properties_add_list(ppts, S_CUSTOM_SIZE, T_CUSTOM_SIZE,
 				    OBS_COMBO_TYPE_EDITABLE,
 				    OBS_COMBO_FORMAT_STRING);
@@ -31,6 +31,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <util/threading.h>
 #include <util/bmem.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/platform.h>
 #include <obs-module.h>
@@ -65,6 +66,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/* number of buffers always left queued with the driver, frames are copied
+ * instead of being handed to libobs directly when fewer would be left */
+#define V4L2_MIN_QUEUED_BUFFERS 2
+
+/**
+ * Mapped buffers, shared with libobs while it holds on to captured frames
+ *
+ * The buffers are only unmapped once capture has stopped and libobs has
+ * released every frame pointing into them, which can be after the source has
+ * been destroyed.
+ */
+struct v4l2_shared_buffers {
+	volatile long refs;
+	volatile long borrowed;
+
+	pthread_mutex_t mutex;
+	uint32_t generation;
+	DARRAY(uint32_t) released;
+
+	struct v4l2_buffer_data buffers;
+};
+
+/**
+ * Buffer held by libobs, released buffers are queued again by the capture
+ * thread unless capture was restarted in the meantime
+ */
+struct v4l2_borrowed_frame {
+	struct v4l2_shared_buffers *shared;
+	uint32_t generation;
+	uint32_t index;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -91,7 +124,7 @@ struct v4l2_data {
 	int width;
 	int height;
 	int linesize;
-	struct v4l2_buffer_data buffers;
+	struct v4l2_shared_buffers *shared;
 
 	bool auto_reset;
 	int timeout_frames;
@@ -161,6 +194,115 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+static struct v4l2_shared_buffers *v4l2_shared_buffers_create(void)
+{
+	struct v4l2_shared_buffers *shared =
+		bzalloc(sizeof(struct v4l2_shared_buffers));
+
+	shared->refs = 1;
+	pthread_mutex_init(&shared->mutex, NULL);
+	return shared;
+}
+
+static void v4l2_shared_buffers_release(struct v4l2_shared_buffers *shared)
+{
+	if (os_atomic_dec_long(&shared->refs) != 0)
+		return;
+
+	v4l2_destroy_mmap(&shared->buffers);
+	da_free(shared->released);
+	pthread_mutex_destroy(&shared->mutex);
+	bfree(shared);
+}
+
+/**
+ * Forget about buffers held by libobs, used when capture is stopped or
+ * restarted, as that queues all buffers with the driver again
+ */
+static void v4l2_shared_buffers_reset(struct v4l2_shared_buffers *shared)
+{
+	pthread_mutex_lock(&shared->mutex);
+	shared->generation++;
+	da_resize(shared->released, 0);
+	pthread_mutex_unlock(&shared->mutex);
+}
+
+static void v4l2_release_frame(void *param)
+{
+	struct v4l2_borrowed_frame *frame = param;
+	struct v4l2_shared_buffers *shared = frame->shared;
+
+	pthread_mutex_lock(&shared->mutex);
+	if (frame->generation == shared->generation)
+		da_push_back(shared->released, &frame->index);
+	pthread_mutex_unlock(&shared->mutex);
+
+	os_atomic_dec_long(&shared->borrowed);
+	v4l2_shared_buffers_release(shared);
+	bfree(frame);
+}
+
+/**
+ * Queue buffers released by libobs with the driver again
+ */
+static int_fast32_t v4l2_requeue_released(struct v4l2_data *data)
+{
+	struct v4l2_shared_buffers *shared = data->shared;
+	struct v4l2_buffer buf;
+	int_fast32_t ret = 0;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+
+	pthread_mutex_lock(&shared->mutex);
+	for (size_t i = 0; i < shared->released.num; i++) {
+		buf.index = shared->released.array[i];
+		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	da_resize(shared->released, 0);
+	pthread_mutex_unlock(&shared->mutex);
+
+	return ret;
+}
+
+/**
+ * Hand a captured buffer to libobs without copying it
+ *
+ * @return false if too few buffers would be left with the driver, in which
+ *         case the frame has to be copied and the buffer queued right away
+ */
+static bool v4l2_output_borrowed(struct v4l2_data *data,
+				 const struct obs_source_frame *out,
+				 uint32_t index)
+{
+	struct v4l2_shared_buffers *shared = data->shared;
+	struct v4l2_borrowed_frame *frame;
+	long queued = (long)shared->buffers.count -
+		      os_atomic_load_long(&shared->borrowed) - 1;
+
+	if (queued < V4L2_MIN_QUEUED_BUFFERS)
+		return false;
+
+	frame = bmalloc(sizeof(struct v4l2_borrowed_frame));
+	frame->shared = shared;
+	frame->index = index;
+
+	pthread_mutex_lock(&shared->mutex);
+	frame->generation = shared->generation;
+	pthread_mutex_unlock(&shared->mutex);
+
+	os_atomic_inc_long(&shared->refs);
+	os_atomic_inc_long(&shared->borrowed);
+
+	obs_source_output_video_borrowed(data->source, out, v4l2_release_frame,
+					 frame);
+	return true;
+}
+
 /*
  * Worker thread to get video data
  */
@@ -176,6 +318,7 @@ static void *v4l2_thread(void *vptr)
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
+	bool borrowed;
 	int fps_num, fps_denom;
 	float ffps;
 	uint64_t timeout_usec;
@@ -193,7 +336,7 @@ static void *v4l2_thread(void *vptr)
 	     "%s: select timeout set to %" PRIu64 " (%dx frame periods)",
 	     data->device_id, timeout_usec, data->timeout_frames);
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	if (v4l2_start_capture(data->dev, &data->shared->buffers) < 0)
 		goto exit;
 
 	blog(LOG_DEBUG, "%s: new capture started", data->device_id);
@@ -205,6 +348,12 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_DEBUG, "%s: obs frame prepared", data->device_id);
 
 	while (os_event_try(data->event) == EAGAIN) {
+		if (v4l2_requeue_released(data) < 0) {
+			blog(LOG_ERROR, "%s: failed to enqueue buffer",
+			     data->device_id);
+			break;
+		}
+
 		FD_ZERO(&fds);
 		FD_SET(data->dev, &fds);
 
@@ -223,7 +372,8 @@ static void *v4l2_thread(void *vptr)
 			     data->device_id);
 
 #ifdef _DEBUG
-			v4l2_query_all_buffers(data->dev, &data->buffers);
+			v4l2_query_all_buffers(data->dev,
+					       &data->shared->buffers);
 #endif
 
 			if (v4l2_ioctl(data->dev, VIDIOC_LOG_STATUS) < 0) {
@@ -232,8 +382,10 @@ static void *v4l2_thread(void *vptr)
 			}
 
 			if (data->auto_reset) {
-				if (v4l2_reset_capture(data->dev,
-						       &data->buffers) == 0)
+				v4l2_shared_buffers_reset(data->shared);
+				if (v4l2_reset_capture(
+					    data->dev,
+					    &data->shared->buffers) == 0)
 					blog(LOG_INFO,
 					     "%s: stream reset successful",
 					     data->device_id);
@@ -269,7 +421,8 @@ static void *v4l2_thread(void *vptr)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *)data->buffers.info[buf.index].start;
+		start = (uint8_t *)data->shared->buffers.info[buf.index].start;
+		borrowed = false;
 
 		if (data->pixfmt == V4L2_PIX_FMT_MJPEG ||
 		    data->pixfmt == V4L2_PIX_FMT_H264) {
@@ -282,13 +435,19 @@ static void *v4l2_thread(void *vptr)
 		} else {
 			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 				out.data[i] = start + plane_offsets[i];
+
+			borrowed = v4l2_output_borrowed(data, &out, buf.index);
 		}
-		obs_source_output_video(data->source, &out);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
-			blog(LOG_ERROR, "%s: failed to enqueue buffer",
-			     data->device_id);
-			break;
+		if (!borrowed) {
+			obs_source_output_video(data->source, &out);
+
+			if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+				blog(LOG_ERROR,
+				     "%s: failed to enqueue buffer",
+				     data->device_id);
+				break;
+			}
 		}
 
 		frames++;
@@ -928,7 +1087,11 @@ static void v4l2_terminate(struct v4l2_data *data)
 	    data->pixfmt == V4L2_PIX_FMT_H264) {
 		v4l2_destroy_decoder(&data->decoder);
 	}
-	v4l2_destroy_mmap(&data->buffers);
+	if (data->shared) {
+		v4l2_shared_buffers_reset(data->shared);
+		v4l2_shared_buffers_release(data->shared);
+		data->shared = NULL;
+	}
 
 	if (data->dev != -1) {
 		v4l2_close(data->dev);
@@ -1043,7 +1206,8 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float)fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	data->shared = v4l2_shared_buffers_create();
+	if (v4l2_create_mmap(data->dev, &data->shared->buffers) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
@@ -46,6 +46,10 @@ target_sources(
           obs-ffmpeg-output.h
           obs-ffmpeg-mux.c
           obs-ffmpeg-mux.h
+          obs-ffmpeg-mux-shm.c
+          obs-ffmpeg-mux-shm.h
+          obs-ffmpeg-spill.c
+          obs-ffmpeg-spill.h
           obs-ffmpeg-hls-mux.c
           obs-ffmpeg-source.c
           obs-ffmpeg-compat.h
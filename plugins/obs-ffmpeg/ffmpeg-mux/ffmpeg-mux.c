@@ -20,6 +20,11 @@
 #include <windows.h>
 #define inline __inline
 
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <stdio.h>
@@ -76,6 +81,94 @@ static inline void resize_buf_free(struct resize_buf *rb)
 
 /* ------------------------------------------------------------------------- */
 
+static struct {
+	struct ffm_shm_header *header;
+	uint8_t *data;
+	size_t size;
+} shm = {0};
+
+static void shm_ring_open(const char *name)
+{
+#ifndef _WIN32
+	struct ffm_shm_header *header;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (shm.header)
+		return;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open shared memory ring '%s'\n",
+			name);
+		return;
+	}
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*header)) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	close(fd);
+	shm_unlink(name);
+
+	if (map == MAP_FAILED)
+		return;
+
+	header = map;
+	if (header->magic != FFM_SHM_MAGIC ||
+	    header->data_offset + header->capacity > (uint64_t)st.st_size) {
+		munmap(map, (size_t)st.st_size);
+		return;
+	}
+
+	shm.header = header;
+	shm.data = (uint8_t *)map + header->data_offset;
+	shm.size = (size_t)st.st_size;
+
+	os_atomic_set_long(&header->ready, 1);
+#else
+	/* not implemented, everything keeps going through the pipe */
+	(void)name;
+#endif
+}
+
+static void shm_ring_close(void)
+{
+#ifndef _WIN32
+	if (shm.header)
+		munmap(shm.header, shm.size);
+#endif
+	shm.header = NULL;
+}
+
+static uint8_t *shm_ring_get(struct ffm_packet_info *info)
+{
+	if (!shm.header)
+		return NULL;
+
+	uint64_t capacity = shm.header->capacity;
+	uint64_t offset = info->shm_pos % capacity;
+
+	if (offset + info->size > capacity)
+		return NULL;
+	return shm.data + offset;
+}
+
+/* lets the other side reuse the space used by this payload */
+static void shm_ring_release(struct ffm_packet_info *info)
+{
+	if (info->shared && shm.header)
+		os_atomic_set_long(
+			&shm.header->tail,
+			(long)(uint32_t)(info->shm_pos + info->size));
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct main_params {
 	char *file;
 	/* printable_file is file with any stream key information removed */
@@ -671,21 +764,33 @@ static size_t safe_read(void *vdata, size_t size)
 	return total;
 }
 
+static uint8_t *read_payload(struct ffm_packet_info *info,
+			     struct resize_buf *rb)
+{
+	if (info->shared)
+		return shm_ring_get(info);
+
+	resize_buf_resize(rb, info->size);
+	return safe_read(rb->buf, info->size) == info->size ? rb->buf : NULL;
+}
+
 static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
 {
 	struct ffm_packet_info info = {0};
+	struct resize_buf rb = {0};
 
 	bool success = safe_read(&info, sizeof(info)) == sizeof(info);
 	if (success) {
-		uint8_t *data = malloc(info.size);
+		uint8_t *data = read_payload(&info, &rb);
 
-		if (safe_read(data, info.size) == info.size) {
+		if (data) {
 			ffmpeg_mux_header(ffm, data, &info);
 		} else {
 			success = false;
 		}
 
-		free(data);
+		shm_ring_release(&info);
+		resize_buf_free(&rb);
 	}
 
 	return success;
@@ -1299,16 +1404,30 @@ int main(int argc, char *argv[])
 			continue;
 		}
 
-		resize_buf_resize(&rb, info.size);
+		if (info.type == FFM_PACKET_SHM_RING) {
+			resize_buf_resize(&rb, info.size + 1);
+			if (safe_read(rb.buf, info.size) != info.size) {
+				fail = true;
+				continue;
+			}
+			rb.buf[info.size] = 0;
+			shm_ring_open((const char *)rb.buf);
+			continue;
+		}
+
+		uint8_t *data = read_payload(&info, &rb);
 
-		if (safe_read(rb.buf, info.size) == info.size) {
-			fail = !ffmpeg_mux_packet(&ffm, rb.buf, &info);
+		if (data) {
+			fail = !ffmpeg_mux_packet(&ffm, data, &info);
 		} else {
 			fail = true;
 		}
+
+		shm_ring_release(&info);
 	}
 
 	ffmpeg_mux_free(&ffm);
+	shm_ring_close();
 	resize_buf_free(&rb);
 	resize_buf_free(&rb_filename);
 
@@ -23,6 +23,7 @@ enum ffm_packet_type {
 	FFM_PACKET_VIDEO,
 	FFM_PACKET_AUDIO,
 	FFM_PACKET_CHANGE_FILE,
+	FFM_PACKET_SHM_RING,
 };
 
 #define FFM_SUCCESS 0
@@ -36,4 +37,29 @@ struct ffm_packet_info {
 	uint32_t index;
 	enum ffm_packet_type type;
 	bool keyframe;
+
+	/* payload is in the shared memory ring at shm_pos instead of
+	 * following the info structure in the pipe */
+	bool shared;
+	uint64_t shm_pos;
+};
+
+/* Optional shared memory ring for packet payloads.  The name of the ring is
+ * sent with FFM_PACKET_SHM_RING after the headers; ffmpeg-mux sets ready
+ * once it has mapped it, and until then all payloads go through the pipe.
+ * Positions only ever increase, the offset within the ring is the position
+ * modulo capacity, and a payload never wraps around the end of the ring.
+ * tail only holds the low 32 bits of the position, as long is 32-bit on
+ * Windows; the ring is far smaller than 4 GiB, so the distance between the
+ * positions is still exact modulo 2^32. */
+#define FFM_SHM_MAGIC 0x6d6d6666
+
+struct ffm_shm_header {
+	uint32_t magic;
+	uint32_t data_offset;
+	uint64_t capacity;
+
+	/* written by ffmpeg-mux */
+	volatile long ready;
+	volatile long tail;
 };
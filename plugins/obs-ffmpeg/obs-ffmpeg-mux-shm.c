@@ -0,0 +1,130 @@
+#include "obs-ffmpeg-mux-shm.h"
+#include "ffmpeg-mux/ffmpeg-mux.h"
+
+#include <util/base.h>
+#include <util/threading.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define SHM_DATA_OFFSET 64
+
+#ifdef _WIN32
+bool mux_shm_create(struct mux_shm *shm, size_t capacity)
+{
+	/* not implemented, payloads always go through the pipe */
+	UNUSED_PARAMETER(capacity);
+	memset(shm, 0, sizeof(*shm));
+	return false;
+}
+
+void mux_shm_destroy(struct mux_shm *shm)
+{
+	memset(shm, 0, sizeof(*shm));
+}
+
+#else
+static volatile long shm_id = 0;
+
+bool mux_shm_create(struct mux_shm *shm, size_t capacity)
+{
+	size_t size = SHM_DATA_OFFSET + capacity;
+	void *map;
+	int fd;
+
+	memset(shm, 0, sizeof(*shm));
+
+	/* the read position is only shared as 32 bits */
+	if (capacity > INT32_MAX)
+		return false;
+
+	snprintf(shm->name, sizeof(shm->name), "/obs-ffmpeg-mux-%d-%ld",
+		 (int)getpid(), os_atomic_inc_long(&shm_id));
+
+	fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) {
+		blog(LOG_DEBUG, "[ffmpeg muxer] shm_open failed: %s",
+		     strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		blog(LOG_DEBUG, "[ffmpeg muxer] ftruncate failed: %s",
+		     strerror(errno));
+		close(fd);
+		shm_unlink(shm->name);
+		return false;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		blog(LOG_DEBUG, "[ffmpeg muxer] mmap failed: %s",
+		     strerror(errno));
+		shm_unlink(shm->name);
+		return false;
+	}
+
+	shm->header = map;
+	shm->data = (uint8_t *)map + SHM_DATA_OFFSET;
+	shm->size = size;
+	shm->capacity = capacity;
+
+	shm->header->magic = FFM_SHM_MAGIC;
+	shm->header->data_offset = SHM_DATA_OFFSET;
+	shm->header->capacity = capacity;
+	return true;
+}
+
+void mux_shm_destroy(struct mux_shm *shm)
+{
+	if (shm->header) {
+		/* ffmpeg-mux unlinks it once attached, but it may never have
+		 * gotten that far */
+		shm_unlink(shm->name);
+		munmap(shm->header, shm->size);
+	}
+
+	memset(shm, 0, sizeof(*shm));
+}
+#endif
+
+bool mux_shm_push(struct mux_shm *shm, const uint8_t *data, size_t size,
+		  uint64_t *p_pos)
+{
+	if (!shm->header || !size || size > shm->capacity)
+		return false;
+
+	if (!shm->ready) {
+		if (!os_atomic_load_long(&shm->header->ready))
+			return false;
+		shm->ready = true;
+	}
+
+	uint32_t tail = (uint32_t)os_atomic_load_long(&shm->header->tail);
+	uint64_t pos = shm->head;
+	size_t offset = (size_t)(pos % shm->capacity);
+
+	if (offset + size > shm->capacity) {
+		pos += shm->capacity - offset;
+		offset = 0;
+	}
+
+	/* ffmpeg-mux is behind, send this one through the pipe */
+	if ((uint32_t)(pos + size) - tail > shm->capacity)
+		return false;
+
+	memcpy(shm->data + offset, data, size);
+	shm->head = pos + size;
+	shm->shared_bytes += size;
+
+	*p_pos = pos;
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <util/c99defs.h>
+
+struct ffm_shm_header;
+
+/* Producer side of the shared memory payload ring used by ffmpeg-mux */
+struct mux_shm {
+	struct ffm_shm_header *header;
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	uint64_t head;
+	bool ready;
+
+	char name[64];
+
+	uint64_t shared_bytes;
+};
+
+bool mux_shm_create(struct mux_shm *shm, size_t capacity);
+void mux_shm_destroy(struct mux_shm *shm);
+
+/* Copies a payload into the ring if ffmpeg-mux has attached and there is
+ * room for it, returning its position in p_pos. */
+bool mux_shm_push(struct mux_shm *shm, const uint8_t *data, size_t size,
+		  uint64_t *p_pos);
@@ -45,12 +45,33 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 }
 #endif
 
+/* packets whose data lives in the replay buffer's spill file are not
+ * reference counted */
+static inline void replay_packet_ref(struct ffmpeg_muxer *stream,
+				     struct encoder_packet *dst,
+				     struct encoder_packet *src)
+{
+	if (spill_ring_contains(&stream->spill, src->data))
+		*dst = *src;
+	else
+		obs_encoder_packet_ref(dst, src);
+}
+
+static inline void replay_packet_release(struct ffmpeg_muxer *stream,
+					 struct encoder_packet *pkt)
+{
+	if (spill_ring_contains(&stream->spill, pkt->data))
+		memset(pkt, 0, sizeof(*pkt));
+	else
+		obs_encoder_packet_release(pkt);
+}
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
 	while (stream->packets.size > 0) {
 		struct encoder_packet pkt;
 		deque_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
+		replay_packet_release(stream, &pkt);
 	}
 
 	deque_free(&stream->packets);
@@ -70,11 +91,12 @@ static void ffmpeg_mux_destroy(void *data)
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
 	for (size_t i = 0; i < stream->mux_packets.num; i++)
-		obs_encoder_packet_release(&stream->mux_packets.array[i]);
+		replay_packet_release(stream, &stream->mux_packets.array[i]);
 	da_free(stream->mux_packets);
 	deque_free(&stream->packets);
+	spill_ring_free(&stream->spill);
 
-	os_process_pipe_destroy(stream->pipe);
+	stop_pipe(stream, NULL);
 	dstr_free(&stream->path);
 	dstr_free(&stream->printable_path);
 	dstr_free(&stream->stream_key);
@@ -501,8 +523,7 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 	}
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		stop_pipe(stream, &ret);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -640,52 +661,90 @@ static void generate_filename(struct ffmpeg_muxer *stream, struct dstr *dst,
 	obs_data_release(settings);
 }
 
-bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
+static void get_packet_info(struct ffmpeg_muxer *stream,
+			    const struct encoder_packet *packet,
+			    struct ffm_packet_info *info)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
-	size_t ret;
 
-	struct ffm_packet_info info = {.pts = packet->pts,
-				       .dts = packet->dts,
-				       .size = (uint32_t)packet->size,
-				       .index = (int)packet->track_idx,
-				       .type = is_video ? FFM_PACKET_VIDEO
-							: FFM_PACKET_AUDIO,
-				       .keyframe = packet->keyframe};
+	*info = (struct ffm_packet_info){
+		.pts = packet->pts,
+		.dts = packet->dts,
+		.size = (uint32_t)packet->size,
+		.index = (int)packet->track_idx,
+		.type = is_video ? FFM_PACKET_VIDEO : FFM_PACKET_AUDIO,
+		.keyframe = packet->keyframe};
 
 	if (stream->split_file) {
 		if (is_video) {
-			info.dts -= stream->video_pts_offset;
-			info.pts -= stream->video_pts_offset;
+			info->dts -= stream->video_pts_offset;
+			info->pts -= stream->video_pts_offset;
 		} else {
-			info.dts -= stream->audio_dts_offsets[info.index];
-			info.pts -= stream->audio_dts_offsets[info.index];
+			info->dts -= stream->audio_dts_offsets[info->index];
+			info->pts -= stream->audio_dts_offsets[info->index];
 		}
 	}
+}
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info,
-				    sizeof(info));
-	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
-		signal_failure(stream);
-		return false;
-	}
+bool write_packets(struct ffmpeg_muxer *stream, struct encoder_packet *packets,
+		   size_t num)
+{
+	struct ffm_packet_info info[MAX_WRITE_PACKETS];
+	struct os_process_pipe_buf bufs[MAX_WRITE_PACKETS * 2];
+
+	while (num) {
+		size_t count = num < MAX_WRITE_PACKETS ? num : MAX_WRITE_PACKETS;
+		size_t num_bufs = 0;
+		size_t total = 0;
+		size_t ret;
+
+		/* info structure and packet data go out in a single write,
+		 * with the data in the shared memory ring when possible */
+		for (size_t i = 0; i < count; i++) {
+			struct encoder_packet *pkt = &packets[i];
+
+			get_packet_info(stream, pkt, &info[i]);
+			info[i].shared = mux_shm_push(&stream->shm, pkt->data,
+						      pkt->size,
+						      &info[i].shm_pos);
+
+			bufs[num_bufs].data = (const uint8_t *)&info[i];
+			bufs[num_bufs++].len = sizeof(info[i]);
+			total += sizeof(info[i]);
+
+			if (!info[i].shared) {
+				bufs[num_bufs].data = pkt->data;
+				bufs[num_bufs++].len = pkt->size;
+				total += pkt->size;
+			}
+		}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
-	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
-		signal_failure(stream);
-		return false;
-	}
+		ret = os_process_pipe_writev(stream->pipe, bufs, num_bufs);
+		if (ret != total) {
+			warn("os_process_pipe_writev for packet data failed");
+			signal_failure(stream);
+			return false;
+		}
 
-	stream->total_bytes += packet->size;
+		for (size_t i = 0; i < count; i++) {
+			stream->total_bytes += packets[i].size;
 
-	if (stream->split_file)
-		stream->cur_size += packet->size;
+			if (stream->split_file)
+				stream->cur_size += packets[i].size;
+		}
+
+		packets += count;
+		num -= count;
+	}
 
 	return true;
 }
 
+bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
+{
+	return write_packets(stream, packet, 1);
+}
+
 static bool send_audio_headers(struct ffmpeg_muxer *stream,
 			       obs_encoder_t *aencoder, size_t idx)
 {
@@ -710,6 +769,39 @@ static bool send_video_headers(struct ffmpeg_muxer *stream)
 	return write_packet(stream, &packet);
 }
 
+static void send_shm_ring(struct ffmpeg_muxer *stream)
+{
+	if (!mux_shm_create(&stream->shm, MUX_SHM_SIZE))
+		return;
+
+	uint32_t size = (uint32_t)strlen(stream->shm.name);
+	struct ffm_packet_info info = {.type = FFM_PACKET_SHM_RING,
+				       .size = size};
+	struct os_process_pipe_buf bufs[] = {
+		{(const uint8_t *)&info, sizeof(info)},
+		{(const uint8_t *)stream->shm.name, size},
+	};
+
+	if (os_process_pipe_writev(stream->pipe, bufs, 2) !=
+	    sizeof(info) + size)
+		mux_shm_destroy(&stream->shm);
+}
+
+void stop_pipe(struct ffmpeg_muxer *stream, int *ret)
+{
+	int code = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	if (stream->shm.shared_bytes)
+		info("Sent %llu MB through shared memory",
+		     (unsigned long long)(stream->shm.shared_bytes /
+					  (1024 * 1024)));
+	mux_shm_destroy(&stream->shm);
+
+	if (ret)
+		*ret = code;
+}
+
 bool send_headers(struct ffmpeg_muxer *stream)
 {
 	obs_encoder_t *aencoder;
@@ -728,6 +820,10 @@ bool send_headers(struct ffmpeg_muxer *stream)
 		}
 	} while (aencoder);
 
+	/* ffmpeg-mux only reads the ring name after the headers */
+	if (!stream->shm.header)
+		send_shm_ring(stream);
+
 	return true;
 }
 
@@ -1007,6 +1103,17 @@ static void get_last_replay(void *data, calldata_t *cd)
 		calldata_set_string(cd, "path", stream->path.array);
 }
 
+static void get_last_replay_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+	if (!os_atomic_load_bool(&stream->muxing)) {
+		calldata_set_int(cd, "save_ms", (long long)stream->last_save_ms);
+		calldata_set_int(cd, "latency_ms",
+				 (long long)stream->last_save_latency_ms);
+		calldata_set_int(cd, "bytes", (long long)stream->last_save_bytes);
+	}
+}
+
 static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 {
 	UNUSED_PARAMETER(settings);
@@ -1022,6 +1129,10 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 	proc_handler_add(ph, "void save()", save_replay_proc, stream);
 	proc_handler_add(ph, "void get_last_replay(out string path)",
 			 get_last_replay, stream);
+	proc_handler_add(ph,
+			 "void get_last_replay_stats(out int save_ms, "
+			 "out int latency_ms, out int bytes)",
+			 get_last_replay_stats, stream);
 
 	signal_handler_t *sh = obs_output_get_signal_handler(output);
 	signal_handler_add(sh, "void saved()");
@@ -1037,6 +1148,44 @@ static void replay_buffer_destroy(void *data)
 	ffmpeg_mux_destroy(data);
 }
 
+static void replay_buffer_init_spill(struct ffmpeg_muxer *stream,
+				     obs_data_t *settings)
+{
+	const char *dir = obs_data_get_string(settings, "spill_directory");
+	bool spill = obs_data_get_bool(settings, "spill_to_disk");
+
+	/* a previous save may still be reading from the old spill file */
+	if (stream->mux_thread_joinable) {
+		pthread_join(stream->mux_thread, NULL);
+		stream->mux_thread_joinable = false;
+	}
+
+	spill_ring_free(&stream->spill);
+
+	if (!spill)
+		return;
+	if (!stream->max_size) {
+		warn("Spilling to disk requires a maximum buffer size, "
+		     "keeping replay buffer in memory");
+		return;
+	}
+	if (!*dir)
+		dir = obs_data_get_string(settings, "directory");
+
+	/* leave some headroom for the space lost when wrapping around */
+	int64_t capacity = stream->max_size + stream->max_size / 8;
+	if ((uint64_t)capacity > SIZE_MAX ||
+	    !spill_ring_init(&stream->spill, dir, (size_t)capacity)) {
+		warn("Failed to create spill file in '%s', "
+		     "keeping replay buffer in memory",
+		     dir);
+		return;
+	}
+
+	info("Spilling replay buffer to '%s' (%lld MB)", dir,
+	     (long long)(capacity / (1024 * 1024)));
+}
+
 static bool replay_buffer_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -1049,6 +1198,7 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	replay_buffer_init_spill(stream, s);
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -1069,6 +1219,9 @@ static bool purge_front(struct ffmpeg_muxer *stream)
 
 	deque_pop_front(&stream->packets, &pkt, sizeof(pkt));
 
+	if (spill_ring_contains(&stream->spill, pkt.data))
+		spill_ring_pop(&stream->spill, pkt.data, pkt.size);
+
 	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
 
 	if (keyframe)
@@ -1084,7 +1237,7 @@ static bool purge_front(struct ffmpeg_muxer *stream)
 		stream->cur_size -= (int64_t)pkt.size;
 	}
 
-	obs_encoder_packet_release(&pkt);
+	replay_packet_release(stream, &pkt);
 	return keyframe;
 }
 
@@ -1124,14 +1277,16 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 		purge(stream);
 }
 
-static void insert_packet(mux_packets_t *packets, struct encoder_packet *packet,
-			  int64_t video_offset, int64_t *audio_offsets,
-			  int64_t video_pts_offset, int64_t *audio_dts_offsets)
+static void insert_packet(struct ffmpeg_muxer *stream,
+			  struct encoder_packet *packet, int64_t video_offset,
+			  int64_t *audio_offsets, int64_t video_pts_offset,
+			  int64_t *audio_dts_offsets)
 {
+	mux_packets_t *packets = &stream->mux_packets;
 	struct encoder_packet pkt;
 	size_t idx;
 
-	obs_encoder_packet_ref(&pkt, packet);
+	replay_packet_ref(stream, &pkt, packet);
 
 	if (pkt.type == OBS_ENCODER_VIDEO) {
 		pkt.dts_usec -= video_offset;
@@ -1155,7 +1310,9 @@ static void insert_packet(mux_packets_t *packets, struct encoder_packet *packet,
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+	uint64_t start_bytes = stream->total_bytes;
 	bool error = false;
+	size_t count;
 
 	start_pipe(stream, stream->path.array);
 
@@ -1172,26 +1329,44 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		if (!write_packet(stream, pkt)) {
+	/* packets are written straight from the shared encoder buffers (or
+	 * the spill file) and released as soon as they have been sent */
+	for (size_t i = 0; i < stream->mux_packets.num; i += count) {
+		struct encoder_packet *pkts = stream->mux_packets.array + i;
+
+		count = stream->mux_packets.num - i;
+		if (count > MAX_WRITE_PACKETS)
+			count = MAX_WRITE_PACKETS;
+
+		if (!write_packets(stream, pkts, count)) {
 			warn("Could not write packet for file '%s'",
 			     stream->path.array);
 			error = true;
 			goto error;
 		}
-		obs_encoder_packet_release(pkt);
+		for (size_t j = 0; j < count; j++)
+			replay_packet_release(stream, &pkts[j]);
 	}
 
-	info("Wrote replay buffer to '%s'", stream->path.array);
+	uint64_t end = os_gettime_ns();
+	stream->last_save_ms = (end - stream->save_start_ns) / 1000000;
+	stream->last_save_latency_ms =
+		(end / 1000 - (uint64_t)stream->save_request_ts) / 1000;
+	stream->last_save_bytes = stream->total_bytes - start_bytes;
+
+	info("Wrote replay buffer to '%s' (%zu packets, %llu bytes) in %llu ms, "
+	     "%llu ms after the save was requested",
+	     stream->path.array, stream->mux_packets.num,
+	     (unsigned long long)stream->last_save_bytes,
+	     (unsigned long long)stream->last_save_ms,
+	     (unsigned long long)stream->last_save_latency_ms);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
+	stop_pipe(stream, NULL);
 	if (error) {
 		for (size_t i = 0; i < stream->mux_packets.num; i++)
-			obs_encoder_packet_release(
-				&stream->mux_packets.array[i]);
+			replay_packet_release(stream,
+					      &stream->mux_packets.array[i]);
 	}
 	da_free(stream->mux_packets);
 	os_atomic_set_bool(&stream->muxing, false);
@@ -1211,6 +1386,8 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	const size_t size = sizeof(struct encoder_packet);
 	size_t num_packets = stream->packets.size / size;
 
+	stream->save_start_ns = os_gettime_ns();
+
 	da_reserve(stream->mux_packets, num_packets);
 
 	/* ---------------------------- */
@@ -1242,13 +1419,15 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 			}
 		}
 
-		insert_packet(&stream->mux_packets, pkt, video_offset,
-			      audio_offsets, video_pts_offset,
-			      audio_dts_offsets);
+		insert_packet(stream, pkt, video_offset, audio_offsets,
+			      video_pts_offset, audio_dts_offsets);
 	}
 
 	generate_filename(stream, &stream->path, true);
 
+	/* the mux thread writes spilled packets straight from the mapping,
+	 * so keep that region intact until it's done */
+	spill_ring_pin(&stream->spill);
 	os_atomic_set_bool(&stream->muxing, true);
 	stream->mux_thread_joinable = pthread_create(&stream->mux_thread, NULL,
 						     replay_buffer_mux_thread,
@@ -1273,6 +1452,23 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
 	replay_buffer_clear(stream);
 }
 
+static void spill_packet(struct ffmpeg_muxer *stream,
+			 struct encoder_packet *pkt)
+{
+	bool pinned = os_atomic_load_bool(&stream->muxing);
+	uint8_t *data =
+		spill_ring_push(&stream->spill, pkt->data, pkt->size, pinned);
+
+	/* no room left (or a save is still reading the old data), keep this
+	 * one in memory instead */
+	if (!data)
+		return;
+
+	struct encoder_packet heap = *pkt;
+	obs_encoder_packet_release(&heap);
+	pkt->data = data;
+}
+
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -1301,7 +1497,10 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		stream->cur_time = pkt.dts_usec;
 	stream->cur_size += pkt.size;
 
-	deque_push_back(&stream->packets, packet, sizeof(*packet));
+	if (stream->spill.data)
+		spill_packet(stream, &pkt);
+
+	deque_push_back(&stream->packets, &pkt, sizeof(pkt));
 
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
 		stream->keyframes++;
@@ -1315,6 +1514,7 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 			stream->mux_thread_joinable = false;
 		}
 
+		stream->save_request_ts = stream->save_ts;
 		stream->save_ts = 0;
 		replay_buffer_save(stream);
 	}
@@ -1327,6 +1527,8 @@ static void replay_buffer_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_bool(s, "spill_to_disk", false);
+	obs_data_set_default_string(s, "spill_directory", "");
 }
 
 struct obs_output_info replay_buffer = {
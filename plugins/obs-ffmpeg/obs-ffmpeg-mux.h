@@ -9,11 +9,18 @@
 #include <util/platform.h>
 #include <util/threading.h>
 
+#include "obs-ffmpeg-mux-shm.h"
+#include "obs-ffmpeg-spill.h"
+
+#define MAX_WRITE_PACKETS 32
+#define MUX_SHM_SIZE (16 * 1024 * 1024)
+
 typedef DARRAY(struct encoder_packet) mux_packets_t;
 
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
+	struct mux_shm shm;
 	int64_t stop_ts;
 	uint64_t total_bytes;
 	bool sent_headers;
@@ -37,6 +44,12 @@ struct ffmpeg_muxer {
 	obs_hotkey_id hotkey;
 	volatile bool muxing;
 	mux_packets_t mux_packets;
+	struct spill_ring spill;
+	int64_t save_request_ts;
+	uint64_t save_start_ns;
+	uint64_t last_save_ms;
+	uint64_t last_save_latency_ms;
+	uint64_t last_save_bytes;
 
 	/* split file */
 	bool found_video;
@@ -69,7 +82,10 @@ struct ffmpeg_muxer {
 bool stopping(struct ffmpeg_muxer *stream);
 bool active(struct ffmpeg_muxer *stream);
 void start_pipe(struct ffmpeg_muxer *stream, const char *path);
+void stop_pipe(struct ffmpeg_muxer *stream, int *ret);
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet);
+bool write_packets(struct ffmpeg_muxer *stream, struct encoder_packet *packets,
+		   size_t num);
 bool send_headers(struct ffmpeg_muxer *stream);
 int deactivate(struct ffmpeg_muxer *stream, int code);
 void ffmpeg_mux_stop(void *data, uint64_t ts);
@@ -44,9 +44,12 @@ struct ffmpeg_source {
 	char *ffmpeg_options;
 	int buffering_mb;
 	int speed_percent;
+	int decode_threads;
+	enum mp_thread_type decode_thread_type;
 	bool is_looping;
 	bool is_local_file;
 	bool is_hw_decoding;
+	bool pipelined_decode;
 	bool full_decode;
 	bool is_clear_on_media_end;
 	bool restart_on_activate;
@@ -105,6 +108,8 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
+	obs_property_t *pipelined =
+		obs_properties_get(props, "pipelined_decode");
 	obs_property_t *reconnect_delay_sec =
 		obs_properties_get(props, "reconnect_delay_sec");
 	obs_property_set_visible(input, !enabled);
@@ -113,6 +118,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(local_file, enabled);
 	obs_property_set_visible(looping, enabled);
 	obs_property_set_visible(speed, enabled);
+	obs_property_set_visible(pipelined, enabled);
 	obs_property_set_visible(seekable, !enabled);
 	obs_property_set_visible(reconnect_delay_sec, !enabled);
 
@@ -205,6 +211,29 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 	obs_properties_add_bool(props, "hw_decode",
 				obs_module_text("HardwareDecode"));
 
+	prop = obs_properties_add_int_slider(props, "decode_threads",
+					     obs_module_text("DecodeThreads"),
+					     0, 64, 1);
+	obs_property_set_long_description(
+		prop, obs_module_text("DecodeThreads.ToolTip"));
+
+	prop = obs_properties_add_list(props, "decode_thread_type",
+				       obs_module_text("DecodeThreadType"),
+				       OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(prop,
+				  obs_module_text("DecodeThreadType.Auto"),
+				  MP_THREAD_AUTO);
+	obs_property_list_add_int(prop,
+				  obs_module_text("DecodeThreadType.Frame"),
+				  MP_THREAD_FRAME);
+	obs_property_list_add_int(prop,
+				  obs_module_text("DecodeThreadType.Slice"),
+				  MP_THREAD_SLICE);
+
+	obs_properties_add_bool(props, "pipelined_decode",
+				obs_module_text("PipelinedDecode"));
+
 	obs_properties_add_bool(props, "clear_on_media_end",
 				obs_module_text("ClearOnMediaEnd"));
 
@@ -258,6 +287,9 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		"\tis_looping:              %s\n"
 		"\tis_linear_alpha:         %s\n"
 		"\tis_hw_decoding:          %s\n"
+		"\tdecode_threads:          %d\n"
+		"\tdecode_thread_type:      %d\n"
+		"\tpipelined_decode:        %s\n"
 		"\tis_clear_on_media_end:   %s\n"
 		"\trestart_on_activate:     %s\n"
 		"\tclose_when_inactive:     %s\n"
@@ -266,7 +298,9 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		input ? input : "(null)",
 		input_format ? input_format : "(null)", s->speed_percent,
 		s->is_looping ? "yes" : "no", s->is_linear_alpha ? "yes" : "no",
-		s->is_hw_decoding ? "yes" : "no",
+		s->is_hw_decoding ? "yes" : "no", s->decode_threads,
+		(int)s->decode_thread_type,
+		s->pipelined_decode ? "yes" : "no",
 		s->is_clear_on_media_end ? "yes" : "no",
 		s->restart_on_activate ? "yes" : "no",
 		s->close_when_inactive ? "yes" : "no",
@@ -279,6 +313,13 @@ static void get_frame(void *opaque, struct obs_source_frame *f)
 	obs_source_output_video(s->source, f);
 }
 
+static void get_borrowed_frame(void *opaque, struct obs_source_frame *f,
+			       obs_source_frame_release_t release, void *param)
+{
+	struct ffmpeg_source *s = opaque;
+	obs_source_output_video_borrowed(s->source, f, release, param);
+}
+
 static void preload_frame(void *opaque, struct obs_source_frame *f)
 {
 	struct ffmpeg_source *s = opaque;
@@ -331,6 +372,7 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.v_cb = get_frame,
 			.v_preload_cb = preload_frame,
 			.v_seek_cb = seek_frame,
+			.v_borrow_cb = get_borrowed_frame,
 			.a_cb = get_audio,
 			.stop_cb = media_stopped,
 			.path = s->input,
@@ -345,6 +387,9 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.reconnecting = s->reconnecting,
 			.request_preload = s->is_stinger,
 			.full_decode = s->full_decode,
+			.decode_threads = s->decode_threads,
+			.decode_thread_type = s->decode_thread_type,
+			.pipelined_decode = s->pipelined_decode,
 		};
 
 		s->media = media_playback_create(&info);
@@ -446,6 +491,9 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	enum video_range_type range;
 	bool is_linear_alpha;
 	int speed_percent;
+	int decode_threads;
+	enum mp_thread_type decode_thread_type;
+	bool pipelined_decode;
 	bool is_looping;
 
 	bfree(s->input_format);
@@ -477,10 +525,19 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	if (speed_percent < 1 || speed_percent > 200)
 		speed_percent = 100;
 	ffmpeg_options = obs_data_get_string(settings, "ffmpeg_options");
+	decode_threads = (int)obs_data_get_int(settings, "decode_threads");
+	if (decode_threads < 0 || decode_threads > 64)
+		decode_threads = 0;
+	decode_thread_type = (enum mp_thread_type)obs_data_get_int(
+		settings, "decode_thread_type");
+	pipelined_decode = obs_data_get_bool(settings, "pipelined_decode");
 
 	/* Restart media source if these properties are changed */
 	if (s->is_hw_decoding != is_hw_decoding || s->range != range ||
 	    s->speed_percent != speed_percent ||
+	    s->decode_threads != decode_threads ||
+	    s->decode_thread_type != decode_thread_type ||
+	    s->pipelined_decode != pipelined_decode ||
 	    (s->ffmpeg_options &&
 	     strcmp(s->ffmpeg_options, ffmpeg_options) != 0))
 		should_restart_media = true;
@@ -514,6 +571,9 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->is_linear_alpha = is_linear_alpha;
 	s->buffering_mb = (int)obs_data_get_int(settings, "buffering_mb");
 	s->speed_percent = speed_percent;
+	s->decode_threads = decode_threads;
+	s->decode_thread_type = decode_thread_type;
+	s->pipelined_decode = pipelined_decode;
 	s->is_local_file = is_local_file;
 	s->seekable = obs_data_get_bool(settings, "seekable");
 	s->ffmpeg_options = ffmpeg_options ? bstrdup(ffmpeg_options) : NULL;
@@ -594,6 +654,61 @@ static void get_nb_frames(void *data, calldata_t *cd)
 	calldata_set_int(cd, "num_frames", frames);
 }
 
+static void get_decode_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	struct mp_decode_stats stats = {0};
+	double video_ms = 0.0;
+	double audio_ms = 0.0;
+
+	if (s->media)
+		media_playback_get_decode_stats(s->media, &stats);
+
+	if (stats.video_frames)
+		video_ms = (double)stats.video_decode_time_ns /
+			   (double)stats.video_frames / 1000000.0;
+	if (stats.audio_frames)
+		audio_ms = (double)stats.audio_decode_time_ns /
+			   (double)stats.audio_frames / 1000000.0;
+
+	calldata_set_int(cd, "video_frames", (long long)stats.video_frames);
+	calldata_set_float(cd, "video_decode_ms", video_ms);
+	calldata_set_int(cd, "audio_frames", (long long)stats.audio_frames);
+	calldata_set_float(cd, "audio_decode_ms", audio_ms);
+	calldata_set_int(cd, "video_queued_packets",
+			 stats.video_queued_packets);
+	calldata_set_int(cd, "audio_queued_packets",
+			 stats.audio_queued_packets);
+	calldata_set_int(cd, "video_queued_frames", stats.video_queued_frames);
+	calldata_set_int(cd, "audio_queued_frames", stats.audio_queued_frames);
+	calldata_set_int(cd, "late_frames", (long long)stats.late_frames);
+	calldata_set_bool(cd, "pipelined", stats.pipelined);
+}
+
+static void get_cache_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	struct mp_cache_stats stats = {0};
+	bool cached = false;
+	double decode_ms = 0.0;
+
+	if (s->media)
+		cached = media_playback_get_cache_stats(s->media, &stats);
+
+	if (stats.decoded_frames)
+		decode_ms = (double)stats.decode_time_ns /
+			    (double)stats.decoded_frames / 1000000.0;
+
+	calldata_set_bool(cd, "cached", cached);
+	calldata_set_int(cd, "frames", (long long)stats.frames);
+	calldata_set_int(cd, "resident_bytes", (long long)stats.resident_bytes);
+	calldata_set_int(cd, "raw_bytes", (long long)stats.raw_bytes);
+	calldata_set_int(cd, "users", stats.users);
+	calldata_set_int(cd, "decoded_frames", (long long)stats.decoded_frames);
+	calldata_set_float(cd, "decode_ms", decode_ms);
+	calldata_set_bool(cd, "packet_mode", stats.packet_mode);
+}
+
 static bool ffmpeg_source_play_hotkey(void *data, obs_hotkey_pair_id id,
 				      obs_hotkey_t *hotkey, bool pressed)
 {
@@ -688,6 +803,23 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 			 get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
 			 get_nb_frames, s);
+	proc_handler_add(ph,
+			 "void get_decode_stats(out int video_frames, "
+			 "out float video_decode_ms, out int audio_frames, "
+			 "out float audio_decode_ms, "
+			 "out int video_queued_packets, "
+			 "out int audio_queued_packets, "
+			 "out int video_queued_frames, "
+			 "out int audio_queued_frames, out int late_frames, "
+			 "out bool pipelined)",
+			 get_decode_stats, s);
+	proc_handler_add(ph,
+			 "void get_cache_stats(out bool cached, "
+			 "out int frames, out int resident_bytes, "
+			 "out int raw_bytes, "
+			 "out int users, out int decoded_frames, "
+			 "out float decode_ms, out bool packet_mode)",
+			 get_cache_stats, s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
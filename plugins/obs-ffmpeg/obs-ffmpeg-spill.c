@@ -0,0 +1,229 @@
+#include "obs-ffmpeg-spill.h"
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define do_log(level, format, ...) \
+	blog(level, "[replay spill] " format, ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+
+static void spill_file_path(struct dstr *path, const char *dir)
+{
+	dstr_copy(path, dir);
+	dstr_replace(path, "\\", "/");
+	if (dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+
+	os_mkdirs(path->array);
+	dstr_catf(path, ".obs-replay-%llx.spill",
+		  (unsigned long long)os_gettime_ns());
+}
+
+#ifdef _WIN32
+static bool spill_map(struct spill_ring *ring, const char *path,
+		      size_t capacity)
+{
+	uint64_t size = capacity;
+	wchar_t *wpath;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return false;
+
+	/* removed by the system once the last handle is closed */
+	ring->file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+				 CREATE_NEW,
+				 FILE_ATTRIBUTE_TEMPORARY |
+					 FILE_FLAG_DELETE_ON_CLOSE,
+				 NULL);
+	bfree(wpath);
+
+	if (ring->file == INVALID_HANDLE_VALUE) {
+		warn("Failed to create '%s': %lu", path, GetLastError());
+		ring->file = NULL;
+		return false;
+	}
+
+	ring->mapping = CreateFileMappingW(ring->file, NULL, PAGE_READWRITE,
+					   (DWORD)(size >> 32), (DWORD)size,
+					   NULL);
+	if (!ring->mapping) {
+		warn("Failed to map '%s': %lu", path, GetLastError());
+		return false;
+	}
+
+	ring->data = MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				   capacity);
+	if (!ring->data) {
+		warn("Failed to map view of '%s': %lu", path, GetLastError());
+		return false;
+	}
+
+	return true;
+}
+
+static void spill_unmap(struct spill_ring *ring)
+{
+	if (ring->data)
+		UnmapViewOfFile(ring->data);
+	if (ring->mapping)
+		CloseHandle(ring->mapping);
+	if (ring->file)
+		CloseHandle(ring->file);
+
+	ring->data = NULL;
+	ring->mapping = NULL;
+	ring->file = NULL;
+}
+
+#else
+static int spill_preallocate(int fd, size_t capacity)
+{
+#ifdef __APPLE__
+	fstore_t store = {
+		.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL,
+		.fst_posmode = F_PEOFPOSMODE,
+		.fst_length = (off_t)capacity,
+	};
+
+	if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+		store.fst_flags = F_ALLOCATEALL;
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+			return errno;
+	}
+
+	/* F_PREALLOCATE reserves blocks but leaves the size alone */
+	return ftruncate(fd, (off_t)capacity) == 0 ? 0 : errno;
+#else
+	return posix_fallocate(fd, 0, (off_t)capacity);
+#endif
+}
+
+static bool spill_map(struct spill_ring *ring, const char *path,
+		      size_t capacity)
+{
+	int err;
+
+	ring->fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (ring->fd == -1) {
+		warn("Failed to create '%s': %s", path, strerror(errno));
+		return false;
+	}
+
+	/* the mapping keeps the file alive, nothing is left behind if we
+	 * crash */
+	unlink(path);
+
+	/* reserve the blocks up front so that running out of disk space
+	 * fails here, and the replay buffer stays in memory, instead of
+	 * raising SIGBUS on a write to a sparse mapping */
+	err = spill_preallocate(ring->fd, capacity);
+	if (err != 0) {
+		warn("Failed to allocate %zu bytes for '%s': %s", capacity,
+		     path, strerror(err));
+		return false;
+	}
+
+	void *data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+			  ring->fd, 0);
+	if (data == MAP_FAILED) {
+		warn("Failed to map '%s': %s", path, strerror(errno));
+		return false;
+	}
+
+	ring->data = data;
+	return true;
+}
+
+static void spill_unmap(struct spill_ring *ring)
+{
+	if (ring->data)
+		munmap(ring->data, ring->capacity);
+	if (ring->fd != -1)
+		close(ring->fd);
+
+	ring->data = NULL;
+	ring->fd = -1;
+}
+#endif
+
+bool spill_ring_init(struct spill_ring *ring, const char *dir,
+		     size_t capacity)
+{
+	struct dstr path = {0};
+	bool success;
+
+	memset(ring, 0, sizeof(*ring));
+#ifndef _WIN32
+	ring->fd = -1;
+#endif
+	ring->capacity = capacity;
+
+	spill_file_path(&path, dir);
+	success = spill_map(ring, path.array, capacity);
+	dstr_free(&path);
+
+	if (!success)
+		spill_ring_free(ring);
+	return success;
+}
+
+void spill_ring_free(struct spill_ring *ring)
+{
+	if (!ring->capacity)
+		return;
+
+	spill_unmap(ring);
+	memset(ring, 0, sizeof(*ring));
+#ifndef _WIN32
+	ring->fd = -1;
+#endif
+}
+
+uint8_t *spill_ring_push(struct spill_ring *ring, const uint8_t *data,
+			 size_t size, bool pinned)
+{
+	if (!ring->data || !size || size > ring->capacity)
+		return NULL;
+
+	uint64_t oldest = pinned ? ring->pin : ring->tail;
+	uint64_t pos = ring->head;
+	size_t offset = (size_t)(pos % ring->capacity);
+
+	/* allocations never straddle the end of the mapping */
+	if (offset + size > ring->capacity) {
+		pos += ring->capacity - offset;
+		offset = 0;
+	}
+
+	if (pos + size - oldest > ring->capacity)
+		return NULL;
+
+	ring->head = pos + size;
+	memcpy(ring->data + offset, data, size);
+	return ring->data + offset;
+}
+
+void spill_ring_pop(struct spill_ring *ring, const uint8_t *ptr, size_t size)
+{
+	size_t offset = (size_t)(ring->tail % ring->capacity);
+
+	/* the allocation wrapped, skip the unused space at the end */
+	if ((size_t)(ptr - ring->data) != offset)
+		ring->tail += ring->capacity - offset;
+
+	ring->tail += size;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Preallocated, memory-mapped ring file used by the replay buffer to keep
+ * packet data on disk instead of in memory.  Space is handed out in FIFO
+ * order and each allocation is contiguous within the mapping, so a packet's
+ * data pointer can be passed straight to the muxer pipe.
+ *
+ * Positions are logical byte offsets that only ever increase; the physical
+ * offset within the mapping is the position modulo the capacity.
+ */
+struct spill_ring {
+	uint8_t *data;
+	size_t capacity;
+
+	uint64_t head;
+	uint64_t tail;
+	uint64_t pin;
+
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int fd;
+#endif
+};
+
+bool spill_ring_init(struct spill_ring *ring, const char *dir,
+		     size_t capacity);
+void spill_ring_free(struct spill_ring *ring);
+
+/* Copies data into the ring and returns its location in the mapping, or
+ * NULL if there is not enough free space.  If pinned, space at or after the
+ * position recorded by spill_ring_pin is not reused. */
+uint8_t *spill_ring_push(struct spill_ring *ring, const uint8_t *data,
+			 size_t size, bool pinned);
+
+/* Releases the oldest allocation, which must be the one at ptr. */
+void spill_ring_pop(struct spill_ring *ring, const uint8_t *ptr, size_t size);
+
+static inline void spill_ring_pin(struct spill_ring *ring)
+{
+	ring->pin = ring->tail;
+}
+
+static inline bool spill_ring_contains(const struct spill_ring *ring,
+				       const uint8_t *ptr)
+{
+	return ring->data && ptr >= ring->data &&
+	       ptr < ring->data + ring->capacity;
+}
@@ -318,14 +318,14 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
-static void flv_video(struct serializer *s, int32_t dts_offset,
+static bool flv_video(struct serializer *s, int32_t dts_offset,
 		      struct encoder_packet *packet, bool is_header)
 {
 	int64_t offset = packet->pts - packet->dts;
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
 	if (!packet->data || !packet->size)
-		return;
+		return false;
 
 	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
 
@@ -347,18 +347,16 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	s_w8(s, packet->keyframe ? 0x17 : 0x27);
 	s_w8(s, is_header ? 0 : 1);
 	s_wb24(s, get_ms_time(packet, offset));
-	s_write(s, packet->data, packet->size);
-
-	write_previous_tag_size(s);
+	return true;
 }
 
-static void flv_audio(struct serializer *s, int32_t dts_offset,
+static bool flv_audio(struct serializer *s, int32_t dts_offset,
 		      struct encoder_packet *packet, bool is_header)
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
 	if (!packet->data || !packet->size)
-		return;
+		return false;
 
 	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
 
@@ -379,37 +377,13 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 	/* these are the two extra bytes mentioned above */
 	s_w8(s, 0xaf);
 	s_w8(s, is_header ? 0 : 1);
-	s_write(s, packet->data, packet->size);
-
-	write_previous_tag_size(s);
-}
-
-void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
-		    uint8_t **output, size_t *size, bool is_header)
-{
-	struct array_output_data data;
-	struct serializer s;
-
-	array_output_serializer_init(&s, &data);
-
-	if (packet->type == OBS_ENCODER_VIDEO)
-		flv_video(&s, dts_offset, packet, is_header);
-	else
-		flv_audio(&s, dts_offset, packet, is_header);
-
-	*output = data.bytes.array;
-	*size = data.bytes.num;
+	return true;
 }
 
-void flv_packet_audio_ex(struct encoder_packet *packet,
+static bool flv_audio_ex(struct serializer *s, struct encoder_packet *packet,
 			 enum audio_id_t codec_id, int32_t dts_offset,
-			 uint8_t **output, size_t *size, int type, size_t idx)
+			 int type, size_t idx)
 {
-	struct array_output_data data;
-	struct serializer s;
-
-	array_output_serializer_init(&s, &data);
-
 	assert(packet->type == OBS_ENCODER_AUDIO);
 
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
@@ -417,13 +391,13 @@ void flv_packet_audio_ex(struct encoder_packet *packet,
 	bool is_multitrack = idx > 0;
 
 	if (!packet->data || !packet->size)
-		return;
+		return false;
 
 	int header_metadata_size = 5; // w8+wa4cc
 	if (is_multitrack)
 		header_metadata_size += 2; // w8 + w8
 
-	s_w8(&s, RTMP_PACKET_TYPE_AUDIO);
+	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
 
 #ifdef DEBUG_TIMESTAMPS
 	blog(LOG_DEBUG, "Audio: %lu", time_ms);
@@ -434,38 +408,29 @@ void flv_packet_audio_ex(struct encoder_packet *packet,
 	last_time = time_ms;
 #endif
 
-	s_wb24(&s, (uint32_t)packet->size + header_metadata_size);
-	s_wb24(&s, (uint32_t)time_ms);
-	s_w8(&s, (time_ms >> 24) & 0x7F);
-	s_wb24(&s, 0);
+	s_wb24(s, (uint32_t)packet->size + header_metadata_size);
+	s_wb24(s, (uint32_t)time_ms);
+	s_w8(s, (time_ms >> 24) & 0x7F);
+	s_wb24(s, 0);
 
-	s_w8(&s, AUDIO_HEADER_EX |
-			 (is_multitrack ? AUDIO_PACKETTYPE_MULTITRACK : type));
+	s_w8(s, AUDIO_HEADER_EX |
+			(is_multitrack ? AUDIO_PACKETTYPE_MULTITRACK : type));
 	if (is_multitrack) {
-		s_w8(&s, MULTITRACKTYPE_ONE_TRACK | type);
-		s_wa4cc(&s, codec_id);
-		s_w8(&s, (uint8_t)idx);
+		s_w8(s, MULTITRACKTYPE_ONE_TRACK | type);
+		s_wa4cc(s, codec_id);
+		s_w8(s, (uint8_t)idx);
 	} else {
-		s_wa4cc(&s, codec_id);
+		s_wa4cc(s, codec_id);
 	}
 
-	s_write(&s, packet->data, packet->size);
-
-	write_previous_tag_size(&s);
-
-	*output = data.bytes.array;
-	*size = data.bytes.num;
+	return true;
 }
 
 // Y2023 spec
-void flv_packet_ex(struct encoder_packet *packet, enum video_id_t codec_id,
-		   int32_t dts_offset, uint8_t **output, size_t *size, int type,
-		   size_t idx)
+static bool flv_video_ex(struct serializer *s, struct encoder_packet *packet,
+			 enum video_id_t codec_id, int32_t dts_offset,
+			 int type, size_t idx)
 {
-	struct array_output_data data;
-	struct serializer s;
-	array_output_serializer_init(&s, &data);
-
 	assert(packet->type == OBS_ENCODER_VIDEO);
 
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
@@ -482,10 +447,10 @@ void flv_packet_ex(struct encoder_packet *packet, enum video_id_t codec_id,
 	if (is_multitrack)
 		header_metadata_size += 2; // w8+w8
 
-	s_w8(&s, RTMP_PACKET_TYPE_VIDEO);
-	s_wb24(&s, (uint32_t)packet->size + header_metadata_size);
-	s_wtimestamp(&s, time_ms);
-	s_wb24(&s, 0); // always 0
+	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
+	s_wb24(s, (uint32_t)packet->size + header_metadata_size);
+	s_wtimestamp(s, time_ms);
+	s_wb24(s, 0); // always 0
 
 	uint8_t frame_type = packet->keyframe ? FT_KEY : FT_INTER;
 
@@ -494,73 +459,246 @@ void flv_packet_ex(struct encoder_packet *packet, enum video_id_t codec_id,
 	 * The default trackId is 0.
 	 */
 	if (is_multitrack) {
-		s_w8(&s, FRAME_HEADER_EX | PACKETTYPE_MULTITRACK | frame_type);
-		s_w8(&s, MULTITRACKTYPE_ONE_TRACK | type);
-		s_w4cc(&s, codec_id);
+		s_w8(s, FRAME_HEADER_EX | PACKETTYPE_MULTITRACK | frame_type);
+		s_w8(s, MULTITRACKTYPE_ONE_TRACK | type);
+		s_w4cc(s, codec_id);
 		// trackId
-		s_w8(&s, (uint8_t)idx);
+		s_w8(s, (uint8_t)idx);
 	} else {
-		s_w8(&s, FRAME_HEADER_EX | type | frame_type);
-		s_w4cc(&s, codec_id);
+		s_w8(s, FRAME_HEADER_EX | type | frame_type);
+		s_w4cc(s, codec_id);
 	}
 
 	// H.264/HEVC composition time offset
 	if ((codec_id == CODEC_H264 || codec_id == CODEC_HEVC) &&
 	    type == PACKETTYPE_FRAMES) {
-		s_wb24(&s, get_ms_time(packet, packet->pts - packet->dts));
+		s_wb24(s, get_ms_time(packet, packet->pts - packet->dts));
 	}
 
-	// packet data
-	s_write(&s, packet->data, packet->size);
+	return true;
+}
 
-	// packet tail
-	write_previous_tag_size(&s);
+static inline int video_frames_type(struct encoder_packet *packet,
+				    enum video_id_t codec)
+{
+	// PACKETTYPE_FRAMESX is an optimization to avoid sending composition
+	// time offsets of 0. See Enhanced RTMP spec.
+	if ((codec == CODEC_H264 || codec == CODEC_HEVC) &&
+	    packet->dts == packet->pts)
+		return PACKETTYPE_FRAMESX;
+	return PACKETTYPE_FRAMES;
+}
 
-	*output = data.bytes.array;
-	*size = data.bytes.num;
+/* ------------------------------------------------------------------------- */
+/* Tags as slices */
+
+void flv_tag_slices_init(struct flv_tag_slices *tag)
+{
+	memset(tag, 0, sizeof(*tag));
+	array_output_serializer_init(&tag->s, &tag->header);
+}
+
+void flv_tag_slices_free(struct flv_tag_slices *tag)
+{
+	array_output_serializer_free(&tag->header);
+	memset(tag, 0, sizeof(*tag));
+}
+
+static inline void flv_tag_slices_reset(struct flv_tag_slices *tag)
+{
+	array_output_serializer_reset(&tag->header);
+	tag->data = NULL;
+	tag->size = 0;
+}
+
+static bool flv_tag_slices_finish(struct flv_tag_slices *tag, bool success,
+				  struct encoder_packet *packet)
+{
+	if (!success)
+		return false;
+
+	/*
+	 * From FLV file format specification version 10:
+	 * Size of previous [current] tag, including its header.
+	 * For FLV version 1 this value is 11 plus the DataSize of
+	 * the previous [current] tag.
+	 */
+	uint32_t tag_size = (uint32_t)(tag->header.bytes.num + packet->size);
+
+	tag->data = packet->data;
+	tag->size = packet->size;
+	tag->trailer[0] = (uint8_t)(tag_size >> 24);
+	tag->trailer[1] = (uint8_t)(tag_size >> 16);
+	tag->trailer[2] = (uint8_t)(tag_size >> 8);
+	tag->trailer[3] = (uint8_t)tag_size;
+	return true;
+}
+
+bool flv_packet_mux_slices(struct flv_tag_slices *tag,
+			   struct encoder_packet *packet, int32_t dts_offset,
+			   bool is_header)
+{
+	bool success;
+
+	flv_tag_slices_reset(tag);
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		success = flv_video(&tag->s, dts_offset, packet, is_header);
+	else
+		success = flv_audio(&tag->s, dts_offset, packet, is_header);
+
+	return flv_tag_slices_finish(tag, success, packet);
+}
+
+bool flv_packet_start_slices(struct flv_tag_slices *tag,
+			     struct encoder_packet *packet,
+			     enum video_id_t codec, size_t idx)
+{
+	flv_tag_slices_reset(tag);
+	return flv_tag_slices_finish(tag,
+				     flv_video_ex(&tag->s, packet, codec, 0,
+						  PACKETTYPE_SEQ_START, idx),
+				     packet);
+}
+
+bool flv_packet_frames_slices(struct flv_tag_slices *tag,
+			      struct encoder_packet *packet,
+			      enum video_id_t codec, int32_t dts_offset,
+			      size_t idx)
+{
+	flv_tag_slices_reset(tag);
+	return flv_tag_slices_finish(
+		tag,
+		flv_video_ex(&tag->s, packet, codec, dts_offset,
+			     video_frames_type(packet, codec), idx),
+		packet);
+}
+
+bool flv_packet_end_slices(struct flv_tag_slices *tag,
+			   struct encoder_packet *packet, enum video_id_t codec,
+			   size_t idx)
+{
+	flv_tag_slices_reset(tag);
+	return flv_tag_slices_finish(tag,
+				     flv_video_ex(&tag->s, packet, codec, 0,
+						  PACKETTYPE_SEQ_END, idx),
+				     packet);
+}
+
+bool flv_packet_audio_start_slices(struct flv_tag_slices *tag,
+				   struct encoder_packet *packet,
+				   enum audio_id_t codec, size_t idx)
+{
+	flv_tag_slices_reset(tag);
+	return flv_tag_slices_finish(
+		tag,
+		flv_audio_ex(&tag->s, packet, codec, 0,
+			     AUDIO_PACKETTYPE_SEQ_START, idx),
+		packet);
+}
+
+bool flv_packet_audio_frames_slices(struct flv_tag_slices *tag,
+				    struct encoder_packet *packet,
+				    enum audio_id_t codec, int32_t dts_offset,
+				    size_t idx)
+{
+	flv_tag_slices_reset(tag);
+	return flv_tag_slices_finish(tag,
+				     flv_audio_ex(&tag->s, packet, codec,
+						  dts_offset,
+						  AUDIO_PACKETTYPE_FRAMES, idx),
+				     packet);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Contiguous tags */
+
+/* appends the payload and trailer to the header and hands over the buffer */
+static void flv_tag_slices_join(struct flv_tag_slices *tag, bool success,
+				uint8_t **output, size_t *size)
+{
+	if (success) {
+		s_write(&tag->s, tag->data, tag->size);
+		s_write(&tag->s, tag->trailer, sizeof(tag->trailer));
+	} else {
+		flv_tag_slices_free(tag);
+	}
+
+	*output = tag->header.bytes.array;
+	*size = tag->header.bytes.num;
+}
+
+void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
+		    uint8_t **output, size_t *size, bool is_header)
+{
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_mux_slices(&tag, packet, dts_offset,
+						  is_header),
+			    output, size);
 }
 
 void flv_packet_start(struct encoder_packet *packet, enum video_id_t codec,
 		      uint8_t **output, size_t *size, size_t idx)
 {
-	flv_packet_ex(packet, codec, 0, output, size, PACKETTYPE_SEQ_START,
-		      idx);
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_start_slices(&tag, packet, codec, idx),
+			    output, size);
 }
 
 void flv_packet_frames(struct encoder_packet *packet, enum video_id_t codec,
 		       int32_t dts_offset, uint8_t **output, size_t *size,
 		       size_t idx)
 {
-	int packet_type = PACKETTYPE_FRAMES;
-	// PACKETTYPE_FRAMESX is an optimization to avoid sending composition
-	// time offsets of 0. See Enhanced RTMP spec.
-	if ((codec == CODEC_H264 || codec == CODEC_HEVC) &&
-	    packet->dts == packet->pts)
-		packet_type = PACKETTYPE_FRAMESX;
-	flv_packet_ex(packet, codec, dts_offset, output, size, packet_type,
-		      idx);
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_frames_slices(&tag, packet, codec,
+						     dts_offset, idx),
+			    output, size);
 }
 
 void flv_packet_end(struct encoder_packet *packet, enum video_id_t codec,
 		    uint8_t **output, size_t *size, size_t idx)
 {
-	flv_packet_ex(packet, codec, 0, output, size, PACKETTYPE_SEQ_END, idx);
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_end_slices(&tag, packet, codec, idx),
+			    output, size);
 }
 
 void flv_packet_audio_start(struct encoder_packet *packet,
 			    enum audio_id_t codec, uint8_t **output,
 			    size_t *size, size_t idx)
 {
-	flv_packet_audio_ex(packet, codec, 0, output, size,
-			    AUDIO_PACKETTYPE_SEQ_START, idx);
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_audio_start_slices(&tag, packet, codec,
+							  idx),
+			    output, size);
 }
 
 void flv_packet_audio_frames(struct encoder_packet *packet,
 			     enum audio_id_t codec, int32_t dts_offset,
 			     uint8_t **output, size_t *size, size_t idx)
 {
-	flv_packet_audio_ex(packet, codec, dts_offset, output, size,
-			    AUDIO_PACKETTYPE_FRAMES, idx);
+	struct flv_tag_slices tag;
+	flv_tag_slices_init(&tag);
+
+	flv_tag_slices_join(&tag,
+			    flv_packet_audio_frames_slices(&tag, packet, codec,
+							   dts_offset, idx),
+			    output, size);
 }
 
 void flv_packet_metadata(enum video_id_t codec_id, uint8_t **output,
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <obs.h>
+#include <util/array-serializer.h>
 
 #define MILLISECOND_DEN 1000
 
@@ -84,3 +85,42 @@ extern void flv_packet_audio_start(struct encoder_packet *packet,
 extern void flv_packet_audio_frames(struct encoder_packet *packet,
 				    enum audio_id_t codec, int32_t dts_offset,
 				    uint8_t **output, size_t *size, size_t idx);
+
+/*
+ * Same tags as above, but split around the packet payload so that it can be
+ * written by reference instead of being copied behind the tag header.  The
+ * header buffer is reused between calls; data points into the packet, so the
+ * slices are only valid for as long as the packet is.  The functions return
+ * false if there is nothing to write.
+ */
+struct flv_tag_slices {
+	struct array_output_data header;
+	struct serializer s;
+	const uint8_t *data;
+	size_t size;
+	uint8_t trailer[4];
+};
+
+extern void flv_tag_slices_init(struct flv_tag_slices *tag);
+extern void flv_tag_slices_free(struct flv_tag_slices *tag);
+
+extern bool flv_packet_mux_slices(struct flv_tag_slices *tag,
+				  struct encoder_packet *packet,
+				  int32_t dts_offset, bool is_header);
+extern bool flv_packet_start_slices(struct flv_tag_slices *tag,
+				    struct encoder_packet *packet,
+				    enum video_id_t codec, size_t idx);
+extern bool flv_packet_frames_slices(struct flv_tag_slices *tag,
+				     struct encoder_packet *packet,
+				     enum video_id_t codec, int32_t dts_offset,
+				     size_t idx);
+extern bool flv_packet_end_slices(struct flv_tag_slices *tag,
+				  struct encoder_packet *packet,
+				  enum video_id_t codec, size_t idx);
+extern bool flv_packet_audio_start_slices(struct flv_tag_slices *tag,
+					  struct encoder_packet *packet,
+					  enum audio_id_t codec, size_t idx);
+extern bool flv_packet_audio_frames_slices(struct flv_tag_slices *tag,
+					   struct encoder_packet *packet,
+					   enum audio_id_t codec,
+					   int32_t dts_offset, size_t idx);
@@ -34,6 +34,7 @@
 
 #include "happy-eyeballs.h"
 #include <util/platform.h>
+#include <util/threading.h>
 
 #if !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
@@ -1576,11 +1577,67 @@ ReadN(RTMP *r, char *buffer, int n)
     return nOriginalSize - n;
 }
 
+/* Returns TRUE if the send should be retried, otherwise the connection is
+ * torn down */
+static int
+HandleSendError(RTMP *r, const char *func, size_t n)
+{
+    struct linger l;
+    int sockerr = GetSockError();
+    RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d bytes)", func,
+             sockerr, (int)n);
+
+    if (sockerr == EINTR && !RTMP_ctrlC)
+        return TRUE;
+
+    r->last_error_code = sockerr;
+
+    // Force-close the socket. Sometimes a send() error isn't fatal, so
+    // we could end up writing an unpublish message which some services
+    // treat as a clean shutdown. We need to disable lingering too so
+    // the remote side sees an abortive shutdown (RST).
+    l.l_onoff = 1;
+    l.l_linger = 0;
+    setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_LINGER, (char *)&l, sizeof(l));
+    RTMPSockBuf_Close(&r->m_sb);
+
+    RTMP_Close(r);
+    return FALSE;
+}
+
+static void
+AddSendStats(RTMP *r, int nBytes)
+{
+    long kib = os_atomic_load_long(&r->m_nSendKiB);
+
+    os_atomic_inc_long(&r->m_nSendCalls);
+
+    r->m_nSendRemainder += nBytes;
+    if (r->m_nSendRemainder < 1024)
+        return;
+
+    /* the stats can be reset from another thread at any time */
+    while (!os_atomic_compare_exchange_long(&r->m_nSendKiB, &kib,
+                                            kib + r->m_nSendRemainder / 1024))
+        ;
+    r->m_nSendRemainder %= 1024;
+}
+
+void
+RTMP_ResetSendStats(RTMP *r)
+{
+    os_atomic_set_long(&r->m_nSendCalls, 0);
+    os_atomic_set_long(&r->m_nSendKiB, 0);
+}
+
 static int
 WriteN(RTMP *r, const char *buffer, int n)
 {
     const char *ptr = buffer;
-    struct linger l;
+
+    /* keep anything queued in front of this */
+    if (r->m_batch && r->m_batch->count && !RTMP_FlushBatch(r))
+        return FALSE;
 
     while (n > 0)
     {
@@ -1596,25 +1653,9 @@ WriteN(RTMP *r, const char *buffer, int n)
 
         if (nBytes < 0)
         {
-            int sockerr = GetSockError();
-            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d bytes)", __FUNCTION__,
-                     sockerr, n);
-
-            if (sockerr == EINTR && !RTMP_ctrlC)
+            if (HandleSendError(r, __FUNCTION__, n))
                 continue;
 
-            r->last_error_code = sockerr;
-
-            // Force-close the socket. Sometimes a send() error isn't fatal, so
-            // we could end up writing an unpublish message which some services
-            // treat as a clean shutdown. We need to disable lingering too so
-            // the remote side sees an abortive shutdown (RST).
-            l.l_onoff = 1;
-            l.l_linger = 0;
-            setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_LINGER, (char *)&l, sizeof(l));
-            RTMPSockBuf_Close(&r->m_sb);
-
-            RTMP_Close(r);
             n = 1;
             break;
         }
@@ -1622,6 +1663,8 @@ WriteN(RTMP *r, const char *buffer, int n)
         if (nBytes == 0)
             break;
 
+        AddSendStats(r, nBytes);
+
         n -= nBytes;
         ptr += nBytes;
     }
@@ -1629,6 +1672,80 @@ WriteN(RTMP *r, const char *buffer, int n)
     return n == 0;
 }
 
+#define RTMP_COALESCE_SIZE 16384
+
+/* Paths that can't take a vector of buffers (TLS, custom send functions)
+ * get the small slices merged so that every chunk header doesn't turn into
+ * its own write */
+static int
+WriteCoalesced(RTMP *r, const RTMPIOVec *iov, int count)
+{
+    char buf[RTMP_COALESCE_SIZE];
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (len + iov[i].len > sizeof(buf))
+        {
+            if (len && !WriteN(r, buf, (int)len))
+                return FALSE;
+            len = 0;
+        }
+
+        if (iov[i].len > sizeof(buf))
+        {
+            if (!WriteN(r, iov[i].data, (int)iov[i].len))
+                return FALSE;
+            continue;
+        }
+
+        memcpy(buf + len, iov[i].data, iov[i].len);
+        len += iov[i].len;
+    }
+
+    return !len || WriteN(r, buf, (int)len);
+}
+
+/* Note: advances iov past whatever was written */
+static int
+WriteV(RTMP *r, RTMPIOVec *iov, int count)
+{
+    if ((r->m_bCustomSend && r->m_customSendFunc) || r->m_sb.sb_ssl)
+        return WriteCoalesced(r, iov, count);
+
+    while (count > 0)
+    {
+        int nBytes = RTMPSockBuf_Sendv(&r->m_sb, iov, count);
+
+        if (nBytes < 0)
+        {
+            if (HandleSendError(r, __FUNCTION__, iov->len))
+                continue;
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            break;
+
+        AddSendStats(r, nBytes);
+
+        while (count > 0 && (size_t)nBytes >= iov->len)
+        {
+            nBytes -= (int)iov->len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->data += nBytes;
+            iov->len -= nBytes;
+        }
+    }
+
+    return count == 0;
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -4085,18 +4202,19 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+/* Encodes the chunk header for packet so that it ends at hend, compressing
+ * it against the previous packet on the same channel where possible.
+ * Returns the start of the header or NULL on failure. */
+static char *
+EncodePacketHeader(RTMP *r, RTMPPacket *packet, char *hend, int *phSize,
+                   int *pcSize, char *pc, uint32_t *pt)
 {
     const RTMPPacket *prevPacket;
     uint32_t last = 0;
     int nSize;
     int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *header, *hptr, c;
     uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -4107,7 +4225,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
             free(r->m_vecChannelsOut);
             r->m_vecChannelsOut = NULL;
             r->m_channelsAllocatedOut = 0;
-            return FALSE;
+            return NULL;
         }
         r->m_vecChannelsOut = packets;
         memset(r->m_vecChannelsOut + r->m_channelsAllocatedOut, 0, sizeof(RTMPPacket*) * (n - r->m_channelsAllocatedOut));
@@ -4142,7 +4260,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     {
         RTMP_Log(RTMP_LOGERROR, "sanity failed!! trying to send header of type: 0x%02x.",
                  (unsigned char)packet->m_headerType);
-        return FALSE;
+        return NULL;
     }
 
     nSize = packetSize[packet->m_headerType];
@@ -4151,16 +4269,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     t = packet->m_nTimeStamp - last;
     packet->m_nLastWireTimeStamp = t;
 
-    if (packet->m_body)
-    {
-        header = packet->m_body - nSize;
-        hend = packet->m_body;
-    }
-    else
-    {
-        header = hbuf + 6;
-        hend = hbuf + sizeof(hbuf);
-    }
+    header = hend - nSize;
 
     if (packet->m_nChannel > 319)
         cSize = 2;
@@ -4217,6 +4326,30 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     if (nSize > 1 && t >= 0xffffff)
         hptr = AMF_EncodeInt32(hptr, hend, t);
 
+    *phSize = hSize;
+    *pcSize = cSize;
+    *pc = c;
+    *pt = t;
+    return header;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    int nSize;
+    int hSize, cSize;
+    char *header, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    uint32_t t;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    header = EncodePacketHeader(r, packet,
+                                packet->m_body ? packet->m_body : hbuf + sizeof(hbuf),
+                                &hSize, &cSize, &c, &t);
+    if (!header)
+        return FALSE;
+
     nSize = packet->m_nBodySize;
     buffer = packet->m_body;
     nChunkSize = r->m_outChunkSize;
@@ -4533,6 +4666,53 @@ RTMPSockBuf_Send(RTMPSockBuf *sb, const char *buf, int len)
     return rc;
 }
 
+int
+RTMPSockBuf_Sendv(RTMPSockBuf *sb, const RTMPIOVec *iov, int count)
+{
+    int i;
+
+    if (count > RTMP_BATCH_IOV)
+        count = RTMP_BATCH_IOV;
+
+#if defined(RTMP_NETSTACK_DUMP)
+    for (i = 0; i < count; i++)
+        fwrite(iov[i].data, 1, iov[i].len, netstackdump);
+#endif
+
+#ifdef _WIN32
+    {
+        WSABUF bufs[RTMP_BATCH_IOV];
+        DWORD sent = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            bufs[i].buf = (CHAR *)iov[i].data;
+            bufs[i].len = (ULONG)iov[i].len;
+        }
+
+        if (WSASend(sb->sb_socket, bufs, count, &sent, 0, NULL, NULL) != 0)
+            return -1;
+        return (int)sent;
+    }
+#else
+    {
+        struct iovec vecs[RTMP_BATCH_IOV];
+        struct msghdr msg;
+
+        for (i = 0; i < count; i++)
+        {
+            vecs[i].iov_base = (void *)iov[i].data;
+            vecs[i].iov_len = iov[i].len;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vecs;
+        msg.msg_iovlen = count;
+        return (int)sendmsg(sb->sb_socket, &msg, MSG_NOSIGNAL);
+    }
+#endif
+}
+
 int
 RTMPSockBuf_Close(RTMPSockBuf *sb)
 {
@@ -5314,6 +5494,295 @@ fail:
     return total;
 }
 
+/* Writes iov, or appends it to the active batch.  Slices pointing into
+ * scratch are copied since that memory does not outlive the caller. */
+static int
+SendV(RTMP *r, RTMPIOVec *iov, int count, const char *scratch,
+      size_t scratchSize)
+{
+    RTMPBatch *batch = r->m_batch;
+    int i;
+
+    if (!batch)
+        return WriteV(r, iov, count);
+
+    for (i = 0; i < count; i++)
+    {
+        int copy = iov[i].data >= scratch && iov[i].data < scratch + scratchSize;
+        RTMPIOVec *prev;
+        char *dst;
+
+        if (batch->count == RTMP_BATCH_IOV ||
+            (copy && batch->headersUsed + iov[i].len > sizeof(batch->headers)))
+        {
+            if (!RTMP_FlushBatch(r))
+                return FALSE;
+        }
+
+        if (!copy)
+        {
+            batch->iov[batch->count++] = iov[i];
+            continue;
+        }
+
+        dst = batch->headers + batch->headersUsed;
+        memcpy(dst, iov[i].data, iov[i].len);
+        batch->headersUsed += (int)iov[i].len;
+
+        /* consecutive headers, e.g. for packets without a body */
+        prev = batch->count ? &batch->iov[batch->count - 1] : NULL;
+        if (prev && prev->data + prev->len == dst)
+        {
+            prev->len += iov[i].len;
+            continue;
+        }
+
+        batch->iov[batch->count].data = dst;
+        batch->iov[batch->count++].len = iov[i].len;
+    }
+
+    return TRUE;
+}
+
+void
+RTMP_BeginBatch(RTMP *r, RTMPBatch *batch)
+{
+    batch->count = 0;
+    batch->headersUsed = 0;
+    r->m_batch = batch;
+}
+
+int
+RTMP_FlushBatch(RTMP *r)
+{
+    RTMPBatch *batch = r->m_batch;
+    int ret;
+
+    if (!batch || !batch->count)
+        return TRUE;
+
+    /* the fallback in WriteV goes through WriteN */
+    r->m_batch = NULL;
+    ret = WriteV(r, batch->iov, batch->count);
+    r->m_batch = batch;
+
+    batch->count = 0;
+    batch->headersUsed = 0;
+    return ret;
+}
+
+int
+RTMP_EndBatch(RTMP *r)
+{
+    int ret = RTMP_FlushBatch(r);
+    r->m_batch = NULL;
+    return ret;
+}
+
+/* Unlike RTMP_SendPacket, which writes the continuation headers into the
+ * body in place, the body is never written to or copied here; each chunk is
+ * sent as its header followed by slices of the caller's buffers. */
+int
+RTMP_SendPacketV(RTMP *r, RTMPPacket *packet, const RTMPIOVec *body, int count)
+{
+    char hbuf[RTMP_MAX_HEADER_SIZE * 2];
+    char *cbuf = hbuf + RTMP_MAX_HEADER_SIZE;
+    RTMPIOVec out[RTMP_MAX_IOV];
+    int nOut = 0, idx = 0;
+    size_t offset = 0;
+    int hSize, cSize, cHeaderSize;
+    int nSize, nChunkSize;
+    char *header, c;
+    uint32_t t;
+
+    /* chunks have to be merged into a single post, so there's nothing to
+     * gain over the contiguous path */
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+    {
+        char *buf = malloc(RTMP_MAX_HEADER_SIZE + packet->m_nBodySize);
+        char *ptr;
+        int ret, i;
+
+        if (!buf)
+            return FALSE;
+
+        ptr = buf + RTMP_MAX_HEADER_SIZE;
+        for (i = 0; i < count; i++)
+        {
+            memcpy(ptr, body[i].data, body[i].len);
+            ptr += body[i].len;
+        }
+
+        packet->m_body = buf + RTMP_MAX_HEADER_SIZE;
+        ret = RTMP_SendPacket(r, packet, FALSE);
+        packet->m_body = NULL;
+        free(buf);
+        return ret;
+    }
+
+    header = EncodePacketHeader(r, packet, hbuf + RTMP_MAX_HEADER_SIZE,
+                                &hSize, &cSize, &c, &t);
+    if (!header)
+        return FALSE;
+
+    /* type 3 header preceding every chunk after the first */
+    cbuf[0] = (0xc0 | c);
+    cHeaderSize = 1;
+    if (cSize)
+    {
+        int tmp = packet->m_nChannel - 64;
+        cbuf[cHeaderSize++] = tmp & 0xff;
+        if (cSize == 2)
+            cbuf[cHeaderSize++] = tmp >> 8;
+    }
+    if (t >= 0xffffff)
+    {
+        AMF_EncodeInt32(cbuf + cHeaderSize, cbuf + RTMP_MAX_HEADER_SIZE, t);
+        cHeaderSize += 4;
+    }
+
+    nSize = packet->m_nBodySize;
+    nChunkSize = r->m_outChunkSize;
+
+    RTMP_Log(RTMP_LOGDEBUG2, "%s: fd=%d, size=%d", __FUNCTION__, (int)r->m_sb.sb_socket,
+             nSize);
+
+    out[nOut].data = header;
+    out[nOut++].len = hSize;
+
+    while (nSize > 0)
+    {
+        int chunk = nSize < nChunkSize ? nSize : nChunkSize;
+        nSize -= chunk;
+
+        while (chunk > 0)
+        {
+            size_t len;
+
+            if (idx == count)
+            {
+                RTMP_Log(RTMP_LOGERROR, "%s: body is shorter than %u bytes",
+                         __FUNCTION__, packet->m_nBodySize);
+                return FALSE;
+            }
+
+            len = body[idx].len - offset;
+            if (len > (size_t)chunk)
+                len = chunk;
+
+            if (len)
+            {
+                out[nOut].data = body[idx].data + offset;
+                out[nOut++].len = len;
+                chunk -= (int)len;
+                offset += len;
+            }
+
+            if (offset == body[idx].len)
+            {
+                idx++;
+                offset = 0;
+            }
+
+            if (nOut == RTMP_MAX_IOV)
+            {
+                if (!SendV(r, out, nOut, hbuf, sizeof(hbuf)))
+                    return FALSE;
+                nOut = 0;
+            }
+        }
+
+        if (nSize > 0)
+        {
+            out[nOut].data = cbuf;
+            out[nOut++].len = cHeaderSize;
+
+            if (nOut == RTMP_MAX_IOV)
+            {
+                if (!SendV(r, out, nOut, hbuf, sizeof(hbuf)))
+                    return FALSE;
+                nOut = 0;
+            }
+        }
+    }
+
+    if (nOut && !SendV(r, out, nOut, hbuf, sizeof(hbuf)))
+        return FALSE;
+
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    return TRUE;
+}
+
+int
+RTMP_WriteV(RTMP *r, const RTMPIOVec *iov, int count, int streamIdx)
+{
+    RTMPPacket packet = {0};
+    RTMPIOVec body[RTMP_MAX_IOV];
+    const char *buf;
+    size_t remaining, total = 0;
+    int nBody = 0, i;
+
+    if (count < 1 || count > RTMP_MAX_IOV || iov[0].len < 11)
+    {
+        /* FLV pkt too small */
+        return 0;
+    }
+
+    buf = iov[0].data;
+    packet.m_nChannel = 0x04;	/* source channel */
+    packet.m_nInfoField2 = r->Link.streams[streamIdx].id;
+    packet.m_packetType = *buf++;
+    packet.m_nBodySize = AMF_DecodeInt24(buf);
+    buf += 3;
+    packet.m_nTimeStamp = AMF_DecodeInt24(buf);
+    buf += 3;
+    packet.m_nTimeStamp |= *buf++ << 24;
+
+    if (((packet.m_packetType == RTMP_PACKET_TYPE_AUDIO
+            || packet.m_packetType == RTMP_PACKET_TYPE_VIDEO) &&
+            !packet.m_nTimeStamp) || packet.m_packetType == RTMP_PACKET_TYPE_INFO)
+    {
+        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    }
+    else
+    {
+        packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    }
+
+    /* the body follows the tag header, anything past it is the previous
+     * tag size */
+    remaining = packet.m_nBodySize;
+    for (i = 0; i < count && remaining; i++)
+    {
+        size_t skip = i == 0 ? 11 : 0;
+        size_t len = iov[i].len - skip;
+
+        if (len > remaining)
+            len = remaining;
+        if (!len)
+            continue;
+
+        body[nBody].data = iov[i].data + skip;
+        body[nBody++].len = len;
+        remaining -= len;
+    }
+
+    if (remaining)
+    {
+        RTMP_Log(RTMP_LOGDEBUG, "%s, incomplete FLV tag", __FUNCTION__);
+        return FALSE;
+    }
+
+    if (!RTMP_SendPacketV(r, &packet, body, nBody))
+        return -1;
+
+    for (i = 0; i < count; i++)
+        total += iov[i].len;
+    return (int)total;
+}
+
 int
 RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
 {
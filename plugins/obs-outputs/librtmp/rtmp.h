@@ -275,6 +275,25 @@ extern "C"
         void *sb_ssl;
     } RTMPSockBuf;
 
+    /* slice of a scatter/gather write */
+    typedef struct RTMPIOVec
+    {
+        const char *data;
+        size_t len;
+    } RTMPIOVec;
+
+#define RTMP_MAX_IOV 64
+#define RTMP_BATCH_IOV 1024
+
+    /* output queued between RTMP_BeginBatch and RTMP_EndBatch */
+    typedef struct RTMPBatch
+    {
+        RTMPIOVec iov[RTMP_BATCH_IOV];
+        int count;
+        char headers[RTMP_BATCH_IOV * 4];	/* copied chunk headers */
+        int headersUsed;
+    } RTMPBatch;
+
     void RTMPPacket_Reset(RTMPPacket *p);
     void RTMPPacket_Dump(RTMPPacket *p);
     int RTMPPacket_Alloc(RTMPPacket *p, uint32_t nSize);
@@ -455,6 +474,14 @@ extern "C"
         int connect_time_ms;
         int last_error_code;
 
+        RTMPBatch *m_batch;
+        /* socket writes, read from other threads with os_atomic_load_long.
+         * bytes are counted in KiB so that they can't overflow a 32-bit
+         * long, with the rest kept by the writing thread */
+        volatile long m_nSendCalls;
+        volatile long m_nSendKiB;
+        int m_nSendRemainder;
+
 #ifdef CRYPTO
         TLS_CTX RTMP_TLS_ctx;
 #endif
@@ -495,6 +522,9 @@ extern "C"
 
     int RTMP_ReadPacket(RTMP *r, RTMPPacket *packet);
     int RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue);
+    /* sends a packet whose body is given as slices instead of m_body */
+    int RTMP_SendPacketV(RTMP *r, RTMPPacket *packet, const RTMPIOVec *body,
+                         int count);
     int RTMP_SendChunk(RTMP *r, RTMPChunk *chunk);
     int RTMP_IsConnected(RTMP *r);
     SOCKET RTMP_Socket(RTMP *r);
@@ -534,6 +564,7 @@ extern "C"
 
     int RTMPSockBuf_Fill(RTMPSockBuf *sb);
     int RTMPSockBuf_Send(RTMPSockBuf *sb, const char *buf, int len);
+    int RTMPSockBuf_Sendv(RTMPSockBuf *sb, const RTMPIOVec *iov, int count);
     int RTMPSockBuf_Close(RTMPSockBuf *sb);
 
     int RTMP_SendCreateStream(RTMP *r);
@@ -543,6 +574,20 @@ extern "C"
     void RTMP_DropRequest(RTMP *r, int i, int freeit);
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
+    /* writes a single FLV tag given as slices, the first of which must hold
+     * the complete 11 byte tag header */
+    int RTMP_WriteV(RTMP *r, const RTMPIOVec *iov, int count, int streamIdx);
+
+    /* Until RTMP_EndBatch, RTMP_WriteV/RTMP_SendPacketV only queue their
+     * output in batch, which is then sent with as few socket writes as
+     * possible.  The buffers passed to them must stay valid until the batch
+     * has been flushed; any other write flushes it first. */
+    void RTMP_BeginBatch(RTMP *r, RTMPBatch *batch);
+    int RTMP_FlushBatch(RTMP *r);
+    int RTMP_EndBatch(RTMP *r);
+
+    /* zeroes m_nSendCalls and m_nSendKiB */
+    void RTMP_ResetSendStats(RTMP *r);
 
 #ifdef USE_HASHSWF
     /* hashswf.c */
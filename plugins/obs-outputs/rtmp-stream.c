@@ -145,14 +145,44 @@ static void rtmp_stream_destroy(void *data)
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
+	for (size_t i = 0; i < MAX_SEND_BATCH; i++)
+		flv_tag_slices_free(&stream->tags[i]);
+	bfree(stream->batch);
 	bfree(stream);
 }
 
+static inline void get_send_stats(struct rtmp_stream *stream, double *calls,
+				  double *bytes)
+{
+	*calls = (double)os_atomic_load_long(&stream->rtmp.m_nSendCalls);
+	*bytes = (double)os_atomic_load_long(&stream->rtmp.m_nSendKiB) * 1024.0;
+}
+
+static void get_send_stats_proc(void *data, calldata_t *cd)
+{
+	struct rtmp_stream *stream = data;
+	double calls, bytes;
+	double secs = 0.0;
+
+	get_send_stats(stream, &calls, &bytes);
+
+	if (active(stream))
+		secs = (double)(os_gettime_ns() - stream->send_start_ns) /
+		       1000000000.0;
+
+	calldata_set_float(cd, "syscalls_per_sec",
+			   secs > 0.0 ? calls / secs : 0.0);
+	calldata_set_float(cd, "bytes_per_syscall",
+			   calls > 0.0 ? bytes / calls : 0.0);
+}
+
 static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
+	for (size_t i = 0; i < MAX_SEND_BATCH; i++)
+		flv_tag_slices_init(&stream->tags[i]);
 
 	RTMP_LogSetCallback(log_rtmp);
 	RTMP_LogSetLevel(RTMP_LOGWARNING);
@@ -193,6 +223,12 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 		goto fail;
 	}
 
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph,
+			 "void get_send_stats(out float syscalls_per_sec, "
+			 "out float bytes_per_syscall)",
+			 get_send_stats_proc, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 
@@ -250,6 +286,34 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	return new_packet;
 }
 
+/* must be called with packets_mutex locked */
+static inline void add_batch_packet(struct rtmp_stream *stream,
+				    const struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO && !stream->batch_has_video) {
+		stream->batch_video_dts_usec = packet->dts_usec;
+		stream->batch_has_video = true;
+	}
+	stream->batch_packets++;
+}
+
+static inline bool get_next_batch_packet(struct rtmp_stream *stream,
+					 struct encoder_packet *packet)
+{
+	bool new_packet = false;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	if (stream->packets.size) {
+		deque_pop_front(&stream->packets, packet,
+				sizeof(struct encoder_packet));
+		add_batch_packet(stream, packet);
+		new_packet = true;
+	}
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return new_packet;
+}
+
 static bool process_recv_data(struct rtmp_stream *stream, size_t size)
 {
 	UNUSED_PARAMETER(size);
@@ -405,25 +469,49 @@ static int handle_socket_read(struct rtmp_stream *stream)
 	return 0;
 }
 
+/* the tag for the next packet; while batching, each queued packet keeps its
+ * own until the batch has been sent */
+static inline struct flv_tag_slices *next_tag(struct rtmp_stream *stream)
+{
+	return &stream->tags[stream->batch_tags];
+}
+
+/* sends the FLV tag last built into next_tag(), writing the packet payload
+ * straight from the encoder packet */
+static int send_tag(struct rtmp_stream *stream, size_t *size)
+{
+	struct flv_tag_slices *tag = next_tag(stream);
+	RTMPIOVec iov[3] = {
+		{(const char *)tag->header.bytes.array, tag->header.bytes.num},
+		{(const char *)tag->data, tag->size},
+		{(const char *)tag->trailer, sizeof(tag->trailer)},
+	};
+
+	*size = iov[0].len + iov[1].len + iov[2].len;
+
+#ifdef TEST_FRAMEDROPS
+	droptest_cap_data_rate(stream, *size);
+#endif
+
+	if (stream->rtmp.m_batch)
+		stream->batch_tags++;
+
+	return RTMP_WriteV(&stream->rtmp, iov, 3, 0);
+}
+
 static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t size;
+	size_t size = 0;
 	int ret = 0;
 
 	if (handle_socket_read(stream))
 		return -1;
 
-	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset, &data,
-		       &size, is_header);
-
-#ifdef TEST_FRAMEDROPS
-	droptest_cap_data_rate(stream, size);
-#endif
-
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	if (flv_packet_mux_slices(next_tag(stream), packet,
+				  is_header ? 0 : stream->start_dts_offset,
+				  is_header))
+		ret = send_tag(stream, &size);
 
 	if (is_header)
 		bfree(packet->data);
@@ -438,30 +526,29 @@ static int send_packet_ex(struct rtmp_stream *stream,
 			  struct encoder_packet *packet, bool is_header,
 			  bool is_footer, size_t idx)
 {
-	uint8_t *data;
+	struct flv_tag_slices *tag = next_tag(stream);
 	size_t size = 0;
+	bool success;
 	int ret = 0;
 
 	if (handle_socket_read(stream))
 		return -1;
 
 	if (is_header) {
-		flv_packet_start(packet, stream->video_codec[idx], &data, &size,
-				 idx);
+		success = flv_packet_start_slices(
+			tag, packet, stream->video_codec[idx], idx);
 	} else if (is_footer) {
-		flv_packet_end(packet, stream->video_codec[idx], &data, &size,
-			       idx);
+		success = flv_packet_end_slices(tag, packet,
+						stream->video_codec[idx], idx);
 	} else {
-		flv_packet_frames(packet, stream->video_codec[idx],
-				  stream->start_dts_offset, &data, &size, idx);
+		success = flv_packet_frames_slices(tag, packet,
+						   stream->video_codec[idx],
+						   stream->start_dts_offset,
+						   idx);
 	}
 
-#ifdef TEST_FRAMEDROPS
-	droptest_cap_data_rate(stream, size);
-#endif
-
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	if (success)
+		ret = send_tag(stream, &size);
 
 	if (is_header || is_footer) // manually created packets
 		bfree(packet->data);
@@ -476,24 +563,25 @@ static int send_audio_packet_ex(struct rtmp_stream *stream,
 				struct encoder_packet *packet, bool is_header,
 				size_t idx)
 {
-	uint8_t *data;
+	struct flv_tag_slices *tag = next_tag(stream);
 	size_t size = 0;
+	bool success;
 	int ret = 0;
 
 	if (handle_socket_read(stream))
 		return -1;
 
 	if (is_header) {
-		flv_packet_audio_start(packet, stream->audio_codec[idx], &data,
-				       &size, idx);
+		success = flv_packet_audio_start_slices(
+			tag, packet, stream->audio_codec[idx], idx);
 	} else {
-		flv_packet_audio_frames(packet, stream->audio_codec[idx],
-					stream->start_dts_offset, &data, &size,
-					idx);
+		success = flv_packet_audio_frames_slices(
+			tag, packet, stream->audio_codec[idx],
+			stream->start_dts_offset, idx);
 	}
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	if (success)
+		ret = send_tag(stream, &size);
 
 	if (is_header)
 		bfree(packet->data);
@@ -652,6 +740,114 @@ static void log_sndbuf_size(struct rtmp_stream *stream)
 	}
 }
 
+static int send_media_packet(struct rtmp_stream *stream,
+			     struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO &&
+	    (stream->video_codec[packet->track_idx] != CODEC_H264 ||
+	     (stream->video_codec[packet->track_idx] == CODEC_H264 &&
+	      packet->track_idx != 0))) {
+		return send_packet_ex(stream, packet, false, false,
+				      packet->track_idx);
+	} else if (packet->type == OBS_ENCODER_AUDIO &&
+		   packet->track_idx != 0) {
+		return send_audio_packet_ex(stream, packet, false,
+					    packet->track_idx);
+	} else {
+		return send_packet(stream, packet, false);
+	}
+}
+
+/* sends packet along with whatever else is already queued behind it, using
+ * as few socket writes as possible.  sets shutdown if a queued packet is
+ * past the stop timestamp. */
+static int send_batch(struct rtmp_stream *stream,
+		      struct encoder_packet *packet, bool *shutdown)
+{
+	struct encoder_packet held[MAX_SEND_BATCH];
+	struct encoder_packet next;
+	size_t count = 0;
+	size_t bytes = 0;
+	uint64_t send_beg = os_gettime_ns();
+	int ret = 0;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	add_batch_packet(stream, packet);
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	stream->batch_tags = 0;
+	RTMP_BeginBatch(&stream->rtmp, stream->batch);
+
+	for (;;) {
+		/* the batch references the packet data until it is sent */
+		obs_encoder_packet_ref(&held[count++], packet);
+		bytes += packet->size;
+
+		if (send_media_packet(stream, packet) < 0) {
+			ret = -1;
+			break;
+		}
+
+		if (count == MAX_SEND_BATCH || bytes >= MAX_SEND_BATCH_BYTES)
+			break;
+		if (stopping(stream) && stream->stop_ts == 0)
+			break;
+		if (!get_next_batch_packet(stream, &next))
+			break;
+
+		if (stopping(stream) && can_shutdown_stream(stream, &next)) {
+			obs_encoder_packet_release(&next);
+			*shutdown = true;
+			break;
+		}
+
+		*packet = next;
+	}
+
+	if (!RTMP_EndBatch(&stream->rtmp))
+		ret = -1;
+	stream->batch_tags = 0;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	stream->batch_packets = 0;
+	stream->batch_has_video = false;
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	if (ret == 0 && stream->dbr_enabled) {
+		struct dbr_frame dbr_frame;
+
+		/* the packets went out together, so they share their timing */
+		dbr_frame.send_beg = send_beg;
+		dbr_frame.send_end = os_gettime_ns();
+
+		pthread_mutex_lock(&stream->dbr_mutex);
+		for (size_t i = 0; i < count; i++) {
+			dbr_frame.size = held[i].size;
+			dbr_add_frame(stream, &dbr_frame);
+		}
+		pthread_mutex_unlock(&stream->dbr_mutex);
+	}
+
+	for (size_t i = 0; i < count; i++)
+		obs_encoder_packet_release(&held[i]);
+
+	return ret;
+}
+
+static void log_send_stats(struct rtmp_stream *stream)
+{
+	double secs = (double)(os_gettime_ns() - stream->send_start_ns) /
+		      1000000000.0;
+	double calls, bytes;
+
+	get_send_stats(stream, &calls, &bytes);
+	if (calls <= 0.0 || secs <= 0.0)
+		return;
+
+	info("Socket writes: %.0f (%.1f/s), %.0f bytes per write", calls,
+	     calls / secs, bytes / calls);
+}
+
 static void *send_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -662,6 +858,11 @@ static void *send_thread(void *data)
 	log_sndbuf_size(stream);
 #endif
 
+	/* the handshake and connect messages aren't part of the stats, and
+	 * after a reconnect they start over along with the time */
+	stream->send_start_ns = os_gettime_ns();
+	RTMP_ResetSendStats(&stream->rtmp);
+
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
 		struct dbr_frame dbr_frame;
@@ -687,26 +888,24 @@ static void *send_thread(void *data)
 			}
 		}
 
+		if (stream->batch_send) {
+			bool shutdown = false;
+
+			if (send_batch(stream, &packet, &shutdown) < 0) {
+				os_atomic_set_bool(&stream->disconnected, true);
+				break;
+			}
+			if (shutdown)
+				break;
+			continue;
+		}
+
 		if (stream->dbr_enabled) {
 			dbr_frame.send_beg = os_gettime_ns();
 			dbr_frame.size = packet.size;
 		}
 
-		int sent;
-		if (packet.type == OBS_ENCODER_VIDEO &&
-		    (stream->video_codec[packet.track_idx] != CODEC_H264 ||
-		     (stream->video_codec[packet.track_idx] == CODEC_H264 &&
-		      packet.track_idx != 0))) {
-			sent = send_packet_ex(stream, &packet, false, false,
-					      packet.track_idx);
-		} else if (packet.type == OBS_ENCODER_AUDIO &&
-			   packet.track_idx != 0) {
-			sent = send_audio_packet_ex(stream, &packet, false,
-						    packet.track_idx);
-		} else {
-			sent = send_packet(stream, &packet, false);
-		}
-
+		int sent = send_media_packet(stream, &packet);
 		if (sent < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
@@ -736,6 +935,7 @@ static void *send_thread(void *data)
 #if defined(_WIN32)
 	log_sndbuf_size(stream);
 #endif
+	log_send_stats(stream);
 
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
@@ -1425,6 +1625,13 @@ static bool init_connect(struct rtmp_stream *stream)
 	stream->low_latency_mode = false;
 #endif
 
+	/* the new socket loop already buffers writes for its own thread */
+	stream->batch_send =
+		obs_data_get_bool(settings, OPT_BATCH_SEND_ENABLED) &&
+		!stream->new_socket_loop;
+	if (stream->batch_send && !stream->batch)
+		stream->batch = bmalloc(sizeof(RTMPBatch));
+
 	obs_data_release(settings);
 	return true;
 }
@@ -1656,8 +1863,10 @@ static void dbr_inc_bitrate(struct rtmp_stream *stream)
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
 	struct encoder_packet first;
+	int64_t first_dts_usec;
 	int64_t buffer_duration_usec;
-	size_t num_packets = num_buffered_packets(stream);
+	size_t num_packets = num_buffered_packets(stream) +
+			     stream->batch_packets;
 	const char *name = pframes ? "p-frames" : "b-frames";
 	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST
 			       : OBS_NAL_PRIORITY_HIGH;
@@ -1682,12 +1891,19 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
+	/* a batch that is still being written is older than anything that
+	 * is queued, and can no longer have frames dropped from it, but it
+	 * still counts towards how far behind the stream is */
+	if (stream->batch_has_video)
+		first_dts_usec = stream->batch_video_dts_usec;
+	else if (find_first_video_packet(stream, &first))
+		first_dts_usec = first.dts_usec;
+	else
 		return;
 
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	buffer_duration_usec = stream->last_dts_usec - first_dts_usec;
 
 	if (!pframes) {
 		stream->congestion =
@@ -1819,6 +2035,7 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
 	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
+	obs_data_set_default_bool(defaults, OPT_BATCH_SEND_ENABLED, false);
 #ifdef _WIN32
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
@@ -1864,6 +2081,9 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 	}
 	netif_saddr_data_free(&addrs);
 
+	obs_properties_add_bool(props, OPT_BATCH_SEND_ENABLED,
+				obs_module_text("RTMPStream.BatchSend"));
+
 #ifdef _WIN32
 	obs_properties_add_bool(props, OPT_NEWSOCKETLOOP_ENABLED,
 				obs_module_text("RTMPStream.NewSocketLoop"));
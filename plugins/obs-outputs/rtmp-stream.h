@@ -32,6 +32,11 @@
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
 #define OPT_METADATA_MULTITRACK "metadata_multitrack"
+#define OPT_BATCH_SEND_ENABLED "batch_send_enabled"
+
+/* limits on how many queued packets are sent together */
+#define MAX_SEND_BATCH 32
+#define MAX_SEND_BATCH_BYTES (1024 * 1024)
 
 //#define TEST_FRAMEDROPS
 //#define TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS
@@ -60,6 +65,12 @@ struct rtmp_stream {
 	struct deque packets;
 	bool sent_headers;
 
+	/* packets already taken off the queue for the batch that is being
+	 * sent, which still count as buffered when deciding to drop frames */
+	size_t batch_packets;
+	bool batch_has_video;
+	int64_t batch_video_dts_usec;
+
 	bool got_first_packet;
 	int64_t start_dts_offset;
 
@@ -132,6 +143,14 @@ struct rtmp_stream {
 	os_event_t *buffer_has_data_event;
 	os_event_t *socket_available_event;
 	os_event_t *send_thread_signaled_exit;
+
+	bool batch_send;
+	RTMPBatch *batch;
+	uint64_t send_start_ns;
+
+	/* send thread only */
+	struct flv_tag_slices tags[MAX_SEND_BATCH];
+	size_t batch_tags;
 };
 
 #ifdef _WIN32
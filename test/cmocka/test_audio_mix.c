@@ -0,0 +1,53 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <media-io/audio-mix.h>
+
+#define MAX_FLOATS 1024
+
+static float random_sample(void)
+{
+	return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static void audio_mix_matches_scalar_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static float src[MAX_FLOATS];
+	static float dst[MAX_FLOATS];
+	static float expected[MAX_FLOATS];
+
+	srand(1234);
+
+	/* odd offsets and lengths cover the unaligned head and scalar tail */
+	for (size_t offset = 0; offset < 5; offset++) {
+		for (size_t count = 0; count + offset <= MAX_FLOATS;
+		     count += 37) {
+			for (size_t i = 0; i < MAX_FLOATS; i++) {
+				src[i] = random_sample();
+				dst[i] = expected[i] = random_sample();
+			}
+
+			for (size_t i = 0; i < count; i++)
+				expected[offset + i] += src[i];
+
+			audio_mix_float(dst + offset, src, count);
+
+			assert_memory_equal(dst, expected, sizeof(dst));
+		}
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(audio_mix_matches_scalar_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,276 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <util/buffered-file-serializer.h>
+#include <util/array-serializer.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/bmem.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define FPS 60
+#define GOP FPS
+
+static uint32_t next_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+/* the same as write_box_size in mp4-mux.c */
+static void write_box_size(struct serializer *s, int64_t start)
+{
+	int64_t end = serializer_get_pos(s);
+
+	serializer_seek(s, start, SERIALIZE_SEEK_START);
+	s_wb32(s, (uint32_t)(end - start));
+	serializer_seek(s, end, SERIALIZE_SEEK_START);
+}
+
+static void write_box(struct serializer *s, const char *name, uint32_t *seed,
+		      size_t size)
+{
+	int64_t start = serializer_get_pos(s);
+
+	s_wb32(s, 0);
+	s_write(s, name, 4);
+	for (size_t i = 0; i < size; i++)
+		s_w8(s, (uint8_t)next_rand(seed));
+
+	write_box_size(s, start);
+}
+
+/*
+ * Writes a file the way mp4-mux does in hybrid mode: an mdat with a 64-bit
+ * size that is only patched at the very end, and once per second a moof
+ * whose nested boxes each get their size patched after being written,
+ * followed by the sample data.  Returns the number of bytes written.
+ */
+static uint64_t write_mp4(struct serializer *s, uint32_t seed,
+			  uint64_t bitrate, uint64_t max_bytes)
+{
+	size_t frame_size = (size_t)(bitrate / 8 / FPS);
+	uint8_t *frame = bmalloc(frame_size * 6);
+	uint32_t sizes[GOP];
+	int64_t mdat_start;
+
+	for (size_t i = 0; i < frame_size * 6; i++)
+		frame[i] = (uint8_t)next_rand(&seed);
+
+	write_box(s, "ftyp", &seed, 24);
+	write_box(s, "free", &seed, 8);
+
+	mdat_start = serializer_get_pos(s);
+	s_wb32(s, 1);
+	s_write(s, "mdat", 4);
+	s_wb64(s, 0);
+
+	while ((uint64_t)serializer_get_pos(s) < max_bytes) {
+		int64_t moof_start = serializer_get_pos(s);
+		int64_t traf_start;
+		int64_t frag_mdat_start;
+
+		/* keyframe at the start of every gop, which is also much
+		 * larger than the other frames */
+		for (size_t i = 0; i < GOP; i++) {
+			size_t size = frame_size / 2 +
+				      next_rand(&seed) % (frame_size + 1);
+			sizes[i] = (uint32_t)(i == 0 ? size * 3 : size);
+		}
+
+		s_wb32(s, 0);
+		s_write(s, "moof", 4);
+		write_box(s, "mfhd", &seed, 8);
+
+		traf_start = serializer_get_pos(s);
+		s_wb32(s, 0);
+		s_write(s, "traf", 4);
+		write_box(s, "tfhd", &seed, 12);
+		write_box(s, "tfdt", &seed, 12);
+
+		int64_t trun_start = serializer_get_pos(s);
+		s_wb32(s, 0);
+		s_write(s, "trun", 4);
+		s_wb32(s, GOP);
+		for (size_t i = 0; i < GOP; i++)
+			s_wb32(s, sizes[i]);
+		write_box_size(s, trun_start);
+
+		write_box_size(s, traf_start);
+		write_box_size(s, moof_start);
+
+		frag_mdat_start = serializer_get_pos(s);
+		s_wb32(s, 0);
+		s_write(s, "mdat", 4);
+		for (size_t i = 0; i < GOP; i++) {
+			size_t offset = next_rand(&seed) % frame_size;
+			s_write(s, frame + offset, sizes[i]);
+		}
+		write_box_size(s, frag_mdat_start);
+	}
+
+	uint64_t mdat_end = (uint64_t)serializer_get_pos(s);
+	serializer_seek(s, mdat_start + 8, SERIALIZE_SEEK_START);
+	s_wb64(s, mdat_end - (uint64_t)mdat_start);
+	serializer_seek(s, (int64_t)mdat_end, SERIALIZE_SEEK_START);
+
+	write_box(s, "moov", &seed, 4096);
+
+	bfree(frame);
+	return (uint64_t)serializer_get_pos(s);
+}
+
+static void test_file_path(struct dstr *path, const char *name)
+{
+	dstr_copy(path, BUFFERED_FILE_TEST_DIR);
+	os_mkdirs(path->array);
+	dstr_cat_ch(path, '/');
+	dstr_cat(path, name);
+}
+
+static uint64_t write_file(const char *path, bool io_uring, uint32_t seed,
+			   uint64_t bitrate, uint64_t max_bytes,
+			   size_t chunk_size)
+{
+	struct serializer s;
+	uint64_t size;
+
+	buffered_file_serializer_set_io_uring(io_uring);
+	assert_true(
+		buffered_file_serializer_init(&s, path, 0, chunk_size));
+	buffered_file_serializer_set_io_uring(true);
+
+	size = write_mp4(&s, seed, bitrate, max_bytes);
+
+	assert_true(serializer_get_pos(&s) >= 0);
+	buffered_file_serializer_free(&s);
+	return size;
+}
+
+static void assert_file_equal(const char *path, const uint8_t *data,
+			      size_t size)
+{
+	FILE *file = os_fopen(path, "rb");
+	uint8_t *buf = bmalloc(size + 1);
+
+	assert_non_null(file);
+	assert_int_equal(fread(buf, 1, size + 1, file), size);
+	assert_memory_equal(buf, data, size);
+
+	fclose(file);
+	bfree(buf);
+}
+
+/* the io_uring writes complete in any order, so the box size patches must
+ * still end up in the same places as with fwrite and an in-memory file */
+static void buffered_file_patch_test(void **state)
+{
+	static const size_t chunk_sizes[] = {0, 65536, 4096};
+	struct dstr sync_path = {0};
+	struct dstr uring_path = {0};
+	UNUSED_PARAMETER(state);
+
+	test_file_path(&sync_path, "patch_sync.mp4");
+	test_file_path(&uring_path, "patch_uring.mp4");
+
+	for (uint32_t seed = 1; seed <= 6; seed++) {
+		size_t chunk_size = chunk_sizes[seed % 3];
+		uint64_t bitrate = seed * 6000000ULL;
+		uint64_t max_bytes = 8 * 1024 * 1024;
+		struct array_output_data ref_data;
+		struct serializer ref;
+
+		array_output_serializer_init(&ref, &ref_data);
+		uint64_t size = write_mp4(&ref, seed, bitrate, max_bytes);
+		assert_int_equal(ref_data.bytes.num, size);
+
+		assert_int_equal(write_file(sync_path.array, false, seed,
+					    bitrate, max_bytes, chunk_size),
+				 size);
+		assert_int_equal(write_file(uring_path.array, true, seed,
+					    bitrate, max_bytes, chunk_size),
+				 size);
+
+		assert_file_equal(sync_path.array, ref_data.bytes.array, size);
+		assert_file_equal(uring_path.array, ref_data.bytes.array,
+				  size);
+
+		array_output_serializer_free(&ref_data);
+	}
+
+	os_unlink(sync_path.array);
+	os_unlink(uring_path.array);
+	dstr_free(&sync_path);
+	dstr_free(&uring_path);
+}
+
+static uint64_t cpu_time_ns(void)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+		       1000000000ULL +
+	       (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) *
+		       1000ULL;
+#endif
+}
+
+/* how long it takes to write and close a 256 MB recording, and the cpu time
+ * spent on it by all threads */
+static void buffered_file_bitrate_bench(void **state)
+{
+	static const uint64_t bitrates[] = {6000000, 20000000, 50000000,
+					    200000000};
+	struct dstr path = {0};
+	UNUSED_PARAMETER(state);
+
+	test_file_path(&path, "bench.mp4");
+
+	for (size_t i = 0; i < sizeof(bitrates) / sizeof(bitrates[0]); i++) {
+		for (int io_uring = 0; io_uring <= 1; io_uring++) {
+			uint64_t start = os_gettime_ns();
+			uint64_t cpu_start = cpu_time_ns();
+
+			uint64_t size = write_file(path.array, io_uring, 1,
+						   bitrates[i],
+						   256 * 1024 * 1024, 0);
+
+			uint64_t end = os_gettime_ns();
+			uint64_t cpu_end = cpu_time_ns();
+			double gb = (double)size / 1e9;
+
+			print_message("%3llu Mbps %-8s %7.1f MB/s, cpu %6.1f "
+				      "ms per GB\n",
+				      (unsigned long long)(bitrates[i] /
+							   1000000),
+				      io_uring ? "io_uring" : "fwrite",
+				      gb * 1e12 / (double)(end - start),
+				      (double)(cpu_end - cpu_start) / 1e6 /
+					      gb);
+
+			os_unlink(path.array);
+		}
+	}
+
+	dstr_free(&path);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(buffered_file_patch_test),
+		cmocka_unit_test(buffered_file_bitrate_bench),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
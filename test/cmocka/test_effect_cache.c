@@ -0,0 +1,219 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <graphics/effect-cache.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+#define PREPROCESSOR "_OPENGL"
+#define CACHE_PASSES 10
+
+static void assert_optional_string_equal(const char *a, const char *b)
+{
+	assert_true((a == NULL) == (b == NULL));
+	if (a)
+		assert_string_equal(a, b);
+}
+
+static void assert_params_equal(const struct effect_cache_param *a,
+				const struct effect_cache_param *b)
+{
+	assert_string_equal(a->name, b->name);
+	assert_int_equal(a->type, b->type);
+	assert_int_equal(a->default_val.num, b->default_val.num);
+	if (a->default_val.num)
+		assert_memory_equal(a->default_val.array, b->default_val.array,
+				    a->default_val.num);
+
+	assert_int_equal(a->annotations.num, b->annotations.num);
+	for (size_t i = 0; i < a->annotations.num; i++)
+		assert_params_equal(a->annotations.array + i,
+				    b->annotations.array + i);
+}
+
+static void assert_shaders_equal(const struct effect_cache_shader *a,
+				 const struct effect_cache_shader *b)
+{
+	assert_string_equal(a->location, b->location);
+	assert_optional_string_equal(a->source, b->source);
+
+	assert_int_equal(a->params.num, b->params.num);
+	for (size_t i = 0; i < a->params.num; i++)
+		assert_string_equal(a->params.array[i], b->params.array[i]);
+}
+
+static void assert_effects_equal(const struct effect_cache_data *a,
+				 const struct effect_cache_data *b)
+{
+	assert_int_equal(a->params.num, b->params.num);
+	for (size_t i = 0; i < a->params.num; i++)
+		assert_params_equal(a->params.array + i, b->params.array + i);
+
+	assert_int_equal(a->techniques.num, b->techniques.num);
+	for (size_t i = 0; i < a->techniques.num; i++) {
+		const struct effect_cache_technique *ta =
+			a->techniques.array + i;
+		const struct effect_cache_technique *tb =
+			b->techniques.array + i;
+
+		assert_optional_string_equal(ta->name, tb->name);
+		assert_int_equal(ta->passes.num, tb->passes.num);
+
+		for (size_t j = 0; j < ta->passes.num; j++) {
+			assert_optional_string_equal(ta->passes.array[j].name,
+						     tb->passes.array[j].name);
+			assert_shaders_equal(&ta->passes.array[j].vertex,
+					     &tb->passes.array[j].vertex);
+			assert_shaders_equal(&ta->passes.array[j].pixel,
+					     &tb->passes.array[j].pixel);
+		}
+	}
+}
+
+/* parses each of the bundled effects, and compares that against loading them
+ * back from the cache, reporting the time taken for each */
+static void effect_cache_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	os_glob_t *glob;
+	uint64_t start, parse_ns = 0, load_ns = 0;
+	size_t count = 0;
+
+	assert_true(os_mkdirs(OBS_EFFECT_CACHE_DIR) != MKDIR_ERROR);
+	assert_int_equal(os_glob(OBS_EFFECT_DIR "/*.effect", 0, &glob), 0);
+
+	for (size_t i = 0; i < glob->gl_pathc; i++) {
+		const char *file = glob->gl_pathv[i].path;
+		char *effect_string = os_quick_read_utf8_file(file);
+		struct effect_cache_data parsed = {0};
+		struct effect_cache_data loaded = {0};
+		char *errors = NULL;
+		char *cache_file;
+
+		assert_non_null(effect_string);
+
+		cache_file = effect_cache_file_path(OBS_EFFECT_CACHE_DIR,
+						    effect_string, file,
+						    PREPROCESSOR);
+		os_unlink(cache_file);
+
+		for (size_t pass = 0; pass < CACHE_PASSES; pass++) {
+			effect_cache_data_free(&parsed);
+
+			start = os_gettime_ns();
+			assert_true(effect_cache_data_parse(&parsed,
+							    effect_string, file,
+							    PREPROCESSOR,
+							    &errors));
+			parse_ns += os_gettime_ns() - start;
+		}
+
+		assert_false(effect_cache_data_load(&loaded, cache_file,
+						    effect_string,
+						    PREPROCESSOR));
+		assert_true(effect_cache_data_save(&parsed, cache_file,
+						   effect_string,
+						   PREPROCESSOR));
+
+		for (size_t pass = 0; pass < CACHE_PASSES; pass++) {
+			effect_cache_data_free(&loaded);
+
+			start = os_gettime_ns();
+			assert_true(effect_cache_data_load(&loaded, cache_file,
+							   effect_string,
+							   PREPROCESSOR));
+			load_ns += os_gettime_ns() - start;
+		}
+
+		assert_effects_equal(&parsed, &loaded);
+		effect_cache_data_free(&loaded);
+
+		/* must not be used for other text or another backend */
+		assert_false(effect_cache_data_load(&loaded, cache_file, "",
+						    PREPROCESSOR));
+		assert_false(effect_cache_data_load(&loaded, cache_file,
+						    effect_string, "_D3D11"));
+
+		os_unlink(cache_file);
+		effect_cache_data_free(&parsed);
+		bfree(cache_file);
+		bfree(effect_string);
+		count++;
+	}
+
+	os_globfree(glob);
+	assert_true(count > 0);
+
+	print_message("%zu effects: %.2f ms per parse, "
+		      "%.2f ms per cache load\n",
+		      count,
+		      (double)parse_ns / (double)(count * CACHE_PASSES) /
+			      1000000.0,
+		      (double)load_ns / (double)(count * CACHE_PASSES) /
+			      1000000.0);
+}
+
+static void write_file(const char *path)
+{
+	assert_true(os_quick_write_utf8_file(path, "x", 1, false));
+}
+
+/* caches of other versions are removed when the cache is opened, everything
+ * outside of the effect-cache directory is left alone */
+static void effect_cache_dir_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *base = OBS_EFFECT_CACHE_DIR "/dir_test";
+	char *gl_dir, *d3d_dir;
+
+	assert_true(os_mkdirs(OBS_EFFECT_CACHE_DIR
+			      "/dir_test/effect-cache/1.2.3-1/opengl") !=
+		    MKDIR_ERROR);
+	assert_true(os_mkdirs(OBS_EFFECT_CACHE_DIR "/dir_test/1.2.3-1") !=
+		    MKDIR_ERROR);
+	assert_true(os_mkdirs(OBS_EFFECT_CACHE_DIR
+			      "/dir_test/effect-cache/other") != MKDIR_ERROR);
+	write_file(OBS_EFFECT_CACHE_DIR
+		   "/dir_test/effect-cache/1.2.3-1/opengl/a.effect");
+	write_file(OBS_EFFECT_CACHE_DIR "/dir_test/0123456789abcdef.effect");
+
+	gl_dir = effect_cache_dir_open(base, PREPROCESSOR);
+	assert_non_null(gl_dir);
+	assert_true(os_file_exists(gl_dir));
+	assert_non_null(strstr(gl_dir, "/effect-cache/"));
+	assert_non_null(strstr(gl_dir, "/opengl"));
+
+	assert_false(os_file_exists(OBS_EFFECT_CACHE_DIR
+				    "/dir_test/effect-cache/1.2.3-1"));
+	assert_true(os_file_exists(OBS_EFFECT_CACHE_DIR
+				   "/dir_test/effect-cache/other"));
+	assert_true(os_file_exists(OBS_EFFECT_CACHE_DIR "/dir_test/1.2.3-1"));
+	assert_true(os_file_exists(OBS_EFFECT_CACHE_DIR
+				   "/dir_test/0123456789abcdef.effect"));
+
+	/* another backend of the same version keeps the first one's cache */
+	d3d_dir = effect_cache_dir_open(base, "_D3D11");
+	assert_non_null(d3d_dir);
+	assert_string_not_equal(gl_dir, d3d_dir);
+	assert_true(os_file_exists(gl_dir));
+	assert_true(os_file_exists(d3d_dir));
+
+	bfree(gl_dir);
+	bfree(d3d_dir);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(effect_cache_test),
+		cmocka_unit_test(effect_cache_dir_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
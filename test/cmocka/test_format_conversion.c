@@ -0,0 +1,386 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <media-io/format-conversion.h>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+
+#define BENCH_FRAMES 20
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+}
+
+/* odd widths cover the scalar tails after the vector loops */
+static void uyvx_to_nv12_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint32_t widths[] = {1920, 1284, 36};
+
+	srand(1234);
+
+	for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+		uint32_t width = widths[i];
+		uint32_t height = 18;
+		uint8_t *input = bmalloc(width * 4 * height);
+		struct video_frame frame;
+
+		fill_random(input, width * 4 * height);
+		video_frame_init(&frame, VIDEO_FORMAT_NV12, width, height);
+		compress_uyvx_to_nv12(input, width * 4, 0, height, frame.data,
+				      frame.linesize);
+
+		for (uint32_t y = 0; y < height; y += 2) {
+			const uint8_t *line0 = input + y * width * 4;
+			const uint8_t *line1 = line0 + width * 4;
+			const uint8_t *lum0 =
+				frame.data[0] + y * frame.linesize[0];
+			const uint8_t *lum1 = lum0 + frame.linesize[0];
+			const uint8_t *uv =
+				frame.data[1] + y / 2 * frame.linesize[1];
+
+			for (uint32_t x = 0; x < width; x += 2) {
+				const uint8_t *p0 = line0 + x * 4;
+				const uint8_t *p1 = line1 + x * 4;
+				int u = p0[0] + p0[4] + p1[0] + p1[4];
+				int v = p0[2] + p0[6] + p1[2] + p1[6];
+
+				assert_int_equal(lum0[x], p0[1]);
+				assert_int_equal(lum0[x + 1], p0[5]);
+				assert_int_equal(lum1[x], p1[1]);
+				assert_int_equal(lum1[x + 1], p1[5]);
+				assert_int_equal(uv[x], u / 4);
+				assert_int_equal(uv[x + 1], v / 4);
+			}
+		}
+
+		video_frame_free(&frame);
+		bfree(input);
+	}
+}
+
+static void decompress_422_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint32_t width = 1292;
+	uint8_t *input = bmalloc(width * 2);
+	uint32_t *output = bmalloc(width * 4);
+
+	srand(1234);
+	fill_random(input, width * 2);
+
+	/* width / 2 input dwords are expanded per line */
+	decompress_422(input, width, 0, 1, (uint8_t *)output, width, true);
+
+	for (uint32_t i = 0; i < width / 2; i++) {
+		const uint8_t *in = input + i * 4;
+		uint32_t dw = in[0] | in[1] << 8 | in[2] << 16 |
+			      (uint32_t)in[3] << 24;
+
+		assert_int_equal(output[i * 2], dw);
+		assert_int_equal(output[i * 2 + 1], (dw & 0xFFFFFF00) | in[2]);
+	}
+
+	bfree(output);
+	bfree(input);
+}
+
+struct bgra_job {
+	const uint8_t *input;
+	uint32_t linesize;
+	struct video_frame *frame;
+};
+
+static void bgra_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct bgra_job *job = param;
+
+	compress_bgra_to_nv12(job->input, job->linesize, start_y, end_y,
+			      job->frame->data, job->frame->linesize,
+			      VIDEO_CS_709, VIDEO_RANGE_PARTIAL);
+}
+
+/* compares against floating point BT.709 partial range, and checks that a
+ * frame with an odd size converted in slices matches a single call */
+static void bgra_to_nv12_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint32_t width = 1921;
+	const uint32_t height = 1081;
+	const double kr = 0.2126;
+	const double kb = 0.0722;
+	const double kg = 1.0 - kr - kb;
+
+	uint8_t *input = bmalloc(width * 4 * height);
+	struct video_frame frame, sliced;
+	format_conversion_pool_t *pool = format_conversion_pool_create(4);
+	struct bgra_job job = {input, width * 4, &sliced};
+
+	srand(1234);
+	fill_random(input, width * 4 * height);
+	video_frame_init(&frame, VIDEO_FORMAT_NV12, width, height);
+	video_frame_init(&sliced, VIDEO_FORMAT_NV12, width, height);
+
+	compress_bgra_to_nv12(input, width * 4, 0, height, frame.data,
+			      frame.linesize, VIDEO_CS_709,
+			      VIDEO_RANGE_PARTIAL);
+
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t *p = input + (y * width + x) * 4;
+			double lum = kr * p[2] + kg * p[1] + kb * p[0];
+			long expected = lround(16.0 + lum * 219.0 / 255.0);
+			long actual = frame.data[0][y * frame.linesize[0] + x];
+
+			assert_true(labs(expected - actual) <= 1);
+		}
+	}
+
+	for (uint32_t y = 0; y + 1 < height; y += 2) {
+		for (uint32_t x = 0; x + 1 < width; x += 2) {
+			const uint8_t *p0 = input + (y * width + x) * 4;
+			const uint8_t *p1 = p0 + width * 4;
+			const uint8_t *uv =
+				frame.data[1] + y / 2 * frame.linesize[1] + x;
+			double b = (p0[0] + p0[4] + p1[0] + p1[4]) / 4.0;
+			double g = (p0[1] + p0[5] + p1[1] + p1[5]) / 4.0;
+			double r = (p0[2] + p0[6] + p1[2] + p1[6]) / 4.0;
+			double lum = kr * r + kg * g + kb * b;
+			double u = 128.0 + (b - lum) / (2.0 * (1.0 - kb)) *
+						   224.0 / 255.0;
+			double v = 128.0 + (r - lum) / (2.0 * (1.0 - kr)) *
+						   224.0 / 255.0;
+
+			assert_true(labs(lround(u) - uv[0]) <= 1);
+			assert_true(labs(lround(v) - uv[1]) <= 1);
+		}
+	}
+
+	format_conversion_pool_run(pool, height, bgra_slice, &job);
+
+	for (uint32_t y = 0; y < height; y++)
+		assert_memory_equal(frame.data[0] + y * frame.linesize[0],
+				    sliced.data[0] + y * sliced.linesize[0],
+				    width);
+	for (uint32_t y = 0; y < (height + 1) / 2; y++)
+		assert_memory_equal(frame.data[1] + y * frame.linesize[1],
+				    sliced.data[1] + y * sliced.linesize[1],
+				    (width + 1) / 2 * 2);
+
+	format_conversion_pool_destroy(pool);
+	video_frame_free(&sliced);
+	video_frame_free(&frame);
+	bfree(input);
+}
+
+static void p010_round_trip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint32_t width = 1926;
+	const uint32_t height = 6;
+	struct video_frame i010, p010, result;
+
+	video_frame_init(&i010, VIDEO_FORMAT_I010, width, height);
+	video_frame_init(&p010, VIDEO_FORMAT_P010, width, height);
+	video_frame_init(&result, VIDEO_FORMAT_I010, width, height);
+
+	srand(1234);
+	for (size_t plane = 0; plane < 3; plane++) {
+		uint32_t lines = plane ? height / 2 : height;
+		uint16_t *data = (uint16_t *)i010.data[plane];
+
+		for (size_t i = 0; i < i010.linesize[plane] / 2 * lines; i++)
+			data[i] = (uint16_t)(rand() & 0x3FF);
+	}
+
+	convert_i010_to_p010((const uint8_t *const *)i010.data, i010.linesize,
+			     0, height, p010.data, p010.linesize);
+
+	for (uint32_t y = 0; y < height / 2; y++) {
+		const uint16_t *u = (const uint16_t *)(i010.data[1] +
+						       y * i010.linesize[1]);
+		const uint16_t *v = (const uint16_t *)(i010.data[2] +
+						       y * i010.linesize[2]);
+		const uint16_t *uv = (const uint16_t *)(p010.data[1] +
+							y * p010.linesize[1]);
+
+		for (uint32_t x = 0; x < width / 2; x++) {
+			assert_int_equal(uv[x * 2], u[x] << 6);
+			assert_int_equal(uv[x * 2 + 1], v[x] << 6);
+		}
+	}
+
+	convert_p010_to_i010((const uint8_t *const *)p010.data, p010.linesize,
+			     0, height, result.data, result.linesize);
+
+	for (size_t plane = 0; plane < 3; plane++) {
+		uint32_t lines = plane ? height / 2 : height;
+		uint32_t size = plane ? width : width * 2;
+
+		for (uint32_t y = 0; y < lines; y++)
+			assert_memory_equal(
+				i010.data[plane] + y * i010.linesize[plane],
+				result.data[plane] + y * result.linesize[plane],
+				size);
+	}
+
+	video_frame_free(&result);
+	video_frame_free(&p010);
+	video_frame_free(&i010);
+}
+
+/* ------------------------------------------------------------------------- */
+
+enum bench_kernel {
+	BENCH_UYVX_TO_NV12,
+	BENCH_BGRA_TO_NV12,
+	BENCH_I010_TO_P010,
+	BENCH_P010_TO_I010,
+	BENCH_DECOMPRESS_NV12,
+};
+
+static const char *bench_names[] = {
+	"uyvx_to_nv12", "bgra_to_nv12", "i010_to_p010",
+	"p010_to_i010", "decompress_nv12",
+};
+
+struct bench_job {
+	enum bench_kernel kernel;
+	struct video_frame in;
+	struct video_frame out;
+
+	/* bytes read plus bytes written per frame */
+	size_t size;
+};
+
+static void bench_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct bench_job *job = param;
+	const uint8_t *const *in = (const uint8_t *const *)job->in.data;
+
+	switch (job->kernel) {
+	case BENCH_UYVX_TO_NV12:
+		compress_uyvx_to_nv12(in[0], job->in.linesize[0], start_y,
+				      end_y, job->out.data, job->out.linesize);
+		break;
+	case BENCH_BGRA_TO_NV12:
+		compress_bgra_to_nv12(in[0], job->in.linesize[0], start_y,
+				      end_y, job->out.data, job->out.linesize,
+				      VIDEO_CS_709, VIDEO_RANGE_PARTIAL);
+		break;
+	case BENCH_I010_TO_P010:
+		convert_i010_to_p010(in, job->in.linesize, start_y, end_y,
+				     job->out.data, job->out.linesize);
+		break;
+	case BENCH_P010_TO_I010:
+		convert_p010_to_i010(in, job->in.linesize, start_y, end_y,
+				     job->out.data, job->out.linesize);
+		break;
+	case BENCH_DECOMPRESS_NV12:
+		decompress_nv12(in, job->in.linesize, start_y, end_y,
+				job->out.data[0], job->out.linesize[0]);
+		break;
+	}
+}
+
+static void init_bench_job(struct bench_job *job, enum bench_kernel kernel,
+			   uint32_t width, uint32_t height)
+{
+	static const enum video_format formats[][2] = {
+		{VIDEO_FORMAT_BGRA, VIDEO_FORMAT_NV12},
+		{VIDEO_FORMAT_BGRA, VIDEO_FORMAT_NV12},
+		{VIDEO_FORMAT_I010, VIDEO_FORMAT_P010},
+		{VIDEO_FORMAT_P010, VIDEO_FORMAT_I010},
+		{VIDEO_FORMAT_NV12, VIDEO_FORMAT_BGRA},
+	};
+	size_t in_size =
+		video_frame_get_data_size(formats[kernel][0], width, height);
+	size_t out_size =
+		video_frame_get_data_size(formats[kernel][1], width, height);
+
+	job->kernel = kernel;
+	job->size = in_size + out_size;
+	video_frame_init(&job->in, formats[kernel][0], width, height);
+	video_frame_init(&job->out, formats[kernel][1], width, height);
+
+	/* the planes of a frame are allocated together */
+	fill_random(job->in.data[0], in_size);
+}
+
+static double run_bench(format_conversion_pool_t *pool, struct bench_job *job,
+			uint32_t height)
+{
+	uint64_t start;
+
+	/* warm up caches and wake the worker threads */
+	format_conversion_pool_run(pool, height, bench_slice, job);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < BENCH_FRAMES; i++)
+		format_conversion_pool_run(pool, height, bench_slice, job);
+
+	return (double)(job->size * BENCH_FRAMES) /
+	       (double)(os_gettime_ns() - start);
+}
+
+/* reports throughput in GB/s for each kernel, on one thread and sliced
+ * across the pool */
+static void conversion_benchmark_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const uint32_t sizes[][2] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	format_conversion_pool_t *pool = format_conversion_pool_create(0);
+
+	srand(1234);
+
+	for (size_t k = 0; k <= BENCH_DECOMPRESS_NV12; k++) {
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			uint32_t width = sizes[s][0];
+			uint32_t height = sizes[s][1];
+			struct bench_job job;
+			double single, sliced;
+
+			init_bench_job(&job, (enum bench_kernel)k, width,
+				       height);
+
+			single = run_bench(NULL, &job, height);
+			sliced = run_bench(pool, &job, height);
+
+			print_message("%-16s %4ux%-4u %6.2f GB/s, "
+				      "%6.2f GB/s sliced\n",
+				      bench_names[k], width, height, single,
+				      sliced);
+
+			video_frame_free(&job.out);
+			video_frame_free(&job.in);
+		}
+	}
+
+	format_conversion_pool_destroy(pool);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(uyvx_to_nv12_test),
+		cmocka_unit_test(decompress_422_test),
+		cmocka_unit_test(bgra_to_nv12_test),
+		cmocka_unit_test(p010_round_trip_test),
+		cmocka_unit_test(conversion_benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,765 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs-interleave.h>
+#include <util/platform.h>
+#include <util/darray.h>
+
+/* ------------------------------------------------------------------------- */
+/* reference: the single dts-sorted array the interleaver used to be, kept
+ * here to check that the per-track FIFOs produce the same stream.  audio
+ * packets of different tracks with the same dts used to be ordered by
+ * arrival; they are now ordered by track index, which is the only intended
+ * difference and is applied here too. */
+
+struct ref_interleaver {
+	struct packet_interleaver state;
+	DARRAY(struct encoder_packet) packets;
+};
+
+static bool ref_started(struct ref_interleaver *ref)
+{
+	if (!ref->state.received_audio)
+		return false;
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++)
+		if (ref->state.video_tracks[i] && !ref->state.received_video[i])
+			return false;
+	return true;
+}
+
+static void ref_apply_offset(struct ref_interleaver *ref,
+			     struct encoder_packet *out)
+{
+	int64_t offset = out->type == OBS_ENCODER_VIDEO
+				 ? ref->state.video_offsets[out->track_idx]
+				 : ref->state.audio_offsets[out->track_idx];
+
+	out->dts -= offset;
+	out->pts -= offset;
+	out->dts_usec = out->dts * 1000000 / out->timebase_den;
+}
+
+static bool ref_has_higher_opposing_ts(struct ref_interleaver *ref,
+				       struct encoder_packet *packet)
+{
+	bool has_higher = true;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (!ref->state.video_tracks[i] ||
+		    (packet->type == OBS_ENCODER_VIDEO &&
+		     i == packet->track_idx))
+			continue;
+		has_higher = has_higher && ref->state.highest_video_ts[i] >
+						   packet->dts_usec;
+	}
+
+	return packet->type == OBS_ENCODER_AUDIO
+		       ? has_higher
+		       : (has_higher &&
+			  ref->state.highest_audio_ts > packet->dts_usec);
+}
+
+static void ref_set_higher_ts(struct ref_interleaver *ref,
+			      struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		int64_t *ts = &ref->state.highest_video_ts[packet->track_idx];
+		if (*ts < packet->dts_usec)
+			*ts = packet->dts_usec;
+	} else if (ref->state.highest_audio_ts < packet->dts_usec) {
+		ref->state.highest_audio_ts = packet->dts_usec;
+	}
+}
+
+static void ref_insert(struct ref_interleaver *ref, struct encoder_packet *out)
+{
+	size_t idx;
+	for (idx = 0; idx < ref->packets.num; idx++) {
+		struct encoder_packet *cur = ref->packets.array + idx;
+
+		if (out->dts_usec == cur->dts_usec && out->type == cur->type &&
+		    out->track_idx > cur->track_idx)
+			continue;
+
+		if (out->dts_usec == cur->dts_usec &&
+		    (out->type == OBS_ENCODER_VIDEO ||
+		     cur->type == OBS_ENCODER_AUDIO))
+			break;
+		else if (out->dts_usec < cur->dts_usec)
+			break;
+	}
+
+	da_insert(ref->packets, idx, out);
+}
+
+static int ref_find_first(struct ref_interleaver *ref,
+			  enum obs_encoder_type type, size_t idx)
+{
+	for (size_t i = 0; i < ref->packets.num; i++) {
+		struct encoder_packet *packet = &ref->packets.array[i];
+		if (packet->type == type && packet->track_idx == idx)
+			return (int)i;
+	}
+	return -1;
+}
+
+static int ref_find_last(struct ref_interleaver *ref,
+			 enum obs_encoder_type type, size_t idx)
+{
+	for (size_t i = ref->packets.num; i > 0; i--) {
+		struct encoder_packet *packet = &ref->packets.array[i - 1];
+		if (packet->type == type && packet->track_idx == idx)
+			return (int)(i - 1);
+	}
+	return -1;
+}
+
+static void ref_discard_to_idx(struct ref_interleaver *ref, size_t idx)
+{
+	da_erase_range(ref->packets, 0, idx);
+}
+
+static size_t ref_get_start_idx(struct ref_interleaver *ref)
+{
+	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
+	int first_video = ref_find_first(ref, OBS_ENCODER_VIDEO, 0);
+	int64_t video_ts = ref->packets.array[first_video].dts_usec;
+	size_t idx = 0;
+
+	for (size_t i = 0; i < ref->packets.num; i++) {
+		struct encoder_packet *packet = &ref->packets.array[i];
+		int64_t diff;
+
+		if (packet->type != OBS_ENCODER_AUDIO)
+			continue;
+
+		diff = llabs(packet->dts_usec - video_ts);
+		if (diff < closest_diff) {
+			closest_diff = diff;
+			idx = i;
+		}
+	}
+
+	return (size_t)first_video < idx ? (size_t)first_video : idx;
+}
+
+static bool ref_prune(struct ref_interleaver *ref)
+{
+	int video_idx = ref_find_first(ref, OBS_ENCODER_VIDEO, 0);
+	int64_t duration_usec, max_audio_duration_usec = 0;
+	int64_t diff = 0;
+	int audio_encoders = 0;
+	size_t start_idx;
+	int max_idx;
+
+	if (video_idx == -1)
+		return false;
+
+	struct encoder_packet *video = &ref->packets.array[video_idx];
+	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
+	max_idx = video_idx;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (!ref->state.audio_tracks[i])
+			continue;
+		audio_encoders++;
+
+		int audio_idx = ref_find_first(ref, OBS_ENCODER_AUDIO, i);
+		if (audio_idx == -1) {
+			ref->state.received_audio = false;
+			return false;
+		}
+		if (audio_idx > max_idx)
+			max_idx = audio_idx;
+
+		diff = ref->packets.array[audio_idx].dts_usec - video->dts_usec;
+		if (ref->state.audio_durations_usec[i] >
+		    max_audio_duration_usec)
+			max_audio_duration_usec =
+				ref->state.audio_durations_usec[i];
+	}
+
+	if (audio_encoders > 1 && duration_usec < max_audio_duration_usec)
+		duration_usec = max_audio_duration_usec;
+
+	start_idx = diff > duration_usec ? (size_t)max_idx + 1
+					 : ref_get_start_idx(ref);
+	if (start_idx)
+		ref_discard_to_idx(ref, start_idx);
+	return true;
+}
+
+static bool ref_get_firsts(struct ref_interleaver *ref, int *video, int *audio)
+{
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (!ref->state.video_tracks[i])
+			continue;
+		video[i] = ref_find_first(ref, OBS_ENCODER_VIDEO, i);
+		if (video[i] == -1) {
+			ref->state.received_video[i] = false;
+			return false;
+		}
+	}
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (!ref->state.audio_tracks[i])
+			continue;
+		audio[i] = ref_find_first(ref, OBS_ENCODER_AUDIO, i);
+		if (audio[i] == -1) {
+			ref->state.received_audio = false;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* tracks 0 are always in use in these tests */
+static bool ref_initialize(struct ref_interleaver *ref)
+{
+	int video[MAX_OUTPUT_VIDEO_ENCODERS];
+	int audio[MAX_OUTPUT_AUDIO_ENCODERS];
+	size_t start_idx;
+
+	if (!ref_get_firsts(ref, video, audio))
+		return false;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (!ref->state.audio_tracks[i])
+			continue;
+		int last = ref_find_last(ref, OBS_ENCODER_AUDIO, i);
+		if (ref->packets.array[last].dts_usec <
+		    ref->packets.array[video[0]].dts_usec) {
+			ref->state.received_audio = false;
+			return false;
+		}
+	}
+
+	start_idx = ref_get_start_idx(ref);
+	if (start_idx) {
+		ref_discard_to_idx(ref, start_idx);
+		if (!ref_get_firsts(ref, video, audio))
+			return false;
+	}
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++)
+		if (ref->state.video_tracks[i])
+			ref->state.video_offsets[i] =
+				ref->packets.array[video[i]].pts;
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++)
+		if (ref->state.audio_tracks[i] &&
+		    ref->packets.array[audio[i]].dts > 0)
+			ref->state.audio_offsets[i] =
+				ref->packets.array[audio[i]].dts;
+
+	ref->state.highest_audio_ts -= ref->packets.array[audio[0]].dts_usec;
+
+	for (size_t i = 0; i < ref->packets.num; i++)
+		ref_apply_offset(ref, &ref->packets.array[i]);
+	return true;
+}
+
+static void ref_resort(struct ref_interleaver *ref)
+{
+	DARRAY(struct encoder_packet) old_array;
+
+	old_array.da = ref->packets.da;
+	memset(&ref->packets, 0, sizeof(ref->packets));
+
+	for (size_t i = 0; i < old_array.num; i++) {
+		ref_set_higher_ts(ref, &old_array.array[i]);
+		ref_insert(ref, &old_array.array[i]);
+	}
+
+	da_free(old_array);
+}
+
+static bool ref_push(struct ref_interleaver *ref, struct encoder_packet *out)
+{
+	bool was_started = ref_started(ref);
+
+	if (was_started) {
+		ref_apply_offset(ref, out);
+	} else if (out->type == OBS_ENCODER_VIDEO) {
+		ref->state.received_video[out->track_idx] = true;
+	} else {
+		ref->state.received_audio = true;
+	}
+
+	ref_insert(ref, out);
+
+	if (!ref_started(ref))
+		return false;
+
+	if (!was_started) {
+		if (!ref_prune(ref) || !ref_initialize(ref))
+			return false;
+		ref_resort(ref);
+	} else {
+		ref_set_higher_ts(ref, out);
+	}
+	return true;
+}
+
+static bool ref_pop(struct ref_interleaver *ref, struct encoder_packet *out)
+{
+	if (!ref->packets.num)
+		return false;
+
+	*out = ref->packets.array[0];
+	if (!ref_has_higher_opposing_ts(ref, out))
+		return false;
+
+	da_erase(ref->packets, 0);
+	return true;
+}
+
+static void ref_discard_before(struct ref_interleaver *ref, int64_t dts_usec)
+{
+	size_t idx = 0;
+
+	while (idx < ref->packets.num &&
+	       ref->packets.array[idx].dts_usec < dts_usec)
+		idx++;
+	if (idx)
+		ref_discard_to_idx(ref, idx);
+}
+
+/* ------------------------------------------------------------------------- */
+/* synthetic streams */
+
+struct track_config {
+	enum obs_encoder_type type;
+	size_t idx;
+	uint32_t timebase_den;
+	int64_t frame_dts;
+
+	/* system time of the first packet, and its dts; audio encoders that
+	 * are shared with another output don't start at 0 */
+	int64_t start_usec;
+	int64_t first_dts;
+
+	/* time it takes the encoder to produce a packet */
+	int64_t latency_usec;
+	int64_t jitter_usec;
+
+	/* keyframe interval, and the frame the encoder starts on */
+	int gop;
+	int first_frame;
+};
+
+struct stream_config {
+	struct track_config tracks[MAX_INTERLEAVED_TRACKS];
+	size_t num_tracks;
+	int64_t duration_usec;
+};
+
+struct arrival {
+	int64_t time;
+	struct encoder_packet packet;
+};
+
+static int compare_arrival(const void *a, const void *b)
+{
+	const struct arrival *arr_a = a;
+	const struct arrival *arr_b = b;
+
+	if (arr_a->time != arr_b->time)
+		return arr_a->time < arr_b->time ? -1 : 1;
+	if (arr_a->packet.type != arr_b->packet.type)
+		return arr_a->packet.type < arr_b->packet.type ? -1 : 1;
+	if (arr_a->packet.track_idx != arr_b->packet.track_idx)
+		return arr_a->packet.track_idx < arr_b->packet.track_idx ? -1
+									  : 1;
+	return arr_a->packet.dts < arr_b->packet.dts ? -1 : 1;
+}
+
+/* generates the packets of every track in the order they would reach the
+ * output.  each track's packets arrive in order, with the tracks interleaved
+ * by when their encoders finish */
+static void make_stream(const struct stream_config *config,
+			struct arrival **out, size_t *out_num)
+{
+	DARRAY(struct arrival) arrivals = {0};
+
+	for (size_t i = 0; i < config->num_tracks; i++) {
+		const struct track_config *track = &config->tracks[i];
+		int64_t last_arrival = 0;
+
+		for (int frame = track->first_frame;; frame++) {
+			struct arrival arr = {0};
+			int64_t dts = track->first_dts +
+				      (frame - track->first_frame) *
+					      track->frame_dts;
+			int64_t ts = track->start_usec +
+				     (dts - track->first_dts) * 1000000 /
+					     track->timebase_den;
+
+			if (ts - track->start_usec > config->duration_usec)
+				break;
+
+			arr.packet.type = track->type;
+			arr.packet.track_idx = track->idx;
+			arr.packet.timebase_num = 1;
+			arr.packet.timebase_den = (int32_t)track->timebase_den;
+			arr.packet.dts = dts;
+			arr.packet.pts = dts;
+			arr.packet.dts_usec = ts;
+			arr.packet.keyframe =
+				track->type == OBS_ENCODER_AUDIO ||
+				frame % track->gop == 0;
+
+			arr.time = ts + track->latency_usec;
+			if (track->jitter_usec)
+				arr.time += rand() % track->jitter_usec;
+			if (arr.time < last_arrival)
+				arr.time = last_arrival;
+			last_arrival = arr.time;
+
+			da_push_back(arrivals, &arr);
+		}
+	}
+
+	qsort(arrivals.array, arrivals.num, sizeof(struct arrival),
+	      compare_arrival);
+
+	*out = arrivals.array;
+	*out_num = arrivals.num;
+}
+
+static void configure(struct packet_interleaver *il,
+		      const struct stream_config *config)
+{
+	memset(il, 0, sizeof(*il));
+	packet_interleaver_reset(il);
+
+	for (size_t i = 0; i < config->num_tracks; i++) {
+		const struct track_config *track = &config->tracks[i];
+
+		if (track->type == OBS_ENCODER_VIDEO) {
+			il->video_tracks[track->idx] = true;
+		} else {
+			il->audio_tracks[track->idx] = true;
+			il->audio_durations_usec[track->idx] =
+				track->frame_dts * 1000000 /
+				track->timebase_den;
+		}
+	}
+}
+
+typedef DARRAY(struct encoder_packet) packet_array_t;
+
+/* feeds the stream through the interleaver the same way the output does:
+ * non-keyframes are dropped until a track's first keyframe, and at most
+ * one packet is sent for every packet received */
+static void run_interleaver(const struct stream_config *config,
+			    const struct arrival *arrivals, size_t num,
+			    packet_array_t *sent)
+{
+	struct packet_interleaver il;
+	struct encoder_packet out;
+
+	configure(&il, config);
+
+	for (size_t i = 0; i < num; i++) {
+		struct encoder_packet packet = arrivals[i].packet;
+
+		if (packet.type == OBS_ENCODER_VIDEO &&
+		    !il.received_video[packet.track_idx] && !packet.keyframe) {
+			packet_interleaver_discard_before(&il, packet.dts_usec);
+			continue;
+		}
+
+		if (packet_interleaver_push(&il, &packet) &&
+		    packet_interleaver_pop(&il, &out))
+			da_push_back(*sent, &out);
+	}
+
+	packet_interleaver_reset(&il);
+}
+
+static void run_reference(const struct stream_config *config,
+			  const struct arrival *arrivals, size_t num,
+			  packet_array_t *sent)
+{
+	struct ref_interleaver ref = {0};
+	struct encoder_packet out;
+
+	configure(&ref.state, config);
+
+	for (size_t i = 0; i < num; i++) {
+		struct encoder_packet packet = arrivals[i].packet;
+
+		if (packet.type == OBS_ENCODER_VIDEO &&
+		    !ref.state.received_video[packet.track_idx] &&
+		    !packet.keyframe) {
+			ref_discard_before(&ref, packet.dts_usec);
+			continue;
+		}
+
+		if (ref_push(&ref, &packet) && ref_pop(&ref, &out))
+			da_push_back(*sent, &out);
+	}
+
+	da_free(ref.packets);
+}
+
+/* captions are attached to the first video frame of a track whose pts is at
+ * or past the caption's time, so the frames they land on follow from the
+ * sent video packets */
+static void get_caption_frames(const packet_array_t *sent, size_t *frames,
+			       size_t num_captions, double interval)
+{
+	size_t caption = 0;
+
+	for (size_t i = 0; i < sent->num && caption < num_captions; i++) {
+		const struct encoder_packet *packet = &sent->array[i];
+		double ts;
+
+		if (packet->type != OBS_ENCODER_VIDEO || packet->track_idx)
+			continue;
+
+		ts = (double)(packet->pts * packet->timebase_num) /
+		     (double)packet->timebase_den;
+		if (ts >= interval * (double)(caption + 1))
+			frames[caption++] = i;
+	}
+
+	for (; caption < num_captions; caption++)
+		frames[caption] = DARRAY_INVALID;
+}
+
+#define NUM_CAPTIONS 8
+
+static void check_same_stream(const struct stream_config *config)
+{
+	packet_array_t expected = {0};
+	packet_array_t sent = {0};
+	size_t expected_captions[NUM_CAPTIONS];
+	size_t sent_captions[NUM_CAPTIONS];
+	struct arrival *arrivals;
+	size_t num;
+
+	make_stream(config, &arrivals, &num);
+	run_reference(config, arrivals, num, &expected);
+	run_interleaver(config, arrivals, num, &sent);
+
+	/* make sure the stream actually started */
+	assert_true(expected.num > num / 4);
+	assert_int_equal(sent.num, expected.num);
+
+	for (size_t i = 0; i < sent.num; i++) {
+		struct encoder_packet *a = &expected.array[i];
+		struct encoder_packet *b = &sent.array[i];
+
+		assert_int_equal(b->type, a->type);
+		assert_int_equal(b->track_idx, a->track_idx);
+		assert_int_equal(b->dts, a->dts);
+		assert_int_equal(b->pts, a->pts);
+		assert_int_equal(b->dts_usec, a->dts_usec);
+
+		if (i)
+			assert_true(b->dts_usec >= sent.array[i - 1].dts_usec);
+	}
+
+	get_caption_frames(&expected, expected_captions, NUM_CAPTIONS, 0.5);
+	get_caption_frames(&sent, sent_captions, NUM_CAPTIONS, 0.5);
+	assert_memory_equal(sent_captions, expected_captions,
+			    sizeof(sent_captions));
+
+	da_free(expected);
+	da_free(sent);
+	bfree(arrivals);
+}
+
+static struct track_config video_track(size_t idx, int64_t start_usec)
+{
+	struct track_config track = {0};
+	track.type = OBS_ENCODER_VIDEO;
+	track.idx = idx;
+	track.timebase_den = 60;
+	track.frame_dts = 1;
+	track.start_usec = start_usec;
+	track.latency_usec = 20000;
+	track.jitter_usec = 15000;
+	track.gop = 120;
+	return track;
+}
+
+static struct track_config audio_track(size_t idx, int64_t start_usec,
+				       int64_t frame_dts)
+{
+	struct track_config track = {0};
+	track.type = OBS_ENCODER_AUDIO;
+	track.idx = idx;
+	track.timebase_den = 48000;
+	track.frame_dts = frame_dts;
+	track.start_usec = start_usec;
+	track.latency_usec = 2000;
+	track.jitter_usec = 1000;
+	track.gop = 1;
+	return track;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* one video and one audio track, with the encoders starting at different
+ * times and video joining mid-GOP, so that starting up has to discard
+ * non-keyframes and line up audio with the first keyframe */
+static void interleave_single_track_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	srand(1);
+
+	for (int seed = 0; seed < 50; seed++) {
+		struct stream_config config = {0};
+
+		config.duration_usec = 5000000;
+		config.tracks[0] = video_track(0, 1000000 + rand() % 100000);
+		config.tracks[0].first_frame = rand() % 3 ? 0 : 30;
+		config.tracks[1] =
+			audio_track(0, 1000000 + rand() % 100000, 1024);
+		config.num_tracks = 2;
+
+		check_same_stream(&config);
+	}
+}
+
+/* audio that started long before video is pruned up to the first video
+ * frame; this also covers audio encoders shared with another output, whose
+ * timestamps don't start at 0 */
+static void interleave_prune_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	srand(2);
+
+	for (int seed = 0; seed < 50; seed++) {
+		struct stream_config config = {0};
+
+		config.duration_usec = 3000000;
+		config.tracks[0] = video_track(0, 2000000);
+		config.tracks[0].latency_usec = 200000 + rand() % 300000;
+		config.tracks[1] = audio_track(0, 1000000 - rand() % 500000,
+					       1024);
+		config.tracks[1].first_dts = 1024 * (rand() % 1000);
+		config.tracks[2] = audio_track(1, 1500000, 1024);
+		config.tracks[2].first_dts = 1024 * (rand() % 1000);
+		config.num_tracks = 3;
+
+		check_same_stream(&config);
+	}
+}
+
+/* two video tracks of an encoder group and audio tracks with different frame
+ * sizes, so the merged order after the offsets are applied differs from the
+ * order the packets were buffered in before starting */
+static void interleave_resort_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	srand(3);
+
+	for (int seed = 0; seed < 50; seed++) {
+		struct stream_config config = {0};
+
+		config.duration_usec = 4000000;
+		config.tracks[0] = video_track(0, 1000000 + rand() % 50000);
+		config.tracks[1] = video_track(1, config.tracks[0].start_usec);
+		config.tracks[1].timebase_den = 30;
+		config.tracks[1].gop = 30;
+		config.tracks[2] = audio_track(0, 1000000 + rand() % 50000,
+					       1024);
+		config.tracks[3] = audio_track(1, 1000000 + rand() % 50000,
+					       960);
+		config.tracks[4] = audio_track(2, 1000000 + rand() % 50000,
+					       1024);
+		config.tracks[4].first_dts = 1024 * (rand() % 100);
+		config.num_tracks = 5;
+
+		check_same_stream(&config);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define BENCH_RUNS 5
+
+static double bench_run(const struct stream_config *config,
+			const struct arrival *arrivals, size_t num,
+			bool reference)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		packet_array_t sent = {0};
+		uint64_t start = os_gettime_ns();
+
+		if (reference)
+			run_reference(config, arrivals, num, &sent);
+		else
+			run_interleaver(config, arrivals, num, &sent);
+
+		uint64_t elapsed = os_gettime_ns() - start;
+		if (elapsed < best)
+			best = elapsed;
+		da_free(sent);
+	}
+
+	return (double)best / (double)num;
+}
+
+static void bench_stream(const char *name, const struct stream_config *config)
+{
+	struct arrival *arrivals;
+	size_t num;
+
+	make_stream(config, &arrivals, &num);
+
+	double ref_ns = bench_run(config, arrivals, num, true);
+	double new_ns = bench_run(config, arrivals, num, false);
+
+	print_message("%s: %zu packets, %.1f ns/packet (single array: "
+		      "%.1f ns/packet)\n",
+		      name, num, new_ns, ref_ns);
+
+	bfree(arrivals);
+}
+
+/* one video track and six audio tracks for a minute, first with encoders
+ * that keep up, then with a video encoder that lags half a second behind
+ * audio so that the interleave buffer holds a few hundred packets */
+static void interleave_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct stream_config config = {0};
+
+	srand(4);
+
+	config.duration_usec = 60000000;
+	config.tracks[0] = video_track(0, 1000000);
+	for (size_t i = 0; i < 6; i++)
+		config.tracks[i + 1] = audio_track(i, 1000000, 1024);
+	config.num_tracks = 7;
+
+	bench_stream("1 video + 6 audio tracks", &config);
+
+	config.tracks[0].latency_usec = 500000;
+	bench_stream("1 video + 6 audio tracks, 500ms video latency", &config);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(interleave_single_track_test),
+		cmocka_unit_test(interleave_prune_test),
+		cmocka_unit_test(interleave_resort_test),
+		cmocka_unit_test(interleave_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,585 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+#include <media-playback/media-playback.h>
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+
+#define FPS 25
+#define GOP 5
+#define NUM_FRAMES 20
+#define FRAME_NS (1000000000LL / FPS)
+#define SIZE 64
+#define LARGE_SIZE 1024
+
+/* the luma of every frame is its index, so that it can still be told apart
+ * after lossy compression */
+#define INDEX_LUMA(idx) (16 + (idx) * 10)
+
+struct sample {
+	int64_t ts;
+	int idx;
+};
+
+struct seek {
+	size_t at;
+	int target;
+};
+
+struct playback {
+	pthread_mutex_t mutex;
+	DARRAY(struct sample) samples;
+	DARRAY(struct seek) seeks;
+	long laps;
+};
+
+static bool encode(AVFormatContext *fmt, AVCodecContext *ctx,
+		   AVStream *stream, AVFrame *frame)
+{
+	AVPacket *pkt = av_packet_alloc();
+	int ret = avcodec_send_frame(ctx, frame);
+
+	while (ret >= 0) {
+		ret = avcodec_receive_packet(ctx, pkt);
+		if (ret < 0)
+			break;
+
+		av_packet_rescale_ts(pkt, ctx->time_base, stream->time_base);
+		pkt->stream_index = stream->index;
+		ret = av_interleaved_write_frame(fmt, pkt);
+	}
+
+	av_packet_free(&pkt);
+	return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+/* a short mpeg4 clip with a keyframe every GOP frames, which compresses well
+ * enough for the cache to keep it as packets and decode it during playback */
+static void write_clip(const char *path, int size)
+{
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	AVFormatContext *fmt = NULL;
+	AVCodecContext *ctx;
+	AVStream *stream;
+	AVFrame *frame;
+
+	assert_non_null(codec);
+	assert_true(avformat_alloc_output_context2(&fmt, NULL, NULL, path) >=
+		    0);
+
+	stream = avformat_new_stream(fmt, NULL);
+	ctx = avcodec_alloc_context3(codec);
+	ctx->width = size;
+	ctx->height = size;
+	ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+	ctx->time_base = (AVRational){1, FPS};
+	ctx->framerate = (AVRational){FPS, 1};
+	ctx->gop_size = GOP;
+	ctx->max_b_frames = 0;
+	ctx->flags |= AV_CODEC_FLAG_QSCALE;
+	ctx->global_quality = FF_QP2LAMBDA * 2;
+	if (fmt->oformat->flags & AVFMT_GLOBALHEADER)
+		ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	assert_true(avcodec_open2(ctx, codec, NULL) >= 0);
+	assert_true(avcodec_parameters_from_context(stream->codecpar, ctx) >=
+		    0);
+	stream->time_base = ctx->time_base;
+
+	assert_true(avio_open(&fmt->pb, path, AVIO_FLAG_WRITE) >= 0);
+	assert_true(avformat_write_header(fmt, NULL) >= 0);
+
+	frame = av_frame_alloc();
+	frame->format = ctx->pix_fmt;
+	frame->width = size;
+	frame->height = size;
+	assert_true(av_frame_get_buffer(frame, 0) >= 0);
+
+	for (int i = 0; i < NUM_FRAMES; i++) {
+		assert_true(av_frame_make_writable(frame) >= 0);
+		memset(frame->data[0], INDEX_LUMA(i),
+		       (size_t)frame->linesize[0] * size);
+		memset(frame->data[1], 128,
+		       (size_t)frame->linesize[1] * size / 2);
+		memset(frame->data[2], 128,
+		       (size_t)frame->linesize[2] * size / 2);
+		frame->pts = i;
+		assert_true(encode(fmt, ctx, stream, frame));
+	}
+
+	assert_true(encode(fmt, ctx, stream, NULL));
+	assert_true(av_write_trailer(fmt) >= 0);
+
+	av_frame_free(&frame);
+	avcodec_free_context(&ctx);
+	avio_closep(&fmt->pb);
+	avformat_free_context(fmt);
+}
+
+static int get_frame_index(const struct obs_source_frame *frame)
+{
+	const uint8_t *center = frame->data[0] +
+				frame->linesize[0] * (frame->height / 2) +
+				frame->width / 2;
+	return (*center - 16 + 5) / 10;
+}
+
+static void video_cb(void *opaque, struct obs_source_frame *frame)
+{
+	struct playback *pb = opaque;
+	struct sample sample = {(int64_t)frame->timestamp,
+				get_frame_index(frame)};
+	struct sample *last;
+
+	pthread_mutex_lock(&pb->mutex);
+	last = da_end(pb->samples);
+	if (sample.idx == 0 && last && last->idx >= NUM_FRAMES - 2)
+		pb->laps++;
+	da_push_back(pb->samples, &sample);
+	pthread_mutex_unlock(&pb->mutex);
+}
+
+static long get_laps(struct playback *pb)
+{
+	long laps;
+
+	pthread_mutex_lock(&pb->mutex);
+	laps = pb->laps;
+	pthread_mutex_unlock(&pb->mutex);
+	return laps;
+}
+
+static void wait_for_laps(struct playback *pb, long laps)
+{
+	uint64_t end = os_gettime_ns() + 10000000000ULL;
+
+	while (get_laps(pb) < laps && os_gettime_ns() < end)
+		os_sleep_ms(10);
+
+	assert_true(get_laps(pb) >= laps);
+}
+
+/* seeks relative to the frame that was shown last.  the first frame is
+ * left out, as landing there could not be told apart from a new lap */
+static void seek_ahead(struct playback *pb, media_playback_t *mp, int ahead)
+{
+	struct sample *last;
+	struct seek seek;
+
+	pthread_mutex_lock(&pb->mutex);
+	last = da_end(pb->samples);
+	seek.at = pb->samples.num;
+	seek.target = 1 + (last->idx + ahead - 1) % (NUM_FRAMES - 1);
+	da_push_back(pb->seeks, &seek);
+	pthread_mutex_unlock(&pb->mutex);
+
+	media_playback_seek(mp, seek.target * 1000 / FPS);
+	os_sleep_ms(NUM_FRAMES * 1000 / FPS / 2);
+}
+
+/*
+ * Every frame has to follow the one before it by exactly one frame duration,
+ * and show either the next frame or, if that was not decoded in time, the
+ * same frame again.  The only exceptions are the start of a new lap, which
+ * has to start at the first frame, and seeks, which have to land at their
+ * target.  Frames right after a seek may be skipped while the decoder
+ * restarts from the keyframe before the target.
+ */
+static void check_samples(struct playback *pb, long *laps, size_t *landed)
+{
+	size_t next_seek = 0;
+	struct seek *seek = NULL;
+
+	assert_true(pb->samples.num > 0);
+	assert_int_equal(pb->samples.array[0].idx, 0);
+
+	*laps = 0;
+	*landed = 0;
+
+	for (size_t i = 1; i < pb->samples.num; i++) {
+		struct sample *prev = &pb->samples.array[i - 1];
+		struct sample *cur = &pb->samples.array[i];
+
+		while (next_seek < pb->seeks.num &&
+		       pb->seeks.array[next_seek].at <= i)
+			seek = &pb->seeks.array[next_seek++];
+
+		if ((cur->idx == prev->idx || cur->idx == prev->idx + 1) &&
+		    cur->ts - prev->ts == FRAME_NS)
+			continue;
+
+		if (cur->idx == 0 && prev->idx >= NUM_FRAMES - 2 &&
+		    cur->ts > prev->ts) {
+			(*laps)++;
+			continue;
+		}
+
+		if (seek && cur->idx >= seek->target &&
+		    cur->idx <= seek->target + 3) {
+			(*landed)++;
+			seek = NULL;
+			continue;
+		}
+
+		print_message("frame %zu: %d at %lld after %d at %lld\n", i,
+			      cur->idx, (long long)cur->ts, prev->idx,
+			      (long long)prev->ts);
+		fail();
+	}
+}
+
+static media_playback_t *create_playback(struct playback *pb,
+					 const char *path)
+{
+	struct mp_media_info info = {
+		.opaque = pb,
+		.v_cb = video_cb,
+		.path = path,
+		.speed = 100,
+		.force_range = VIDEO_RANGE_DEFAULT,
+		.is_local_file = true,
+		.full_decode = true,
+	};
+	media_playback_t *mp;
+
+	pthread_mutex_init(&pb->mutex, NULL);
+
+	mp = media_playback_create(&info);
+	assert_non_null(mp);
+	return mp;
+}
+
+static void free_playback(struct playback *pb)
+{
+	pthread_mutex_destroy(&pb->mutex);
+	da_free(pb->samples);
+	da_free(pb->seeks);
+}
+
+static void get_clip_path(struct dstr *path, const char *name, int size)
+{
+	dstr_copy(path, MEDIA_CACHE_TEST_DIR);
+	os_mkdirs(path->array);
+	dstr_catf(path, "/%s", name);
+	write_clip(path->array, size);
+}
+
+static int get_last_index(struct playback *pb)
+{
+	struct sample *last;
+	int idx;
+
+	pthread_mutex_lock(&pb->mutex);
+	last = da_end(pb->samples);
+	idx = last ? last->idx : -1;
+	pthread_mutex_unlock(&pb->mutex);
+	return idx;
+}
+
+static void wait_for_frame(struct playback *pb, int idx)
+{
+	uint64_t end = os_gettime_ns() + 10000000000ULL;
+
+	while (get_last_index(pb) < idx && os_gettime_ns() < end)
+		os_sleep_ms(10);
+
+	assert_true(get_last_index(pb) >= idx);
+}
+
+static inline void wait_for_end(struct playback *pb)
+{
+	wait_for_frame(pb, NUM_FRAMES - 1);
+}
+
+static void media_cache_loop_test(void **state)
+{
+	struct mp_cache_stats stats = {0};
+	struct playback pb = {0};
+	struct dstr path = {0};
+	media_playback_t *mp;
+	long laps;
+	size_t landed;
+	UNUSED_PARAMETER(state);
+
+	get_clip_path(&path, "loop.mkv", SIZE);
+	mp = create_playback(&pb, path.array);
+
+	media_playback_play(mp, true, false);
+
+	/* the next lap is decoded ahead and picked up by window_rewind */
+	wait_for_laps(&pb, 2);
+
+	/* a frame that is usually already decoded, then one that is not,
+	 * which restarts decoding from the keyframe before it */
+	seek_ahead(&pb, mp, 3);
+	seek_ahead(&pb, mp, NUM_FRAMES / 2);
+
+	wait_for_laps(&pb, get_laps(&pb) + 1);
+
+	assert_true(media_playback_get_cache_stats(mp, &stats));
+	assert_true(stats.packet_mode);
+	assert_int_equal(stats.frames, NUM_FRAMES);
+	assert_int_equal(stats.users, 1);
+	assert_true(stats.decoded_frames > 0);
+
+	media_playback_destroy(mp);
+
+	check_samples(&pb, &laps, &landed);
+	assert_true(laps >= 3);
+	assert_true(landed >= 1);
+
+	os_unlink(path.array);
+	free_playback(&pb);
+	dstr_free(&path);
+}
+
+/* two sources of the same file share the cached packets, but seek, loop and
+ * decode ahead on their own */
+static void media_cache_shared_test(void **state)
+{
+	struct mp_cache_stats stats = {0};
+	struct playback pb_a = {0};
+	struct playback pb_b = {0};
+	struct dstr path = {0};
+	media_playback_t *mp_a;
+	media_playback_t *mp_b;
+	long laps;
+	size_t landed;
+	UNUSED_PARAMETER(state);
+
+	get_clip_path(&path, "shared.mkv", SIZE);
+	mp_a = create_playback(&pb_a, path.array);
+	mp_b = create_playback(&pb_b, path.array);
+
+	assert_true(media_playback_get_cache_stats(mp_a, &stats));
+	assert_int_equal(stats.users, 2);
+	assert_true(media_playback_get_cache_stats(mp_b, &stats));
+	assert_int_equal(stats.users, 2);
+
+	/* the second source starts once the first one is already looping,
+	 * and plays the clip once without following its seeks */
+	media_playback_play(mp_a, true, false);
+	wait_for_laps(&pb_a, 1);
+	media_playback_play(mp_b, false, false);
+
+	seek_ahead(&pb_a, mp_a, NUM_FRAMES / 2);
+	wait_for_laps(&pb_a, get_laps(&pb_a) + 1);
+	wait_for_end(&pb_b);
+
+	assert_true(media_playback_get_cache_stats(mp_b, &stats));
+	assert_true(stats.packet_mode);
+	assert_int_equal(stats.frames, NUM_FRAMES);
+	assert_true(stats.decoded_frames > 0);
+
+	media_playback_destroy(mp_a);
+	media_playback_destroy(mp_b);
+
+	check_samples(&pb_a, &laps, &landed);
+	assert_true(laps >= 2);
+	assert_true(landed >= 1);
+
+	check_samples(&pb_b, &laps, &landed);
+	assert_int_equal(laps, 0);
+	assert_int_equal(landed, 0);
+
+	os_unlink(path.array);
+	free_playback(&pb_a);
+	free_playback(&pb_b);
+	dstr_free(&path);
+}
+
+/*
+ * The first source of a file decodes it for every other source.  If it is
+ * destroyed before it is done, a source that is waiting for it has to decode
+ * the file in its place.  The clip is large enough that the first source is
+ * usually still decoding when it is destroyed, either way the second one has
+ * to play it.
+ */
+static void media_cache_abandoned_test(void **state)
+{
+	struct mp_cache_stats stats = {0};
+	struct playback pb_a = {0};
+	struct playback pb_b = {0};
+	struct dstr path = {0};
+	media_playback_t *mp_a;
+	media_playback_t *mp_b;
+	long laps;
+	size_t landed;
+	UNUSED_PARAMETER(state);
+
+	get_clip_path(&path, "abandoned.mkv", LARGE_SIZE);
+	mp_a = create_playback(&pb_a, path.array);
+	mp_b = create_playback(&pb_b, path.array);
+	media_playback_destroy(mp_a);
+
+	assert_true(media_playback_get_cache_stats(mp_b, &stats));
+	assert_int_equal(stats.users, 1);
+
+	media_playback_play(mp_b, true, false);
+	wait_for_laps(&pb_b, 1);
+
+	assert_true(media_playback_get_cache_stats(mp_b, &stats));
+	assert_int_equal(stats.frames, NUM_FRAMES);
+
+	media_playback_destroy(mp_b);
+
+	assert_int_equal(pb_a.samples.num, 0);
+	check_samples(&pb_b, &laps, &landed);
+	assert_true(laps >= 1);
+
+	os_unlink(path.array);
+	free_playback(&pb_a);
+	free_playback(&pb_b);
+	dstr_free(&path);
+}
+
+/* a frame that is not a keyframe, so that the decoder has to be flushed and
+ * restarted from the keyframe before it */
+#define SEEK_FRAME (GOP * 2 + 3)
+
+/* plays the clip once without the cache, seeking ahead once it started */
+static void play_uncached(struct playback *pb, const char *path,
+			  bool pipelined, struct mp_decode_stats *stats,
+			  uint32_t *max_queued)
+{
+	struct mp_media_info info = {
+		.opaque = pb,
+		.v_cb = video_cb,
+		.path = path,
+		.speed = 100,
+		.force_range = VIDEO_RANGE_DEFAULT,
+		.is_local_file = true,
+		.pipelined_decode = pipelined,
+	};
+	struct seek seek = {0, SEEK_FRAME};
+	media_playback_t *mp;
+	uint64_t end;
+
+	pthread_mutex_init(&pb->mutex, NULL);
+
+	mp = media_playback_create(&info);
+	assert_non_null(mp);
+
+	media_playback_play(mp, false, false);
+	wait_for_frame(pb, 1);
+
+	pthread_mutex_lock(&pb->mutex);
+	seek.at = pb->samples.num;
+	da_push_back(pb->seeks, &seek);
+	pthread_mutex_unlock(&pb->mutex);
+
+	media_playback_seek(mp, SEEK_FRAME * 1000 / FPS);
+
+	*max_queued = 0;
+	end = os_gettime_ns() + 10000000000ULL;
+
+	while (get_last_index(pb) < NUM_FRAMES - 1 && os_gettime_ns() < end) {
+		assert_true(media_playback_get_decode_stats(mp, stats));
+		if (stats->video_queued_frames > *max_queued)
+			*max_queued = stats->video_queued_frames;
+		os_sleep_ms(5);
+	}
+
+	assert_true(media_playback_get_decode_stats(mp, stats));
+	media_playback_destroy(mp);
+
+	assert_int_equal(get_last_index(pb), NUM_FRAMES - 1);
+}
+
+/* every frame has to follow the one before it, except for the one the seek
+ * lands on, which has to be the keyframe before the seek target.  returns
+ * the index of that sample */
+static size_t find_seek_landing(struct playback *pb)
+{
+	size_t landing = 0;
+
+	assert_true(pb->samples.num > 0);
+	assert_int_equal(pb->samples.array[0].idx, 0);
+
+	for (size_t i = 1; i < pb->samples.num; i++) {
+		struct sample *prev = &pb->samples.array[i - 1];
+		struct sample *cur = &pb->samples.array[i];
+
+		if (cur->idx == prev->idx + 1 && cur->ts - prev->ts == FRAME_NS)
+			continue;
+
+		print_message("seek landed at frame %zu: %d after %d\n", i,
+			      cur->idx, prev->idx);
+		assert_int_equal(landing, 0);
+		assert_true(i >= pb->seeks.array[0].at);
+		assert_int_equal(cur->idx, SEEK_FRAME / GOP * GOP);
+		landing = i;
+	}
+
+	assert_true(landing > 0);
+	return landing;
+}
+
+/* decoding on threads of their own has to produce the same frames with the
+ * same timestamps as decoding on the media thread, seeks included */
+static void media_pipelined_decode_test(void **state)
+{
+	struct mp_decode_stats stats = {0};
+	struct playback serial = {0};
+	struct playback pipelined = {0};
+	struct dstr path = {0};
+	uint32_t max_queued;
+	size_t serial_landing;
+	size_t pipelined_landing;
+	size_t count;
+	UNUSED_PARAMETER(state);
+
+	get_clip_path(&path, "pipelined.mkv", SIZE);
+
+	play_uncached(&serial, path.array, false, &stats, &max_queued);
+	assert_false(stats.pipelined);
+	assert_int_equal(max_queued, 0);
+
+	play_uncached(&pipelined, path.array, true, &stats, &max_queued);
+	assert_true(stats.pipelined);
+	assert_true(max_queued > 0);
+	assert_true(stats.video_frames >= NUM_FRAMES);
+
+	serial_landing = find_seek_landing(&serial);
+	pipelined_landing = find_seek_landing(&pipelined);
+
+	count = serial.samples.num - serial_landing;
+	assert_int_equal(pipelined.samples.num - pipelined_landing, count);
+
+	for (size_t i = 0; i < count; i++) {
+		struct sample *a = &serial.samples.array[serial_landing + i];
+		struct sample *b =
+			&pipelined.samples.array[pipelined_landing + i];
+		struct sample *a0 = &serial.samples.array[serial_landing];
+		struct sample *b0 =
+			&pipelined.samples.array[pipelined_landing];
+
+		assert_int_equal(a->idx, b->idx);
+		assert_int_equal(a->ts - a0->ts, b->ts - b0->ts);
+	}
+
+	os_unlink(path.array);
+	free_playback(&serial);
+	free_playback(&pipelined);
+	dstr_free(&path);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(media_cache_loop_test),
+		cmocka_unit_test(media_cache_shared_test),
+		cmocka_unit_test(media_cache_abandoned_test),
+		cmocka_unit_test(media_pipelined_decode_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,313 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/pipe.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <obs-ffmpeg-mux-shm.h>
+#include <ffmpeg-mux/ffmpeg-mux.h>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+/* matches MAX_WRITE_PACKETS and MUX_SHM_SIZE in obs-ffmpeg-mux.h */
+#define WRITE_PACKETS 32
+#define SHM_SIZE (16 * 1024 * 1024)
+
+#define BENCH_BYTES (512ULL * 1024 * 1024)
+
+static const char *self_path;
+
+/* ------------------------------------------------------------------------- */
+/* ffmpeg-mux side, run in a child process reading from stdin */
+
+static bool read_all(void *data, size_t size)
+{
+	return fread(data, 1, size, stdin) == size;
+}
+
+static struct ffm_shm_header *consumer_open_ring(const char *name,
+						 size_t *p_size)
+{
+	struct ffm_shm_header *header;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	close(fd);
+	shm_unlink(name);
+
+	if (map == MAP_FAILED)
+		return NULL;
+
+	header = map;
+	os_atomic_set_long(&header->ready, 1);
+	*p_size = (size_t)st.st_size;
+	return header;
+}
+
+/* every payload starts with its packet number, and the rest of it is summed
+ * up so that the data is read like a muxer writing it to a file would */
+static int run_consumer(void)
+{
+	struct ffm_shm_header *header = NULL;
+	struct ffm_packet_info info;
+	uint8_t *buf = NULL;
+	size_t buf_size = 0;
+	size_t map_size = 0;
+	uint64_t expected = 0;
+	uint64_t sum = 0;
+
+	while (read_all(&info, sizeof(info))) {
+		uint8_t *data;
+
+		if (info.size > buf_size) {
+			buf_size = info.size + 1;
+			buf = brealloc(buf, buf_size);
+		}
+
+		if (info.type == FFM_PACKET_SHM_RING) {
+			if (!read_all(buf, info.size))
+				return 1;
+			buf[info.size] = 0;
+			header = consumer_open_ring((const char *)buf,
+						    &map_size);
+			continue;
+		}
+
+		if (info.shared) {
+			if (!header)
+				return 1;
+			data = (uint8_t *)header + header->data_offset +
+			       info.shm_pos % header->capacity;
+		} else {
+			if (!read_all(buf, info.size))
+				return 1;
+			data = buf;
+		}
+
+		uint64_t num;
+		memcpy(&num, data, sizeof(num));
+		if (num != expected++)
+			return 2;
+
+		for (size_t i = sizeof(num); i + 8 <= info.size; i += 8) {
+			uint64_t val;
+			memcpy(&val, data + i, sizeof(val));
+			sum += val;
+		}
+
+		if (info.shared)
+			os_atomic_set_long(
+				&header->tail,
+				(long)(uint32_t)(info.shm_pos + info.size));
+	}
+
+	if (header)
+		munmap(header, map_size);
+	bfree(buf);
+
+	/* keeps the summing loop from being optimized out */
+	return sum == 1 ? 3 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* obs side, writing packets the same way write_packets does */
+
+static uint64_t cpu_time_ns(int who)
+{
+	struct rusage usage;
+	getrusage(who, &usage);
+	return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+		       1000000000ULL +
+	       (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) *
+		       1000ULL;
+}
+
+static bool send_ring(os_process_pipe_t *pipe, struct mux_shm *shm)
+{
+	if (!mux_shm_create(shm, SHM_SIZE))
+		return false;
+
+	uint32_t size = (uint32_t)strlen(shm->name);
+	struct ffm_packet_info info = {.type = FFM_PACKET_SHM_RING,
+				       .size = size};
+	struct os_process_pipe_buf bufs[] = {
+		{(const uint8_t *)&info, sizeof(info)},
+		{(const uint8_t *)shm->name, size},
+	};
+
+	return os_process_pipe_writev(pipe, bufs, 2) == sizeof(info) + size;
+}
+
+static void transfer(size_t packet_size, bool use_shm)
+{
+	struct ffm_packet_info info[WRITE_PACKETS];
+	struct os_process_pipe_buf bufs[WRITE_PACKETS * 2];
+	uint8_t *payloads[WRITE_PACKETS];
+	struct mux_shm shm = {0};
+	os_process_args_t *args;
+	uint64_t num_packets = BENCH_BYTES / packet_size;
+	uint64_t packet = 0;
+	uint64_t start, end, self_start, self_end, child_start, child_end;
+	os_process_pipe_t *pipe;
+
+	for (size_t i = 0; i < WRITE_PACKETS; i++) {
+		payloads[i] = bmalloc(packet_size);
+		for (size_t j = 0; j < packet_size; j++)
+			payloads[i][j] = (uint8_t)(i * 31 + j);
+	}
+
+	args = os_process_args_create(self_path);
+	os_process_args_add_arg(args, "--consumer");
+
+	child_start = cpu_time_ns(RUSAGE_CHILDREN);
+	self_start = cpu_time_ns(RUSAGE_SELF);
+	start = os_gettime_ns();
+
+	pipe = os_process_pipe_create2(args, "w");
+	assert_non_null(pipe);
+
+	if (use_shm)
+		assert_true(send_ring(pipe, &shm));
+
+	while (packet < num_packets) {
+		size_t count = num_packets - packet;
+		size_t num_bufs = 0;
+		size_t total = 0;
+
+		if (count > WRITE_PACKETS)
+			count = WRITE_PACKETS;
+
+		for (size_t i = 0; i < count; i++) {
+			uint8_t *data = payloads[i];
+			uint64_t num = packet + i;
+			memcpy(data, &num, sizeof(num));
+
+			info[i] = (struct ffm_packet_info){
+				.size = (uint32_t)packet_size,
+				.type = FFM_PACKET_VIDEO};
+			info[i].shared = mux_shm_push(&shm, data, packet_size,
+						      &info[i].shm_pos);
+
+			bufs[num_bufs].data = (const uint8_t *)&info[i];
+			bufs[num_bufs++].len = sizeof(info[i]);
+			total += sizeof(info[i]);
+
+			if (!info[i].shared) {
+				bufs[num_bufs].data = data;
+				bufs[num_bufs++].len = packet_size;
+				total += packet_size;
+			}
+		}
+
+		assert_int_equal(os_process_pipe_writev(pipe, bufs, num_bufs),
+				 total);
+		packet += count;
+	}
+
+	/* waits for the child, so its cpu time is accounted for */
+	assert_int_equal(os_process_pipe_destroy(pipe), 0);
+
+	end = os_gettime_ns();
+	self_end = cpu_time_ns(RUSAGE_SELF);
+	child_end = cpu_time_ns(RUSAGE_CHILDREN);
+
+	double gb = (double)(num_packets * packet_size) / 1e9;
+	double secs = (double)(end - start) / 1e9;
+
+	print_message("%-4s %7zu byte packets: %7.1f MB/s, cpu per GB: "
+		      "obs %6.1f ms, mux %6.1f ms (%.0f%% shared)\n",
+		      use_shm ? "shm" : "pipe", packet_size, gb * 1000.0 / secs,
+		      (double)(self_end - self_start) / 1e6 / gb,
+		      (double)(child_end - child_start) / 1e6 / gb,
+		      (double)shm.shared_bytes * 100.0 /
+			      (double)(num_packets * packet_size));
+
+	if (use_shm)
+		assert_true(shm.shared_bytes > 0);
+
+	mux_shm_destroy(&shm);
+	for (size_t i = 0; i < WRITE_PACKETS; i++)
+		bfree(payloads[i]);
+	os_process_args_destroy(args);
+}
+
+/* audio sized, typical video and keyframe sized packets */
+static void mux_shm_throughput_test(void **state)
+{
+	static const size_t sizes[] = {4096, 65536, 524288};
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		transfer(sizes[i], false);
+		transfer(sizes[i], true);
+	}
+}
+
+/* positions keep going past 4 GiB, while ffmpeg-mux only shares the low 32
+ * bits of its read position */
+static void mux_shm_position_wrap_test(void **state)
+{
+	uint8_t payload[4096] = {0};
+	struct mux_shm shm;
+	uint64_t pos;
+	UNUSED_PARAMETER(state);
+
+	assert_true(mux_shm_create(&shm, SHM_SIZE));
+	os_atomic_set_long(&shm.header->ready, 1);
+
+	for (uint64_t start = 0xFFFF0000ULL; start < 0x1000100000ULL;
+	     start += 0xFFFF0000ULL) {
+		shm.head = start;
+		os_atomic_set_long(&shm.header->tail, (long)(uint32_t)start);
+
+		/* an empty ring, and one that is only missing the payload */
+		for (size_t i = 0; i < SHM_SIZE / sizeof(payload); i++)
+			assert_true(mux_shm_push(&shm, payload,
+						 sizeof(payload), &pos));
+		assert_false(mux_shm_push(&shm, payload, sizeof(payload),
+					  &pos));
+
+		os_atomic_set_long(&shm.header->tail,
+				   (long)(uint32_t)(start + sizeof(payload)));
+		assert_true(mux_shm_push(&shm, payload, sizeof(payload), &pos));
+		assert_int_equal(pos % SHM_SIZE, start % SHM_SIZE);
+	}
+
+	mux_shm_destroy(&shm);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(mux_shm_position_wrap_test),
+		cmocka_unit_test(mux_shm_throughput_test),
+	};
+
+	if (argc > 1 && strcmp(argv[1], "--consumer") == 0)
+		return run_consumer();
+
+	self_path = argv[0];
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,574 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <obs-data.h>
+#include <util/platform.h>
+
+#define NUM_KEYS 2000
+#define LOOKUPS 1000000
+
+#define NUM_SOURCES 500
+#define JSON_PASSES 20
+
+struct fields_test {
+	long long width;
+	double scale;
+	bool enabled;
+	const char *path;
+	long long missing;
+};
+
+static void data_fields_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static struct obs_data_field fields[] = {
+		OBS_DATA_FIELD("width", OBS_DATA_FIELD_INT, struct fields_test,
+			       width),
+		OBS_DATA_FIELD("scale", OBS_DATA_FIELD_DOUBLE,
+			       struct fields_test, scale),
+		OBS_DATA_FIELD("enabled", OBS_DATA_FIELD_BOOL,
+			       struct fields_test, enabled),
+		OBS_DATA_FIELD("path", OBS_DATA_FIELD_STRING,
+			       struct fields_test, path),
+		OBS_DATA_FIELD("missing", OBS_DATA_FIELD_INT,
+			       struct fields_test, missing),
+	};
+
+	obs_data_t *data = obs_data_create();
+	struct fields_test out = {0};
+
+	obs_data_set_int(data, "width", 1920);
+	obs_data_set_double(data, "scale", 0.5);
+	obs_data_set_bool(data, "enabled", true);
+	obs_data_set_string(data, "path", "/tmp/test");
+	obs_data_set_default_int(data, "missing", 7);
+
+	obs_data_fields_init(fields, 5);
+	obs_data_get_fields(data, fields, 5, &out);
+
+	assert_int_equal(out.width, 1920);
+	assert_true(out.scale == 0.5);
+	assert_true(out.enabled);
+	assert_string_equal(out.path, "/tmp/test");
+	assert_int_equal(out.missing, 7);
+
+	obs_data_release(data);
+}
+
+/* compares lookups by name against pre-hashed keys on a large object */
+static void data_key_lookup_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_key_t keys[NUM_KEYS];
+	char names[NUM_KEYS][32];
+	long long sum_name = 0;
+	long long sum_key = 0;
+	uint64_t start, name_ns, key_ns;
+
+	for (size_t i = 0; i < NUM_KEYS; i++) {
+		snprintf(names[i], sizeof(names[i]), "setting_name_%zu", i);
+		obs_data_set_int(data, names[i], (long long)i);
+		keys[i] = obs_data_key_create(names[i]);
+	}
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < LOOKUPS; i++)
+		sum_name += obs_data_get_int(data, names[i % NUM_KEYS]);
+	name_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < LOOKUPS; i++)
+		sum_key += obs_data_get_int_key(data, &keys[i % NUM_KEYS]);
+	key_ns = os_gettime_ns() - start;
+
+	assert_int_equal(sum_name, sum_key);
+	print_message("%d keys: %.1f ns per lookup by name, "
+		      "%.1f ns per lookup by key\n",
+		      NUM_KEYS, (double)name_ns / LOOKUPS,
+		      (double)key_ns / LOOKUPS);
+
+	obs_data_release(data);
+}
+
+static obs_data_t *create_scene_collection(void)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	char name[64];
+
+	obs_data_set_string(collection, "name", "Benchmark \"Collection\"");
+	obs_data_set_string(collection, "current_scene", "Scene 0");
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		obs_data_t *source = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		obs_data_array_t *filters = obs_data_array_create();
+
+		snprintf(name, sizeof(name), "Source %zu \u00e9\t", i);
+		obs_data_set_string(source, "name", name);
+		obs_data_set_string(source, "id", "ffmpeg_source");
+		obs_data_set_int(source, "flags", (long long)i * 31);
+		obs_data_set_double(source, "volume", 1.0 / (double)(i + 1));
+		obs_data_set_bool(source, "enabled", i % 2 == 0);
+
+		for (size_t j = 0; j < 20; j++) {
+			snprintf(name, sizeof(name), "setting_%zu", j);
+			if (j % 3 == 0)
+				obs_data_set_string(settings, name,
+						    "/home/user/Videos/clip.mkv");
+			else if (j % 3 == 1)
+				obs_data_set_int(settings, name,
+						 (long long)(i * j) - 500);
+			else
+				obs_data_set_double(settings, name,
+						    (double)j * 0.1);
+		}
+
+		for (size_t j = 0; j < 3; j++) {
+			obs_data_t *filter = obs_data_create();
+			obs_data_set_string(filter, "id", "color_filter");
+			obs_data_set_double(filter, "gamma", (double)j - 0.5);
+			obs_data_array_push_back(filters, filter);
+			obs_data_release(filter);
+		}
+
+		obs_data_set_obj(source, "settings", settings);
+		obs_data_set_array(source, "filters", filters);
+		obs_data_array_push_back(sources, source);
+
+		obs_data_array_release(filters);
+		obs_data_release(settings);
+		obs_data_release(source);
+	}
+
+	obs_data_set_array(collection, "sources", sources);
+	obs_data_array_release(sources);
+	return collection;
+}
+
+/* saves and loads a large generated scene collection, checking that it
+ * survives the round trip and reporting the time taken for each */
+static void data_json_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *collection = create_scene_collection();
+	uint64_t start, save_ns = 0, load_ns = 0;
+	size_t size = 0;
+
+	for (size_t i = 0; i < JSON_PASSES; i++) {
+		start = os_gettime_ns();
+		const char *json = obs_data_get_json_pretty(collection);
+		save_ns += os_gettime_ns() - start;
+
+		size = strlen(json);
+
+		start = os_gettime_ns();
+		obs_data_t *loaded = obs_data_create_from_json(json);
+		load_ns += os_gettime_ns() - start;
+
+		assert_non_null(loaded);
+		assert_string_equal(obs_data_get_json_pretty(loaded), json);
+		obs_data_release(loaded);
+	}
+
+	assert_true(obs_data_create_from_json("{\"a\":1,\"a\":2}") == NULL);
+	assert_true(obs_data_create_from_json("{\"a\":[1,]}") == NULL);
+
+	print_message("%zu byte collection: %.2f ms per save, "
+		      "%.2f ms per load\n",
+		      size, (double)save_ns / JSON_PASSES / 1000000.0,
+		      (double)load_ns / JSON_PASSES / 1000000.0);
+
+	obs_data_release(collection);
+}
+
+/* every one of these is rejected by jansson with JSON_REJECT_DUPLICATES */
+static const char *invalid_json[] = {
+	"",
+	"   ",
+	"1",
+	"\"a\"",
+	"{",
+	"[",
+	"{\"a\"}",
+	"{\"a\":}",
+	"{\"a\" 1}",
+	"{\"a\":1,}",
+	"{,}",
+	"{a:1}",
+	"{'a':1}",
+	"{\"a\":1} x",
+	"{\"a\":1}}",
+	"{\"a\":[1,]}",
+	"{\"a\":[,1]}",
+	"{\"a\":tru}",
+	"{\"a\":nul}",
+	"{\"a\":True}",
+	"{\"a\":NaN}",
+	"{\"a\":Infinity}",
+	/* numbers */
+	"{\"a\":01}",
+	"{\"a\":-}",
+	"{\"a\":+1}",
+	"{\"a\":1.}",
+	"{\"a\":.5}",
+	"{\"a\":1e}",
+	"{\"a\":1e+}",
+	"{\"a\":0x10}",
+	"{\"a\":1e400}",
+	"{\"a\":-1e400}",
+	"{\"a\":9223372036854775808}",
+	"{\"a\":-9223372036854775809}",
+	/* strings */
+	"{\"a\":\"abc}",
+	"{\"a\":\"\\x\"}",
+	"{\"a\":\"\\u12\"}",
+	"{\"a\":\"\\u12g4\"}",
+	"{\"a\":\"\\u0000\"}",
+	"{\"a\":\"\\ud800\"}",
+	"{\"a\":\"\\ud800x\"}",
+	"{\"a\":\"\\ud800\\u0041\"}",
+	"{\"a\":\"\\udc00\"}",
+	"{\"a\":\"\t\"}",
+	"{\"a\":\"\n\"}",
+	"{\"a\":\"\xff\"}",
+	"{\"a\":\"\xc3\"}",
+	"{\"a\":\"\xc0\xaf\"}",
+	"{\"a\":\"\xed\xa0\x80\"}",
+	"{\"\xff\":1}",
+	/* duplicate keys, including null values and objects that are not
+	 * kept because they are not directly in an array of objects */
+	"{\"a\":1,\"a\":2}",
+	"{\"a\":1,\"a\":\"1\"}",
+	"{\"a\":null,\"a\":1}",
+	"{\"a\":1,\"a\":null}",
+	"{\"a\":null,\"a\":null}",
+	"{\"a\":null,\"o\":{\"b\":null},\"a\":{}}",
+	"{\"\":1,\"\":2}",
+	"{\"\\u0061\":1,\"a\":2}",
+	"{\"o\":{\"a\":{},\"a\":[]}}",
+	"{\"x\":[{\"a\":1,\"a\":2}]}",
+	"{\"x\":[[{\"a\":1,\"a\":2}]]}",
+	"{\"x\":[1,{\"o\":{\"a\":null,\"a\":null}}]}",
+	"{\"x\":[[{\"o\":{\"a\":1,\"a\":null}}]]}",
+	"[{\"a\":1,\"a\":2}]",
+};
+
+/* while these are accepted */
+static const char *valid_json[] = {
+	"{}",
+	" \t\r\n{ \t\r\n} \t\r\n",
+	"[]",
+	"[1,\"a\",null,true,{}]",
+	"{\"a\":null}",
+	"{\"a\":null,\"b\":null}",
+	"{\"a\":null,\"o\":{\"a\":1}}",
+	"{\"o\":{\"a\":null},\"a\":1}",
+	"{\"o\":{\"a\":null},\"p\":{\"a\":null}}",
+	"{\"x\":[{\"a\":null},{\"a\":null}]}",
+	"{\"x\":[[{\"a\":1}],[{\"a\":1}]]}",
+	"{\"a\":1,\"A\":2}",
+	"{\"\":1}",
+	"{\"a\":-0,\"b\":-0.0,\"c\":0e0,\"d\":1E+2,\"e\":1e-400}",
+};
+
+static void data_json_parse_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < sizeof(invalid_json) / sizeof(*invalid_json);
+	     i++) {
+		obs_data_t *data = obs_data_create_from_json(invalid_json[i]);
+		if (data)
+			fail_msg("accepted: %s", invalid_json[i]);
+	}
+
+	for (size_t i = 0; i < sizeof(valid_json) / sizeof(*valid_json);
+	     i++) {
+		obs_data_t *data = obs_data_create_from_json(valid_json[i]);
+		if (!data)
+			fail_msg("rejected: %s", valid_json[i]);
+		obs_data_release(data);
+	}
+}
+
+static void data_json_escape_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(
+		"{\"s\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\","
+		"\"u\":\"\\u0041\\u00e9\\u20AC\\u001f\\u007f\","
+		"\"pair\":\"\\ud83d\\ude00\\uD834\\uDD1E\","
+		"\"raw\":\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\","
+		"\"\\u006b\\u0065\\u0079\":true}");
+
+	assert_non_null(data);
+	assert_string_equal(obs_data_get_string(data, "s"),
+			    "\"\\/\b\f\n\r\t");
+	assert_string_equal(obs_data_get_string(data, "u"),
+			    "A\xc3\xa9\xe2\x82\xac\x1f\x7f");
+	assert_string_equal(obs_data_get_string(data, "pair"),
+			    "\xf0\x9f\x98\x80\xf0\x9d\x84\x9e");
+	assert_string_equal(obs_data_get_string(data, "raw"),
+			    "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+	assert_true(obs_data_get_bool(data, "key"));
+
+	/* only control characters, quotes and backslashes are escaped */
+	assert_string_equal(
+		obs_data_get_json(data),
+		"{\"s\":\"\\\"\\\\/\\b\\f\\n\\r\\t\","
+		"\"u\":\"A\xc3\xa9\xe2\x82\xac\\u001F\x7f\","
+		"\"pair\":\"\xf0\x9f\x98\x80\xf0\x9d\x84\x9e\","
+		"\"raw\":\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\","
+		"\"key\":true}");
+
+	obs_data_release(data);
+}
+
+static void assert_int_item(obs_data_t *data, const char *name, long long val)
+{
+	obs_data_item_t *item = obs_data_item_byname(data, name);
+
+	assert_non_null(item);
+	assert_int_equal(obs_data_item_numtype(item), OBS_DATA_NUM_INT);
+	assert_true(obs_data_item_get_int(item) == val);
+	obs_data_item_release(&item);
+}
+
+static void assert_double_item(obs_data_t *data, const char *name,
+			       double val)
+{
+	obs_data_item_t *item = obs_data_item_byname(data, name);
+
+	assert_non_null(item);
+	assert_int_equal(obs_data_item_numtype(item), OBS_DATA_NUM_DOUBLE);
+	assert_true(obs_data_item_get_double(item) == val);
+	assert_true(!!signbit(obs_data_item_get_double(item)) ==
+		    !!signbit(val));
+	obs_data_item_release(&item);
+}
+
+static void data_json_number_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(
+		"{\"zero\":0,\"neg_zero\":-0,\"max\":9223372036854775807,"
+		"\"min\":-9223372036854775808,\"real_neg_zero\":-0.0,"
+		"\"exp\":1e3,\"exp_upper\":1E+2,\"exp_neg\":25e-1,"
+		"\"exp_zero\":0e0,\"frac\":0.125,\"huge\":1.5e308,"
+		"\"tiny\":1e-400,\"neg_exp\":-2.5E-3}");
+
+	assert_non_null(data);
+
+	assert_int_item(data, "zero", 0);
+	assert_int_item(data, "neg_zero", 0);
+	assert_int_item(data, "max", LLONG_MAX);
+	assert_int_item(data, "min", LLONG_MIN);
+
+	assert_double_item(data, "real_neg_zero", -0.0);
+	assert_double_item(data, "exp", 1000.0);
+	assert_double_item(data, "exp_upper", 100.0);
+	assert_double_item(data, "exp_neg", 2.5);
+	assert_double_item(data, "exp_zero", 0.0);
+	assert_double_item(data, "frac", 0.125);
+	assert_double_item(data, "huge", 1.5e308);
+	assert_double_item(data, "tiny", 0.0);
+	assert_double_item(data, "neg_exp", -2.5e-3);
+
+	assert_string_equal(
+		obs_data_get_json(data),
+		"{\"zero\":0,\"neg_zero\":0,\"max\":9223372036854775807,"
+		"\"min\":-9223372036854775808,\"real_neg_zero\":-0.0,"
+		"\"exp\":1000.0,\"exp_upper\":100.0,\"exp_neg\":2.5,"
+		"\"exp_zero\":0.0,\"frac\":0.125,\"huge\":1.5e308,"
+		"\"tiny\":0.0,\"neg_exp\":-0.0025000000000000001}");
+
+	obs_data_release(data);
+}
+
+static obs_data_t *create_json_fixture(void)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *empty = obs_data_create();
+	obs_data_t *nested = obs_data_create();
+	obs_data_t *item = obs_data_create();
+	obs_data_array_t *items = obs_data_array_create();
+	obs_data_array_t *empty_array = obs_data_array_create();
+
+	obs_data_set_string(data, "name",
+			    "Scene \"1\" \\ \n\t\x01\x1f\x7f "
+			    "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 </b>");
+	obs_data_set_string(data, "", "empty key");
+	obs_data_set_string(data, "empty string", "");
+	obs_data_set_int(data, "zero", 0);
+	obs_data_set_int(data, "negative", -42);
+	obs_data_set_int(data, "min", LLONG_MIN);
+	obs_data_set_int(data, "max", LLONG_MAX);
+	obs_data_set_double(data, "half", 0.5);
+	obs_data_set_double(data, "tenth", 0.1);
+	obs_data_set_double(data, "third", 1.0 / 3.0);
+	obs_data_set_double(data, "whole", 100.0);
+	obs_data_set_double(data, "negative zero", -0.0);
+	obs_data_set_double(data, "big", 1e300);
+	obs_data_set_double(data, "precise", 123456789012345678.0);
+	obs_data_set_double(data, "small", 1.5e-7);
+	obs_data_set_bool(data, "on", true);
+	obs_data_set_bool(data, "off", false);
+
+	obs_data_set_default_int(data, "overridden", 1);
+	obs_data_set_int(data, "overridden", 2);
+	obs_data_set_default_string(data, "default", "only a default");
+
+	obs_data_set_obj(data, "empty", empty);
+	obs_data_set_array(data, "empty array", empty_array);
+
+	obs_data_set_int(item, "id", 1);
+	obs_data_set_obj(item, "empty", empty);
+	obs_data_array_push_back(items, item);
+	obs_data_array_push_back(items, empty);
+	obs_data_set_array(nested, "items", items);
+	obs_data_set_string(nested, "type", "group");
+	obs_data_set_obj(data, "nested", nested);
+
+	obs_data_array_release(empty_array);
+	obs_data_array_release(items);
+	obs_data_release(item);
+	obs_data_release(nested);
+	obs_data_release(empty);
+	return data;
+}
+
+/* written by jansson 2.14 from the same data, with JSON_PRESERVE_ORDER and
+ * JSON_COMPACT or JSON_INDENT(4) */
+static const char *fixture_json =
+	"{\"name\":\"Scene \\\"1\\\" \\\\ \\n\\t\\u0001\\u001F\x7f"
+	" \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 </b>\","
+	"\"\":\"empty key\",\"empty string\":\"\",\"zero\":0,"
+	"\"negative\":-42,\"min\":-9223372036854775808,"
+	"\"max\":9223372036854775807,\"half\":0.5,"
+	"\"tenth\":0.10000000000000001,\"third\":0.33333333333333331,"
+	"\"whole\":100.0,\"negative zero\":-0.0,"
+	"\"big\":1.0000000000000001e300,"
+	"\"precise\":1.2345678901234568e17,"
+	"\"small\":1.4999999999999999e-7,\"on\":true,\"off\":false,"
+	"\"overridden\":2,\"empty\":{},\"empty array\":[],"
+	"\"nested\":{\"items\":[{\"id\":1,\"empty\":{}},{}],"
+	"\"type\":\"group\"}}";
+
+static const char *fixture_json_pretty =
+	"{\n"
+	"    \"name\": \"Scene \\\"1\\\" \\\\ \\n\\t\\u0001\\u001F\x7f"
+	" \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 </b>\",\n"
+	"    \"\": \"empty key\",\n"
+	"    \"empty string\": \"\",\n"
+	"    \"zero\": 0,\n"
+	"    \"negative\": -42,\n"
+	"    \"min\": -9223372036854775808,\n"
+	"    \"max\": 9223372036854775807,\n"
+	"    \"half\": 0.5,\n"
+	"    \"tenth\": 0.10000000000000001,\n"
+	"    \"third\": 0.33333333333333331,\n"
+	"    \"whole\": 100.0,\n"
+	"    \"negative zero\": -0.0,\n"
+	"    \"big\": 1.0000000000000001e300,\n"
+	"    \"precise\": 1.2345678901234568e17,\n"
+	"    \"small\": 1.4999999999999999e-7,\n"
+	"    \"on\": true,\n"
+	"    \"off\": false,\n"
+	"    \"overridden\": 2,\n"
+	"    \"empty\": {},\n"
+	"    \"empty array\": [],\n"
+	"    \"nested\": {\n"
+	"        \"items\": [\n"
+	"            {\n"
+	"                \"id\": 1,\n"
+	"                \"empty\": {}\n"
+	"            },\n"
+	"            {}\n"
+	"        ],\n"
+	"        \"type\": \"group\"\n"
+	"    }\n"
+	"}";
+
+static const char *fixture_json_defaults =
+	"{\n"
+	"    \"name\": \"Scene \\\"1\\\" \\\\ \\n\\t\\u0001\\u001F\x7f"
+	" \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 </b>\",\n"
+	"    \"\": \"empty key\",\n"
+	"    \"empty string\": \"\",\n"
+	"    \"zero\": 0,\n"
+	"    \"negative\": -42,\n"
+	"    \"min\": -9223372036854775808,\n"
+	"    \"max\": 9223372036854775807,\n"
+	"    \"half\": 0.5,\n"
+	"    \"tenth\": 0.10000000000000001,\n"
+	"    \"third\": 0.33333333333333331,\n"
+	"    \"whole\": 100.0,\n"
+	"    \"negative zero\": -0.0,\n"
+	"    \"big\": 1.0000000000000001e300,\n"
+	"    \"precise\": 1.2345678901234568e17,\n"
+	"    \"small\": 1.4999999999999999e-7,\n"
+	"    \"on\": true,\n"
+	"    \"off\": false,\n"
+	"    \"overridden\": 2,\n"
+	"    \"default\": \"only a default\",\n"
+	"    \"empty\": {},\n"
+	"    \"empty array\": [],\n"
+	"    \"nested\": {\n"
+	"        \"items\": [\n"
+	"            {\n"
+	"                \"id\": 1,\n"
+	"                \"empty\": {}\n"
+	"            },\n"
+	"            {}\n"
+	"        ],\n"
+	"        \"type\": \"group\"\n"
+	"    }\n"
+	"}";
+
+static void data_json_writer_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_json_fixture();
+
+	assert_string_equal(obs_data_get_json(data), fixture_json);
+	assert_string_equal(obs_data_get_json_pretty(data),
+			    fixture_json_pretty);
+	assert_string_equal(obs_data_get_json_pretty_with_defaults(data),
+			    fixture_json_defaults);
+
+	obs_data_t *loaded = obs_data_create_from_json(fixture_json_pretty);
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_json(loaded), fixture_json);
+	obs_data_release(loaded);
+
+	obs_data_release(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(data_fields_test),
+		cmocka_unit_test(data_key_lookup_test),
+		cmocka_unit_test(data_json_test),
+		cmocka_unit_test(data_json_parse_test),
+		cmocka_unit_test(data_json_escape_test),
+		cmocka_unit_test(data_json_number_test),
+		cmocka_unit_test(data_json_writer_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
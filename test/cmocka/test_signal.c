@@ -0,0 +1,170 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+static void count_cb(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	os_atomic_inc_long(data);
+}
+
+static void remove_self_cb(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	os_atomic_inc_long(data);
+	signal_handler_remove_current();
+}
+
+struct connect_data {
+	signal_handler_t *handler;
+	volatile long count;
+};
+
+static void connect_cb(void *data, calldata_t *cd)
+{
+	struct connect_data *cb = data;
+	UNUSED_PARAMETER(cd);
+
+	signal_handler_connect(cb->handler, "test", count_cb,
+			       (void *)&cb->count);
+	signal_handler_remove_current();
+}
+
+static void signal_basic_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct signal_id id = signal_id_create("test");
+	volatile long a = 0;
+	volatile long b = 0;
+
+	assert_true(signal_handler_add(handler, "void test()"));
+	assert_true(signal_handler_add(handler, "void other()"));
+	assert_true(!signal_handler_add(handler, "void test()"));
+
+	signal_handler_connect(handler, "test", count_cb, (void *)&a);
+	signal_handler_connect(handler, "test", count_cb, (void *)&a);
+	signal_handler_connect(handler, "test", remove_self_cb, (void *)&b);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal_id(handler, &id, NULL);
+	signal_handler_signal(handler, "other", NULL);
+
+	assert_int_equal(a, 2);
+	assert_int_equal(b, 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, (void *)&a);
+	signal_handler_signal(handler, "test", NULL);
+
+	assert_int_equal(a, 2);
+
+	/* connected during an emission, so only called by the next one */
+	struct connect_data cd = {handler, 0};
+	signal_handler_connect(handler, "test", connect_cb, &cd);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(cd.count, 0);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(cd.count, 1);
+
+	signal_handler_destroy(handler);
+}
+
+struct emit_thread {
+	signal_handler_t *handler;
+	struct signal_id id;
+	volatile long *count;
+	volatile bool *stop;
+	long emits;
+};
+
+static void *emit_thread(void *data)
+{
+	struct emit_thread *et = data;
+
+	while (!os_atomic_load_bool(et->stop)) {
+		signal_handler_signal_id(et->handler, &et->id, NULL);
+		et->emits++;
+	}
+
+	return NULL;
+}
+
+#define EMIT_THREADS 4
+
+/* emits from several threads while callbacks are connected and disconnected
+ * and signals are added, and reports the emit rate */
+static void signal_contention_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct emit_thread threads[EMIT_THREADS];
+	pthread_t ids[EMIT_THREADS];
+	volatile long count = 0;
+	volatile long churn = 0;
+	volatile bool stop = false;
+	struct dstr decl = {0};
+	uint64_t start, end;
+	long emits = 0;
+
+	signal_handler_add(handler, "void test()");
+	signal_handler_connect(handler, "test", count_cb, (void *)&count);
+
+	start = os_gettime_ns();
+
+	for (size_t i = 0; i < EMIT_THREADS; i++) {
+		threads[i].handler = handler;
+		threads[i].id = signal_id_create("test");
+		threads[i].count = &count;
+		threads[i].stop = &stop;
+		threads[i].emits = 0;
+		pthread_create(&ids[i], NULL, emit_thread, &threads[i]);
+	}
+
+	for (size_t i = 0; i < 1000; i++) {
+		signal_handler_connect(handler, "test", count_cb,
+				       (void *)&churn);
+		signal_handler_disconnect(handler, "test", count_cb,
+					  (void *)&churn);
+
+		if (i % 10 == 0) {
+			dstr_printf(&decl, "void extra%zu()", i);
+			assert_true(signal_handler_add(handler, decl.array));
+		}
+	}
+
+	os_sleep_ms(100);
+	os_atomic_set_bool(&stop, true);
+
+	for (size_t i = 0; i < EMIT_THREADS; i++) {
+		pthread_join(ids[i], NULL);
+		emits += threads[i].emits;
+	}
+
+	end = os_gettime_ns();
+
+	assert_int_equal(count, emits);
+	print_message("%ld emits from %d threads, %.0f emits/sec\n", emits,
+		      EMIT_THREADS,
+		      (double)emits * 1000000000.0 / (double)(end - start));
+
+	dstr_free(&decl);
+	signal_handler_destroy(handler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(signal_basic_test),
+		cmocka_unit_test(signal_contention_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
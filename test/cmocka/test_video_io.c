@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+
+#define HANDOFF_FRAMES 20000
+
+struct handoff {
+	uint64_t *latencies;
+	volatile long received;
+	uint64_t last_timestamp;
+	bool in_order;
+};
+
+static void handoff_cb(void *param, struct video_data *frame)
+{
+	struct handoff *h = param;
+	uint64_t now = os_gettime_ns();
+	long idx = os_atomic_load_long(&h->received);
+
+	if (frame->timestamp <= h->last_timestamp)
+		h->in_order = false;
+	h->last_timestamp = frame->timestamp;
+
+	if (idx < HANDOFF_FRAMES)
+		h->latencies[idx] = now - frame->timestamp;
+	os_atomic_inc_long(&h->received);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t *)a;
+	uint64_t val_b = *(const uint64_t *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static video_t *open_output(void)
+{
+	struct video_output_info info = {0};
+	video_t *video = NULL;
+
+	info.name = "test";
+	info.format = VIDEO_FORMAT_NV12;
+	info.fps_num = 60;
+	info.fps_den = 1;
+	info.width = 64;
+	info.height = 64;
+	info.cache_size = 16;
+	info.colorspace = VIDEO_CS_709;
+	info.range = VIDEO_RANGE_PARTIAL;
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+/* hands frames to the video thread one at a time and measures how long it
+ * takes each of them to reach the input callback */
+static void handoff_latency(bool parallel)
+{
+	struct handoff h = {0};
+	struct video_frame frame;
+	video_t *video = open_output();
+
+	h.latencies = bzalloc(HANDOFF_FRAMES * sizeof(uint64_t));
+	h.in_order = true;
+
+	assert_true(video_output_set_parallel_delivery(video, parallel));
+	assert_true(video_output_connect(video, NULL, handoff_cb, &h));
+
+	for (long i = 0; i < HANDOFF_FRAMES; i++) {
+		assert_true(video_output_lock_frame(video, &frame, 1,
+						    os_gettime_ns()));
+		video_output_unlock_frame(video);
+
+		while (os_atomic_load_long(&h.received) <= i)
+			;
+	}
+
+	video_output_disconnect(video, handoff_cb, &h);
+	video_output_close(video);
+
+	assert_true(h.in_order);
+	assert_int_equal(h.received, HANDOFF_FRAMES);
+
+	qsort(h.latencies, HANDOFF_FRAMES, sizeof(uint64_t), compare_u64);
+	print_message("%s handoff: median %.2f us, p99 %.2f us, max %.2f us\n",
+		      parallel ? "parallel" : "serial",
+		      (double)h.latencies[HANDOFF_FRAMES / 2] / 1000.0,
+		      (double)h.latencies[HANDOFF_FRAMES * 99 / 100] / 1000.0,
+		      (double)h.latencies[HANDOFF_FRAMES - 1] / 1000.0);
+
+	bfree(h.latencies);
+}
+
+static void video_io_handoff_latency_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	handoff_latency(false);
+	handoff_latency(true);
+}
+
+/* produces frames as fast as possible, so the ring is regularly full and
+ * the newest frame is repeated instead */
+static void video_io_handoff_throughput_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct handoff h = {0};
+	struct video_frame frame;
+	video_t *video = open_output();
+	uint64_t start, end;
+	long locked = 0;
+
+	h.latencies = bzalloc(HANDOFF_FRAMES * sizeof(uint64_t));
+
+	assert_true(video_output_connect(video, NULL, handoff_cb, &h));
+
+	start = os_gettime_ns();
+
+	for (long i = 0; i < HANDOFF_FRAMES; i++) {
+		if (video_output_lock_frame(video, &frame, 1,
+					    os_gettime_ns())) {
+			video_output_unlock_frame(video);
+			locked++;
+		}
+	}
+
+	while (os_atomic_load_long(&h.received) < locked)
+		os_sleep_ms(1);
+
+	end = os_gettime_ns();
+
+	/* let the video thread finish any repeated frames */
+	os_sleep_ms(50);
+	video_output_disconnect(video, handoff_cb, &h);
+
+	assert_int_equal(video_output_get_total_frames(video),
+			 os_atomic_load_long(&h.received));
+
+	print_message("%d frames produced in %.2f ms: %ld handed off, "
+		      "%u repeated\n",
+		      HANDOFF_FRAMES, (double)(end - start) / 1000000.0,
+		      locked, video_output_get_skipped_frames(video));
+
+	video_output_close(video);
+	bfree(h.latencies);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(video_io_handoff_latency_test),
+		cmocka_unit_test(video_io_handoff_throughput_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}